@@ -16,6 +16,10 @@
 #include "bayou.h"
 #include "self.h"
 
+#ifdef CONFIG_LZMA
+#include <lzma.h>
+#endif
+
 static int nop_decompress(void *dst, void *src, int len)
 {
 	memcpy(dst, src, len);
@@ -23,8 +27,6 @@ static int nop_decompress(void *dst, void *src, int len)
 }
 
 #ifdef CONFIG_LZMA
-extern int ulzma(u8 *, u8 *);
-
 static int lzma_decompress(void *dst, void *src, int len)
 {
 	return ulzma((u8 *) src, (u8 *) dst);
@@ -80,4 +80,7 @@ int run_address(void *f);
 /* Defined in individual arch / board implementation. */
 int init_default_cbfs_media(struct cbfs_media *media);
 
+/* Changes whenever the default media is set up again. */
+unsigned int cbfs_default_media_generation(void);
+
 #endif
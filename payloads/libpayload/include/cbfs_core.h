@@ -59,6 +59,7 @@
 #define CBFS_COMPRESS_NONE  0
 #define CBFS_COMPRESS_LZMA  1
 #define CBFS_COMPRESS_LZ4   2
+#define CBFS_COMPRESS_ZSTD  3
 
 /** These are standard component types for well known
     components (i.e - those that coreboot needs to consume.
@@ -167,7 +168,7 @@ struct cbfs_file_attr_hash {
 	uint32_t hash_type;
 	/* hash_data is len - sizeof(struct) bytes */
 	uint8_t  hash_data[];
-} __PACKED;
+} __attribute__((packed));
 
 /*** Component sub-headers ***/
 
@@ -281,4 +282,72 @@ void *cbfs_get_attr(struct cbfs_handle *handle, uint32_t tag);
  * If |limit| is not 0, will only return up to that many bytes. */
 void *cbfs_get_contents(struct cbfs_handle *handle, size_t *size, size_t limit);
 
+/* Sequential access to the (decompressed) file contents, which only needs
+ * memory for the decompression window instead of the whole file. For LZMA
+ * the window is the dictionary size of the file, for LZ4 at most 64KiB. A
+ * Zstandard file needs a window for all of its contents. */
+struct cbfs_stream;
+
+/* Returns a stream of the contents of the file, or NULL on error. Caller is
+ * responsible to cbfs_stream_close() it after use. */
+struct cbfs_stream *cbfs_stream_open(struct cbfs_handle *handle);
+
+/* Reads the next up to |size| bytes of the contents into |buf|. Returns the
+ * number of bytes read, which is less than |size| only at the end of the
+ * contents, or -1 on error. */
+ssize_t cbfs_stream_read(struct cbfs_stream *stream, void *buf, size_t size);
+
+void cbfs_stream_close(struct cbfs_stream *stream);
+
+/* Passes the contents of the file to |sink| piece by piece, straight out of
+ * the decompression window. Stops early if |sink| returns non-zero. Returns
+ * the size of the contents, or -1 on error or if |sink| stopped. */
+ssize_t cbfs_stream_process(struct cbfs_handle *handle,
+			    int (*sink)(void *arg, const void *data,
+					size_t size),
+			    void *arg);
+
+/* In-RAM snapshot of the file headers of a CBFS, to look up many files
+ * without walking the media each time. */
+struct cbfs_dir;
+
+struct cbfs_dir_entry {
+	u32 name_offset;		/* into the names of the directory */
+	u32 type;			/* CBFS file type */
+	u32 media_offset;		/* offset from beginning of media */
+	u32 attribute_offset;		/* relative offset of attributes */
+	u32 content_offset;		/* relative offset of contents */
+	u32 content_size;		/* length of file contents in bytes */
+};
+
+/* Reads the directory of the CBFS on media, or NULL on error. Caller is
+ * responsible to cbfs_dir_close() it after use. */
+struct cbfs_dir *cbfs_dir_open(struct cbfs_media *media);
+void cbfs_dir_close(struct cbfs_dir *dir);
+
+/* Makes the next cbfs_dir_lookup() or cbfs_dir_next(dir, NULL) read the
+ * directory again, which invalidates all entries. This happens by itself for
+ * a directory of CBFS_DEFAULT_MEDIA when the default media is set up again. */
+void cbfs_dir_invalidate(struct cbfs_dir *dir);
+
+/* Returns the file following prev in media order, the first file if prev is
+ * NULL, or NULL after the last one. */
+const struct cbfs_dir_entry *cbfs_dir_next(struct cbfs_dir *dir,
+					   const struct cbfs_dir_entry *prev);
+/* Same as cbfs_dir_next(), but only returns files of the given type. */
+const struct cbfs_dir_entry *cbfs_dir_next_type(struct cbfs_dir *dir,
+		const struct cbfs_dir_entry *prev, uint32_t type);
+
+/* Returns the first file with the given name, or NULL if there is none. */
+const struct cbfs_dir_entry *cbfs_dir_lookup(struct cbfs_dir *dir,
+					     const char *name);
+
+const char *cbfs_dir_name(const struct cbfs_dir *dir,
+			  const struct cbfs_dir_entry *entry);
+
+/* Returns a handle to the file, as cbfs_get_handle() would. Caller is
+ * responsible to free() returned handle after use. */
+struct cbfs_handle *cbfs_dir_get_handle(struct cbfs_dir *dir,
+					const struct cbfs_dir_entry *entry);
+
 #endif
@@ -33,6 +33,7 @@
 #define __LZ4_H_
 
 #include <stddef.h>
+#include <stdint.h>
 
 /* Decompresses an LZ4F image (multiple LZ4 blocks with frame header) from src
  * to dst, ensuring that it doesn't read more than srcn bytes and doesn't write
@@ -47,4 +48,52 @@ size_t ulz4fn(const void *src, size_t srcn, void *dst, size_t dstn);
 /* Same as ulz4fn() but does not perform any bounds checks. */
 size_t ulz4f(const void *src, void *dst);
 
+/* Reads up to size bytes of input into buf. Returns the number of bytes
+ * read, or 0 at the end of the input. */
+typedef size_t (*lz4_read_fn)(void *arg, void *buf, size_t size);
+
+#define LZ4_STREAM_BUF_SIZE	4096
+#define LZ4_STREAM_WINDOW	(64 * KiB)	/* > largest offset */
+
+/* State of a streaming decompression of an LZ4F image with independent
+ * blocks. The input is pulled in through read, and the output is decoded
+ * into a window, which holds as much of the previous output as matches
+ * may refer back to. */
+struct lz4_stream {
+	lz4_read_fn read;
+	void *arg;
+	const uint8_t *in;
+	const uint8_t *in_end;
+	uint8_t *window;
+	size_t window_size;
+	size_t pos;			/* in window */
+	size_t total;			/* bytes decoded so far */
+	size_t out_size;		/* from the header, if it has one */
+	size_t block_left;		/* input bytes left in block */
+	size_t block_out;		/* bytes decoded from block */
+	size_t lit_left;		/* literals left in sequence */
+	size_t match_left;		/* bytes left in the current match */
+	uint16_t offset;		/* of the current match */
+	uint8_t token;			/* of the current sequence */
+	uint8_t state;
+	uint8_t has_block_checksum;
+	uint8_t own_window;
+	uint8_t error;
+	uint8_t in_buf[LZ4_STREAM_BUF_SIZE];
+};
+
+/* Reads the frame header and prepares decoding into window, which must be
+ * at least as large as the smaller of LZ4_STREAM_WINDOW and the output
+ * size. If window is NULL, such a window is allocated. Returns 0 on
+ * success, -1 on error. */
+int lz4_stream_init(struct lz4_stream *s, lz4_read_fn read, void *arg,
+		    void *window, size_t window_size);
+
+/* Decodes up to max bytes and points *data at them in the window, where
+ * they stay until the next call. Returns the number of bytes, 0 at the end
+ * of the frame, or -1 on error. */
+ssize_t lz4_stream_next(struct lz4_stream *s, const void **data, size_t max);
+
+void lz4_stream_free(struct lz4_stream *s);
+
 #endif /* __LZ4_H_ */
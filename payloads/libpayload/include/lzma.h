@@ -30,6 +30,10 @@
 #ifndef _LZMA_H
 #define _LZMA_H
 
+#include <commonlib/lzma_decoder.h>
+#include <stddef.h>
+#include <stdint.h>
+
 /* Decompresses the data stream at src to dst. The sizes of the source and
  * destination buffers are in srcn and dstn.
  *
@@ -45,4 +49,38 @@ unsigned long ulzman(const unsigned char *src, unsigned long srcn,
  */
 unsigned long ulzma(const unsigned char *src, unsigned char *dst);
 
+/* Reads up to size bytes of input into buf. Returns the number of bytes
+ * read, or 0 at the end of the input. */
+typedef size_t (*lzma_read_fn)(void *arg, void *buf, size_t size);
+
+#define LZMA_STREAM_BUF_SIZE	4096
+
+/* State of a streaming decompression. The input is pulled in through read,
+ * and the output is decoded into a window, which holds as much of the
+ * previous output as matches may refer back to. */
+struct lzma_stream {
+	lzma_read_fn read;
+	void *arg;
+	struct lzma_decoder dec;
+	uint8_t own_window;
+	uint8_t eof;			/* read has returned 0 */
+	uint8_t error;
+	uint8_t in_buf[LZMA_STREAM_BUF_SIZE];
+};
+
+/* Reads the stream header and prepares decoding into window, which must be
+ * at least as large as the distance of any match, that is the smaller of
+ * the dictionary and the output size. If window is NULL, such a window is
+ * allocated. Returns 0 on success, -1 on error. */
+int lzma_stream_init(struct lzma_stream *s, lzma_read_fn read, void *arg,
+		     void *window, size_t window_size);
+
+/* Decodes up to max bytes and points *data at them in the window, where
+ * they stay until the next call. Returns the number of bytes, 0 at the end
+ * of the stream, or -1 on error. */
+ssize_t lzma_stream_next(struct lzma_stream *s, const void **data,
+			 size_t max);
+
+void lzma_stream_free(struct lzma_stream *s);
+
 #endif
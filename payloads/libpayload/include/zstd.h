@@ -0,0 +1,72 @@
+/*
+ * This file is part of the libpayload project.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _ZSTD_H
+#define _ZSTD_H
+
+#include <commonlib/zstd_decoder.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Decompresses the Zstandard frames at src to dst. The sizes of the source
+ * and destination buffers are in srcn and dstn.
+ *
+ * Returns the decompressed size, or 0 on error
+ */
+size_t uzstdn(const void *src, size_t srcn, void *dst, size_t dstn);
+
+/* Reads up to size bytes of input into buf. Returns the number of bytes
+ * read, or 0 at the end of the input. */
+typedef size_t (*zstd_read_fn)(void *arg, void *buf, size_t size);
+
+/* State of a streaming decompression. The decoder needs all of the output
+ * to resolve matches, so the window holds the whole output, and the input
+ * is pulled in through read all at once before decoding. */
+struct zstd_stream {
+	uint8_t *window;
+	size_t window_size;
+	size_t size;			/* bytes decoded into the window */
+	size_t pos;			/* bytes returned so far */
+	uint8_t own_window;
+};
+
+/* Reads and decodes all input into window, which must be window_size bytes
+ * and at least as large as the output. If window is NULL, a window of
+ * window_size bytes is allocated. Returns 0 on success, -1 on error. */
+int zstd_stream_init(struct zstd_stream *s, zstd_read_fn read, void *arg,
+		     void *window, size_t window_size);
+
+/* Points *data at up to max bytes of the output that follow the ones
+ * returned before. Returns the number of bytes, 0 at the end of the
+ * stream, or -1 on error. */
+ssize_t zstd_stream_next(struct zstd_stream *s, const void **data,
+			 size_t max);
+
+void zstd_stream_free(struct zstd_stream *s);
+
+#endif
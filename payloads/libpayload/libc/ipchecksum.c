@@ -29,25 +29,11 @@
  * SUCH DAMAGE.
  */
 
+#include <commonlib/checksum.h>
 #include <libpayload.h>
 
+/* The implementation is shared with coreboot, see commonlib/checksum.c. */
 unsigned short ipchksum(const void *vptr, unsigned long nbytes)
 {
-	int sum, oddbyte;
-	const unsigned short *ptr = vptr;
-
-	sum = 0;
-	while (nbytes > 1) {
-		sum += *ptr++;
-		nbytes -= 2;
-	}
-	if (nbytes == 1) {
-		oddbyte = 0;
-		((u8 *) & oddbyte)[0] = *(u8 *) ptr;
-		((u8 *) & oddbyte)[1] = 0;
-		sum += oddbyte;
-	}
-	sum = (sum >> 16) + (sum & 0xffff);
-	sum += (sum >> 16);
-	return (~sum);
+	return ip_checksum(vptr, nbytes);
 }
@@ -39,12 +39,17 @@
 #  include <lz4.h>
 #  define CBFS_CORE_WITH_LZ4
 # endif
+# if IS_ENABLED(CONFIG_LP_ZSTD)
+#  include <zstd.h>
+#  define CBFS_CORE_WITH_ZSTD
+# endif
 # define CBFS_MINI_BUILD
 #elif defined(__SMM__)
 # define CBFS_MINI_BUILD
 #else
 # define CBFS_CORE_WITH_LZMA
 # define CBFS_CORE_WITH_LZ4
+# define CBFS_CORE_WITH_ZSTD
 # include <lib.h>
 #endif
 
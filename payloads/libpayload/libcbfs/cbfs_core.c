@@ -32,10 +32,16 @@
  * target environment:
  *
  * CBFS_CORE_WITH_LZMA (must be #define)
- *      if defined, ulzma() must exist for decompression of data streams
+ *      if defined, ulzma() and lzma_stream_*() must exist for decompression
+ *      of data streams
  *
  * CBFS_CORE_WITH_LZ4 (must be #define)
- *      if defined, ulz4f() must exist for decompression of data streams
+ *      if defined, ulz4f() and lz4_stream_*() must exist for decompression
+ *      of data streams
+ *
+ * CBFS_CORE_WITH_ZSTD (must be #define)
+ *      if defined, uzstdn() and zstd_stream_*() must exist for decompression
+ *      of data streams
  *
  * ERROR(x...)
  *      print an error message x (in printf format)
@@ -49,6 +55,7 @@
  */
 
 #include <cbfs.h>
+#include <commonlib/checksum.h>
 #include <string.h>
 #include <sysinfo.h>
 
@@ -135,6 +142,41 @@ static int get_cbfs_range(uint32_t *offset, uint32_t *cbfs_end,
 	return 0;
 }
 
+/* Reads the header of the first file at or after *offset, skipping anything
+ * that is not a file header, and moves *offset to it. Returns 0 on success,
+ * -1 at the end of the CBFS. */
+static int cbfs_next_file(struct cbfs_media *media, uint32_t *offset,
+			  uint32_t cbfs_end, struct cbfs_file *file)
+{
+	while (*offset < cbfs_end &&
+	       media->read(media, file, *offset, sizeof(*file)) ==
+	       sizeof(*file)) {
+		uint32_t new_align = CBFS_ALIGNMENT;
+
+		if (memcmp(CBFS_FILE_MAGIC, file->magic,
+			   sizeof(file->magic)) == 0)
+			return 0;
+
+		if (*offset % CBFS_ALIGNMENT)
+			new_align += CBFS_ALIGNMENT -
+				(*offset % CBFS_ALIGNMENT);
+		ERROR("ERROR: No file header found at 0x%xx - "
+		      "try next aligned address: 0x%x.\n", *offset,
+		      *offset + new_align);
+		*offset += new_align;
+	}
+	return -1;
+}
+
+/* Returns the offset following the file at offset. */
+static uint32_t cbfs_skip_file(uint32_t offset, const struct cbfs_file *file)
+{
+	offset += ntohl(file->len) + ntohl(file->offset);
+	if (offset % CBFS_ALIGNMENT)
+		offset += CBFS_ALIGNMENT - (offset % CBFS_ALIGNMENT);
+	return offset;
+}
+
 /* public API starts here*/
 struct cbfs_handle *cbfs_get_handle(struct cbfs_media *media, const char *name)
 {
@@ -167,20 +209,7 @@ struct cbfs_handle *cbfs_get_handle(struct cbfs_media *media, const char *name)
 	DEBUG("Looking for '%s' starting from 0x%x.\n", name, offset);
 
 	media->open(media);
-	while (offset < cbfs_end &&
-	       media->read(media, &file, offset, sizeof(file)) == sizeof(file)) {
-		if (memcmp(CBFS_FILE_MAGIC, file.magic,
-			   sizeof(file.magic)) != 0) {
-			uint32_t new_align = CBFS_ALIGNMENT;
-			if (offset % CBFS_ALIGNMENT)
-				new_align += CBFS_ALIGNMENT -
-					(offset % CBFS_ALIGNMENT);
-			ERROR("ERROR: No file header found at 0x%xx - "
-			      "try next aligned address: 0x%x.\n", offset,
-			      offset + new_align);
-			offset += new_align;
-			continue;
-		}
+	while (cbfs_next_file(media, &offset, cbfs_end, &file) == 0) {
 		vardata_len = ntohl(file.offset) - sizeof(file);
 		DEBUG(" - load entry 0x%x variable data (%d bytes)...\n",
 			offset, vardata_len);
@@ -210,10 +239,7 @@ struct cbfs_handle *cbfs_get_handle(struct cbfs_media *media, const char *name)
 			media->unmap(media, vardata);
 		}
 
-		// Move to next file.
-		offset += ntohl(file.len) + ntohl(file.offset);
-		if (offset % CBFS_ALIGNMENT)
-			offset += CBFS_ALIGNMENT - (offset % CBFS_ALIGNMENT);
+		offset = cbfs_skip_file(offset, &file);
 	}
 	media->close(media);
 	LOG("WARNING: '%s' not found.\n", name);
@@ -221,48 +247,285 @@ struct cbfs_handle *cbfs_get_handle(struct cbfs_media *media, const char *name)
 	return NULL;
 }
 
-void *cbfs_get_contents(struct cbfs_handle *handle, size_t *size, size_t limit)
+/* Streaming decompression */
+
+#define CBFS_STREAM_BUF_SIZE	4096
+
+struct cbfs_stream {
+	struct cbfs_media media;	/* copy of original media object */
+	size_t offset;			/* of the next input byte */
+	size_t end;			/* of the input on media */
+	size_t size;			/* of the (decompressed) contents */
+	size_t done;			/* bytes of the contents returned */
+	int algo;
+	int started;
+	union {
+#ifdef CBFS_CORE_WITH_LZMA
+		struct lzma_stream lzma;
+#endif
+#ifdef CBFS_CORE_WITH_LZ4
+		struct lz4_stream lz4;
+#endif
+#ifdef CBFS_CORE_WITH_ZSTD
+		struct zstd_stream zstd;
+#endif
+		uint8_t buf[CBFS_STREAM_BUF_SIZE];	/* if uncompressed */
+	} u;
+};
+
+static size_t cbfs_stream_input(void *arg, void *buf, size_t size)
 {
-	struct cbfs_media *m = &handle->media;
-	size_t on_media_size = handle->content_size;
-	int algo = CBFS_COMPRESS_NONE;
-	void *ret = NULL;
-	size_t dummy_size;
+	struct cbfs_stream *stream = arg;
 
+	if (size > stream->end - stream->offset)
+		size = stream->end - stream->offset;
 	if (!size)
-		size = &dummy_size;
+		return 0;
+
+	size = stream->media.read(&stream->media, buf, stream->offset, size);
+	stream->offset += size;
+	return size;
+}
+
+/* Looks up the compression of the file and opens its media. */
+static struct cbfs_stream *cbfs_stream_setup(struct cbfs_handle *handle)
+{
+	struct cbfs_file_attr_compression *comp;
+	struct cbfs_stream *stream;
 
-	struct cbfs_file_attr_compression *comp =
-		cbfs_get_attr(handle, CBFS_FILE_ATTR_TAG_COMPRESSION);
+	stream = malloc(sizeof(*stream));
+	if (!stream)
+		return NULL;
+
+	stream->media = handle->media;
+	stream->offset = handle->media_offset + handle->content_offset;
+	stream->end = stream->offset + handle->content_size;
+	stream->size = handle->content_size;
+	stream->done = 0;
+	stream->algo = CBFS_COMPRESS_NONE;
+	stream->started = 0;
+
+	comp = cbfs_get_attr(handle, CBFS_FILE_ATTR_TAG_COMPRESSION);
 	if (comp) {
-		algo = ntohl(comp->compression);
-		DEBUG("File '%s' is compressed (alg=%d)\n", name, algo);
-		*size = ntohl(comp->decompressed_size);
-		/* TODO: Implement partial decompression with |limit| */
+		stream->algo = ntohl(comp->compression);
+		stream->size = ntohl(comp->decompressed_size);
+		handle->media.unmap(&handle->media, comp);
+		DEBUG("File is compressed (alg=%d)\n", stream->algo);
 	}
 
-	if (algo == CBFS_COMPRESS_NONE) {
-		if (limit != 0 && limit < on_media_size) {
-			*size = limit;
-			on_media_size = limit;
-		} else {
-			*size = on_media_size;
+	stream->media.open(&stream->media);
+	return stream;
+}
+
+/* Sets up the decompressor, which decodes into window if it is not NULL. */
+static int cbfs_stream_start(struct cbfs_stream *stream, void *window,
+			     size_t window_size)
+{
+	int ret;
+
+	switch (stream->algo) {
+	case CBFS_COMPRESS_NONE:
+		ret = 0;
+		break;
+#ifdef CBFS_CORE_WITH_LZMA
+	case CBFS_COMPRESS_LZMA:
+		ret = lzma_stream_init(&stream->u.lzma, cbfs_stream_input,
+				       stream, window, window_size);
+		break;
+#endif
+#ifdef CBFS_CORE_WITH_LZ4
+	case CBFS_COMPRESS_LZ4:
+		ret = lz4_stream_init(&stream->u.lz4, cbfs_stream_input,
+				      stream, window, window_size);
+		break;
+#endif
+#ifdef CBFS_CORE_WITH_ZSTD
+	case CBFS_COMPRESS_ZSTD:
+		/* The window has to hold all of the contents. */
+		ret = zstd_stream_init(&stream->u.zstd, cbfs_stream_input,
+				       stream, window,
+				       window ? window_size : stream->size);
+		break;
+#endif
+	default:
+		ERROR("tried to decompress a stream with algorithm #%x, "
+		      "but that algorithm id is unsupported.\n", stream->algo);
+		ret = -1;
+	}
+
+	stream->started = !ret;
+	return ret;
+}
+
+/* Returns up to max bytes of the contents in *data. Uncompressed files are
+ * read into dst, or into a buffer of the stream if dst is NULL. */
+static ssize_t cbfs_stream_next(struct cbfs_stream *stream, const void **data,
+				size_t max, void *dst)
+{
+	ssize_t ret;
+
+	if (max > stream->size - stream->done)
+		max = stream->size - stream->done;
+	if (!max)
+		return 0;
+
+	switch (stream->algo) {
+#ifdef CBFS_CORE_WITH_LZMA
+	case CBFS_COMPRESS_LZMA:
+		ret = lzma_stream_next(&stream->u.lzma, data, max);
+		break;
+#endif
+#ifdef CBFS_CORE_WITH_LZ4
+	case CBFS_COMPRESS_LZ4:
+		ret = lz4_stream_next(&stream->u.lz4, data, max);
+		break;
+#endif
+#ifdef CBFS_CORE_WITH_ZSTD
+	case CBFS_COMPRESS_ZSTD:
+		ret = zstd_stream_next(&stream->u.zstd, data, max);
+		break;
+#endif
+	default:
+		if (!dst) {
+			dst = stream->u.buf;
+			if (max > sizeof(stream->u.buf))
+				max = sizeof(stream->u.buf);
 		}
+		ret = cbfs_stream_input(stream, dst, max);
+		*data = dst;
 	}
 
-	void *data = m->map(m, handle->media_offset + handle->content_offset,
-			    on_media_size);
-	if (data == CBFS_MEDIA_INVALID_MAP_ADDRESS)
+	if (ret <= 0) {
+		ERROR("File contents end after %zu of %zu bytes.\n",
+		      stream->done, stream->size);
+		return -1;
+	}
+
+	stream->done += ret;
+	return ret;
+}
+
+struct cbfs_stream *cbfs_stream_open(struct cbfs_handle *handle)
+{
+	struct cbfs_stream *stream = cbfs_stream_setup(handle);
+
+	if (stream && cbfs_stream_start(stream, NULL, 0)) {
+		cbfs_stream_close(stream);
 		return NULL;
+	}
+	return stream;
+}
 
-	ret = malloc(*size);
-	if (ret != NULL && !cbfs_decompress(algo, data, ret, *size)) {
-		free(ret);
-		ret = NULL;
+ssize_t cbfs_stream_read(struct cbfs_stream *stream, void *buf, size_t size)
+{
+	size_t copied = 0;
+
+	while (copied < size) {
+		void *dst = (uint8_t *)buf + copied;
+		const void *data;
+		ssize_t ret;
+
+		ret = cbfs_stream_next(stream, &data, size - copied, dst);
+		if (ret < 0)
+			return -1;
+		if (!ret)
+			break;
+
+		if (data != dst)
+			memcpy(dst, data, ret);
+		copied += ret;
 	}
 
-	m->unmap(m, data);
+	return copied;
+}
+
+ssize_t cbfs_stream_process(struct cbfs_handle *handle,
+			    int (*sink)(void *arg, const void *data,
+					size_t size),
+			    void *arg)
+{
+	struct cbfs_stream *stream = cbfs_stream_open(handle);
+	size_t total = 0;
+	const void *data;
+	ssize_t ret;
+
+	if (!stream)
+		return -1;
+
+	while ((ret = cbfs_stream_next(stream, &data, stream->size,
+				       NULL)) > 0) {
+		if (sink(arg, data, ret)) {
+			ret = -1;
+			break;
+		}
+		total += ret;
+	}
+
+	cbfs_stream_close(stream);
+	return ret < 0 ? -1 : total;
+}
+
+void cbfs_stream_close(struct cbfs_stream *stream)
+{
+	if (stream->started) {
+		switch (stream->algo) {
+#ifdef CBFS_CORE_WITH_LZMA
+		case CBFS_COMPRESS_LZMA:
+			lzma_stream_free(&stream->u.lzma);
+			break;
+#endif
+#ifdef CBFS_CORE_WITH_LZ4
+		case CBFS_COMPRESS_LZ4:
+			lz4_stream_free(&stream->u.lz4);
+			break;
+#endif
+#ifdef CBFS_CORE_WITH_ZSTD
+		case CBFS_COMPRESS_ZSTD:
+			zstd_stream_free(&stream->u.zstd);
+			break;
+#endif
+		}
+	}
+
+	stream->media.close(&stream->media);
+	free(stream);
+}
+
+void *cbfs_get_contents(struct cbfs_handle *handle, size_t *size, size_t limit)
+{
+	struct cbfs_stream *stream;
+	void *ret = NULL;
+	size_t dummy_size;
+	ssize_t read;
+
+	if (!size)
+		size = &dummy_size;
+
+	stream = cbfs_stream_setup(handle);
+	if (!stream)
+		return NULL;
+
+	*size = stream->size;
+	if (limit != 0 && limit < *size)
+		*size = limit;
+
+	/* Compressed files are decompressed right into the result, which
+	 * serves as the window, so nothing but the result is allocated. */
+	ret = malloc(*size);
+	if (ret == NULL || cbfs_stream_start(stream, ret, *size))
+		goto fail;
+
+	read = cbfs_stream_read(stream, ret, *size);
+	if (read < 0 || (size_t)read != *size)
+		goto fail;
+
+	cbfs_stream_close(stream);
 	return ret;
+
+fail:
+	cbfs_stream_close(stream);
+	free(ret);
+	return NULL;
 }
 
 void *cbfs_get_file_content(struct cbfs_media *media, const char *name,
@@ -334,6 +597,10 @@ int cbfs_decompress(int algo, void *src, void *dst, int len)
 #ifdef CBFS_CORE_WITH_LZ4
 		case CBFS_COMPRESS_LZ4:
 			return ulz4f(src, dst);
+#endif
+#ifdef CBFS_CORE_WITH_ZSTD
+		case CBFS_COMPRESS_ZSTD:
+			return uzstdn(src, len, dst, (size_t)-1);
 #endif
 		default:
 			ERROR("tried to decompress %d bytes with algorithm #%x,"
@@ -342,3 +609,298 @@ int cbfs_decompress(int algo, void *src, void *dst, int len)
 			return 0;
 	}
 }
+
+/* Directory snapshots */
+
+struct cbfs_dir_hash {
+	uint32_t hash;		/* of the name */
+	uint32_t index;		/* into entries */
+};
+
+struct cbfs_dir {
+	struct cbfs_media media;	/* copy of original media object */
+	int default_media;		/* opened with CBFS_DEFAULT_MEDIA */
+	unsigned int generation;	/* of the default media when read */
+	int valid;
+	struct cbfs_dir_entry *entries;	/* in media order */
+	struct cbfs_dir_hash *hashes;	/* sorted by hash, then index */
+	size_t num_entries;
+	size_t max_entries;
+	char *names;			/* NUL terminated names of all files */
+	size_t names_size;
+	size_t max_names;
+};
+
+static uint32_t cbfs_dir_hash_name(const char *name)
+{
+	return xxh32(name, strlen(name), 0);
+}
+
+static int cbfs_dir_hash_cmp(const void *a, const void *b)
+{
+	const struct cbfs_dir_hash *x = a, *y = b;
+
+	if (x->hash != y->hash)
+		return x->hash < y->hash ? -1 : 1;
+	return x->index < y->index ? -1 : x->index > y->index;
+}
+
+static void cbfs_dir_clear(struct cbfs_dir *dir)
+{
+	free(dir->entries);
+	free(dir->hashes);
+	free(dir->names);
+	dir->entries = NULL;
+	dir->hashes = NULL;
+	dir->names = NULL;
+	dir->num_entries = dir->max_entries = 0;
+	dir->names_size = dir->max_names = 0;
+	dir->valid = 0;
+}
+
+static int cbfs_dir_grow(struct cbfs_dir *dir, size_t name_len)
+{
+	if (dir->num_entries == dir->max_entries) {
+		size_t max = dir->max_entries ? dir->max_entries * 2 : 32;
+		void *entries, *hashes;
+
+		entries = realloc(dir->entries, max * sizeof(*dir->entries));
+		if (!entries)
+			return -1;
+		dir->entries = entries;
+		hashes = realloc(dir->hashes, max * sizeof(*dir->hashes));
+		if (!hashes)
+			return -1;
+		dir->hashes = hashes;
+		dir->max_entries = max;
+	}
+
+	if (dir->names_size + name_len + 1 > dir->max_names) {
+		size_t max = dir->max_names ? dir->max_names : 512;
+		char *names;
+
+		while (dir->names_size + name_len + 1 > max)
+			max *= 2;
+		names = realloc(dir->names, max);
+		if (!names)
+			return -1;
+		dir->names = names;
+		dir->max_names = max;
+	}
+	return 0;
+}
+
+static int cbfs_dir_add(struct cbfs_dir *dir, uint32_t offset,
+			const struct cbfs_file *file)
+{
+	struct cbfs_media *media = &dir->media;
+	struct cbfs_dir_entry *entry;
+	uint32_t content_offset = ntohl(file->offset);
+	uint32_t attribute_offset = ntohl(file->attributes_offset);
+	uint32_t name_end = content_offset;
+	const char *name;
+	size_t name_len;
+
+	if (content_offset <= sizeof(*file)) {
+		ERROR("ERROR: Invalid file header: 0x%x.\n", offset);
+		return 0;
+	}
+	/* The name ends where the attributes start, if there are any. */
+	if (attribute_offset > sizeof(*file) && attribute_offset < name_end)
+		name_end = attribute_offset;
+
+	name = media->map(media, offset + sizeof(*file),
+			  name_end - sizeof(*file));
+	if (name == CBFS_MEDIA_INVALID_MAP_ADDRESS) {
+		ERROR("ERROR: Failed to get filename: 0x%x.\n", offset);
+		return 0;
+	}
+	name_len = strnlen(name, name_end - sizeof(*file));
+
+	if (cbfs_dir_grow(dir, name_len)) {
+		ERROR("ERROR: Out of memory for the CBFS directory.\n");
+		media->unmap(media, name);
+		return -1;
+	}
+
+	memcpy(dir->names + dir->names_size, name, name_len);
+	dir->names[dir->names_size + name_len] = '\0';
+	media->unmap(media, name);
+
+	entry = &dir->entries[dir->num_entries];
+	entry->name_offset = dir->names_size;
+	entry->type = ntohl(file->type);
+	entry->media_offset = offset;
+	entry->attribute_offset = attribute_offset;
+	entry->content_offset = content_offset;
+	entry->content_size = ntohl(file->len);
+
+	dir->hashes[dir->num_entries].hash =
+		cbfs_dir_hash_name(dir->names + dir->names_size);
+	dir->hashes[dir->num_entries].index = dir->num_entries;
+
+	dir->names_size += name_len + 1;
+	dir->num_entries++;
+	return 0;
+}
+
+static int cbfs_dir_scan(struct cbfs_dir *dir)
+{
+	struct cbfs_media *media = &dir->media;
+	uint32_t offset, cbfs_end;
+	struct cbfs_file file;
+
+	cbfs_dir_clear(dir);
+
+	if (dir->default_media) {
+		if (init_default_cbfs_media(media) != 0) {
+			ERROR("Failed to initialize default media.\n");
+			return -1;
+		}
+		dir->generation = cbfs_default_media_generation();
+	}
+
+	if (get_cbfs_range(&offset, &cbfs_end, dir->default_media ?
+			   CBFS_DEFAULT_MEDIA : media)) {
+		ERROR("Failed to find cbfs range\n");
+		return -1;
+	}
+
+	DEBUG("Reading CBFS directory from 0x%x~0x%x.\n", offset, cbfs_end);
+
+	media->open(media);
+	while (cbfs_next_file(media, &offset, cbfs_end, &file) == 0) {
+		if (cbfs_dir_add(dir, offset, &file)) {
+			media->close(media);
+			cbfs_dir_clear(dir);
+			return -1;
+		}
+		offset = cbfs_skip_file(offset, &file);
+	}
+	media->close(media);
+
+	qsort(dir->hashes, dir->num_entries, sizeof(*dir->hashes),
+	      cbfs_dir_hash_cmp);
+	dir->valid = 1;
+
+	DEBUG("CBFS directory has %zu files.\n", dir->num_entries);
+	return 0;
+}
+
+/* Reads the directory again if it is out of date. */
+static int cbfs_dir_check(struct cbfs_dir *dir)
+{
+	if (dir->valid && (!dir->default_media ||
+			   dir->generation == cbfs_default_media_generation()))
+		return 0;
+	return cbfs_dir_scan(dir);
+}
+
+struct cbfs_dir *cbfs_dir_open(struct cbfs_media *media)
+{
+	struct cbfs_dir *dir = calloc(1, sizeof(*dir));
+
+	if (!dir)
+		return NULL;
+
+	if (media == CBFS_DEFAULT_MEDIA)
+		dir->default_media = 1;
+	else
+		memcpy(&dir->media, media, sizeof(*media));
+
+	if (cbfs_dir_scan(dir)) {
+		free(dir);
+		return NULL;
+	}
+	return dir;
+}
+
+void cbfs_dir_close(struct cbfs_dir *dir)
+{
+	if (!dir)
+		return;
+	cbfs_dir_clear(dir);
+	free(dir);
+}
+
+void cbfs_dir_invalidate(struct cbfs_dir *dir)
+{
+	dir->valid = 0;
+}
+
+const struct cbfs_dir_entry *cbfs_dir_next(struct cbfs_dir *dir,
+					   const struct cbfs_dir_entry *prev)
+{
+	size_t next = 0;
+
+	if (prev)
+		next = prev - dir->entries + 1;
+	else if (cbfs_dir_check(dir))
+		return NULL;
+
+	return next < dir->num_entries ? &dir->entries[next] : NULL;
+}
+
+const struct cbfs_dir_entry *cbfs_dir_next_type(struct cbfs_dir *dir,
+		const struct cbfs_dir_entry *prev, uint32_t type)
+{
+	while ((prev = cbfs_dir_next(dir, prev)) && prev->type != type)
+		;
+	return prev;
+}
+
+const struct cbfs_dir_entry *cbfs_dir_lookup(struct cbfs_dir *dir,
+					     const char *name)
+{
+	uint32_t hash;
+	size_t lo = 0, hi;
+
+	if (cbfs_dir_check(dir))
+		return NULL;
+
+	/* Find the first entry with the hash, then compare names. */
+	hash = cbfs_dir_hash_name(name);
+	hi = dir->num_entries;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+
+		if (dir->hashes[mid].hash < hash)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (; lo < dir->num_entries && dir->hashes[lo].hash == hash; lo++) {
+		const struct cbfs_dir_entry *entry =
+			&dir->entries[dir->hashes[lo].index];
+
+		if (strcmp(dir->names + entry->name_offset, name) == 0)
+			return entry;
+	}
+
+	LOG("WARNING: '%s' not found.\n", name);
+	return NULL;
+}
+
+const char *cbfs_dir_name(const struct cbfs_dir *dir,
+			  const struct cbfs_dir_entry *entry)
+{
+	return dir->names + entry->name_offset;
+}
+
+struct cbfs_handle *cbfs_dir_get_handle(struct cbfs_dir *dir,
+					const struct cbfs_dir_entry *entry)
+{
+	struct cbfs_handle *handle = malloc(sizeof(*handle));
+
+	if (!handle)
+		return NULL;
+
+	memcpy(&handle->media, &dir->media, sizeof(dir->media));
+	handle->type = entry->type;
+	handle->media_offset = entry->media_offset;
+	handle->attribute_offset = entry->attribute_offset;
+	handle->content_offset = entry->content_offset;
+	handle->content_size = entry->content_size;
+	return handle;
+}
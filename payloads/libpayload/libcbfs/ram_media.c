@@ -91,9 +91,11 @@ int init_cbfs_ram_media(struct cbfs_media *media, void *start, size_t size) {
 // Legacy setup_cbfs_from_*.
 static int is_default_cbfs_media_initialized;
 static struct cbfs_media default_cbfs_media;
+static unsigned int default_cbfs_media_generation;
 
 int setup_cbfs_from_ram(void *start, uint32_t size) {
 	int result = init_cbfs_ram_media(&default_cbfs_media, start, size);
+	default_cbfs_media_generation++;
 	if (result == 0)
 		is_default_cbfs_media_initialized = 1;
 	return result;
@@ -102,11 +104,16 @@ int setup_cbfs_from_ram(void *start, uint32_t size) {
 extern int libpayload_init_default_cbfs_media(struct cbfs_media *media);
 int setup_cbfs_from_flash(void) {
 	int result = libpayload_init_default_cbfs_media(&default_cbfs_media);
+	default_cbfs_media_generation++;
 	if (result == 0)
 	    is_default_cbfs_media_initialized = 1;
 	return result;
 }
 
+unsigned int cbfs_default_media_generation(void) {
+	return default_cbfs_media_generation;
+}
+
 int init_default_cbfs_media(struct cbfs_media *media) {
 	int result = 0;
 	if (is_default_cbfs_media_initialized != 1) {
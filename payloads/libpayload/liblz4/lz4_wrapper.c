@@ -183,3 +183,242 @@ size_t ulz4f(const void *src, void *dst)
 	/* LZ4 uses signed size parameters, so can't just use ((u32)-1) here. */
 	return ulz4fn(src, 1*GiB, dst, 1*GiB);
 }
+
+enum {
+	LZ4S_BLOCK,		/* at a block header */
+	LZ4S_TOKEN,		/* at a sequence token */
+	LZ4S_LITERALS,		/* in the literals of a sequence or raw block */
+	LZ4S_MATCH,		/* in the match of a sequence */
+	LZ4S_END,		/* past the end mark */
+};
+
+static uint8_t lz4s_refill(struct lz4_stream *s)
+{
+	size_t n = s->read(s->arg, s->in_buf, sizeof(s->in_buf));
+
+	if (!n || n > sizeof(s->in_buf)) {
+		s->error = 1;
+		return 0;
+	}
+	s->in = s->in_buf;
+	s->in_end = s->in_buf + n;
+	return *s->in++;
+}
+
+static inline uint8_t lz4s_byte(struct lz4_stream *s)
+{
+	if (s->in < s->in_end)
+		return *s->in++;
+	return lz4s_refill(s);
+}
+
+static uint8_t lz4s_block_byte(struct lz4_stream *s)
+{
+	if (!s->block_left) {
+		s->error = 1;
+		return 0;
+	}
+	s->block_left--;
+	return lz4s_byte(s);
+}
+
+static size_t lz4s_length(struct lz4_stream *s, size_t len)
+{
+	uint8_t b;
+
+	if (len == 15) {
+		do {
+			b = lz4s_block_byte(s);
+			len += b;
+		} while (b == 255 && !s->error);
+	}
+	return len;
+}
+
+/* Decodes into the window up to end, or less at the end of the frame. */
+static void lz4s_decode(struct lz4_stream *s, size_t end)
+{
+	size_t pos = s->pos;
+	size_t n, i;
+	uint32_t raw;
+
+	while (pos < end && !s->error) {
+		switch (s->state) {
+		case LZ4S_BLOCK:
+			raw = 0;
+			for (i = 0; i < sizeof(raw); i++)
+				raw |= lz4s_byte(s) << (8 * i);
+			if (!raw) {
+				s->state = LZ4S_END;
+				s->out_size = s->total + pos - s->pos;
+				goto out;
+			}
+			s->block_left = raw & 0x7fffffff;
+			s->block_out = 0;
+			if (raw >> 31) {
+				/* Not compressed: all literals. */
+				s->lit_left = s->block_left;
+				s->block_left = 0;
+				s->state = LZ4S_LITERALS;
+			} else {
+				s->state = LZ4S_TOKEN;
+			}
+			break;
+
+		case LZ4S_TOKEN:
+			s->token = lz4s_block_byte(s);
+			s->lit_left = lz4s_length(s, s->token >> 4);
+			if (s->lit_left > s->block_left) {
+				s->error = 1;
+				break;
+			}
+			s->block_left -= s->lit_left;
+			s->state = LZ4S_LITERALS;
+			break;
+
+		case LZ4S_LITERALS:
+			if (s->lit_left) {
+				if (s->in == s->in_end) {
+					s->window[pos++] = lz4s_refill(s);
+					n = 1;
+				} else {
+					n = MIN(MIN(s->lit_left, end - pos),
+						(size_t)(s->in_end - s->in));
+					memcpy(s->window + pos, s->in, n);
+					s->in += n;
+					pos += n;
+				}
+				s->lit_left -= n;
+				s->block_out += n;
+				break;
+			}
+
+			/* The last sequence of a block has no match. */
+			if (!s->block_left) {
+				if (s->has_block_checksum)
+					for (i = 0; i < sizeof(uint32_t); i++)
+						lz4s_byte(s);
+				s->state = LZ4S_BLOCK;
+				break;
+			}
+
+			s->offset = lz4s_block_byte(s);
+			s->offset |= lz4s_block_byte(s) << 8;
+			if (!s->offset ||
+			    s->offset > MIN(s->block_out, s->window_size)) {
+				s->error = 1;
+				break;
+			}
+			s->match_left = lz4s_length(s, s->token & 15) +
+				MINMATCH;
+			s->state = LZ4S_MATCH;
+			break;
+
+		case LZ4S_MATCH:
+			i = pos >= s->offset ? pos - s->offset :
+				pos + s->window_size - s->offset;
+			n = MIN(s->match_left, end - pos);
+			s->match_left -= n;
+			s->block_out += n;
+			while (n--) {
+				s->window[pos++] = s->window[i++];
+				if (i == s->window_size)
+					i = 0;
+			}
+			if (!s->match_left)
+				s->state = LZ4S_TOKEN;
+			break;
+
+		case LZ4S_END:
+			goto out;
+		}
+	}
+
+out:
+	s->pos = pos;
+}
+
+int lz4_stream_init(struct lz4_stream *s, lz4_read_fn read, void *arg,
+		    void *window, size_t window_size)
+{
+	struct lz4_frame_header h;
+	uint8_t *p = (uint8_t *)&h;
+	size_t i;
+
+	memset(s, 0, offsetof(struct lz4_stream, in_buf));
+	s->read = read;
+	s->arg = arg;
+	s->in = s->in_end = s->in_buf;
+	s->out_size = ~(size_t)0;
+
+	for (i = 0; i < sizeof(h); i++)
+		p[i] = lz4s_byte(s);
+	if (s->error || le32toh(h.magic) != LZ4F_MAGICNUMBER ||
+	    h.version != 1 || h.reserved0 || h.reserved1 || h.reserved2 ||
+	    !h.independent_blocks) {
+		printf("lz4: Unsupported frame header.\n");
+		return -1;
+	}
+	s->has_block_checksum = h.has_block_checksum;
+
+	if (h.has_content_size) {
+		uint64_t size = 0;
+
+		for (i = 0; i < sizeof(size); i++)
+			size |= (uint64_t)lz4s_byte(s) << (8 * i);
+		if (size < s->out_size)
+			s->out_size = size;
+	}
+	lz4s_byte(s);		/* header checksum */
+	if (s->error)
+		return -1;
+
+	if (!window) {
+		window_size = MIN(LZ4_STREAM_WINDOW, s->out_size);
+		window = malloc(MAX(window_size, 1));
+		if (!window) {
+			printf("lz4: Cannot allocate %zu byte window!\n",
+			       window_size);
+			return -1;
+		}
+		s->own_window = 1;
+	}
+	s->window = window;
+	s->window_size = window_size;
+	s->state = LZ4S_BLOCK;
+	return 0;
+}
+
+ssize_t lz4_stream_next(struct lz4_stream *s, const void **data, size_t max)
+{
+	size_t start, end;
+
+	if (s->error)
+		return -1;
+
+	if (s->pos == s->window_size)
+		s->pos = 0;
+	start = s->pos;
+	end = start + MIN(max, MIN(s->window_size - start,
+				   s->out_size - s->total));
+	if (end == start)
+		return 0;
+
+	lz4s_decode(s, end);
+	if (s->error) {
+		printf("lz4: Decoding error at byte %zu\n", s->total);
+		return -1;
+	}
+
+	*data = s->window + start;
+	s->total += s->pos - start;
+	return s->pos - start;
+}
+
+void lz4_stream_free(struct lz4_stream *s)
+{
+	if (s->own_window)
+		free(s->window);
+	s->window = NULL;
+	s->own_window = 0;
+}
@@ -1,58 +1,46 @@
 /*
- * coreboot interface to memory-saving variant of LZMA decoder
+ * libpayload interface to the LZMA decoder in commonlib
  *
  * Copyright (C) 2006 Carl-Daniel Hailfinger
  * Released under the BSD license
- *
- * Parts of this file are based on C/7zip/Compress/LZMA_C/LzmaTest.c from the LZMA
- * SDK 4.42, which is written and distributed to public domain by Igor Pavlov.
- *
  */
 
+#include <commonlib/lzma_decoder.h>
 #include <lzma.h>
 #include <stdlib.h>
 #include <stdio.h>
-#include <string.h>
-#include "lzmadecode.c"
 
 unsigned long ulzman(const unsigned char *src, unsigned long srcn,
 		     unsigned char *dst, unsigned long dstn)
 {
-	unsigned char properties[LZMA_PROPERTIES_SIZE];
-	const int data_offset = LZMA_PROPERTIES_SIZE + 8;
-	UInt32 outSize;
-	SizeT inProcessed;
-	SizeT outProcessed;
-	int res;
-	CLzmaDecoderState state;
-	SizeT mallocneeds;
-	unsigned char *scratchpad;
+	struct lzma_decoder d;
+	unsigned long out_size;
+	enum lzma_status status;
+	void *probs;
 
-	memcpy(properties, src, LZMA_PROPERTIES_SIZE);
-	memcpy(&outSize, src + LZMA_PROPERTIES_SIZE, sizeof(outSize));
-	if (outSize > dstn)
-		outSize = dstn;
-	if (LzmaDecodeProperties(&state.Properties, properties,
-				 LZMA_PROPERTIES_SIZE) != LZMA_RESULT_OK) {
+	if (srcn < LZMA_HEADER_SIZE || lzma_decoder_header(&d, src)) {
 		printf("lzma: Incorrect stream properties.\n");
 		return 0;
 	}
-	mallocneeds = (LzmaGetNumProbs(&state.Properties) * sizeof(CProb));
-	scratchpad = malloc(mallocneeds);
-	if (!scratchpad) {
-		printf("lzma: Cannot allocate %u bytes for scratchpad!\n",
-		       mallocneeds);
+
+	probs = malloc(lzma_decoder_probs_size(&d));
+	if (!probs) {
+		printf("lzma: Cannot allocate %zu bytes for scratchpad!\n",
+		       lzma_decoder_probs_size(&d));
 		return 0;
 	}
-	state.Probs = (CProb *)scratchpad;
-	res = LzmaDecode(&state, src + data_offset, srcn - data_offset,
-			 &inProcessed, dst, outSize, &outProcessed);
-	free(scratchpad);
-	if (res != 0) {
-		printf("lzma: Decoding error = %d\n", res);
+
+	out_size = d.out_size < dstn ? d.out_size : dstn;
+	lzma_decoder_init(&d, probs, dst, out_size);
+	d.in = src + LZMA_HEADER_SIZE;
+	d.in_size = srcn - LZMA_HEADER_SIZE;
+	status = lzma_decode(&d, out_size, 1);
+	free(probs);
+	if (status == LZMA_ERROR) {
+		printf("lzma: Decoding error at byte %zu\n", d.total);
 		return 0;
 	}
-	return outProcessed;
+	return d.pos;
 }
 
 unsigned long ulzma(const unsigned char *src, unsigned char *dst)
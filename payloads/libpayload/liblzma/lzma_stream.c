@@ -0,0 +1,147 @@
+/*
+ * This file is part of the libpayload project.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Streaming LZMA decompression. This feeds the commonlib decoder with input
+ * pulled through a callback and lets it decode into a window that may be
+ * much smaller than the output, used as a ring buffer.
+ */
+
+#include <libpayload.h>
+#include <lzma.h>
+
+#define LZMA_MIN_WINDOW		4096
+
+/* Moves the unused input to the front of the buffer and fills it up. */
+static void lzs_refill(struct lzma_stream *s)
+{
+	struct lzma_decoder *d = &s->dec;
+	size_t size = d->in_size;
+
+	memmove(s->in_buf, d->in, size);
+	while (!s->eof && size < sizeof(s->in_buf)) {
+		size_t n = s->read(s->arg, s->in_buf + size,
+				   sizeof(s->in_buf) - size);
+
+		if (!n || n > sizeof(s->in_buf) - size)
+			s->eof = 1;
+		else
+			size += n;
+	}
+	d->in = s->in_buf;
+	d->in_size = size;
+}
+
+int lzma_stream_init(struct lzma_stream *s, lzma_read_fn read, void *arg,
+		     void *window, size_t window_size)
+{
+	struct lzma_decoder *d = &s->dec;
+	void *probs;
+
+	memset(s, 0, offsetof(struct lzma_stream, in_buf));
+	s->read = read;
+	s->arg = arg;
+	d->in = s->in_buf;
+	lzs_refill(s);
+
+	if (d->in_size < LZMA_HEADER_SIZE || lzma_decoder_header(d, d->in)) {
+		printf("lzma: Incorrect stream properties.\n");
+		return -1;
+	}
+	d->in += LZMA_HEADER_SIZE;
+	d->in_size -= LZMA_HEADER_SIZE;
+
+	if (!window) {
+		window_size = MAX(d->dict_size, LZMA_MIN_WINDOW);
+		if (window_size > d->out_size)
+			window_size = d->out_size;
+		window = malloc(MAX(window_size, 1));
+		if (!window) {
+			printf("lzma: Cannot allocate %zu byte window!\n",
+			       window_size);
+			return -1;
+		}
+		s->own_window = 1;
+	}
+
+	probs = malloc(lzma_decoder_probs_size(d));
+	if (!probs) {
+		printf("lzma: Cannot allocate %zu bytes for scratchpad!\n",
+		       lzma_decoder_probs_size(d));
+		if (s->own_window)
+			free(window);
+		return -1;
+	}
+
+	/* This leaves the input alone. */
+	lzma_decoder_init(d, probs, window, window_size);
+	return 0;
+}
+
+ssize_t lzma_stream_next(struct lzma_stream *s, const void **data,
+			 size_t max)
+{
+	struct lzma_decoder *d = &s->dec;
+	enum lzma_status status;
+	size_t start, end;
+
+	if (s->error)
+		return -1;
+
+	if (d->pos == d->window_size)
+		d->pos = 0;
+	start = d->pos;
+	end = start + MIN(max, d->window_size - start);
+	if (d->out_size - d->total < end - start)
+		end = start + (d->out_size - d->total);
+	if (end == start)
+		return 0;
+
+	while ((status = lzma_decode(d, end, s->eof)) == LZMA_NEED_INPUT)
+		lzs_refill(s);
+
+	if (status == LZMA_ERROR) {
+		printf("lzma: Decoding error at byte %zu\n", d->total);
+		s->error = 1;
+		return -1;
+	}
+	if (status == LZMA_END)
+		d->out_size = d->total;
+
+	*data = d->window + start;
+	return d->pos - start;
+}
+
+void lzma_stream_free(struct lzma_stream *s)
+{
+	free(s->dec.probs);
+	s->dec.probs = NULL;
+	if (s->own_window)
+		free(s->dec.window);
+	s->dec.window = NULL;
+	s->own_window = 0;
+}
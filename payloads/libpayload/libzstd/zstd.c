@@ -0,0 +1,148 @@
+/*
+ * This file is part of the libpayload project.
+ *
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * libpayload interface to the Zstandard decoder in commonlib. Streams are
+ * decoded in one go into a window that holds the whole output, since the
+ * decoder does not wrap its output around.
+ */
+
+#include <libpayload.h>
+#include <zstd.h>
+
+#define ZSTD_STREAM_BUF_SIZE	4096
+
+size_t uzstdn(const void *src, size_t srcn, void *dst, size_t dstn)
+{
+	struct zstd_decoder d;
+	void *workspace;
+	enum zstd_status status;
+
+	workspace = malloc(ZSTD_WORKSPACE_SIZE);
+	if (!workspace) {
+		printf("zstd: Cannot allocate %u bytes for workspace!\n",
+		       ZSTD_WORKSPACE_SIZE);
+		return 0;
+	}
+
+	zstd_decoder_init(&d, workspace, dst, dstn);
+	d.in = src;
+	d.in_size = srcn;
+	status = zstd_decode(&d);
+	free(workspace);
+	if (status != ZSTD_STATUS_END) {
+		printf("zstd: Decoding error at byte %zu\n", d.pos);
+		return 0;
+	}
+	return d.pos;
+}
+
+/* Reads all input into a buffer that grows as needed. */
+static void *zstd_read_all(zstd_read_fn read, void *arg, size_t *size)
+{
+	size_t len = 0, alloc = 0;
+	uint8_t *buf = NULL;
+
+	for (;;) {
+		size_t n;
+
+		if (alloc - len < ZSTD_STREAM_BUF_SIZE) {
+			uint8_t *grown;
+
+			alloc = MAX(2 * alloc, ZSTD_STREAM_BUF_SIZE);
+			grown = realloc(buf, alloc);
+			if (!grown) {
+				printf("zstd: Cannot allocate %zu byte input "
+				       "buffer!\n", alloc);
+				free(buf);
+				return NULL;
+			}
+			buf = grown;
+		}
+
+		n = read(arg, buf + len, alloc - len);
+		if (!n || n > alloc - len)
+			break;
+		len += n;
+	}
+
+	*size = len;
+	return buf;
+}
+
+int zstd_stream_init(struct zstd_stream *s, zstd_read_fn read, void *arg,
+		     void *window, size_t window_size)
+{
+	size_t in_size;
+	void *in;
+
+	memset(s, 0, sizeof(*s));
+
+	in = zstd_read_all(read, arg, &in_size);
+	if (!in)
+		return -1;
+
+	if (!window) {
+		window = malloc(MAX(window_size, 1));
+		if (!window) {
+			printf("zstd: Cannot allocate %zu byte window!\n",
+			       window_size);
+			free(in);
+			return -1;
+		}
+		s->own_window = 1;
+	}
+	s->window = window;
+	s->window_size = window_size;
+
+	s->size = uzstdn(in, in_size, window, window_size);
+	free(in);
+	if (!s->size && in_size) {
+		zstd_stream_free(s);
+		return -1;
+	}
+	return 0;
+}
+
+ssize_t zstd_stream_next(struct zstd_stream *s, const void **data,
+			 size_t max)
+{
+	size_t n = MIN(max, s->size - s->pos);
+
+	*data = s->window + s->pos;
+	s->pos += n;
+	return n;
+}
+
+void zstd_stream_free(struct zstd_stream *s)
+{
+	if (s->own_window)
+		free(s->window);
+	s->window = NULL;
+	s->own_window = 0;
+}
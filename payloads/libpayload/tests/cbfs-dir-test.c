@@ -0,0 +1,301 @@
+/*
+ * CBFS directory snapshots against a CBFS built in memory: every lookup
+ * must find the same file as cbfs_get_handle(), with less media traffic,
+ * and snapshots must follow changes of the image once invalidated.
+ */
+
+#define LIBPAYLOAD
+
+/* system headers */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* libpayload headers */
+#include <libpayload-config.h>
+#include <cbfs.h>
+#include <cbfs_ram.h>
+#include <sysinfo.h>
+
+#define ROM_SIZE	(256 * 1024)
+#define BOOTBLOCK_SIZE	0x100
+#define FILES		60
+
+struct sysinfo_t lib_sysinfo;
+
+/* Failed assertions end up here. */
+void halt(void)
+{
+	exit(1);
+}
+
+int libpayload_init_default_cbfs_media(struct cbfs_media *media)
+{
+	return -1;
+}
+
+static uint8_t rom[ROM_SIZE];
+static struct cbfs_media ram;
+static int reads, maps;
+
+static size_t count_read(struct cbfs_media *media, void *dest, size_t offset,
+			 size_t count)
+{
+	reads++;
+	return ram.read(&ram, dest, offset, count);
+}
+
+static void *count_map(struct cbfs_media *media, size_t offset, size_t count)
+{
+	maps++;
+	return ram.map(&ram, offset, count);
+}
+
+static void *count_unmap(struct cbfs_media *media, const void *address)
+{
+	return ram.unmap(&ram, address);
+}
+
+static int count_open(struct cbfs_media *media)
+{
+	return 0;
+}
+
+static int count_close(struct cbfs_media *media)
+{
+	return 0;
+}
+
+static struct cbfs_media media = {
+	.open = count_open,
+	.close = count_close,
+	.read = count_read,
+	.map = count_map,
+	.unmap = count_unmap,
+};
+
+static uint32_t align_up(uint32_t offset)
+{
+	return (offset + CBFS_ALIGNMENT - 1) & ~(CBFS_ALIGNMENT - 1);
+}
+
+/* Appends a file, with a compression attribute if decompressed_size is
+ * not 0, and returns the offset following it. */
+static uint32_t add_file(uint32_t offset, const char *name, uint32_t type,
+			 const void *data, uint32_t len,
+			 uint32_t decompressed_size)
+{
+	struct cbfs_file *file = (struct cbfs_file *)&rom[offset];
+	uint32_t header_len = align_up(sizeof(*file) + strlen(name) + 1);
+	uint32_t attr_len = 0;
+
+	if (decompressed_size) {
+		struct cbfs_file_attr_compression *comp =
+			(void *)&rom[offset + header_len];
+
+		attr_len = sizeof(*comp);
+		comp->tag = htonl(CBFS_FILE_ATTR_TAG_COMPRESSION);
+		comp->len = htonl(attr_len);
+		comp->compression = htonl(CBFS_COMPRESS_NONE);
+		comp->decompressed_size = htonl(decompressed_size);
+		file->attributes_offset = htonl(header_len);
+	} else {
+		file->attributes_offset = 0;
+	}
+
+	memcpy(file->magic, CBFS_FILE_MAGIC, sizeof(file->magic));
+	file->len = htonl(len);
+	file->type = htonl(type);
+	file->offset = htonl(header_len + attr_len);
+	memset(file->filename, 0, header_len - sizeof(*file));
+	strcpy(file->filename, name);
+	memcpy(&rom[offset + header_len + attr_len], data, len);
+	return align_up(offset + header_len + attr_len + len);
+}
+
+static void build_rom(int version)
+{
+	struct cbfs_header *header;
+	uint32_t offset = 0, cbfs_end = ROM_SIZE - BOOTBLOCK_SIZE - 1;
+	char name[32], data[300];
+	int i;
+
+	memset(rom, 0xff, sizeof(rom));
+	for (i = 0; i < FILES; i++) {
+		snprintf(name, sizeof(name), "fallback/file%d", i);
+		memset(data, i + version, sizeof(data));
+		offset = add_file(offset, name,
+				  i % 3 ? CBFS_TYPE_RAW : CBFS_TYPE_STAGE,
+				  data, 20 + i * 4, i % 5 ? 0 : 20 + i * 4);
+	}
+
+	/* A second "dup" is never found by name. */
+	offset = add_file(offset, "dup", CBFS_TYPE_RAW, "first", 6, 0);
+	offset = add_file(offset, "dup", CBFS_TYPE_PAYLOAD, "second", 7, 0);
+	if (version)
+		offset = add_file(offset, "new", CBFS_TYPE_RAW, "new", 4, 0);
+
+	/* Empty space up to the bootblock. */
+	add_file(offset, "", 0xffffffff, "", 0, 0);
+	((struct cbfs_file *)&rom[offset])->len =
+		htonl(cbfs_end - offset - 64);
+
+	header = (struct cbfs_header *)&rom[ROM_SIZE - BOOTBLOCK_SIZE];
+	memset(header, 0, sizeof(*header));
+	header->magic = htonl(CBFS_HEADER_MAGIC);
+	header->version = htonl(CBFS_HEADER_VERSION);
+	header->romsize = htonl(ROM_SIZE);
+	header->bootblocksize = htonl(BOOTBLOCK_SIZE);
+	header->align = htonl(CBFS_ALIGNMENT);
+	header->offset = 0;
+	header->architecture = htonl(CBFS_ARCHITECTURE_X86);
+	*(int32_t *)&rom[ROM_SIZE - 4] = -BOOTBLOCK_SIZE;
+}
+
+static void check_handle(struct cbfs_dir *dir, const char *name)
+{
+	const struct cbfs_dir_entry *entry;
+	struct cbfs_handle *h1, *h2;
+	int dir_reads, dir_maps;
+
+	reads = maps = 0;
+	h1 = cbfs_get_handle(&media, name);
+	dir_reads = reads;
+	dir_maps = maps;
+	reads = maps = 0;
+	entry = cbfs_dir_lookup(dir, name);
+	assert(reads == 0 && maps == 0);
+	assert(reads < dir_reads && maps <= dir_maps);
+
+	if (!h1) {
+		assert(!entry);
+		return;
+	}
+	assert(entry);
+	assert(!strcmp(cbfs_dir_name(dir, entry), name));
+	h2 = cbfs_dir_get_handle(dir, entry);
+	assert(h2);
+	assert(h1->type == h2->type);
+	assert(h1->media_offset == h2->media_offset);
+	assert(h1->attribute_offset == h2->attribute_offset);
+	assert(h1->content_offset == h2->content_offset);
+	assert(h1->content_size == h2->content_size);
+	assert(!!cbfs_get_attr(h1, CBFS_FILE_ATTR_TAG_COMPRESSION) ==
+	       !!cbfs_get_attr(h2, CBFS_FILE_ATTR_TAG_COMPRESSION));
+	free(h1);
+	free(h2);
+}
+
+static void test_lookup(void)
+{
+	const struct cbfs_dir_entry *entry;
+	struct cbfs_handle *handle;
+	struct cbfs_dir *dir;
+	char name[32];
+	size_t size;
+	void *data;
+	int i, n;
+
+	reads = maps = 0;
+	dir = cbfs_dir_open(&media);
+	assert(dir);
+	printf("snapshot of %d files: %d reads, %d maps\n", FILES + 3,
+	       reads, maps);
+
+	for (i = 0; i < FILES; i++) {
+		snprintf(name, sizeof(name), "fallback/file%d", i);
+		check_handle(dir, name);
+	}
+	check_handle(dir, "dup");
+	check_handle(dir, "missing");
+	check_handle(dir, "fallback/file");
+	check_handle(dir, "new");
+
+	entry = cbfs_dir_lookup(dir, "dup");
+	handle = cbfs_dir_get_handle(dir, entry);
+	data = cbfs_get_contents(handle, &size, 0);
+	assert(size == 6 && !strcmp(data, "first"));
+	free(data);
+	free(handle);
+
+	/* Compressed files report their decompressed size. */
+	entry = cbfs_dir_lookup(dir, "fallback/file10");
+	handle = cbfs_dir_get_handle(dir, entry);
+	data = cbfs_get_contents(handle, &size, 0);
+	assert(size == 60 && ((uint8_t *)data)[59] == 10);
+	free(data);
+	free(handle);
+
+	/* Iteration sees every file in media order. */
+	n = 0;
+	for (entry = cbfs_dir_next(dir, NULL); entry;
+	     entry = cbfs_dir_next(dir, entry))
+		n++;
+	assert(n == FILES + 3);
+	n = 0;
+	for (entry = cbfs_dir_next_type(dir, NULL, CBFS_TYPE_STAGE); entry;
+	     entry = cbfs_dir_next_type(dir, entry, CBFS_TYPE_STAGE)) {
+		snprintf(name, sizeof(name), "fallback/file%d", n * 3);
+		assert(!strcmp(cbfs_dir_name(dir, entry), name));
+		n++;
+	}
+	assert(n == (FILES + 2) / 3);
+	entry = cbfs_dir_next_type(dir, NULL, CBFS_TYPE_PAYLOAD);
+	assert(!strcmp(cbfs_dir_name(dir, entry), "dup"));
+	assert(!cbfs_dir_next_type(dir, entry, CBFS_TYPE_PAYLOAD));
+
+	/* The snapshot is kept until it is invalidated. */
+	build_rom(1);
+	assert(!cbfs_dir_lookup(dir, "new"));
+	cbfs_dir_invalidate(dir);
+	reads = 0;
+	assert(cbfs_dir_lookup(dir, "new"));
+	/* Each file header and the master header offset are read once. */
+	assert(reads == FILES + 4 + 1);
+	check_handle(dir, "new");
+	entry = cbfs_dir_lookup(dir, "fallback/file7");
+	handle = cbfs_dir_get_handle(dir, entry);
+	data = cbfs_get_contents(handle, &size, 0);
+	assert(size == 48 && ((uint8_t *)data)[0] == 8);
+	free(data);
+	free(handle);
+
+	cbfs_dir_close(dir);
+}
+
+/* Snapshots of the default media follow setup_cbfs_from_ram(). */
+static void test_default_media(void)
+{
+	static uint8_t copy[ROM_SIZE];
+	struct cbfs_media old;
+	struct cbfs_dir *dir;
+
+	build_rom(0);
+	memcpy(copy, rom, sizeof(copy));
+	assert(!setup_cbfs_from_ram(copy, sizeof(copy)));
+	dir = cbfs_dir_open(CBFS_DEFAULT_MEDIA);
+	assert(dir);
+	assert(cbfs_dir_lookup(dir, "dup"));
+	assert(!cbfs_dir_lookup(dir, "new"));
+
+	build_rom(1);
+	/* ram_media.c cannot release media yet. */
+	assert(!init_default_cbfs_media(&old));
+	free(old.context);
+	assert(!setup_cbfs_from_ram(rom, sizeof(rom)));
+	assert(cbfs_dir_lookup(dir, "new"));
+	cbfs_dir_close(dir);
+}
+
+int main(void)
+{
+	init_cbfs_ram_media(&ram, rom, sizeof(rom));
+	build_rom(0);
+
+	test_lookup();
+	test_default_media();
+
+	printf("cbfs-dir-test: passed\n");
+	return 0;
+}
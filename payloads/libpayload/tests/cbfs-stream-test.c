@@ -0,0 +1,422 @@
+/*
+ * Streaming decompression of CBFS files against a CBFS built in memory,
+ * compressed by cbfstool's encoders: LZMA, LZ4 and uncompressed files of
+ * all sizes must read back the same through cbfs_get_contents(), stream
+ * reads of any chunk size and cbfs_stream_process(), and truncated
+ * compressed files must fail. Raw LZMA streams with a small dictionary
+ * make the window wrap.
+ */
+
+#define LIBPAYLOAD
+
+/* system headers */
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* libpayload headers */
+#include <libpayload-config.h>
+#include <cbfs.h>
+#include <cbfs_ram.h>
+#include <lz4.h>
+#include <lzma.h>
+#include <sysinfo.h>
+
+/* cbfstool's encoders */
+#include "../../../util/cbfstool/lzma/C/LzmaEnc.h"
+#include "../../../util/cbfstool/lz4/lib/lz4frame.h"
+
+#define ROM_SIZE	(4 * 1024 * 1024)
+#define BOOTBLOCK_SIZE	0x100
+#define DATA_SIZE	(400 * 1024)
+#define RAW_SIZE	(DATA_SIZE + DATA_SIZE / 8 + 1024)
+
+#define ARRAY_SIZE(a)	(sizeof(a) / sizeof((a)[0]))
+
+struct sysinfo_t lib_sysinfo;
+
+/* Failed assertions end up here. */
+void halt(void)
+{
+	exit(1);
+}
+
+int libpayload_init_default_cbfs_media(struct cbfs_media *media)
+{
+	return -1;
+}
+
+static uint8_t rom[ROM_SIZE];
+static struct cbfs_media media;
+static uint8_t data[DATA_SIZE];
+static uint8_t raw[RAW_SIZE];
+static uint32_t rom_offset;
+
+static const size_t sizes[] = { 1, 2, 1000, 4096, 70000, DATA_SIZE };
+static const int algos[] = {
+	CBFS_COMPRESS_NONE, CBFS_COMPRESS_LZMA, CBFS_COMPRESS_LZ4
+};
+
+/* Code, tables and text alike: runs, copies and noise. The noise at the
+ * end does not compress. */
+static void make_data(void)
+{
+	size_t pos = 0, end = DATA_SIZE - 32 * 1024;
+
+	srand(7);
+	for (pos = end; pos < DATA_SIZE; pos++)
+		data[pos] = rand();
+	pos = 0;
+	while (pos < end) {
+		size_t n = 1 + rand() % 2000, i;
+
+		if (n > end - pos)
+			n = end - pos;
+		switch (rand() % 4) {
+		case 0:
+			memset(data + pos, rand() % 3 ? 0 : 0xff, n);
+			break;
+		case 1:
+			for (i = 0; i < n; i++)
+				data[pos + i] = rand();
+			break;
+		case 2:
+			for (i = 0; i < n; i++)
+				data[pos + i] = "libpayload "[rand() % 11];
+			break;
+		default:
+			if (pos > 0) {
+				size_t from = rand() % pos;
+
+				for (i = 0; i < n; i++)
+					data[pos + i] = data[from + i];
+			}
+			break;
+		}
+		pos += n;
+	}
+}
+
+static void *sz_alloc(void *p, size_t size)
+{
+	return malloc(size);
+}
+
+static void sz_free(void *p, void *address)
+{
+	free(address);
+}
+
+static struct ISzAlloc alloc = { sz_alloc, sz_free };
+
+/* LZMA as cbfstool writes it, or with an end marker and a given
+ * dictionary if dict_size is not 0. */
+static size_t lzma_encode(const uint8_t *src, size_t len, uint8_t *dst,
+			  uint32_t dict_size)
+{
+	struct CLzmaEncProps props;
+	size_t props_size = LZMA_PROPS_SIZE;
+	size_t size = RAW_SIZE - LZMA_HEADER_SIZE;
+	uint64_t out_size = dict_size ? LZMA_SIZE_UNKNOWN : len;
+	int i;
+
+	LzmaEncProps_Init(&props);
+	props.dictSize = dict_size ? dict_size : len;
+	props.lc = 1;
+	props.lp = 0;
+	props.pb = 0;
+	props.fb = 273;
+	props.numThreads = 1;
+	assert(LzmaEncode(dst + LZMA_HEADER_SIZE, &size, src, len, &props,
+			  dst, &props_size, !!dict_size, NULL, &alloc,
+			  &alloc) == SZ_OK);
+	for (i = 0; i < 8; i++)
+		dst[LZMA_PROPS_SIZE + i] = out_size >> (8 * i);
+	return LZMA_HEADER_SIZE + size;
+}
+
+static size_t compress(int algo, const uint8_t *src, size_t len,
+		       uint8_t *dst)
+{
+	LZ4F_preferences_t prefs = {
+		.compressionLevel = 20,
+		.frameInfo = {
+			.blockSizeID = max4MB,
+			.blockMode = blockIndependent,
+			.contentChecksumFlag = noContentChecksum,
+		},
+	};
+	size_t size;
+
+	switch (algo) {
+	case CBFS_COMPRESS_LZMA:
+		return lzma_encode(src, len, dst, 0);
+	case CBFS_COMPRESS_LZ4:
+		size = LZ4F_compressFrame(dst, RAW_SIZE, src, len, &prefs);
+		assert(!LZ4F_isError(size));
+		return size;
+	default:
+		memcpy(dst, src, len);
+		return len;
+	}
+}
+
+static uint32_t align_up(uint32_t offset)
+{
+	return (offset + CBFS_ALIGNMENT - 1) & ~(CBFS_ALIGNMENT - 1);
+}
+
+/* Appends the last len bytes of data as a file, compressed with algo, and
+ * cut short by cut bytes. */
+static void add_file(const char *name, int algo, size_t len, size_t cut)
+{
+	struct cbfs_file *file = (struct cbfs_file *)&rom[rom_offset];
+	uint32_t header_len = align_up(sizeof(*file) + strlen(name) + 1);
+	uint32_t attr_len = 0;
+	size_t size;
+
+	size = compress(algo, &data[DATA_SIZE - len], len, raw) - cut;
+	if (algo != CBFS_COMPRESS_NONE) {
+		struct cbfs_file_attr_compression *comp =
+			(void *)&rom[rom_offset + header_len];
+
+		attr_len = sizeof(*comp);
+		comp->tag = htonl(CBFS_FILE_ATTR_TAG_COMPRESSION);
+		comp->len = htonl(attr_len);
+		comp->compression = htonl(algo);
+		comp->decompressed_size = htonl(len);
+		file->attributes_offset = htonl(header_len);
+	} else {
+		file->attributes_offset = 0;
+	}
+
+	memcpy(file->magic, CBFS_FILE_MAGIC, sizeof(file->magic));
+	file->len = htonl(size);
+	file->type = htonl(CBFS_TYPE_RAW);
+	file->offset = htonl(header_len + attr_len);
+	memset(file->filename, 0, header_len - sizeof(*file));
+	strcpy(file->filename, name);
+	memcpy(&rom[rom_offset + header_len + attr_len], raw, size);
+	rom_offset = align_up(rom_offset + header_len + attr_len + size);
+	assert(rom_offset < ROM_SIZE / 2);
+}
+
+static void build_rom(void)
+{
+	struct cbfs_header *header;
+	uint32_t empty, cbfs_end = ROM_SIZE - BOOTBLOCK_SIZE - 1;
+	char name[32];
+	int a, i;
+
+	memset(rom, 0xff, sizeof(rom));
+	for (a = 0; a < ARRAY_SIZE(algos); a++) {
+		for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+			snprintf(name, sizeof(name), "%d/%zu", algos[a],
+				 sizes[i]);
+			add_file(name, algos[a], sizes[i], 0);
+		}
+		/* Only compressed files know how long they should be. */
+		if (algos[a] == CBFS_COMPRESS_NONE)
+			continue;
+		snprintf(name, sizeof(name), "%d/cut", algos[a]);
+		add_file(name, algos[a], 70000, 100);
+	}
+
+	/* Empty space up to the bootblock. */
+	empty = rom_offset;
+	add_file("", CBFS_COMPRESS_NONE, 0, 0);
+	((struct cbfs_file *)&rom[empty])->type = 0xffffffff;
+	((struct cbfs_file *)&rom[empty])->len = htonl(cbfs_end - empty - 64);
+
+	header = (struct cbfs_header *)&rom[ROM_SIZE - BOOTBLOCK_SIZE];
+	memset(header, 0, sizeof(*header));
+	header->magic = htonl(CBFS_HEADER_MAGIC);
+	header->version = htonl(CBFS_HEADER_VERSION);
+	header->romsize = htonl(ROM_SIZE);
+	header->bootblocksize = htonl(BOOTBLOCK_SIZE);
+	header->align = htonl(CBFS_ALIGNMENT);
+	header->offset = 0;
+	header->architecture = htonl(CBFS_ARCHITECTURE_X86);
+	*(int32_t *)&rom[ROM_SIZE - 4] = -BOOTBLOCK_SIZE;
+}
+
+static struct cbfs_handle *open_file(int algo, size_t len)
+{
+	struct cbfs_handle *handle;
+	char name[32];
+
+	snprintf(name, sizeof(name), "%d/%zu", algo, len);
+	handle = cbfs_get_handle(&media, name);
+	assert(handle);
+	return handle;
+}
+
+static void test_get_contents(int algo, size_t len)
+{
+	const uint8_t *expected = &data[DATA_SIZE - len];
+	struct cbfs_handle *handle = open_file(algo, len);
+	size_t size, limit;
+	void *buf;
+
+	buf = cbfs_get_contents(handle, &size, 0);
+	assert(buf && size == len);
+	assert(!memcmp(buf, expected, len));
+	free(buf);
+
+	/* A limit stops decompression early. */
+	limit = len / 3 + 1;
+	buf = cbfs_get_contents(handle, &size, limit);
+	assert(buf && size == limit);
+	assert(!memcmp(buf, expected, limit));
+	free(buf);
+
+	free(handle);
+}
+
+static void test_stream_read(int algo, size_t len)
+{
+	static const size_t chunks[] = { 1, 7, 4096, 65537, 1024 * 1024 };
+	static uint8_t buf[DATA_SIZE];
+	const uint8_t *expected = &data[DATA_SIZE - len];
+	struct cbfs_handle *handle = open_file(algo, len);
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(chunks); i++) {
+		struct cbfs_stream *stream = cbfs_stream_open(handle);
+		size_t done = 0;
+		ssize_t ret;
+
+		assert(stream);
+		while ((ret = cbfs_stream_read(stream, buf + done,
+					       chunks[i])) > 0)
+			done += ret;
+		assert(ret == 0);
+		assert(done == len);
+		assert(!memcmp(buf, expected, len));
+		cbfs_stream_close(stream);
+	}
+
+	free(handle);
+}
+
+struct sink {
+	const uint8_t *expected;
+	size_t done;
+	size_t stop;
+	int calls;
+};
+
+static int check_piece(void *arg, const void *piece, size_t size)
+{
+	struct sink *sink = arg;
+
+	assert(!memcmp(piece, sink->expected + sink->done, size));
+	sink->done += size;
+	sink->calls++;
+	return sink->stop && sink->done >= sink->stop;
+}
+
+static void test_process(int algo, size_t len)
+{
+	struct cbfs_handle *handle = open_file(algo, len);
+	struct sink sink = { &data[DATA_SIZE - len], 0, 0, 0 };
+
+	assert(cbfs_stream_process(handle, check_piece, &sink) == len);
+	assert(sink.done == len);
+
+	/* A sink can stop early. */
+	if (len > 1) {
+		sink.done = 0;
+		sink.stop = 1;
+		sink.calls = 0;
+		assert(cbfs_stream_process(handle, check_piece, &sink) == -1);
+		assert(sink.calls == 1);
+	}
+
+	free(handle);
+}
+
+/* Truncated files fail, rather than returning part of the contents. */
+static void test_cut(int algo)
+{
+	static uint8_t buf[DATA_SIZE];
+	struct cbfs_stream *stream;
+	struct cbfs_handle *handle;
+	char name[32];
+
+	snprintf(name, sizeof(name), "%d/cut", algo);
+	handle = cbfs_get_handle(&media, name);
+	assert(handle);
+	assert(!cbfs_get_contents(handle, NULL, 0));
+	stream = cbfs_stream_open(handle);
+	assert(stream);
+	assert(cbfs_stream_read(stream, buf, sizeof(buf)) == -1);
+	cbfs_stream_close(stream);
+	free(handle);
+}
+
+struct raw_input {
+	const uint8_t *p;
+	size_t left;
+};
+
+static size_t read_raw(void *arg, void *buf, size_t size)
+{
+	struct raw_input *in = arg;
+
+	if (size > in->left)
+		size = in->left;
+	memcpy(buf, in->p, size);
+	in->p += size;
+	in->left -= size;
+	return size;
+}
+
+/* Raw LZMA streams with an end marker and a dictionary much smaller than
+ * the output, decoded into a window of the dictionary size. */
+static void test_lzma_window(uint32_t dict_size)
+{
+	struct raw_input in = { raw, lzma_encode(data, DATA_SIZE, raw,
+						 dict_size) };
+	struct lzma_stream s;
+	size_t done = 0;
+	const void *out;
+	ssize_t ret;
+
+	assert(lzma_stream_init(&s, read_raw, &in, NULL, dict_size) == 0);
+	while ((ret = lzma_stream_next(&s, &out, 1 + rand() % 10000)) > 0) {
+		assert(done + ret <= DATA_SIZE);
+		assert(!memcmp(out, &data[done], ret));
+		done += ret;
+	}
+	assert(ret == 0);
+	assert(done == DATA_SIZE);
+	lzma_stream_free(&s);
+}
+
+int main(void)
+{
+	int a, i;
+
+	make_data();
+	build_rom();
+	init_cbfs_ram_media(&media, rom, sizeof(rom));
+
+	for (a = 0; a < ARRAY_SIZE(algos); a++) {
+		for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+			test_get_contents(algos[a], sizes[i]);
+			test_stream_read(algos[a], sizes[i]);
+			test_process(algos[a], sizes[i]);
+		}
+		if (algos[a] != CBFS_COMPRESS_NONE)
+			test_cut(algos[a]);
+	}
+
+	test_lzma_window(4096);
+	test_lzma_window(64 * 1024);
+
+	free(media.context);
+	printf("cbfs-stream-test: passed\n");
+	return 0;
+}
@@ -253,7 +253,7 @@ void acpi_create_mcfg(acpi_mcfg_t *mcfg)
 	header->checksum = acpi_checksum((void *)mcfg, header->length);
 }
 
-static void *get_tcpa_log(u32 *size)
+void *acpi_get_tcpa_log(u32 *size)
 {
 	const struct cbmem_entry *ce;
 	const u32 tcpa_default_log_len = 0x10000;
@@ -286,7 +286,7 @@ static void acpi_create_tcpa(acpi_tcpa_t *tcpa)
 
 	memset((void *)tcpa, 0, sizeof(acpi_tcpa_t));
 
-	lasa = get_tcpa_log(&tcpa_log_len);
+	lasa = acpi_get_tcpa_log(&tcpa_log_len);
 	if (!lasa) {
 		return;
 	}
@@ -200,7 +200,9 @@ int arch_supports_bounce_buffer(void)
 static void try_payload(struct prog *prog)
 {
 	if (prog_type(prog) == PROG_PAYLOAD) {
-		if (IS_ENABLED(CONFIG_RELOCATABLE_RAMSTAGE))
+		/* Without a bounce buffer the payload is clear of coreboot. */
+		if (IS_ENABLED(CONFIG_RELOCATABLE_RAMSTAGE) ||
+		    !prog_size(prog))
 			jmp_payload_no_bounce_buffer(prog_entry(prog));
 		else
 			jmp_payload(prog_entry(prog),
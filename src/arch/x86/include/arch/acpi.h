@@ -641,6 +641,9 @@ unsigned long acpi_create_hest_error_source(acpi_hest_t *hest, acpi_hest_esd_t *
 
 void acpi_save_gnvs(u32 gnvs_address);
 
+/* Find the TCPA event log in CBMEM, allocating it on first use. */
+void *acpi_get_tcpa_log(u32 *size);
+
 /* For ACPI S3 support. */
 void acpi_fail_wakeup(void);
 void acpi_resume(void *wake_vec);
@@ -0,0 +1,51 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __ARCH_TABLE_CACHE_H__
+#define __ARCH_TABLE_CACHE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if IS_ENABLED(CONFIG_TABLE_CACHE)
+/*
+ * Copy the tables with CBMEM id from the cache in RW_TABLE_CACHE to start
+ * if they were generated on a boot with the same fingerprint, relocating
+ * them if start differs from where they were generated. Returns the end
+ * of the restored tables, or 0 if they have to be generated.
+ */
+unsigned long table_cache_restore(uint32_t id, unsigned long start,
+				  size_t max_size);
+
+/* Record the freshly generated tables in [start, end) for the next boot. */
+void table_cache_save(uint32_t id, unsigned long start, unsigned long end);
+
+/* Add board specific inputs of the tables to the fingerprint. */
+void table_cache_fingerprint_add(const void *data, size_t size);
+
+/* Called from the fingerprint calculation, use table_cache_fingerprint_add */
+void mainboard_table_cache_fingerprint(void);
+#else
+static inline unsigned long table_cache_restore(uint32_t id,
+						unsigned long start,
+						size_t max_size)
+{
+	return 0;
+}
+static inline void table_cache_save(uint32_t id, unsigned long start,
+				    unsigned long end) {}
+static inline void table_cache_fingerprint_add(const void *data,
+					       size_t size) {}
+#endif
+
+#endif
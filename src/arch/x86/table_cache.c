@@ -0,0 +1,531 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Cross boot cache of the ACPI and SMBIOS tables. The fingerprint covers
+ * everything the table generators look at that can change without a new
+ * coreboot build: the device tree including all resources and therefore
+ * the memory map, the CPU, the DIMMs and the location of the CBMEM areas
+ * the tables point into. The tables themselves may move; pointers within
+ * them are relocated on restore.
+ *
+ * RW_TABLE_CACHE is not verified. The hash stored with each entry only
+ * catches stale or torn updates, it is no authentication, so whoever can
+ * write the region decides which tables the OS gets. Restoring must still
+ * never touch memory outside of the destination: every pointer and length
+ * read from the cache is checked to stay within the restored tables, and
+ * the cache is rejected if one does not.
+ */
+
+#include <arch/acpi.h>
+#include <arch/cpu.h>
+#include <arch/table_cache.h>
+#include <bootstate.h>
+#include <cbmem.h>
+#include <console/console.h>
+#include <device/device.h>
+#include <fmap.h>
+#include <smbios.h>
+#include <string.h>
+#include <version.h>
+
+#define TABLE_CACHE_REGION	"RW_TABLE_CACHE"
+#define TABLE_CACHE_SIGNATURE	0x434c4254	/* 'TBLC' */
+#define TABLE_CACHE_VERSION	1
+#define TABLE_CACHE_MAX_ENTRIES	4
+
+#define FNV_OFFSET_BASIS	0xcbf29ce484222325ULL
+#define FNV_PRIME		0x100000001b3ULL
+
+struct table_cache_entry {
+	uint32_t id;
+	uint32_t offset;	/* of the data within the region */
+	uint32_t size;
+	uint32_t reserved;
+	uint64_t base;		/* address the tables were generated at */
+	uint64_t hash;		/* of the data */
+} __attribute__((packed));
+
+struct table_cache_header {
+	uint32_t signature;
+	uint16_t version;
+	uint16_t num_entries;
+	uint64_t fingerprint;
+	struct table_cache_entry entries[TABLE_CACHE_MAX_ENTRIES];
+} __attribute__((packed));
+
+/* CBMEM areas the generated tables hold pointers to. */
+static const uint32_t referenced_cbmem_ids[] = {
+	CBMEM_ID_CBTABLE,
+	CBMEM_ID_ACPI_GNVS,
+	CBMEM_ID_TCPA_LOG,
+	CBMEM_ID_ELOG,
+};
+
+static struct {
+	int loaded;
+	uint64_t fingerprint;
+	struct region_device rdev;
+	/* Contents of RW_TABLE_CACHE, valid if signature is set */
+	struct table_cache_header flash;
+	/* Tables of this boot, written back if any were generated */
+	struct table_cache_header current;
+	int dirty;
+} cache;
+
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t size)
+{
+	const uint8_t *p = data;
+
+	while (size--) {
+		hash ^= *p++;
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+void table_cache_fingerprint_add(const void *data, size_t size)
+{
+	cache.fingerprint = fnv1a(cache.fingerprint, data, size);
+}
+
+void __attribute__((weak)) mainboard_table_cache_fingerprint(void)
+{
+}
+
+static void fingerprint_add_u64(uint64_t value)
+{
+	table_cache_fingerprint_add(&value, sizeof(value));
+}
+
+static void fingerprint_add_string(const char *s)
+{
+	table_cache_fingerprint_add(s, strlen(s) + 1);
+}
+
+static void fingerprint_add_cbmem(uint32_t id, int contents)
+{
+	const struct cbmem_entry *e = cbmem_entry_find(id);
+
+	fingerprint_add_u64(id);
+	if (!e) {
+		fingerprint_add_u64(0);
+		return;
+	}
+
+	fingerprint_add_u64((uintptr_t)cbmem_entry_start(e));
+	fingerprint_add_u64(cbmem_entry_size(e));
+	if (contents)
+		table_cache_fingerprint_add(cbmem_entry_start(e),
+					    cbmem_entry_size(e));
+}
+
+static void fingerprint_add_devices(void)
+{
+	struct device *dev;
+	struct resource *res;
+
+	for (dev = all_devices; dev; dev = dev->next) {
+		fingerprint_add_string(dev_path(dev));
+		fingerprint_add_u64(dev->enabled);
+		fingerprint_add_u64(dev->vendor);
+		fingerprint_add_u64(dev->device);
+		fingerprint_add_u64(dev->subsystem_vendor);
+		fingerprint_add_u64(dev->subsystem_device);
+		fingerprint_add_u64(dev->class);
+
+		for (res = dev->resource_list; res; res = res->next) {
+			fingerprint_add_u64(res->index);
+			fingerprint_add_u64(res->flags);
+			fingerprint_add_u64(res->base);
+			fingerprint_add_u64(res->size);
+		}
+	}
+}
+
+static void table_cache_fingerprint(void)
+{
+	size_t i;
+	u32 size;
+
+	/*
+	 * write_acpi_tables() allocates the TCPA log on first use. Allocate
+	 * it now so that it also exists when the tables are restored, and
+	 * so that its location is part of the fingerprint.
+	 */
+	if (IS_ENABLED(CONFIG_HAVE_ACPI_TABLES))
+		acpi_get_tcpa_log(&size);
+
+	cache.fingerprint = FNV_OFFSET_BASIS;
+
+	/* Any rebuild may change what the generators produce. */
+	fingerprint_add_string(coreboot_version);
+	fingerprint_add_string(coreboot_extra_version);
+	fingerprint_add_string(coreboot_build);
+	fingerprint_add_string(coreboot_compile_time);
+
+	fingerprint_add_u64(cpuid_eax(1));
+	fingerprint_add_u64((uintptr_t)cbmem_top());
+	fingerprint_add_devices();
+
+	/* DIMM serial and part numbers */
+	fingerprint_add_cbmem(CBMEM_ID_MEMINFO, 1);
+
+	for (i = 0; i < ARRAY_SIZE(referenced_cbmem_ids); i++)
+		fingerprint_add_cbmem(referenced_cbmem_ids[i], 0);
+
+	mainboard_table_cache_fingerprint();
+}
+
+static int table_cache_load(void)
+{
+	if (cache.loaded)
+		return cache.loaded > 0;
+
+	cache.loaded = -1;
+	cache.current.signature = TABLE_CACHE_SIGNATURE;
+	cache.current.version = TABLE_CACHE_VERSION;
+
+	if (fmap_locate_area_as_rdev_rw(TABLE_CACHE_REGION, &cache.rdev) < 0) {
+		printk(BIOS_ERR, "Table cache: %s not found\n",
+		       TABLE_CACHE_REGION);
+		return 0;
+	}
+
+	table_cache_fingerprint();
+	cache.current.fingerprint = cache.fingerprint;
+	cache.loaded = 1;
+
+	if (rdev_readat(&cache.rdev, &cache.flash, 0, sizeof(cache.flash)) !=
+	    sizeof(cache.flash) ||
+	    cache.flash.signature != TABLE_CACHE_SIGNATURE ||
+	    cache.flash.version != TABLE_CACHE_VERSION ||
+	    cache.flash.num_entries > TABLE_CACHE_MAX_ENTRIES) {
+		printk(BIOS_DEBUG, "Table cache: empty\n");
+		cache.flash.signature = 0;
+	} else if (cache.flash.fingerprint != cache.fingerprint) {
+		printk(BIOS_INFO, "Table cache: fingerprint changed\n");
+		cache.flash.signature = 0;
+	}
+
+	return 1;
+}
+
+static void table_cache_record(uint32_t id, unsigned long start, size_t size)
+{
+	struct table_cache_entry *e;
+	size_t i;
+
+	for (i = 0; i < cache.current.num_entries; i++)
+		if (cache.current.entries[i].id == id)
+			break;
+	if (i == TABLE_CACHE_MAX_ENTRIES)
+		return;
+	if (i == cache.current.num_entries)
+		cache.current.num_entries++;
+
+	e = &cache.current.entries[i];
+	e->id = id;
+	e->base = start;
+	e->size = size;
+}
+
+/*
+ * The chipset sets up GNVS from its ACPI generators. Restoring the tables
+ * would skip that, so the ACPI tables of such boards are never cached.
+ */
+static int acpi_uses_gnvs(void)
+{
+	return cbmem_entry_find(CBMEM_ID_ACPI_GNVS) ||
+		cbmem_entry_find(CBMEM_ID_ACPI_GNVS_PTR);
+}
+
+static uint64_t relocate(uint64_t p, unsigned long old, unsigned long new,
+			 size_t size)
+{
+	if (p >= old && p - old < size)
+		p += new - old;
+	return p;
+}
+
+/* Whether [p, p + len) lies within the tables restored to [new, new + size) */
+static int in_tables(uint64_t p, uint64_t len, unsigned long new, size_t size)
+{
+	return p >= new && len <= size && p - new <= size - len;
+}
+
+/* The ACPI table at p if it lies within the restored tables. */
+static acpi_header_t *acpi_table_at(uint64_t p, size_t min_length,
+				    unsigned long new, size_t size)
+{
+	acpi_header_t *header = (acpi_header_t *)(uintptr_t)p;
+
+	if (!in_tables(p, sizeof(*header), new, size) ||
+	    header->length < min_length ||
+	    !in_tables(p, header->length, new, size))
+		return NULL;
+	return header;
+}
+
+static int fadt_relocate(acpi_fadt_t *fadt, unsigned long old,
+			 unsigned long new, size_t size)
+{
+	uint64_t x_firmware_ctl, x_dsdt;
+
+	if (fadt->header.length < sizeof(*fadt))
+		return -1;
+
+	fadt->firmware_ctrl = relocate(fadt->firmware_ctrl, old, new, size);
+	fadt->dsdt = relocate(fadt->dsdt, old, new, size);
+	x_firmware_ctl = relocate((uint64_t)fadt->x_firmware_ctl_h << 32 |
+				  fadt->x_firmware_ctl_l, old, new, size);
+	fadt->x_firmware_ctl_l = x_firmware_ctl;
+	fadt->x_firmware_ctl_h = x_firmware_ctl >> 32;
+	x_dsdt = relocate((uint64_t)fadt->x_dsdt_h << 32 | fadt->x_dsdt_l,
+			  old, new, size);
+	fadt->x_dsdt_l = x_dsdt;
+	fadt->x_dsdt_h = x_dsdt >> 32;
+
+	/* The FACS is read again on resume to find the waking vector. */
+	if ((fadt->firmware_ctrl &&
+	     !in_tables(fadt->firmware_ctrl, sizeof(acpi_facs_t), new, size)) ||
+	    (x_firmware_ctl &&
+	     !in_tables(x_firmware_ctl, sizeof(acpi_facs_t), new, size)) ||
+	    !acpi_table_at(fadt->dsdt, sizeof(acpi_header_t), new, size) ||
+	    (x_dsdt && !acpi_table_at(x_dsdt, sizeof(acpi_header_t), new,
+				      size)))
+		return -1;
+
+	fadt->header.checksum = 0;
+	fadt->header.checksum = acpi_checksum((void *)fadt,
+					      fadt->header.length);
+	return 0;
+}
+
+static int acpi_relocate(unsigned long old, unsigned long new, size_t size)
+{
+	acpi_rsdp_t *rsdp = NULL;
+	acpi_rsdt_t *rsdt;
+	acpi_xsdt_t *xsdt;
+	acpi_header_t *header;
+	unsigned long p;
+	size_t i, n;
+
+	for (p = new; p + sizeof(*rsdp) <= new + size; p += 16) {
+		if (!memcmp(((acpi_rsdp_t *)p)->signature, RSDP_SIG, 8)) {
+			rsdp = (acpi_rsdp_t *)p;
+			break;
+		}
+	}
+	if (!rsdp)
+		return -1;
+
+	rsdp->rsdt_address = relocate(rsdp->rsdt_address, old, new, size);
+	rsdp->xsdt_address = relocate(rsdp->xsdt_address, old, new, size);
+	rsdp->checksum = 0;
+	rsdp->checksum = acpi_checksum((void *)rsdp, 20);
+	rsdp->ext_checksum = 0;
+	rsdp->ext_checksum = acpi_checksum((void *)rsdp, sizeof(acpi_rsdp_t));
+
+	/* coreboot puts all tables the RSDT and XSDT list into the blob. */
+	rsdt = (acpi_rsdt_t *)acpi_table_at(rsdp->rsdt_address,
+					    sizeof(acpi_header_t), new, size);
+	if (!rsdt)
+		return -1;
+	n = (rsdt->header.length - sizeof(acpi_header_t)) / sizeof(u32);
+	if (n > ARRAY_SIZE(rsdt->entry))
+		return -1;
+	for (i = 0; i < n; i++) {
+		rsdt->entry[i] = relocate(rsdt->entry[i], old, new, size);
+		header = acpi_table_at(rsdt->entry[i], sizeof(acpi_header_t),
+				       new, size);
+		if (!header)
+			return -1;
+		if (!memcmp(header->signature, "FACP", 4) &&
+		    fadt_relocate((acpi_fadt_t *)header, old, new, size) < 0)
+			return -1;
+	}
+	rsdt->header.checksum = 0;
+	rsdt->header.checksum = acpi_checksum((void *)rsdt,
+					      rsdt->header.length);
+
+	if (!rsdp->xsdt_address)
+		return 0;
+
+	xsdt = (acpi_xsdt_t *)acpi_table_at(rsdp->xsdt_address,
+					    sizeof(acpi_header_t), new, size);
+	if (!xsdt)
+		return -1;
+	n = (xsdt->header.length - sizeof(acpi_header_t)) / sizeof(u64);
+	if (n > ARRAY_SIZE(xsdt->entry))
+		return -1;
+	for (i = 0; i < n; i++) {
+		xsdt->entry[i] = relocate(xsdt->entry[i], old, new, size);
+		if (!acpi_table_at(xsdt->entry[i], sizeof(acpi_header_t), new,
+				   size))
+			return -1;
+	}
+	xsdt->header.checksum = 0;
+	xsdt->header.checksum = acpi_checksum((void *)xsdt,
+					      xsdt->header.length);
+
+	return 0;
+}
+
+static u8 smbios_checksum(u8 *p, u32 length)
+{
+	u8 ret = 0;
+	while (length--)
+		ret += *p++;
+	return -ret;
+}
+
+static int smbios_relocate(unsigned long old, unsigned long new, size_t size)
+{
+	struct smbios_entry *se = (struct smbios_entry *)new;
+
+	if (size < sizeof(*se) || memcmp(se->anchor, "_SM_", 4))
+		return -1;
+
+	se->struct_table_address = relocate(se->struct_table_address, old,
+					    new, size);
+	if (!in_tables(se->struct_table_address, se->struct_table_length, new,
+		       size))
+		return -1;
+	se->intermediate_checksum = 0;
+	se->intermediate_checksum = smbios_checksum((u8 *)se + 0x10,
+					sizeof(struct smbios_entry) - 0x10);
+	se->checksum = 0;
+	se->checksum = smbios_checksum((u8 *)se, sizeof(struct smbios_entry));
+
+	return 0;
+}
+
+/*
+ * Check the tables at new, of which pointers into [old, old + size) are
+ * moved along with them. Returns < 0 if restoring them would be unsafe.
+ */
+static int tables_relocate(uint32_t id, unsigned long old, unsigned long new,
+			   size_t size)
+{
+	if (id == CBMEM_ID_ACPI)
+		return acpi_relocate(old, new, size);
+	if (id == CBMEM_ID_SMBIOS)
+		return smbios_relocate(old, new, size);
+	return -1;
+}
+
+unsigned long table_cache_restore(uint32_t id, unsigned long start,
+				  size_t max_size)
+{
+	const struct table_cache_entry *e = NULL;
+	size_t i;
+
+	if (!table_cache_load() || !cache.flash.signature)
+		return 0;
+	if (id == CBMEM_ID_ACPI && acpi_uses_gnvs())
+		return 0;
+
+	for (i = 0; i < cache.flash.num_entries; i++) {
+		if (cache.flash.entries[i].id == id) {
+			e = &cache.flash.entries[i];
+			break;
+		}
+	}
+	if (!e || e->size > max_size)
+		return 0;
+
+	if (rdev_readat(&cache.rdev, (void *)start, e->offset, e->size) !=
+	    e->size ||
+	    fnv1a(FNV_OFFSET_BASIS, (void *)start, e->size) != e->hash) {
+		printk(BIOS_ERR, "Table cache: %08x corrupted\n", id);
+		return 0;
+	}
+
+	if (tables_relocate(id, e->base, start, e->size) < 0) {
+		printk(BIOS_ERR, "Table cache: %08x rejected\n", id);
+		return 0;
+	}
+
+	printk(BIOS_DEBUG, "Table cache: restored %08x, %u bytes\n", id,
+	       e->size);
+	table_cache_record(id, start, e->size);
+	return start + e->size;
+}
+
+void table_cache_save(uint32_t id, unsigned long start, unsigned long end)
+{
+	if (!table_cache_load() || end <= start)
+		return;
+	if (id == CBMEM_ID_ACPI && acpi_uses_gnvs()) {
+		printk(BIOS_INFO, "Table cache: GNVS in use, not caching "
+		       "ACPI tables\n");
+		return;
+	}
+	/* Tables that would be rejected on restore aren't worth a write. */
+	if (tables_relocate(id, start, start, end - start) < 0) {
+		printk(BIOS_ERR, "Table cache: not caching %08x\n", id);
+		return;
+	}
+
+	table_cache_record(id, start, end - start);
+	cache.dirty = 1;
+}
+
+static void table_cache_flush(void *unused)
+{
+	struct table_cache_header *h = &cache.current;
+	size_t i, offset, region_size;
+
+	if (!cache.dirty)
+		return;
+
+	region_size = region_device_sz(&cache.rdev);
+	offset = ALIGN_UP(sizeof(*h), 16);
+	for (i = 0; i < h->num_entries; i++) {
+		struct table_cache_entry *e = &h->entries[i];
+
+		e->offset = offset;
+		e->hash = fnv1a(FNV_OFFSET_BASIS, (void *)(uintptr_t)e->base,
+				e->size);
+		offset = ALIGN_UP(offset + e->size, 16);
+	}
+
+	if (offset > region_size) {
+		printk(BIOS_ERR, "Table cache: %zu bytes don't fit in %s\n",
+		       offset, TABLE_CACHE_REGION);
+		return;
+	}
+
+	/* The header goes last so an interrupted update is never used. */
+	if (rdev_eraseat(&cache.rdev, 0, region_size) != region_size)
+		goto fail;
+	for (i = 0; i < h->num_entries; i++) {
+		struct table_cache_entry *e = &h->entries[i];
+
+		if (rdev_writeat(&cache.rdev, (void *)(uintptr_t)e->base,
+				 e->offset, e->size) != e->size)
+			goto fail;
+	}
+	if (rdev_writeat(&cache.rdev, h, 0, sizeof(*h)) != sizeof(*h))
+		goto fail;
+
+	printk(BIOS_INFO, "Table cache: updated, %zu bytes\n", offset);
+	return;
+
+fail:
+	printk(BIOS_ERR, "Table cache: update of %s failed\n",
+	       TABLE_CACHE_REGION);
+}
+
+BOOT_STATE_INIT_ENTRY(BS_WRITE_TABLES, BS_ON_EXIT, table_cache_flush, NULL);
@@ -23,6 +23,7 @@
 #include <arch/pirq_routing.h>
 #include <arch/smp/mpspec.h>
 #include <arch/acpi.h>
+#include <arch/table_cache.h>
 #include <string.h>
 #include <cbmem.h>
 #include <smbios.h>
@@ -111,7 +112,14 @@ static unsigned long write_acpi_table(unsigned long rom_table_end)
 		unsigned long new_high_table_pointer;
 
 		rom_table_end = ALIGN(rom_table_end, 16);
-		new_high_table_pointer = write_acpi_tables(high_table_pointer);
+		new_high_table_pointer = table_cache_restore(CBMEM_ID_ACPI,
+					high_table_pointer, MAX_ACPI_SIZE);
+		if (!new_high_table_pointer) {
+			new_high_table_pointer =
+				write_acpi_tables(high_table_pointer);
+			table_cache_save(CBMEM_ID_ACPI, high_table_pointer,
+					 new_high_table_pointer);
+		}
 		if (new_high_table_pointer > ( high_table_pointer + MAX_ACPI_SIZE)) {
 			printk(BIOS_ERR, "ERROR: Increase ACPI size\n");
 		}
@@ -160,7 +168,14 @@ static unsigned long write_smbios_table(unsigned long rom_table_end)
 	if (high_table_pointer) {
 		unsigned long new_high_table_pointer;
 
-		new_high_table_pointer = smbios_write_tables(high_table_pointer);
+		new_high_table_pointer = table_cache_restore(CBMEM_ID_SMBIOS,
+					high_table_pointer, MAX_SMBIOS_SIZE);
+		if (!new_high_table_pointer) {
+			new_high_table_pointer =
+				smbios_write_tables(high_table_pointer);
+			table_cache_save(CBMEM_ID_SMBIOS, high_table_pointer,
+					 new_high_table_pointer);
+		}
 		rom_table_end = ALIGN(rom_table_end, 16);
 		memcpy((void *)rom_table_end, (void *)high_table_pointer, sizeof(struct smbios_entry));
 		rom_table_end += sizeof(struct smbios_entry);
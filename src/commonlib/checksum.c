@@ -0,0 +1,323 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <commonlib/checksum.h>
+#include <commonlib/endian.h>
+#include <string.h>
+
+/*
+ * IP checksum
+ *
+ * The ones' complement sum does not care about the order in which words are
+ * added, and a carry out of bit 15 only has to be added back in at the end.
+ * So the data is read as wide words into a wide accumulator, which is folded
+ * to 16 bits once. Native endian words give the same sum as the reference
+ * loop over bytes on any machine, because the complement is also stored in
+ * native endianness. Data that starts at an odd offset has its sum byte
+ * swapped (RFC 1071, section 2), which is how an incremental update copes
+ * with chunks of any length.
+ */
+
+typedef uint16_t __attribute__((may_alias)) ipc_u16;
+typedef uint32_t __attribute__((may_alias)) ipc_u32;
+
+#if defined(__SSE2__) || defined(__ARM_NEON)
+/* Lets the compiler use 128-bit SSE2 or NEON registers, without intrinsics
+ * headers, which free-standing builds don't have. */
+#define IPC_VECTOR 1
+typedef uint32_t __attribute__((vector_size(16), may_alias)) ipc_v4u32;
+
+/* A 32-bit lane gains at most 2 * 0xffff per 32 bytes; flush the lanes
+ * well before they can overflow. */
+#define IPC_VECTOR_BATCH	(8192 * 32)
+#endif
+
+static inline uint16_t ipc_fold(uint64_t sum)
+{
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+	return sum;
+}
+
+static inline uint16_t ipc_swap(uint16_t sum)
+{
+	return (sum >> 8) | (sum << 8);
+}
+
+/* A byte at an even offset, as a native endian word. */
+static inline uint16_t ipc_byte(uint8_t b)
+{
+	union {
+		uint8_t byte[2];
+		uint16_t word;
+	} value = { .byte = { b, 0 } };
+
+	return value.word;
+}
+
+#ifdef IPC_VECTOR
+static uint64_t ipc_sum_vector(const uint8_t *p, size_t size)
+{
+	uint64_t sum = 0;
+
+	while (size) {
+		const size_t batch = size < IPC_VECTOR_BATCH ?
+			size : IPC_VECTOR_BATCH;
+		ipc_v4u32 acc0 = { 0 }, acc1 = { 0 };
+		size_t i;
+
+		for (i = 0; i < batch; i += 32) {
+			const ipc_v4u32 a = *(const ipc_v4u32 *)(p + i);
+			const ipc_v4u32 b = *(const ipc_v4u32 *)(p + i + 16);
+
+			acc0 += (a & 0xffff) + (a >> 16);
+			acc1 += (b & 0xffff) + (b >> 16);
+		}
+		acc0 += acc1;
+		sum += (uint64_t)acc0[0] + acc0[1] + acc0[2] + acc0[3];
+		p += batch;
+		size -= batch;
+	}
+	return sum;
+}
+#endif
+
+/* Sum of data at an even address, as if it was at an even offset. */
+static uint16_t ipc_sum_even(const uint8_t *p, size_t size)
+{
+	uint64_t sum = 0;
+
+	if (((uintptr_t)p & 2) && size >= 2) {
+		sum += *(const ipc_u16 *)p;
+		p += 2;
+		size -= 2;
+	}
+
+#ifdef IPC_VECTOR
+	if (size >= 64) {
+		size_t len;
+
+		for (; (uintptr_t)p & 15; p += 4, size -= 4)
+			sum += *(const ipc_u32 *)p;
+		len = size & ~(size_t)31;
+		sum += ipc_sum_vector(p, len);
+		p += len;
+		size -= len;
+	}
+#endif
+
+	for (; size >= 16; p += 16, size -= 16) {
+		const ipc_u32 *w = (const ipc_u32 *)p;
+
+		sum += (uint64_t)w[0] + w[1] + w[2] + w[3];
+	}
+	for (; size >= 4; p += 4, size -= 4)
+		sum += *(const ipc_u32 *)p;
+	if (size >= 2) {
+		sum += *(const ipc_u16 *)p;
+		p += 2;
+		size -= 2;
+	}
+	if (size)
+		sum += ipc_byte(*p);
+
+	return ipc_fold(sum);
+}
+
+/* Sum of data at any address, as if it was at an even offset. */
+static uint16_t ipc_sum(const uint8_t *p, size_t size)
+{
+	if (!size)
+		return 0;
+	if (!((uintptr_t)p & 1))
+		return ipc_sum_even(p, size);
+
+	/* The rest is at an odd offset, but an even address. */
+	return ipc_fold((uint32_t)ipc_byte(*p) +
+			ipc_swap(ipc_sum_even(p + 1, size - 1)));
+}
+
+void ip_checksum_init(struct ip_checksum_ctx *ctx)
+{
+	ctx->sum = 0;
+	ctx->len = 0;
+}
+
+void ip_checksum_update(struct ip_checksum_ctx *ctx, const void *data,
+			size_t size)
+{
+	uint16_t sum = ipc_sum(data, size);
+
+	if (ctx->len & 1)
+		sum = ipc_swap(sum);
+	ctx->sum = ipc_fold(ctx->sum + sum);
+	ctx->len += size;
+}
+
+uint16_t ip_checksum_final(const struct ip_checksum_ctx *ctx)
+{
+	return ~ctx->sum;
+}
+
+uint16_t ip_checksum(const void *data, size_t size)
+{
+	return ~ipc_sum(data, size);
+}
+
+uint16_t ip_checksum_add(size_t offset, uint16_t first, uint16_t second)
+{
+	uint16_t sum = ~first;
+	uint16_t next = ~second;
+
+	if (offset & 1)
+		next = ipc_swap(next);
+	return ~ipc_fold((uint32_t)sum + next);
+}
+
+/* xxHash32 */
+
+#define PRIME32_1	2654435761U
+#define PRIME32_2	2246822519U
+#define PRIME32_3	3266489917U
+#define PRIME32_4	668265263U
+#define PRIME32_5	374761393U
+
+static inline uint32_t rotl32(uint32_t x, int r)
+{
+	return (x << r) | (x >> (32 - r));
+}
+
+static inline uint32_t xxh32_round(uint32_t acc, uint32_t input)
+{
+	return rotl32(acc + input * PRIME32_2, 13) * PRIME32_1;
+}
+
+static void xxh32_stripe(struct xxh32_ctx *ctx, const uint8_t *p)
+{
+	ctx->v[0] = xxh32_round(ctx->v[0], read_le32(p + 0));
+	ctx->v[1] = xxh32_round(ctx->v[1], read_le32(p + 4));
+	ctx->v[2] = xxh32_round(ctx->v[2], read_le32(p + 8));
+	ctx->v[3] = xxh32_round(ctx->v[3], read_le32(p + 12));
+}
+
+void xxh32_init(struct xxh32_ctx *ctx, uint32_t seed)
+{
+	ctx->v[0] = seed + PRIME32_1 + PRIME32_2;
+	ctx->v[1] = seed + PRIME32_2;
+	/* Doubles as the seed until the first stripe. */
+	ctx->v[2] = seed;
+	ctx->v[3] = seed - PRIME32_1;
+	ctx->total = 0;
+	ctx->buffered = 0;
+}
+
+void xxh32_update(struct xxh32_ctx *ctx, const void *data, size_t size)
+{
+	const uint8_t *p = data;
+
+	ctx->total += size;
+
+	if (ctx->buffered) {
+		size_t len = sizeof(ctx->buf) - ctx->buffered;
+
+		if (len > size)
+			len = size;
+		memcpy(ctx->buf + ctx->buffered, p, len);
+		ctx->buffered += len;
+		p += len;
+		size -= len;
+		if (ctx->buffered < sizeof(ctx->buf))
+			return;
+		xxh32_stripe(ctx, ctx->buf);
+		ctx->buffered = 0;
+	}
+
+	for (; size >= sizeof(ctx->buf); p += 16, size -= 16)
+		xxh32_stripe(ctx, p);
+
+	memcpy(ctx->buf, p, size);
+	ctx->buffered = size;
+}
+
+uint32_t xxh32_final(const struct xxh32_ctx *ctx)
+{
+	const uint8_t *p = ctx->buf;
+	const uint8_t *const end = ctx->buf + ctx->buffered;
+	uint32_t h;
+
+	if (ctx->total >= sizeof(ctx->buf))
+		h = rotl32(ctx->v[0], 1) + rotl32(ctx->v[1], 7) +
+			rotl32(ctx->v[2], 12) + rotl32(ctx->v[3], 18);
+	else
+		h = ctx->v[2] + PRIME32_5;
+
+	h += ctx->total;
+
+	for (; p + 4 <= end; p += 4)
+		h = rotl32(h + read_le32(p) * PRIME32_3, 17) * PRIME32_4;
+	for (; p < end; p++)
+		h = rotl32(h + *p * PRIME32_5, 11) * PRIME32_1;
+
+	h ^= h >> 15;
+	h *= PRIME32_2;
+	h ^= h >> 13;
+	h *= PRIME32_3;
+	h ^= h >> 16;
+	return h;
+}
+
+uint32_t xxh32(const void *data, size_t size, uint32_t seed)
+{
+	struct xxh32_ctx ctx;
+
+	xxh32_init(&ctx, seed);
+	xxh32_update(&ctx, data, size);
+	return xxh32_final(&ctx);
+}
+
+/* CRC-16/CCITT, a nibble at a time */
+
+static const uint16_t crc16_ccitt_table[16] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+	0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+};
+
+uint16_t crc16_ccitt(uint16_t crc, const void *data, size_t size)
+{
+	const uint8_t *p = data;
+
+	while (size--) {
+		crc = (crc << 4) ^ crc16_ccitt_table[(crc >> 12) ^ (*p >> 4)];
+		crc = (crc << 4) ^ crc16_ccitt_table[(crc >> 12) ^ (*p & 0xf)];
+		p++;
+	}
+	return crc;
+}
@@ -62,6 +62,7 @@
 #define CBMEM_ID_STAGEx_CACHE	0x57a9e100
 #define CBMEM_ID_TCPA_LOG	0x54435041
 #define CBMEM_ID_TIMESTAMP	0x54494d45
+#define CBMEM_ID_TRACE		0x54524345
 #define CBMEM_ID_VBOOT_HANDOFF	0x780074f0
 #define CBMEM_ID_VBOOT_SEL_REG	0x780074f1
 #define CBMEM_ID_VBOOT_WORKBUF	0x78007343
@@ -112,6 +113,7 @@
 	{ CBMEM_ID_SMM_SAVE_SPACE,	"SMM BACKUP " }, \
 	{ CBMEM_ID_TCPA_LOG,		"TCPA LOG   " }, \
 	{ CBMEM_ID_TIMESTAMP,		"TIME STAMP " }, \
+	{ CBMEM_ID_TRACE,		"TRACE      " }, \
 	{ CBMEM_ID_VBOOT_HANDOFF,	"VBOOT      " }, \
 	{ CBMEM_ID_VBOOT_SEL_REG,	"VBOOT SEL  " }, \
 	{ CBMEM_ID_VBOOT_WORKBUF,	"VBOOT WORK " }, \
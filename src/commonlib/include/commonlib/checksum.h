@@ -0,0 +1,91 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _COMMONLIB_CHECKSUM_H_
+#define _COMMONLIB_CHECKSUM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Checksums and hashes shared by coreboot, libpayload and the host tools.
+ * Each comes as a one-shot function and as an init/update/final context for
+ * data that is not in memory all at once; both give the same result no
+ * matter how the data is split up.
+ */
+
+/*
+ * IP checksum (RFC 1071): the ones' complement of the ones' complement sum
+ * of the data as native endian 16-bit words. This is the checksum of the
+ * coreboot tables and of the CMOS option table. Storing the result in a
+ * 16-bit field at an even offset of the data makes the checksum of the
+ * whole data 0.
+ */
+struct ip_checksum_ctx {
+	uint32_t sum;
+	size_t len;
+};
+
+void ip_checksum_init(struct ip_checksum_ctx *ctx);
+void ip_checksum_update(struct ip_checksum_ctx *ctx, const void *data,
+			size_t size);
+uint16_t ip_checksum_final(const struct ip_checksum_ctx *ctx);
+
+uint16_t ip_checksum(const void *data, size_t size);
+
+/*
+ * Combine the checksum first of some data with the checksum second of the
+ * data that follows it, starting offset bytes in.
+ */
+uint16_t ip_checksum_add(size_t offset, uint16_t first, uint16_t second);
+
+/* xxHash32, see https://github.com/Cyan4973/xxHash */
+struct xxh32_ctx {
+	uint32_t v[4];
+	uint32_t total;
+	uint8_t buf[16];
+	size_t buffered;
+};
+
+void xxh32_init(struct xxh32_ctx *ctx, uint32_t seed);
+void xxh32_update(struct xxh32_ctx *ctx, const void *data, size_t size);
+uint32_t xxh32_final(const struct xxh32_ctx *ctx);
+
+uint32_t xxh32(const void *data, size_t size, uint32_t seed);
+
+/*
+ * CRC-16 with the CCITT polynomial 0x1021, most significant bit first and
+ * without a final XOR. Pass the CRC of the data so far, which is 0 for the
+ * JEDEC SPD CRC, and get the CRC including data back.
+ */
+uint16_t crc16_ccitt(uint16_t crc, const void *data, size_t size);
+
+#endif /* _COMMONLIB_CHECKSUM_H_ */
@@ -0,0 +1,117 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _COMMONLIB_LZMA_DECODER_H_
+#define _COMMONLIB_LZMA_DECODER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * LZMA decoder shared by coreboot and libpayload. It decodes the format
+ * written by cbfstool and the LZMA SDK's "lzma_alone": a 13 byte header
+ * followed by the range coded data. Output goes to a window, which is either
+ * the whole output buffer or a ring buffer that holds at least as much of
+ * the previous output as the dictionary, for streaming.
+ */
+
+#define LZMA_HEADER_SIZE	13	/* properties, dictionary, size */
+/* Output size of streams that end with a marker instead */
+#define LZMA_SIZE_UNKNOWN	((uint64_t)-1)
+
+/* Bytes of probabilities for lc + lp, see lzma_decoder_probs_size(). */
+#define LZMA_PROBS_SIZE(lc_lp)	((1846 + (0x300 << (lc_lp))) * 2)
+
+enum lzma_status {
+	LZMA_OK,		/* decoded up to the requested position */
+	LZMA_END,		/* reached the end of the stream */
+	LZMA_NEED_INPUT,	/* ran out of input before either */
+	LZMA_ERROR,		/* corrupted or truncated data */
+};
+
+struct lzma_decoder {
+	/* From the header */
+	unsigned int lc, lp, pb;
+	uint32_t dict_size;
+	uint64_t out_size;		/* or LZMA_SIZE_UNKNOWN */
+
+	/* Input, advanced by lzma_decode() */
+	const uint8_t *in;
+	size_t in_size;
+
+	/* Output */
+	uint8_t *window;
+	size_t window_size;
+	size_t pos;			/* in window */
+	size_t total;			/* bytes decoded so far */
+
+	/* Decoder state */
+	uint16_t *probs;
+	uint32_t range, code;
+	uint32_t rep0, rep1, rep2, rep3;
+	unsigned int state;
+	uint32_t remain;		/* bytes of the current match left */
+	int started;			/* range coder is initialized */
+};
+
+/* Reads the properties, dictionary and output size from the header. Returns
+ * 0 on success, -1 for invalid properties. */
+int lzma_decoder_header(struct lzma_decoder *d, const void *header);
+
+/* Bytes of probabilities the stream needs, which grows with lc + lp. */
+size_t lzma_decoder_probs_size(const struct lzma_decoder *d);
+
+/* Prepares decoding with probs, which must hold lzma_decoder_probs_size()
+ * bytes, into window. Set up d->in and d->in_size before decoding. */
+void lzma_decoder_init(struct lzma_decoder *d, void *probs, void *window,
+		       size_t window_size);
+
+/*
+ * Decodes until d->pos reaches end, which must not be beyond the window
+ * size. After that, the caller may set d->pos to 0 to reuse the window as a
+ * ring buffer. Decoding consumes input from d->in. If last is not set, it
+ * stops with LZMA_NEED_INPUT a few bytes before the input runs out, so the
+ * caller can move those to the front of more input; if it is set, all of
+ * the input is used and running out of it is an error.
+ */
+enum lzma_status lzma_decode(struct lzma_decoder *d, size_t end, int last);
+
+/*
+ * Decodes until d->pos reaches end, like lzma_decode() with last set, from
+ * input that lies in the window itself, usually at its end. Every output
+ * byte is written below the input that is still unread, so the input is
+ * never overwritten. If the output catches up with the input first, it
+ * returns LZMA_OK with d->pos below end; d->in then points at the unread
+ * input, and decoding can go on from a copy of it elsewhere.
+ */
+enum lzma_status lzma_decode_in_place(struct lzma_decoder *d, size_t end);
+
+#endif /* _COMMONLIB_LZMA_DECODER_H_ */
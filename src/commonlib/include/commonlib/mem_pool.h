@@ -21,10 +21,10 @@
 
 /*
  * The memory pool allows one to allocate memory from a fixed size buffer
- * that also allows freeing semantics for reuse. However, the current
- * limitation is that the most recent allocation is the only one that
- * can be freed. If one tries to free any allocation that isn't the
- * most recently allocated it will result in a leak within the memory pool.
+ * that also allows freeing semantics for reuse. Allocations may be freed
+ * in any order. Freed space is coalesced with its free neighbours and
+ * reused by later allocations on a first fit basis. Each allocation carries
+ * an 8 byte header that is accounted against the pool size.
  *
  * The memory returned by allocations are at least 8 byte aligned. Note
  * that this requires the backing buffer to start on at least an 8 byte
@@ -34,6 +34,7 @@
 struct mem_pool {
 	uint8_t *buf;
 	size_t size;
+	/* Header of the block ending at free_offset. */
 	uint8_t *last_alloc;
 	size_t free_offset;
 };
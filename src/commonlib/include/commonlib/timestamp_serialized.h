@@ -49,6 +49,8 @@ enum timestamp_id {
 	TS_END_ULZMA = 16,
 	TS_START_ULZ4F = 17,
 	TS_END_ULZ4F = 18,
+	TS_START_UZSTD = 19,
+	TS_END_UZSTD = 20,
 	TS_DEVICE_ENUMERATE = 30,
 	TS_DEVICE_CONFIGURE = 40,
 	TS_DEVICE_ENABLE = 50,
@@ -57,6 +59,8 @@ enum timestamp_id {
 	TS_CBMEM_POST = 75,
 	TS_WRITE_TABLES = 80,
 	TS_LOAD_PAYLOAD = 90,
+	TS_PAYLOAD_SEGMENT_READ = 91,
+	TS_PAYLOAD_SEGMENT_LOADED = 92,
 	TS_ACPI_WAKE_JUMP = 98,
 	TS_SELFBOOT_JUMP = 99,
 
@@ -71,6 +75,8 @@ enum timestamp_id {
 	TS_DONE_LOADING = 508,
 	TS_DONE_HASHING = 509,
 	TS_END_HASH_BODY = 510,
+	TS_START_TPMCMD = 511,
+	TS_END_TPMCMD = 512,
 	TS_START_COPYVPD = 550,
 	TS_END_COPYVPD_RO = 551,
 	TS_END_COPYVPD_RW = 552,
@@ -134,6 +140,8 @@ static const struct timestamp_id_to_name {
 	{ TS_END_ULZMA,		"finished LZMA decompress (ignore for x86)" },
 	{ TS_START_ULZ4F,	"starting LZ4 decompress (ignore for x86)" },
 	{ TS_END_ULZ4F,		"finished LZ4 decompress (ignore for x86)" },
+	{ TS_START_UZSTD,	"starting Zstandard decompress (ignore for x86)" },
+	{ TS_END_UZSTD,		"finished Zstandard decompress (ignore for x86)" },
 	{ TS_DEVICE_ENUMERATE,	"device enumeration" },
 	{ TS_DEVICE_CONFIGURE,	"device configuration" },
 	{ TS_DEVICE_ENABLE,	"device enable" },
@@ -142,6 +150,8 @@ static const struct timestamp_id_to_name {
 	{ TS_CBMEM_POST,	"cbmem post" },
 	{ TS_WRITE_TABLES,	"write tables" },
 	{ TS_LOAD_PAYLOAD,	"load payload" },
+	{ TS_PAYLOAD_SEGMENT_READ,	"read payload segment" },
+	{ TS_PAYLOAD_SEGMENT_LOADED,	"loaded payload segment" },
 	{ TS_ACPI_WAKE_JUMP,	"ACPI wake jump" },
 	{ TS_SELFBOOT_JUMP,	"selfboot jump" },
 
@@ -155,6 +165,8 @@ static const struct timestamp_id_to_name {
 	{ TS_DONE_LOADING,	"finished loading body (ignore for x86)" },
 	{ TS_DONE_HASHING,	"finished calculating body hash (SHA2)" },
 	{ TS_END_HASH_BODY,	"finished verifying body signature (RSA)" },
+	{ TS_START_TPMCMD,	"starting TPM command" },
+	{ TS_END_TPMCMD,	"finished TPM command" },
 
 	{ TS_START_COPYVPD,	"starting to load Chrome OS VPD" },
 	{ TS_END_COPYVPD_RO,	"finished loading Chrome OS VPD (RO)" },
@@ -0,0 +1,62 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __TRACE_SERIALIZED_H__
+#define __TRACE_SERIALIZED_H__
+
+#include <stdint.h>
+
+#define TRACE_BUFFER_MAGIC	0x45435254	/* 'TRCE' */
+#define TRACE_BUFFER_VERSION	1
+
+/* Set in trace_entry.stamp for function exits. */
+#define TRACE_EXIT		(1ULL << 63)
+
+struct trace_entry {
+	uint64_t	func;
+	uint64_t	stamp;
+} __attribute__((packed));
+
+/*
+ * One ring per CPU, only ever written by that CPU. head counts all records
+ * written so far, the most recent ring_entries of which are kept.
+ */
+struct trace_ring {
+	uint64_t	head;
+	uint64_t	reserved;
+	struct trace_entry entries[0]; /* ring_entries entries */
+} __attribute__((packed));
+
+struct trace_buffer {
+	uint32_t	magic;
+	uint16_t	version;
+	uint16_t	num_cpus;
+	uint32_t	ring_entries;	/* Power of 2 */
+	uint32_t	tick_freq_mhz;
+	/* Runtime address of the traced stage's _program symbol. */
+	uint64_t	program_base;
+	uint64_t	filter_start;
+	uint64_t	filter_end;
+	struct trace_ring rings[0];	/* num_cpus rings */
+} __attribute__((packed));
+
+static inline struct trace_ring *trace_buffer_ring(struct trace_buffer *buf,
+						   unsigned int cpu)
+{
+	uint8_t *p = (uint8_t *)buf->rings;
+
+	return (struct trace_ring *)(p + cpu * (sizeof(struct trace_ring) +
+		buf->ring_entries * sizeof(struct trace_entry)));
+}
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef _COMMONLIB_ZSTD_DECODER_H_
+#define _COMMONLIB_ZSTD_DECODER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Zstandard (RFC 8878) decoder shared by coreboot and libpayload. It decodes
+ * frames into one flat output buffer, so matches can refer back to anything
+ * decoded before in the same frame whatever the window size of the frame
+ * says, and it needs no memory besides a fixed workspace. Dictionaries are
+ * not supported, and the optional content checksum is skipped.
+ */
+
+/* Bytes of the workspace for entropy tables that persist between blocks */
+#define ZSTD_WORKSPACE_SIZE	9232
+
+/* A block never decodes to more than this. */
+#define ZSTD_BLOCK_SIZE_MAX	(128 * 1024)
+
+enum zstd_status {
+	ZSTD_STATUS_OK,		/* stopped before a block, see below */
+	ZSTD_STATUS_END,	/* decoded all of the input */
+	ZSTD_STATUS_ERROR,	/* corrupted or truncated data */
+};
+
+struct zstd_decoder {
+	/* Input, advanced by zstd_decode() a block at a time */
+	const uint8_t *in;
+	size_t in_size;
+
+	/* Output */
+	uint8_t *out;
+	size_t out_size;
+	size_t pos;			/* bytes decoded so far */
+
+	/* Frame state */
+	int in_frame;			/* past the header of a frame */
+	int checksum;			/* frame ends with a checksum */
+	size_t frame_start;		/* output position of the frame */
+	uint64_t content_size;		/* of the frame, or (uint64_t)-1 */
+	uint32_t rep[3];		/* repeat offsets */
+	void *workspace;
+};
+
+/* Prepares decoding into out with workspace, which must hold
+ * ZSTD_WORKSPACE_SIZE bytes. Set up d->in and d->in_size before decoding. */
+void zstd_decoder_init(struct zstd_decoder *d, void *workspace, void *out,
+		       size_t out_size);
+
+/* Decodes all frames in the input. Skippable frames are skipped. */
+enum zstd_status zstd_decode(struct zstd_decoder *d);
+
+/*
+ * Like zstd_decode(), from input that lies in the output buffer, usually at
+ * its end. Every output byte is written below the block being decoded, so no
+ * input is overwritten before it is read. If the output would catch up with
+ * a block, this returns ZSTD_STATUS_OK with d->in at that block and the
+ * output before it, and decoding can go on from a copy of the rest of the
+ * input elsewhere.
+ */
+enum zstd_status zstd_decode_in_place(struct zstd_decoder *d);
+
+#endif /* _COMMONLIB_ZSTD_DECODER_H_ */
@@ -0,0 +1,581 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * This decodes the same streams as the LZMA SDK 4.x decoder that coreboot
+ * and libpayload used before, with the same probability model, but does less
+ * work per bit:
+ * - The range coder state lives in local variables, and the end of the input
+ *   is only checked once per symbol instead of for every byte. The last few
+ *   bytes are decoded from a zero padded copy instead.
+ * - Bit trees (literals, lengths and distance slots) are decoded without
+ *   branches, since their bits are close to random.
+ * - Matches are copied a word at a time, and runs of one byte with memset().
+ * - Any lc + lp is supported, as long as the caller provides the memory for
+ *   the probabilities.
+ *
+ * LZMA_SMALL_DECODER keeps the bit tree loops rolled up and copies matches a
+ * byte at a time, which trades some of that speed for less code.
+ */
+
+#include <commonlib/lzma_decoder.h>
+#include <string.h>
+
+#if defined(IS_ENABLED)
+#define SMALL_DECODER (IS_ENABLED(CONFIG_LZMA_SMALL_DECODER) || \
+		       IS_ENABLED(CONFIG_LP_LZMA_SMALL_DECODER))
+#else
+#define SMALL_DECODER 0
+#endif
+
+#define TOP_VALUE		((uint32_t)1 << 24)
+#define NUM_BIT_MODEL_BITS	11
+#define BIT_MODEL_TOTAL		(1 << NUM_BIT_MODEL_BITS)
+#define NUM_MOVE_BITS		5
+
+/* A symbol never takes more input than this. */
+#define REQUIRED_INPUT_MAX	20
+
+#define NUM_STATES		12
+#define NUM_LIT_STATES		7
+#define NUM_POS_BITS_MAX	4
+#define NUM_POS_SLOT_BITS	6
+#define END_POS_MODEL_INDEX	14
+#define NUM_FULL_DISTANCES	(1 << (END_POS_MODEL_INDEX >> 1))
+#define NUM_ALIGN_BITS		4
+#define MATCH_MIN_LEN		2
+
+#define LEN_CHOICE		0
+#define LEN_CHOICE2		1
+#define LEN_LOW			2
+#define LEN_MID			(LEN_LOW + (1 << (NUM_POS_BITS_MAX + 3)))
+#define LEN_HIGH		(LEN_MID + (1 << (NUM_POS_BITS_MAX + 3)))
+#define NUM_LEN_PROBS		(LEN_HIGH + 256)
+
+#define IS_MATCH		0
+#define IS_REP			(IS_MATCH + (NUM_STATES << NUM_POS_BITS_MAX))
+#define IS_REP_G0		(IS_REP + NUM_STATES)
+#define IS_REP_G1		(IS_REP_G0 + NUM_STATES)
+#define IS_REP_G2		(IS_REP_G1 + NUM_STATES)
+#define IS_REP0_LONG		(IS_REP_G2 + NUM_STATES)
+#define POS_SLOT		(IS_REP0_LONG + (NUM_STATES << NUM_POS_BITS_MAX))
+#define SPEC_POS		(POS_SLOT + (4 << NUM_POS_SLOT_BITS))
+#define POS_ALIGN		(SPEC_POS + NUM_FULL_DISTANCES - \
+				 END_POS_MODEL_INDEX)
+#define LEN_CODER		(POS_ALIGN + (1 << NUM_ALIGN_BITS))
+#define REP_LEN_CODER		(LEN_CODER + NUM_LEN_PROBS)
+#define LITERAL			(REP_LEN_CODER + NUM_LEN_PROBS)
+#define LITERAL_SIZE		0x300
+
+#if LITERAL != 1846
+#error "LZMA_PROBS_SIZE() does not match the probability layout"
+#endif
+
+#define NORMALIZE() \
+	do { \
+		if (range < TOP_VALUE) { \
+			range <<= 8; \
+			code = (code << 8) | *buf++; \
+		} \
+	} while (0)
+
+/* Bits that pick the kind of the next symbol are fairly predictable, so
+ * these branch on them. */
+#define IF_BIT_0(p) \
+	ttt = *(p); \
+	NORMALIZE(); \
+	bound = (range >> NUM_BIT_MODEL_BITS) * ttt; \
+	if (code < bound)
+
+#define UPDATE_0(p) \
+	do { \
+		range = bound; \
+		*(p) = ttt + ((BIT_MODEL_TOTAL - ttt) >> NUM_MOVE_BITS); \
+	} while (0)
+
+#define UPDATE_1(p) \
+	do { \
+		range -= bound; \
+		code -= bound; \
+		*(p) = ttt - (ttt >> NUM_MOVE_BITS); \
+	} while (0)
+
+/* Decodes a bit without branching. mask becomes all ones for a 1 and all
+ * zeroes for a 0. */
+#define GET_BIT_MASK(p) \
+	do { \
+		ttt = *(p); \
+		NORMALIZE(); \
+		bound = (range >> NUM_BIT_MODEL_BITS) * ttt; \
+		mask = 0 - (uint32_t)(code >= bound); \
+		range = ((range - bound) & mask) | (bound & ~mask); \
+		code -= bound & mask; \
+		*(p) = ttt - ((ttt >> NUM_MOVE_BITS) & mask) + \
+			(((BIT_MODEL_TOTAL - ttt) >> NUM_MOVE_BITS) & ~mask); \
+	} while (0)
+
+/* Walks one level down the bit tree at probs, from node i. */
+#define TREE_BIT(probs, i) \
+	do { \
+		GET_BIT_MASK((probs) + (i)); \
+		i = (i << 1) - mask; \
+	} while (0)
+
+/* Same, but also adds the bit to sym, least significant bit first. */
+#define REVERSE_TREE_BIT(probs, i, sym, bit) \
+	do { \
+		GET_BIT_MASK((probs) + (i)); \
+		i = (i << 1) - mask; \
+		sym |= (mask & 1) << (bit); \
+	} while (0)
+
+/* Decodes a length, minus MATCH_MIN_LEN, with the length coder at probs. */
+#define DECODE_LEN(probs, len) \
+	do { \
+		uint16_t *lprobs = (probs); \
+		unsigned int lmax = 1 << 3; \
+		unsigned int lbase = 0; \
+		IF_BIT_0(lprobs + LEN_CHOICE) { \
+			UPDATE_0(lprobs + LEN_CHOICE); \
+			lprobs += LEN_LOW + (pos_state << 3); \
+		} else { \
+			UPDATE_1(lprobs + LEN_CHOICE); \
+			IF_BIT_0(lprobs + LEN_CHOICE2) { \
+				UPDATE_0(lprobs + LEN_CHOICE2); \
+				lprobs += LEN_MID + (pos_state << 3); \
+				lbase = 8; \
+			} else { \
+				UPDATE_1(lprobs + LEN_CHOICE2); \
+				lprobs += LEN_HIGH; \
+				lmax = 1 << 8; \
+				lbase = 16; \
+			} \
+		} \
+		len = 1; \
+		do { \
+			TREE_BIT(lprobs, len); \
+		} while (len < lmax); \
+		len += lbase - lmax; \
+	} while (0)
+
+int lzma_decoder_header(struct lzma_decoder *d, const void *header)
+{
+	const uint8_t *h = header;
+	unsigned int props = h[0];
+	int i;
+
+	if (props >= 9 * 5 * 5)
+		return -1;
+	d->lc = props % 9;
+	d->lp = (props / 9) % 5;
+	d->pb = props / (9 * 5);
+
+	d->dict_size = 0;
+	for (i = 4; i >= 1; i--)
+		d->dict_size = (d->dict_size << 8) | h[i];
+	d->out_size = 0;
+	for (i = 12; i >= 5; i--)
+		d->out_size = (d->out_size << 8) | h[i];
+	return 0;
+}
+
+size_t lzma_decoder_probs_size(const struct lzma_decoder *d)
+{
+	return LZMA_PROBS_SIZE(d->lc + d->lp);
+}
+
+void lzma_decoder_init(struct lzma_decoder *d, void *probs, void *window,
+		       size_t window_size)
+{
+	size_t num_probs = lzma_decoder_probs_size(d) / sizeof(uint16_t);
+	size_t i;
+
+	d->probs = probs;
+	for (i = 0; i < num_probs; i++)
+		d->probs[i] = BIT_MODEL_TOTAL >> 1;
+
+	d->window = window;
+	d->window_size = window_size;
+	d->pos = 0;
+	d->total = 0;
+	d->rep0 = d->rep1 = d->rep2 = d->rep3 = 1;
+	d->state = 0;
+	d->remain = 0;
+	d->started = 0;
+}
+
+/* Copies n bytes from dist bytes back to pos, reading across the end of the
+ * window if it is used as a ring buffer. pos + n must not pass the end. */
+static void copy_match(uint8_t *win, size_t window_size, size_t pos,
+		       uint32_t dist, size_t n)
+{
+	uint8_t *dst = win + pos;
+	const uint8_t *src;
+
+	if (pos < dist) {
+		size_t from = pos + window_size - dist;
+
+		do {
+			*dst++ = win[from];
+			if (++from == window_size)
+				from = 0;
+		} while (--n);
+		return;
+	}
+
+	src = dst - dist;
+	if (dist == 1) {
+		memset(dst, *src, n);
+		return;
+	}
+	if (!SMALL_DECODER && dist >= sizeof(uint64_t)) {
+		/* No word overlaps a word it is copied from. */
+		for (; n >= sizeof(uint64_t); n -= sizeof(uint64_t)) {
+			__builtin_memcpy(dst, src, sizeof(uint64_t));
+			dst += sizeof(uint64_t);
+			src += sizeof(uint64_t);
+		}
+	}
+	while (n--)
+		*dst++ = *src++;
+}
+
+/* Decodes symbols while the output is short of end and the input has not
+ * passed limit. */
+static enum lzma_status decode_symbols(struct lzma_decoder *d, size_t end,
+				       const uint8_t *limit)
+{
+	uint16_t *const probs = d->probs;
+	uint8_t *const win = d->window;
+	const size_t window_size = d->window_size;
+	const unsigned int lc = d->lc;
+	const unsigned int lp_mask = (1U << d->lp) - 1;
+	const unsigned int pb_mask = (1U << d->pb) - 1;
+	const uint8_t *buf = d->in;
+	uint32_t range = d->range;
+	uint32_t code = d->code;
+	uint32_t rep0 = d->rep0, rep1 = d->rep1, rep2 = d->rep2, rep3 = d->rep3;
+	unsigned int state = d->state;
+	size_t pos = d->pos;
+	size_t total = d->total;
+	enum lzma_status status = LZMA_OK;
+	uint32_t ttt, bound, mask;
+	uint16_t *prob;
+
+	do {
+		const unsigned int pos_state = total & pb_mask;
+		unsigned int len, sym;
+		size_t n;
+
+		prob = probs + IS_MATCH + (state << NUM_POS_BITS_MAX) +
+			pos_state;
+		IF_BIT_0(prob) {
+			unsigned int prev;
+
+			UPDATE_0(prob);
+			if (pos)
+				prev = win[pos - 1];
+			else
+				prev = total ? win[window_size - 1] : 0;
+			prob = probs + LITERAL + LITERAL_SIZE *
+				(((total & lp_mask) << lc) + (prev >> (8 - lc)));
+
+			sym = 1;
+			if (state < NUM_LIT_STATES) {
+#if SMALL_DECODER
+				do {
+					TREE_BIT(prob, sym);
+				} while (sym < 0x100);
+#else
+				TREE_BIT(prob, sym);
+				TREE_BIT(prob, sym);
+				TREE_BIT(prob, sym);
+				TREE_BIT(prob, sym);
+				TREE_BIT(prob, sym);
+				TREE_BIT(prob, sym);
+				TREE_BIT(prob, sym);
+				TREE_BIT(prob, sym);
+#endif
+				state = state < 4 ? 0 : state - 3;
+			} else {
+				/* The bits follow those of the byte at rep0
+				 * until the first one that differs. */
+				unsigned int match = win[pos >= rep0 ?
+					pos - rep0 : pos + window_size - rep0];
+				unsigned int offs = 0x100;
+
+				do {
+					unsigned int bit;
+
+					match <<= 1;
+					bit = match & offs;
+					GET_BIT_MASK(prob + offs + bit + sym);
+					sym = (sym << 1) - mask;
+					offs &= bit ^ ~mask;
+				} while (sym < 0x100);
+				state = state < 10 ? state - 3 : state - 6;
+			}
+
+			win[pos++] = sym;
+			total++;
+			continue;
+		}
+		UPDATE_1(prob);
+
+		prob = probs + IS_REP + state;
+		IF_BIT_0(prob) {
+			UPDATE_0(prob);
+			rep3 = rep2;
+			rep2 = rep1;
+			rep1 = rep0;
+			DECODE_LEN(probs + LEN_CODER, len);
+			state = state < NUM_LIT_STATES ? 7 : 10;
+
+			prob = probs + POS_SLOT +
+				((len < 3 ? len : 3) << NUM_POS_SLOT_BITS);
+			sym = 1;
+#if SMALL_DECODER
+			do {
+				TREE_BIT(prob, sym);
+			} while (sym < (1 << NUM_POS_SLOT_BITS));
+#else
+			TREE_BIT(prob, sym);
+			TREE_BIT(prob, sym);
+			TREE_BIT(prob, sym);
+			TREE_BIT(prob, sym);
+			TREE_BIT(prob, sym);
+			TREE_BIT(prob, sym);
+#endif
+			sym -= 1 << NUM_POS_SLOT_BITS;
+
+			if (sym >= 4) {
+				unsigned int bits = (sym >> 1) - 1;
+				uint32_t dist = 2 | (sym & 1);
+				unsigned int i = 1, b;
+
+				if (sym < END_POS_MODEL_INDEX) {
+					dist <<= bits;
+					prob = probs + SPEC_POS + dist - sym - 1;
+					for (b = 0; b < bits; b++)
+						REVERSE_TREE_BIT(prob, i, dist, b);
+				} else {
+					bits -= NUM_ALIGN_BITS;
+					do {
+						NORMALIZE();
+						range >>= 1;
+						code -= range;
+						mask = 0 - (code >> 31);
+						code += range & mask;
+						dist = (dist << 1) + (mask + 1);
+					} while (--bits);
+					dist <<= NUM_ALIGN_BITS;
+					prob = probs + POS_ALIGN;
+#if SMALL_DECODER
+					for (b = 0; b < NUM_ALIGN_BITS; b++)
+						REVERSE_TREE_BIT(prob, i, dist, b);
+#else
+					REVERSE_TREE_BIT(prob, i, dist, 0);
+					REVERSE_TREE_BIT(prob, i, dist, 1);
+					REVERSE_TREE_BIT(prob, i, dist, 2);
+					REVERSE_TREE_BIT(prob, i, dist, 3);
+#endif
+					if (dist == 0xffffffff) {
+						status = LZMA_END;
+						break;
+					}
+				}
+				rep0 = dist + 1;
+			} else {
+				rep0 = sym + 1;
+			}
+
+			if (rep0 > total || rep0 > window_size) {
+				status = LZMA_ERROR;
+				break;
+			}
+		} else {
+			UPDATE_1(prob);
+			if (!total) {
+				status = LZMA_ERROR;
+				break;
+			}
+
+			prob = probs + IS_REP_G0 + state;
+			IF_BIT_0(prob) {
+				UPDATE_0(prob);
+				prob = probs + IS_REP0_LONG +
+					(state << NUM_POS_BITS_MAX) + pos_state;
+				IF_BIT_0(prob) {
+					/* A single byte from rep0 */
+					UPDATE_0(prob);
+					if (pos >= rep0)
+						win[pos] = win[pos - rep0];
+					else
+						win[pos] = win[pos +
+							window_size - rep0];
+					pos++;
+					total++;
+					state = state < NUM_LIT_STATES ? 9 : 11;
+					continue;
+				}
+				UPDATE_1(prob);
+			} else {
+				uint32_t dist;
+
+				UPDATE_1(prob);
+				prob = probs + IS_REP_G1 + state;
+				IF_BIT_0(prob) {
+					UPDATE_0(prob);
+					dist = rep1;
+				} else {
+					UPDATE_1(prob);
+					prob = probs + IS_REP_G2 + state;
+					IF_BIT_0(prob) {
+						UPDATE_0(prob);
+						dist = rep2;
+					} else {
+						UPDATE_1(prob);
+						dist = rep3;
+						rep3 = rep2;
+					}
+					rep2 = rep1;
+				}
+				rep1 = rep0;
+				rep0 = dist;
+			}
+			DECODE_LEN(probs + REP_LEN_CODER, len);
+			state = state < NUM_LIT_STATES ? 8 : 11;
+		}
+
+		len += MATCH_MIN_LEN;
+		n = end - pos < len ? end - pos : len;
+		copy_match(win, window_size, pos, rep0, n);
+		d->remain = len - n;
+		pos += n;
+		total += n;
+	} while (pos < end && buf <= limit);
+
+	d->in_size -= buf - d->in;
+	d->in = buf;
+	d->range = range;
+	d->code = code;
+	d->rep0 = rep0;
+	d->rep1 = rep1;
+	d->rep2 = rep2;
+	d->rep3 = rep3;
+	d->state = state;
+	d->pos = pos;
+	d->total = total;
+	return status;
+}
+
+enum lzma_status lzma_decode(struct lzma_decoder *d, size_t end, int last)
+{
+	enum lzma_status status = LZMA_OK;
+	size_t max_in_size = ~(uintptr_t)0 - (uintptr_t)d->in;
+
+	/* Keep the end of the input from wrapping around, for callers that
+	 * don't know the input size. */
+	if (max_in_size > ~(size_t)0 >> 1)
+		max_in_size = ~(size_t)0 >> 1;
+	if (d->in_size > max_in_size)
+		d->in_size = max_in_size;
+
+	if (!d->started) {
+		int i;
+
+		if (d->in_size < 5)
+			return last ? LZMA_ERROR : LZMA_NEED_INPUT;
+		d->range = 0xffffffff;
+		d->code = 0;
+		for (i = 0; i < 5; i++)
+			d->code = (d->code << 8) | d->in[i];
+		d->in += 5;
+		d->in_size -= 5;
+		d->started = 1;
+	}
+
+	if (d->remain && d->pos < end) {
+		size_t n = end - d->pos < d->remain ? end - d->pos : d->remain;
+
+		copy_match(d->window, d->window_size, d->pos, d->rep0, n);
+		d->remain -= n;
+		d->pos += n;
+		d->total += n;
+	}
+
+	while (d->pos < end && status == LZMA_OK) {
+		if (d->in_size >= REQUIRED_INPUT_MAX) {
+			status = decode_symbols(d, end, d->in + d->in_size -
+						REQUIRED_INPUT_MAX);
+		} else if (!last) {
+			return LZMA_NEED_INPUT;
+		} else {
+			/* Decode the rest from a copy padded with zeroes, and
+			 * fail if that needed more than the real input. */
+			uint8_t tail[2 * REQUIRED_INPUT_MAX];
+			const uint8_t *in = d->in;
+			size_t in_size = d->in_size;
+			size_t used;
+
+			memcpy(tail, in, in_size);
+			memset(tail + in_size, 0, sizeof(tail) - in_size);
+			d->in = tail;
+			status = decode_symbols(d, end, tail + in_size);
+			used = in_size - d->in_size;
+			if (used > in_size)
+				return LZMA_ERROR;
+			d->in = in + used;
+			d->in_size = in_size - used;
+		}
+	}
+
+	return status;
+}
+
+enum lzma_status lzma_decode_in_place(struct lzma_decoder *d, size_t end)
+{
+	enum lzma_status status = LZMA_OK;
+
+	/* Each call stops where the unread input started, so the symbols
+	 * it decodes only read input above what they write. */
+	while (d->pos < end && status == LZMA_OK) {
+		size_t limit = d->in - d->window;
+
+		if (limit > end)
+			limit = end;
+		if (limit <= d->pos)
+			break;
+		status = lzma_decode(d, limit, 1);
+	}
+
+	return status;
+}
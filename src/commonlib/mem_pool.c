@@ -16,32 +16,140 @@
 #include <commonlib/helpers.h>
 #include <commonlib/mem_pool.h>
 
+/*
+ * Every allocation is preceded by a block header. The block size includes
+ * the header itself and is always a multiple of 8 so the low bit is used
+ * to mark free blocks. Blocks below free_offset are laid out back to back
+ * which allows walking them in both directions.
+ */
+struct mem_pool_block {
+	uint32_t size;
+	uint32_t prev_size;
+};
+
+#define BLOCK_FREE	0x1
+#define BLOCK_MIN	(sizeof(struct mem_pool_block) + 8)
+
+static inline size_t block_size(const struct mem_pool_block *b)
+{
+	return b->size & ~BLOCK_FREE;
+}
+
+static inline int block_is_free(const struct mem_pool_block *b)
+{
+	return b->size & BLOCK_FREE;
+}
+
+static inline struct mem_pool_block *block_next(struct mem_pool_block *b)
+{
+	return (void *)((uint8_t *)b + block_size(b));
+}
+
+static inline struct mem_pool_block *block_prev(struct mem_pool_block *b)
+{
+	return (void *)((uint8_t *)b - b->prev_size);
+}
+
+/* Split off the tail of block b past sz as a new free block. */
+static void block_split(struct mem_pool *mp, struct mem_pool_block *b,
+			size_t sz)
+{
+	struct mem_pool_block *rest;
+	size_t rest_size = block_size(b) - sz;
+
+	rest = (void *)((uint8_t *)b + sz);
+	rest->size = rest_size | BLOCK_FREE;
+	rest->prev_size = sz;
+	b->size = sz | (b->size & BLOCK_FREE);
+
+	if (mp->last_alloc == (uint8_t *)b)
+		mp->last_alloc = (uint8_t *)rest;
+	else
+		block_next(rest)->prev_size = rest_size;
+}
+
 void *mem_pool_alloc(struct mem_pool *mp, size_t sz)
 {
-	void *p;
+	struct mem_pool_block *b;
+	uint8_t *top;
 
 	/* Make all allocations be at least 8 byte aligned. */
-	sz = ALIGN_UP(sz, 8);
+	sz = ALIGN_UP(sz, 8) + sizeof(*b);
+
+	/* First fit among blocks which were freed out of order. */
+	top = &mp->buf[mp->free_offset];
+	for (b = (void *)mp->buf; (uint8_t *)b < top; b = block_next(b)) {
+		if (!block_is_free(b) || block_size(b) < sz)
+			continue;
+		if (block_size(b) - sz >= BLOCK_MIN)
+			block_split(mp, b, sz);
+		b->size &= ~BLOCK_FREE;
+		return b + 1;
+	}
 
 	/* Determine if any space available. */
 	if ((mp->size - mp->free_offset) < sz)
 		return NULL;
 
-	p = &mp->buf[mp->free_offset];
+	b = (void *)top;
+	b->size = sz;
+	b->prev_size = 0;
+	if (mp->last_alloc != NULL)
+		b->prev_size = block_size((void *)mp->last_alloc);
 
 	mp->free_offset += sz;
-	mp->last_alloc = p;
+	mp->last_alloc = (uint8_t *)b;
 
-	return p;
+	return b + 1;
 }
 
 void mem_pool_free(struct mem_pool *mp, void *p)
 {
-	/* Determine if p was the most recent allocation. */
-	if (p == NULL || mp->last_alloc != p)
+	struct mem_pool_block *b, *n;
+
+	if (p == NULL)
+		return;
+
+	b = (struct mem_pool_block *)p - 1;
+
+	/* Ignore pointers which weren't handed out by this pool. */
+	if ((uint8_t *)b < mp->buf ||
+	    (uint8_t *)b >= &mp->buf[mp->free_offset] || block_is_free(b))
 		return;
 
-	mp->free_offset = mp->last_alloc - mp->buf;
-	/* No way to track allocation before this one. */
-	mp->last_alloc = NULL;
+	b->size |= BLOCK_FREE;
+
+	/* Merge with the following block. */
+	if ((uint8_t *)b != mp->last_alloc) {
+		n = block_next(b);
+		if (block_is_free(n)) {
+			b->size += block_size(n);
+			if ((uint8_t *)n == mp->last_alloc)
+				mp->last_alloc = (uint8_t *)b;
+			else
+				block_next(b)->prev_size = block_size(b);
+		}
+	}
+
+	/* Merge with the preceding block. */
+	if (b->prev_size != 0 && block_is_free(block_prev(b))) {
+		n = b;
+		b = block_prev(b);
+		b->size += block_size(n);
+		if ((uint8_t *)n == mp->last_alloc)
+			mp->last_alloc = (uint8_t *)b;
+		else
+			block_next(b)->prev_size = block_size(b);
+	}
+
+	/*
+	 * Hand the topmost block back to the unallocated space. Adjacent
+	 * free blocks are always merged so the one before it is in use.
+	 */
+	if ((uint8_t *)b == mp->last_alloc) {
+		mp->free_offset = (uint8_t *)b - mp->buf;
+		mp->last_alloc = NULL;
+		if (b->prev_size != 0)
+			mp->last_alloc = (uint8_t *)block_prev(b);
+	}
 }
@@ -0,0 +1,1046 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. The name of the author may not be used to endorse or promote products
+ *    derived from this software without specific prior written permission.
+ *
+ * Alternatively, this software may be distributed under the terms of the
+ * GNU General Public License ("GPL") version 2 as published by the Free
+ * Software Foundation.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+/*
+ * Zstandard decoder written after RFC 8878 for small memory use rather than
+ * peak speed:
+ * - Literals are not decoded into a buffer of their own first. Huffman coded
+ *   literals are decoded from their streams as the sequences ask for them,
+ *   and raw ones are copied straight from the input.
+ * - The only memory besides the input and output is the workspace for the
+ *   Huffman and FSE tables, which blocks may reuse.
+ * - Backward bit streams are read through a bit position into the stream,
+ *   so no state needs to be kept besides that position.
+ */
+
+#include <commonlib/endian.h>
+#include <commonlib/zstd_decoder.h>
+#include <string.h>
+
+#define ZSTD_MAGIC		0xfd2fb528
+#define ZSTD_SKIPPABLE_MAGIC	0x184d2a50	/* low 4 bits are free */
+#define ZSTD_SIZE_UNKNOWN	((uint64_t)-1)
+
+#define BLOCK_RAW		0
+#define BLOCK_RLE		1
+#define BLOCK_COMPRESSED	2
+
+#define LITERALS_RAW		0
+#define LITERALS_RLE		1
+#define LITERALS_COMPRESSED	2
+#define LITERALS_TREELESS	3
+
+#define MODE_PREDEFINED		0
+#define MODE_RLE		1
+#define MODE_FSE		2
+#define MODE_REPEAT		3
+
+#define HUF_LOG_MAX		11
+#define HUF_WEIGHTS_MAX		255	/* the weight of the last is implied */
+#define HUF_WEIGHT_LOG_MAX	6
+
+#define LL_MAX			35
+#define ML_MAX			52
+#define OF_MAX			31
+#define OF_DEFAULT_MAX		28	/* largest code of the predefined table */
+#define LL_LOG_MAX		9
+#define ML_LOG_MAX		9
+#define OF_LOG_MAX		8
+#define SYMBOLS_MAX		(ML_MAX + 1)
+
+struct fse_entry {
+	uint16_t base;			/* of the next state */
+	uint8_t symbol;
+	uint8_t bits;			/* to read for the next state */
+};
+
+struct huf_entry {
+	uint8_t symbol;
+	uint8_t bits;
+};
+
+struct workspace {
+	struct fse_entry ll[1 << LL_LOG_MAX];
+	struct fse_entry of[1 << OF_LOG_MAX];
+	struct fse_entry ml[1 << ML_LOG_MAX];
+	struct huf_entry huf[1 << HUF_LOG_MAX];
+	uint8_t ll_log, of_log, ml_log, huf_log;
+	uint8_t ll_valid, of_valid, ml_valid, huf_valid;
+};
+
+_Static_assert(sizeof(struct workspace) <= ZSTD_WORKSPACE_SIZE,
+	       "ZSTD_WORKSPACE_SIZE is too small");
+
+static const int16_t ll_default[LL_MAX + 1] = {
+	4, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1,
+	2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 2, 1, 1, 1, 1, 1,
+	-1, -1, -1, -1
+};
+
+static const int16_t ml_default[ML_MAX + 1] = {
+	1, 4, 3, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, -1, -1,
+	-1, -1, -1, -1, -1
+};
+
+static const int16_t of_default[OF_DEFAULT_MAX + 1] = {
+	1, 1, 1, 1, 1, 1, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1, -1
+};
+
+static const uint32_t ll_base[LL_MAX + 1] = {
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+	16, 18, 20, 22, 24, 28, 32, 40, 48, 64, 128, 256, 512, 1024, 2048,
+	4096, 8192, 16384, 32768, 65536
+};
+
+static const uint8_t ll_bits[LL_MAX + 1] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 1, 1, 1, 2, 2, 3, 3, 4, 6, 7, 8, 9, 10, 11, 12,
+	13, 14, 15, 16
+};
+
+static const uint32_t ml_base[ML_MAX + 1] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18,
+	19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34,
+	35, 37, 39, 41, 43, 47, 51, 59, 67, 83, 99, 131, 259, 515, 1027,
+	2051, 4099, 8195, 16387, 32771, 65539
+};
+
+static const uint8_t ml_bits[ML_MAX + 1] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 7, 8, 9, 10, 11,
+	12, 13, 14, 15, 16
+};
+
+/* Index of the highest set bit of v, which must not be 0 */
+static inline unsigned int highbit(uint32_t v)
+{
+	return 31 - __builtin_clz(v);
+}
+
+/*
+ * Backward bit stream. Its bits are numbered from the lowest bit of its first
+ * byte on, and are read from the highest one down. pos is the number of bits
+ * left; it goes below 0 when more bits are read than there are, which then
+ * read as 0.
+ */
+struct bits {
+	const uint8_t *buf;
+	size_t size;
+	long pos;
+};
+
+static int bits_init(struct bits *b, const uint8_t *buf, size_t size)
+{
+	/* The highest set bit of the last byte marks the start. */
+	if (!size || !buf[size - 1])
+		return -1;
+	b->buf = buf;
+	b->size = size;
+	b->pos = (size - 1) * 8 + highbit(buf[size - 1]);
+	return 0;
+}
+
+/* Returns the n <= 32 bits at pos. */
+static inline uint32_t bits_at(const struct bits *b, long pos, unsigned int n)
+{
+	uint64_t v = 0;
+	size_t i, byte;
+
+	if (pos < 0) {
+		if (pos + (long)n <= 0)
+			return 0;
+		return bits_at(b, 0, pos + n) << -pos;
+	}
+
+	byte = pos >> 3;
+	if (byte + sizeof(v) <= b->size) {
+		v = read_le64(b->buf + byte);
+	} else {
+		for (i = 0; byte + i < b->size; i++)
+			v |= (uint64_t)b->buf[byte + i] << (i * 8);
+	}
+	return (v >> (pos & 7)) & (((uint64_t)1 << n) - 1);
+}
+
+static inline uint32_t bits_read(struct bits *b, unsigned int n)
+{
+	b->pos -= n;
+	return bits_at(b, b->pos, n);
+}
+
+/* Returns the n <= 16 bits at bit of a forward bit stream. */
+static uint32_t fwd_bits(const uint8_t *in, size_t size, size_t bit,
+			 unsigned int n)
+{
+	size_t i, byte = bit >> 3;
+	uint32_t v = 0;
+
+	for (i = 0; i < 3 && byte + i < size; i++)
+		v |= (uint32_t)in[byte + i] << (i * 8);
+	return (v >> (bit & 7)) & ((1 << n) - 1);
+}
+
+/* Reads an FSE table description into norm. Returns its size in bytes, or -1
+ * on error. */
+static long fse_read_header(const uint8_t *in, size_t size, int16_t *norm,
+			    unsigned int max_symbol, unsigned int max_log,
+			    unsigned int *log, unsigned int *symbols)
+{
+	unsigned int symbol = 0, nbits, i;
+	int remaining, threshold;
+	size_t bit = 4;
+
+	if (!size)
+		return -1;
+	*log = (in[0] & 0xf) + 5;
+	if (*log > max_log)
+		return -1;
+
+	remaining = (1 << *log) + 1;
+	threshold = 1 << *log;
+	nbits = *log + 1;
+
+	while (remaining > 1) {
+		int max = 2 * threshold - 1 - remaining;
+		uint32_t v = fwd_bits(in, size, bit, nbits);
+		int count;
+
+		if (symbol > max_symbol)
+			return -1;
+
+		if ((int)(v & (threshold - 1)) < max) {
+			count = v & (threshold - 1);
+			bit += nbits - 1;
+		} else {
+			count = v;
+			if (count >= threshold)
+				count -= max;
+			bit += nbits;
+		}
+
+		/* 0 stands for a probability of "less than 1". */
+		count--;
+		remaining -= count < 0 ? -count : count;
+		norm[symbol++] = count;
+		if (remaining < 1)
+			return -1;
+
+		if (!count) {
+			unsigned int repeat;
+
+			do {
+				repeat = fwd_bits(in, size, bit, 2);
+				bit += 2;
+				if (symbol + repeat > max_symbol + 1)
+					return -1;
+				for (i = 0; i < repeat; i++)
+					norm[symbol++] = 0;
+			} while (repeat == 3);
+		}
+
+		while (remaining < threshold) {
+			nbits--;
+			threshold >>= 1;
+		}
+
+		if (bit > size * 8)
+			return -1;
+	}
+
+	if (remaining != 1)
+		return -1;
+
+	*symbols = symbol;
+	return (bit + 7) / 8;
+}
+
+/* Builds the decoding table for the probabilities in norm. */
+static int fse_build(struct fse_entry *table, unsigned int log,
+		     const int16_t *norm, unsigned int symbols)
+{
+	uint32_t size = 1 << log, high = size - 1;
+	uint32_t step = (size >> 1) + (size >> 3) + 3;
+	uint16_t next[SYMBOLS_MAX];
+	uint32_t pos = 0, i, s;
+
+	/* Symbols with a probability of "less than 1" go to the end, */
+	for (s = 0; s < symbols; s++) {
+		if (norm[s] == -1) {
+			table[high--].symbol = s;
+			next[s] = 1;
+		} else {
+			next[s] = norm[s];
+		}
+	}
+
+	/* and the others are spread over the rest. */
+	for (s = 0; s < symbols; s++) {
+		for (i = 0; i < (uint32_t)(norm[s] > 0 ? norm[s] : 0); i++) {
+			table[pos].symbol = s;
+			do {
+				pos = (pos + step) & (size - 1);
+			} while (pos > high);
+		}
+	}
+	if (pos)
+		return -1;
+
+	for (i = 0; i < size; i++) {
+		uint32_t state = next[table[i].symbol]++;
+
+		table[i].bits = log - highbit(state);
+		table[i].base = (state << table[i].bits) - size;
+	}
+
+	return 0;
+}
+
+/* Reads the Huffman tree description and builds its decoding table. Returns
+ * the size of the description in bytes, or -1 on error. */
+static long huf_read_tree(struct workspace *ws, const uint8_t *in,
+			  size_t size)
+{
+	uint8_t weights[HUF_WEIGHTS_MAX + 1];
+	uint32_t rank[HUF_LOG_MAX + 2];
+	unsigned int n = 0, i, log;
+	uint32_t sum = 0, rest;
+	long used;
+
+	if (!size)
+		return -1;
+
+	if (in[0] >= 128) {
+		/* Weights as 4 bit numbers */
+		n = in[0] - 127;
+		used = 1 + (n + 1) / 2;
+		if ((size_t)used > size)
+			return -1;
+		for (i = 0; i < n; i++)
+			weights[i] = in[1 + i / 2] >> (i & 1 ? 0 : 4) & 0xf;
+	} else {
+		/* FSE compressed weights, decoded with two interleaved
+		 * states until the bit stream runs out. */
+		struct fse_entry table[1 << HUF_WEIGHT_LOG_MAX];
+		int16_t norm[HUF_LOG_MAX + 1];
+		unsigned int fse_log, symbols, s1, s2;
+		struct bits b;
+		long hdr;
+
+		used = 1 + in[0];
+		if ((size_t)used > size)
+			return -1;
+		hdr = fse_read_header(in + 1, in[0], norm, HUF_LOG_MAX,
+				      HUF_WEIGHT_LOG_MAX, &fse_log, &symbols);
+		if (hdr < 0 || fse_build(table, fse_log, norm, symbols) ||
+		    bits_init(&b, in + 1 + hdr, in[0] - hdr))
+			return -1;
+
+		s1 = bits_read(&b, fse_log);
+		s2 = bits_read(&b, fse_log);
+		while (1) {
+			if (n + 2 > HUF_WEIGHTS_MAX)
+				return -1;
+			weights[n++] = table[s1].symbol;
+			s1 = table[s1].base + bits_read(&b, table[s1].bits);
+			if (b.pos < 0) {
+				weights[n++] = table[s2].symbol;
+				break;
+			}
+			weights[n++] = table[s2].symbol;
+			s2 = table[s2].base + bits_read(&b, table[s2].bits);
+			if (b.pos < 0) {
+				weights[n++] = table[s1].symbol;
+				break;
+			}
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		if (weights[i] > HUF_LOG_MAX)
+			return -1;
+		if (weights[i])
+			sum += 1 << (weights[i] - 1);
+	}
+	if (!sum)
+		return -1;
+
+	/* The last weight fills the sum up to the next power of 2. */
+	log = highbit(sum) + 1;
+	rest = (1 << log) - sum;
+	if (log > HUF_LOG_MAX || rest & (rest - 1))
+		return -1;
+	weights[n++] = highbit(rest) + 1;
+
+	/* Codes are handed out by increasing weight, then symbol. */
+	memset(rank, 0, sizeof(rank));
+	for (i = 0; i < n; i++)
+		rank[weights[i]]++;
+	for (i = 1, sum = 0; i <= log; i++) {
+		uint32_t count = rank[i];
+
+		rank[i] = sum;
+		sum += count << (i - 1);
+	}
+	for (i = 0; i < n; i++) {
+		unsigned int w = weights[i];
+		uint32_t j, len;
+
+		if (!w)
+			continue;
+		len = 1 << (w - 1);
+		for (j = rank[w]; j < rank[w] + len; j++) {
+			ws->huf[j].symbol = i;
+			ws->huf[j].bits = log + 1 - w;
+		}
+		rank[w] += len;
+	}
+
+	ws->huf_log = log;
+	ws->huf_valid = 1;
+	return used;
+}
+
+/* Literals of a block, handed out in order as the sequences need them */
+struct literals {
+	int type;
+	size_t regen;			/* number of literals */
+	size_t left;			/* literals not handed out yet */
+	const uint8_t *raw;
+	uint8_t rle;
+	/* Huffman streams */
+	struct bits streams[4];
+	size_t stream_left;		/* literals left in the current one */
+	size_t segment;			/* literals in each but the last */
+	unsigned int stream, num_streams;
+};
+
+/* Reads the literals section header and sets up the literals. Returns the
+ * size of the section in bytes, or -1 on error. */
+static long literals_init(struct workspace *ws, struct literals *lit,
+			  const uint8_t *in, size_t size)
+{
+	size_t regen, csize, hsize;
+	unsigned int format;
+	long tree = 0;
+
+	if (!size)
+		return -1;
+	lit->type = in[0] & 3;
+	format = in[0] >> 2 & 3;
+
+	if (lit->type == LITERALS_RAW || lit->type == LITERALS_RLE) {
+		switch (format) {
+		case 1:
+			hsize = 2;
+			break;
+		case 3:
+			hsize = 3;
+			break;
+		default:
+			hsize = 1;
+		}
+		if (hsize > size)
+			return -1;
+		if (hsize == 1)
+			regen = in[0] >> 3;
+		else if (hsize == 2)
+			regen = (in[0] >> 4) + (in[1] << 4);
+		else
+			regen = (in[0] >> 4) + (in[1] << 4) + (in[2] << 12);
+
+		lit->left = regen;
+		if (lit->type == LITERALS_RLE) {
+			if (hsize + 1 > size)
+				return -1;
+			lit->rle = in[hsize];
+			return hsize + 1;
+		}
+		if (hsize + regen > size)
+			return -1;
+		lit->raw = in + hsize;
+		return hsize + regen;
+	}
+
+	/* Huffman coded, with 10, 10, 14 or 18 bit sizes */
+	{
+		static const uint8_t size_bits[] = { 10, 10, 14, 18 };
+		unsigned int sbits = size_bits[format];
+		uint64_t h = 0;
+		unsigned int i;
+
+		hsize = format < 2 ? 3 : format + 2;
+		if (hsize > size)
+			return -1;
+		for (i = 0; i < hsize; i++)
+			h |= (uint64_t)in[i] << (i * 8);
+		regen = h >> 4 & ((1 << sbits) - 1);
+		csize = h >> (4 + sbits) & ((1 << sbits) - 1);
+		lit->num_streams = format ? 4 : 1;
+	}
+
+	if (hsize + csize > size || regen > ZSTD_BLOCK_SIZE_MAX)
+		return -1;
+	in += hsize;
+
+	if (lit->type == LITERALS_COMPRESSED) {
+		tree = huf_read_tree(ws, in, csize);
+		if (tree < 0)
+			return -1;
+	} else if (!ws->huf_valid) {
+		return -1;
+	}
+
+	if (lit->num_streams == 1) {
+		if (bits_init(&lit->streams[0], in + tree, csize - tree))
+			return -1;
+		lit->segment = regen;
+	} else {
+		const uint8_t *p = in + tree + 6;
+		size_t total = csize - tree, sizes[4];
+		unsigned int i;
+
+		if (total < 6 + 4)
+			return -1;
+		total -= 6;
+		sizes[0] = read_le16(in + tree);
+		sizes[1] = read_le16(in + tree + 2);
+		sizes[2] = read_le16(in + tree + 4);
+		if (sizes[0] + sizes[1] + sizes[2] >= total)
+			return -1;
+		sizes[3] = total - sizes[0] - sizes[1] - sizes[2];
+
+		for (i = 0; i < 4; i++) {
+			if (bits_init(&lit->streams[i], p, sizes[i]))
+				return -1;
+			p += sizes[i];
+		}
+		lit->segment = (regen + 3) / 4;
+		if (lit->segment * 3 > regen)
+			return -1;
+	}
+
+	lit->regen = regen;
+	lit->left = regen;
+	lit->stream = 0;
+	lit->stream_left = lit->segment;
+	return hsize + csize;
+}
+
+/* Decodes n literals from a Huffman stream to dst. */
+static void huf_decode(const struct workspace *ws, struct bits *b,
+		       uint8_t *dst, size_t n)
+{
+	const struct huf_entry *table = ws->huf;
+	unsigned int log = ws->huf_log;
+	long pos = b->pos;
+
+	while (n--) {
+		const struct huf_entry *e;
+		uint32_t peek;
+
+		/* The code may use fewer than the bits left. */
+		if (pos >= (long)log)
+			peek = bits_at(b, pos - log, log);
+		else if (pos > 0)
+			peek = bits_at(b, 0, pos) << (log - pos);
+		else
+			peek = 0;
+		e = &table[peek];
+		*dst++ = e->symbol;
+		pos -= e->bits;
+	}
+	b->pos = pos;
+}
+
+/* Copies the next n literals to dst. Returns 0 on success. */
+static int literals_copy(const struct workspace *ws, struct literals *lit,
+			 uint8_t *dst, size_t n)
+{
+	if (n > lit->left)
+		return -1;
+	lit->left -= n;
+
+	switch (lit->type) {
+	case LITERALS_RAW:
+		memmove(dst, lit->raw, n);
+		lit->raw += n;
+		return 0;
+	case LITERALS_RLE:
+		memset(dst, lit->rle, n);
+		return 0;
+	}
+
+	while (n) {
+		size_t chunk = n < lit->stream_left ? n : lit->stream_left;
+
+		huf_decode(ws, &lit->streams[lit->stream], dst, chunk);
+		dst += chunk;
+		n -= chunk;
+		lit->stream_left -= chunk;
+
+		/* Each stream must end exactly with its literals. */
+		if (!lit->stream_left) {
+			if (lit->streams[lit->stream].pos)
+				return -1;
+			if (++lit->stream == lit->num_streams)
+				break;
+			lit->stream_left = lit->segment;
+			if (lit->stream + 1 == lit->num_streams)
+				lit->stream_left = lit->regen - lit->segment *
+						   lit->stream;
+		}
+	}
+	return 0;
+}
+
+/* Sets up the decoding table of one kind of sequence symbol. Returns the
+ * size of its description in bytes, or -1 on error. */
+static long seq_table(struct fse_entry *table, uint8_t *log, uint8_t *valid,
+		      unsigned int mode, const uint8_t *in, size_t size,
+		      const int16_t *def, unsigned int def_symbols,
+		      unsigned int def_log, unsigned int max_symbol,
+		      unsigned int max_log)
+{
+	int16_t norm[SYMBOLS_MAX];
+	unsigned int fse_log, symbols;
+	long used = 0;
+
+	switch (mode) {
+	case MODE_PREDEFINED:
+		if (fse_build(table, def_log, def, def_symbols))
+			return -1;
+		*log = def_log;
+		break;
+	case MODE_RLE:
+		if (!size || in[0] > max_symbol)
+			return -1;
+		table[0].symbol = in[0];
+		table[0].bits = 0;
+		table[0].base = 0;
+		*log = 0;
+		used = 1;
+		break;
+	case MODE_FSE:
+		used = fse_read_header(in, size, norm, max_symbol, max_log,
+				       &fse_log, &symbols);
+		if (used < 0 || fse_build(table, fse_log, norm, symbols))
+			return -1;
+		*log = fse_log;
+		break;
+	default:
+		/* The table of the previous block */
+		if (!*valid)
+			return -1;
+	}
+
+	*valid = 1;
+	return used;
+}
+
+/* Copies n bytes from dist bytes back to dst. */
+static void copy_match(uint8_t *dst, uint32_t dist, size_t n)
+{
+	const uint8_t *src = dst - dist;
+
+	if (dist == 1) {
+		memset(dst, *src, n);
+		return;
+	}
+	if (dist >= sizeof(uint64_t)) {
+		/* No word overlaps a word it is copied from. */
+		for (; n >= sizeof(uint64_t); n -= sizeof(uint64_t)) {
+			__builtin_memcpy(dst, src, sizeof(uint64_t));
+			dst += sizeof(uint64_t);
+			src += sizeof(uint64_t);
+		}
+	}
+	while (n--)
+		*dst++ = *src++;
+}
+
+/* Decodes a compressed block of size bytes at in, whose output must end
+ * before end. Returns 0 on success, 1 if the output would pass stop, which
+ * may be below end, or -1 on error. */
+static int decode_compressed(struct zstd_decoder *d, const uint8_t *in,
+			     size_t size, size_t end, size_t stop)
+{
+	struct workspace *ws = d->workspace;
+	uint32_t ll_state, of_state, ml_state;
+	struct literals lit;
+	unsigned int modes;
+	size_t num, i;
+	struct bits b;
+	long used;
+
+	used = literals_init(ws, &lit, in, size);
+	if (used < 0)
+		return -1;
+	in += used;
+	size -= used;
+
+	/* Number of sequences */
+	if (!size)
+		return -1;
+	if (in[0] < 128) {
+		num = in[0];
+		used = 1;
+	} else if (in[0] < 255) {
+		num = ((in[0] - 128) << 8) + in[1];
+		used = 2;
+	} else {
+		num = in[1] + (in[2] << 8) + 0x7f00;
+		used = 3;
+	}
+	if ((size_t)used > size)
+		return -1;
+	in += used;
+	size -= used;
+
+	if (!num) {
+		if (size)
+			return -1;
+		goto last_literals;
+	}
+
+	if (!size || in[0] & 3)
+		return -1;
+	modes = in[0];
+	in++;
+	size--;
+
+	used = seq_table(ws->ll, &ws->ll_log, &ws->ll_valid, modes >> 6, in,
+			 size, ll_default, LL_MAX + 1, 6, LL_MAX,
+			 LL_LOG_MAX);
+	if (used < 0)
+		return -1;
+	in += used;
+	size -= used;
+	used = seq_table(ws->of, &ws->of_log, &ws->of_valid, modes >> 4 & 3,
+			 in, size, of_default, OF_DEFAULT_MAX + 1, 5,
+			 OF_MAX, OF_LOG_MAX);
+	if (used < 0)
+		return -1;
+	in += used;
+	size -= used;
+	used = seq_table(ws->ml, &ws->ml_log, &ws->ml_valid, modes >> 2 & 3,
+			 in, size, ml_default, ML_MAX + 1, 6,
+			 ML_MAX, ML_LOG_MAX);
+	if (used < 0)
+		return -1;
+	in += used;
+	size -= used;
+
+	if (bits_init(&b, in, size))
+		return -1;
+	ll_state = bits_read(&b, ws->ll_log);
+	of_state = bits_read(&b, ws->of_log);
+	ml_state = bits_read(&b, ws->ml_log);
+
+	for (i = 0; i < num; i++) {
+		const struct fse_entry *ll = &ws->ll[ll_state];
+		const struct fse_entry *of = &ws->of[of_state];
+		const struct fse_entry *ml = &ws->ml[ml_state];
+		uint32_t offset, match_len, lit_len;
+
+		offset = ((uint32_t)1 << of->symbol) +
+			 bits_read(&b, of->symbol);
+		match_len = ml_base[ml->symbol] +
+			    bits_read(&b, ml_bits[ml->symbol]);
+		lit_len = ll_base[ll->symbol] +
+			  bits_read(&b, ll_bits[ll->symbol]);
+
+		/* There are no state updates after the last sequence. */
+		if (i + 1 < num) {
+			ll_state = ll->base + bits_read(&b, ll->bits);
+			ml_state = ml->base + bits_read(&b, ml->bits);
+			of_state = of->base + bits_read(&b, of->bits);
+		}
+
+		/* Offsets 1 to 3 pick one of the repeat offsets, or the
+		 * first one minus 1, shifted by one if there are no
+		 * literals. */
+		if (offset > 3) {
+			offset -= 3;
+			d->rep[2] = d->rep[1];
+			d->rep[1] = d->rep[0];
+			d->rep[0] = offset;
+		} else {
+			unsigned int rep = offset - 1 + !lit_len;
+
+			if (rep) {
+				offset = rep == 3 ? d->rep[0] - 1 :
+						    d->rep[rep];
+				if (rep != 1)
+					d->rep[2] = d->rep[1];
+				d->rep[1] = d->rep[0];
+				d->rep[0] = offset;
+			} else {
+				offset = d->rep[0];
+			}
+		}
+
+		if (lit_len > end - d->pos ||
+		    match_len > end - d->pos - lit_len)
+			return -1;
+		if (d->pos + lit_len + match_len > stop)
+			return 1;
+		if (literals_copy(ws, &lit, d->out + d->pos, lit_len))
+			return -1;
+		d->pos += lit_len;
+
+		if (!offset || offset > d->pos - d->frame_start)
+			return -1;
+		copy_match(d->out + d->pos, offset, match_len);
+		d->pos += match_len;
+	}
+
+	/* All bits of the sequences must have been used. */
+	if (b.pos)
+		return -1;
+
+last_literals:
+	if (lit.left > end - d->pos)
+		return -1;
+	if (d->pos + lit.left > stop)
+		return 1;
+	num = lit.left;
+	if (literals_copy(ws, &lit, d->out + d->pos, num))
+		return -1;
+	d->pos += num;
+	return 0;
+}
+
+/* Reads a frame header, or skips a skippable frame. Returns 0 on success. */
+static int frame_header(struct zstd_decoder *d)
+{
+	static const uint8_t dict_id_size[] = { 0, 1, 2, 4 };
+	static const uint8_t content_size_size[] = { 0, 2, 4, 8 };
+	struct workspace *ws = d->workspace;
+	unsigned int fhd, single, id_size, cs_size, i;
+	const uint8_t *p;
+	uint32_t magic, dict_id = 0;
+	size_t hsize;
+
+	if (d->in_size < 8)
+		return -1;
+	magic = read_le32(d->in);
+
+	if ((magic & ~0xf) == ZSTD_SKIPPABLE_MAGIC) {
+		uint32_t skip = read_le32(d->in + 4);
+
+		if (skip > d->in_size - 8)
+			return -1;
+		d->in += 8 + skip;
+		d->in_size -= 8 + skip;
+		return 0;
+	}
+
+	if (magic != ZSTD_MAGIC)
+		return -1;
+	fhd = d->in[4];
+	if (fhd & 8)
+		return -1;
+	single = fhd >> 5 & 1;
+	id_size = dict_id_size[fhd & 3];
+	cs_size = content_size_size[fhd >> 6];
+	if (!cs_size && single)
+		cs_size = 1;
+
+	/* Magic, frame header descriptor and window descriptor */
+	hsize = 5 + !single + id_size + cs_size;
+	if (d->in_size < hsize)
+		return -1;
+	p = d->in + 5 + !single;
+
+	for (i = 0; i < id_size; i++)
+		dict_id |= (uint32_t)p[i] << (i * 8);
+	if (dict_id)
+		return -1;
+	p += id_size;
+
+	switch (cs_size) {
+	case 0:
+		d->content_size = ZSTD_SIZE_UNKNOWN;
+		break;
+	case 1:
+		d->content_size = p[0];
+		break;
+	case 2:
+		d->content_size = read_le16(p) + 256;
+		break;
+	case 4:
+		d->content_size = read_le32(p);
+		break;
+	default:
+		d->content_size = read_le64(p);
+	}
+	if (d->content_size != ZSTD_SIZE_UNKNOWN &&
+	    d->content_size > d->out_size - d->pos)
+		return -1;
+
+	d->checksum = fhd >> 2 & 1;
+	d->frame_start = d->pos;
+	d->rep[0] = 1;
+	d->rep[1] = 4;
+	d->rep[2] = 8;
+	ws->ll_valid = ws->of_valid = ws->ml_valid = ws->huf_valid = 0;
+	d->in_frame = 1;
+
+	d->in += hsize;
+	d->in_size -= hsize;
+	return 0;
+}
+
+static enum zstd_status decode(struct zstd_decoder *d, int in_place)
+{
+	while (d->in_size || d->in_frame) {
+		unsigned int last, type;
+		size_t size, in_size, room, bound, start;
+		size_t stop = (size_t)-1;
+		const uint8_t *block;
+		uint32_t rep[3];
+		uint32_t h;
+		int ret;
+
+		if (!d->in_frame) {
+			if (frame_header(d))
+				return ZSTD_STATUS_ERROR;
+			continue;
+		}
+
+		if (d->in_size < 3)
+			return ZSTD_STATUS_ERROR;
+		h = d->in[0] | d->in[1] << 8 | d->in[2] << 16;
+		last = h & 1;
+		type = h >> 1 & 3;
+		size = h >> 3;
+		in_size = type == BLOCK_RLE ? 1 : size;
+		if (size > ZSTD_BLOCK_SIZE_MAX || in_size > d->in_size - 3)
+			return ZSTD_STATUS_ERROR;
+
+		room = d->out_size - d->pos;
+		if (d->content_size != ZSTD_SIZE_UNKNOWN &&
+		    d->content_size - (d->pos - d->frame_start) < room)
+			room = d->content_size - (d->pos - d->frame_start);
+
+		/* How much the block decodes to is only known for raw and
+		 * RLE blocks, up front. */
+		bound = type == BLOCK_COMPRESSED ? ZSTD_BLOCK_SIZE_MAX : size;
+		if (bound > room) {
+			if (type != BLOCK_COMPRESSED)
+				return ZSTD_STATUS_ERROR;
+			bound = room;
+		}
+
+		/* The output must stay below the unread input. */
+		if (in_place) {
+			stop = (uintptr_t)d->in - (uintptr_t)d->out;
+			if (d->pos >= stop)
+				return ZSTD_STATUS_OK;
+		}
+
+		block = d->in + 3;
+		switch (type) {
+		case BLOCK_RAW:
+		case BLOCK_RLE:
+			if (d->pos + size > stop)
+				return ZSTD_STATUS_OK;
+			if (type == BLOCK_RAW)
+				memmove(d->out + d->pos, block, size);
+			else
+				memset(d->out + d->pos, block[0], size);
+			d->pos += size;
+			break;
+		case BLOCK_COMPRESSED:
+			/* Only the output position and the repeat offsets
+			 * need to be restored to decode it again later. The
+			 * tables it changes are read from its input again. */
+			memcpy(rep, d->rep, sizeof(rep));
+			start = d->pos;
+			ret = decode_compressed(d, block, size, d->pos + bound,
+						stop);
+			if (ret < 0)
+				return ZSTD_STATUS_ERROR;
+			if (ret > 0) {
+				d->pos = start;
+				memcpy(d->rep, rep, sizeof(rep));
+				return ZSTD_STATUS_OK;
+			}
+			break;
+		default:
+			return ZSTD_STATUS_ERROR;
+		}
+		d->in += 3 + in_size;
+		d->in_size -= 3 + in_size;
+
+		if (last) {
+			/* The checksum is left to the CBFS hashes. */
+			if (d->checksum) {
+				if (d->in_size < 4)
+					return ZSTD_STATUS_ERROR;
+				d->in += 4;
+				d->in_size -= 4;
+			}
+			if (d->content_size != ZSTD_SIZE_UNKNOWN &&
+			    d->pos - d->frame_start != d->content_size)
+				return ZSTD_STATUS_ERROR;
+			d->in_frame = 0;
+		}
+	}
+
+	return ZSTD_STATUS_END;
+}
+
+void zstd_decoder_init(struct zstd_decoder *d, void *workspace, void *out,
+		       size_t out_size)
+{
+	d->in = NULL;
+	d->in_size = 0;
+	d->out = out;
+	d->out_size = out_size;
+	d->pos = 0;
+	d->in_frame = 0;
+	d->workspace = workspace;
+}
+
+enum zstd_status zstd_decode(struct zstd_decoder *d)
+{
+	return decode(d, 0);
+}
+
+enum zstd_status zstd_decode_in_place(struct zstd_decoder *d)
+{
+	return decode(d, 1);
+}
@@ -20,6 +20,7 @@
  * \brief Utilities for decoding DDR3 SPDs
  */
 
+#include <commonlib/checksum.h>
 #include <console/console.h>
 #include <device/device.h>
 #include <device/dram/ddr3.h>
@@ -46,24 +47,6 @@ int dimm_is_registered(enum spd_dimm_type type)
 	return 0;
 }
 
-static u16 crc16(const u8 *ptr, int n_crc)
-{
-	int i;
-	u16 crc = 0;
-
-	while (--n_crc >= 0) {
-		crc = crc ^ ((int)*ptr++ << 8);
-		for (i = 0; i < 8; ++i)
-			if (crc & 0x8000) {
-				crc = (crc << 1) ^ 0x1021;
-			} else {
-				crc = crc << 1;
-			}
-	}
-
-	return crc;
-}
-
 /**
  * \brief Calculate the CRC of a DDR3 SPD
  *
@@ -87,7 +70,7 @@ u16 spd_ddr3_calc_crc(u8 *spd, int len)
 		/* Not enough bytes available to get the CRC */
 		return 0;
 
-	return crc16(spd, n_crc);
+	return crc16_ccitt(0, spd, n_crc);
 }
 
 /**
@@ -104,7 +87,7 @@ u16 spd_ddr3_calc_unique_crc(u8 *spd, int len)
 		/* Not enough bytes available to get the CRC */
 		return 0;
 
-	return crc16(&spd[117], 11);
+	return crc16_ccitt(0, &spd[117], 11);
 }
 
 /**
@@ -60,6 +60,24 @@ static struct region_device nv_dev;
 /* Device that mirrors the eventlog in memory. */
 static struct mem_region_device mirror_dev;
 
+/*
+ * Offset of the most recent event in the mirror, and the end of the range
+ * of events which the incremental scan left on NV storage without loading
+ * them into the mirror.
+ */
+static size_t mirror_last_event;
+static size_t mirror_unread;
+
+/*
+ * The write cursor index lives in the erase block following the event log.
+ * It holds a header followed by entries programmed in order without erasing,
+ * each recording the last event and the write cursor after a sync.
+ */
+#define ELOG_INDEX_INVALID (~(size_t)0)
+static struct region_device index_dev;
+static bool index_present;
+static size_t index_next_entry = ELOG_INDEX_INVALID;
+
 static enum {
 	ELOG_UNINITIALIZED = 0,
 	ELOG_INITIALIZED,
@@ -166,6 +184,9 @@ static void elog_tandem_increment_last_write(size_t size)
 	elog_nv_increment_last_write(size);
 }
 
+static int elog_mirror_load(size_t offset, size_t size);
+static int elog_mirror_load_unread(void);
+
 static void elog_debug_dump_buffer(const char *msg)
 {
 	struct region_device *rdev;
@@ -176,6 +197,9 @@ static void elog_debug_dump_buffer(const char *msg)
 
 	elog_debug(msg);
 
+	if (elog_mirror_load_unread() < 0)
+		return;
+
 	rdev = mirror_dev_get();
 
 	buffer = rdev_mmap_full(rdev);
@@ -388,6 +412,7 @@ static int elog_update_event_buffer_state(void)
 
 		/* Move to the next event */
 		elog_tandem_increment_last_write(len);
+		mirror_last_event = offset;
 		offset += len;
 	}
 
@@ -419,6 +444,11 @@ static int elog_scan_flash(void)
 
 	/* No writes have been done yet. */
 	elog_tandem_reset_last_write();
+	mirror_last_event = 0;
+	mirror_unread = 0;
+
+	/* Whatever the index says can't be trusted after a full scan. */
+	index_next_entry = ELOG_INDEX_INVALID;
 
 	/* Check if the area is empty or not */
 	if (elog_is_buffer_clear(0)) {
@@ -438,6 +468,236 @@ static int elog_scan_flash(void)
 	return elog_update_event_buffer_state();
 }
 
+/* Copy a range of the NV storage to the same offset in the mirror. */
+static int elog_mirror_load(size_t offset, size_t size)
+{
+	const struct region_device *rdev = mirror_dev_get();
+	void *buffer;
+	ssize_t ret;
+
+	buffer = rdev_mmap(rdev, offset, size);
+	if (buffer == NULL)
+		return -1;
+
+	ret = rdev_readat(&nv_dev, buffer, offset, size);
+	rdev_munmap(rdev, buffer);
+
+	if (ret != size) {
+		printk(BIOS_ERR, "ELOG: NV read failure.\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Load the events skipped by the incremental scan into the mirror. */
+static int elog_mirror_load_unread(void)
+{
+	size_t start = elog_events_start();
+
+	if (mirror_unread <= start)
+		return 0;
+
+	if (elog_mirror_load(start, mirror_unread - start) < 0)
+		return -1;
+
+	mirror_unread = 0;
+	return 0;
+}
+
+static size_t elog_index_entries(void)
+{
+	return (region_device_sz(&index_dev) -
+		sizeof(struct elog_index_header)) /
+		sizeof(struct elog_index_entry);
+}
+
+static int elog_index_read_entry(size_t i, struct elog_index_entry *entry)
+{
+	size_t offset = sizeof(struct elog_index_header) + i * sizeof(*entry);
+
+	if (rdev_readat(&index_dev, entry, offset, sizeof(*entry)) !=
+	    sizeof(*entry))
+		return -1;
+	return 0;
+}
+
+/*
+ * Find the most recently programmed index entry. Entries are programmed in
+ * order so the boundary to the erased ones can be found by bisection.
+ */
+static int elog_index_find_last(struct elog_index_entry *last)
+{
+	struct elog_index_header header;
+	struct elog_index_entry entry;
+	size_t low = 0;
+	size_t high = elog_index_entries();
+
+	if (rdev_readat(&index_dev, &header, 0, sizeof(header)) !=
+	    sizeof(header) || header.magic != ELOG_INDEX_SIGNATURE)
+		return -1;
+
+	while (low < high) {
+		size_t mid = (low + high) / 2;
+
+		if (elog_index_read_entry(mid, &entry) < 0)
+			return -1;
+
+		if (entry.cursor == ELOG_INDEX_UNUSED)
+			high = mid;
+		else
+			low = mid + 1;
+	}
+
+	if (low == 0 || elog_index_read_entry(low - 1, last) < 0)
+		return -1;
+
+	index_next_entry = low;
+	return 0;
+}
+
+/*
+ * Record the current write cursor in the index. The index is erased and
+ * started over when it is full or no longer matches the event log.
+ */
+static void elog_index_update(void)
+{
+	static const struct elog_index_header header = {
+		.magic = ELOG_INDEX_SIGNATURE,
+		.reserved = 0xffffffff,
+	};
+	struct elog_index_entry entry;
+	size_t size = region_device_sz(&index_dev);
+	size_t offset;
+
+	if (!index_present || mirror_last_event == 0)
+		return;
+
+	if (index_next_entry >= elog_index_entries()) {
+		if (rdev_eraseat(&index_dev, 0, size) != size ||
+		    rdev_writeat(&index_dev, &header, 0, sizeof(header)) !=
+		    sizeof(header)) {
+			printk(BIOS_ERR, "ELOG: index reset failed.\n");
+			return;
+		}
+		index_next_entry = 0;
+	}
+
+	entry.last_event = mirror_last_event;
+	entry.cursor = mirror_last_write;
+	offset = sizeof(header) + index_next_entry * sizeof(entry);
+
+	if (rdev_writeat(&index_dev, &entry, offset, sizeof(entry)) !=
+	    sizeof(entry)) {
+		printk(BIOS_ERR, "ELOG: index write failed.\n");
+		index_next_entry = ELOG_INDEX_INVALID;
+		return;
+	}
+
+	index_next_entry++;
+}
+
+/* Invalidate the index ahead of erasing the event log. */
+static void elog_index_invalidate(void)
+{
+	const u32 magic = 0;
+
+	if (!index_present)
+		return;
+
+	/* Clearing bits doesn't need an erase. */
+	rdev_writeat(&index_dev, &magic, 0, sizeof(magic));
+	index_next_entry = ELOG_INDEX_INVALID;
+}
+
+/*
+ * Load the log using the index. Only the header, the last indexed event
+ * and any events appended after the last index update are read and
+ * validated. The events in front of the indexed one were validated when
+ * they were written and are loaded on demand.
+ */
+static int elog_scan_flash_incremental(void)
+{
+	struct elog_index_entry last;
+	size_t events_end = region_device_sz(&nv_dev) - MAX_EVENT_SIZE;
+	void *mirror_buffer;
+	size_t offset;
+	size_t len;
+
+	if (!index_present || elog_index_find_last(&last) < 0)
+		return -1;
+
+	elog_debug("%s(last_event=0x%x cursor=0x%x)\n", __func__,
+		   last.last_event, last.cursor);
+
+	if (last.last_event < elog_events_start() ||
+	    last.last_event >= last.cursor || last.cursor > events_end)
+		goto invalid;
+
+	elog_tandem_reset_last_write();
+
+	/* Unread parts of the mirror are treated as empty. */
+	mirror_buffer = rdev_mmap_full(mirror_dev_get());
+	if (mirror_buffer == NULL)
+		goto invalid;
+	memset(mirror_buffer, ELOG_TYPE_EOL, region_device_sz(&nv_dev));
+	rdev_munmap(mirror_dev_get(), mirror_buffer);
+
+	if (elog_mirror_load(0, elog_events_start()) < 0 ||
+	    !elog_is_header_valid())
+		goto invalid;
+	elog_tandem_increment_last_write(elog_events_start());
+
+	/* The indexed event has to still end at the recorded cursor. */
+	len = last.cursor - last.last_event;
+	if (elog_mirror_load(last.last_event, len) < 0 ||
+	    elog_is_event_valid(last.last_event) != len)
+		goto invalid;
+
+	elog_tandem_increment_last_write(last.cursor - elog_events_start());
+	mirror_last_event = last.last_event;
+	mirror_unread = last.last_event;
+
+	/* Pick up events added after the last index update. */
+	offset = last.cursor;
+	while (offset < events_end) {
+		struct event_header event;
+
+		if (elog_mirror_load(offset, sizeof(event)) < 0 ||
+		    rdev_readat(mirror_dev_get(), &event, offset,
+				sizeof(event)) != sizeof(event))
+			goto invalid;
+
+		if (event.type == ELOG_TYPE_EOL)
+			break;
+
+		if (event.length > MAX_EVENT_SIZE ||
+		    event.length < sizeof(event) ||
+		    elog_mirror_load(offset, event.length) < 0 ||
+		    elog_is_event_valid(offset) != event.length) {
+			printk(BIOS_ERR, "ELOG: Invalid event @ offset 0x%zx\n",
+				offset);
+			goto invalid;
+		}
+
+		elog_tandem_increment_last_write(event.length);
+		mirror_last_event = offset;
+		offset += event.length;
+	}
+
+	/* Re-index if anything was appended without updating the index. */
+	if (offset != last.cursor)
+		index_next_entry = ELOG_INDEX_INVALID;
+
+	return 0;
+
+invalid:
+	printk(BIOS_INFO, "ELOG: index out of date, scanning full log.\n");
+	index_next_entry = ELOG_INDEX_INVALID;
+	mirror_unread = 0;
+	return -1;
+}
+
 static void elog_write_header_in_mirror(void)
 {
 	static const struct elog_header header = {
@@ -546,6 +806,10 @@ static int elog_shrink_by_size(size_t requested_size)
 
 	elog_debug("%s()\n", __func__);
 
+	/* Shrinking moves events which may not have been loaded yet. */
+	if (elog_mirror_load_unread() < 0)
+		return -1;
+
 	/* Indicate possible erase required. */
 	elog_nv_needs_possible_erase();
 
@@ -610,8 +874,10 @@ int elog_smbios_write_type15(unsigned long *current, int handle)
 	if (IS_ENABLED(CONFIG_ELOG_CBMEM)) {
 		/* Save event log buffer into CBMEM for the OS to read */
 		void *cbmem = cbmem_add(CBMEM_ID_ELOG, elog_size);
-		if (cbmem)
+		if (cbmem && elog_mirror_load_unread() == 0)
 			rdev_readat(mirror_dev_get(), cbmem, 0, elog_size);
+		else
+			cbmem = NULL;
 		log_address = (uintptr_t)cbmem;
 	} else {
 		log_address = (uintptr_t)elog_flash_offset_to_address();
@@ -680,6 +946,13 @@ static int elog_find_flash(void)
 
 	/* Keep 4KiB max size until large malloc()s have been fixed. */
 	total_size = MIN(4*KiB, region_device_sz(rdev));
+
+	/* Use the block after the log for the index if there is one. */
+	if (IS_ENABLED(CONFIG_ELOG_INDEX) &&
+	    region_device_sz(rdev) >= total_size + ELOG_INDEX_SIZE)
+		index_present = !rdev_chain(&index_dev, rdev, total_size,
+						ELOG_INDEX_SIZE);
+
 	rdev_chain(rdev, rdev, 0, total_size);
 
 	full_threshold = total_size - reserved_space;
@@ -707,6 +980,7 @@ static int elog_sync_to_nv(void)
 
 	/* Erase if necessary. */
 	if (erase_needed) {
+		elog_index_invalidate();
 		elog_nv_erase();
 		elog_nv_reset_last_write();
 	}
@@ -720,8 +994,10 @@ static int elog_sync_to_nv(void)
 	 * If erase wasn't performed then don't rescan. Assume the appended
 	 * write was successful.
 	 */
-	if (!erase_needed)
+	if (!erase_needed) {
+		elog_index_update();
 		return 0;
+	}
 
 	elog_debug_dump_buffer("ELOG: in-memory mirror:\n");
 
@@ -733,6 +1009,8 @@ static int elog_sync_to_nv(void)
 		return -1;
 	}
 
+	elog_index_update();
+
 	return 0;
 }
 
@@ -775,7 +1053,8 @@ int elog_init(void)
 	elog_initialized = ELOG_INITIALIZED;
 
 	/* Load the log from flash and prepare the flash if necessary. */
-	if (elog_scan_flash() < 0 && elog_prepare_empty() < 0) {
+	if (elog_scan_flash_incremental() < 0 && elog_scan_flash() < 0 &&
+	    elog_prepare_empty() < 0) {
 		printk(BIOS_ERR, "ELOG: Unable to prepare flash\n");
 		return -1;
 	}
@@ -879,6 +1158,7 @@ int elog_add_event_raw(u8 event_type, void *data, u8 data_size)
 	elog_update_checksum(event, -(elog_checksum_event(event)));
 	elog_put_event_buffer(event);
 
+	mirror_last_event = mirror_last_write;
 	elog_mirror_increment_last_write(event_size);
 
 	printk(BIOS_INFO, "ELOG: Event(%X) added with size %d\n",
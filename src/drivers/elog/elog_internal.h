@@ -30,6 +30,21 @@ struct elog_header {
 #define ELOG_MIN_AVAILABLE_ENTRIES	2  /* Shrink when this many can't fit */
 #define ELOG_SHRINK_PERCENTAGE		25 /* Percent of total area to remove */
 
+/* Write cursor index following the event log */
+struct elog_index_header {
+	u32 magic;
+	u32 reserved;
+} __attribute__ ((packed));
+
+struct elog_index_entry {
+	u16 last_event;
+	u16 cursor;
+} __attribute__ ((packed));
+
+#define ELOG_INDEX_SIGNATURE		0x58444945  /* 'EIDX' */
+#define ELOG_INDEX_SIZE			(4 * KiB)
+#define ELOG_INDEX_UNUSED		0xffff
+
 /* SMBIOS event log header */
 struct event_header {
 	u8 type;
@@ -20,7 +20,7 @@
 #include <cbmem.h>
 #include "fsp_util.h"
 #include <lib.h> // hexdump
-#include <ip_checksum.h>
+#include <training_cache.h>
 #include <timestamp.h>
 
 #ifndef __PRE_RAM__
@@ -282,7 +282,7 @@ int save_mrc_data(void *hob_start)
 		memset((mrc_data->mrc_data + mrc_hob_size), 0,
 				output_len - mrc_hob_size);
 
-	mrc_data->mrc_checksum = compute_ip_checksum(mrc_data->mrc_data,
+	mrc_data->mrc_checksum = training_cache_hash(mrc_data->mrc_data,
 			mrc_data->mrc_data_size);
 
 	printk(BIOS_SPEW, "Fast boot data (includes align and checksum):\n");
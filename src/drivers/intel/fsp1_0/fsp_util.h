@@ -62,13 +62,12 @@ void printguid(EFI_GUID *guid);
 #define EFI_HOB_TYPE_MEMORY_POOL	0x0007
 
 #if IS_ENABLED(CONFIG_ENABLE_MRC_CACHE)
-#define MRC_DATA_ALIGN			0x1000
 #define MRC_DATA_SIGNATURE		(('M'<<0)|('R'<<8)|('C'<<16)|('D'<<24))
 
 struct mrc_data_container {
 	u32	mrc_signature;	// "MRCD"
 	u32	mrc_data_size;	// Actual total size of this structure
-	u32	mrc_checksum;	// IP style checksum
+	u32	mrc_checksum;	// training_cache_hash() of mrc_data
 	u32	reserved;		// For header alignment
 	u8	mrc_data[0];	// Variable size, platform/run time dependent.
 } __attribute__ ((packed));
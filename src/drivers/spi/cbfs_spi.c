@@ -20,8 +20,11 @@
  */
 
 #include <boot_device.h>
+#include <bootstate.h>
+#include <commonlib/helpers.h>
 #include <console/console.h>
 #include <spi_flash.h>
+#include <string.h>
 #include <symbols.h>
 #include <cbmem.h>
 #include <timer.h>
@@ -39,8 +42,187 @@ static struct spi_flash *spi_flash_info;
  */
 #define SPI_SPEED_DEBUG		0
 
-static ssize_t spi_readat(const struct region_device *rd, void *b,
-				size_t offset, size_t size)
+static ssize_t spi_read_flash(void *b, size_t offset, size_t size);
+static struct mmap_helper_region_device mdev;
+
+/*
+ * Small reads are served from a page cache carved out of the CBFS cache
+ * region. A miss that continues the previous miss reads ahead, doubling
+ * the window up to half the cache. Pages live in one buffer so that a
+ * readahead run lands in adjacent slots and costs a single flash read.
+ * The buffer is only allocated on first use and handed back to the
+ * mappings when they run out of space.
+ */
+#define CACHE_PAGES		CONFIG_SPI_FLASH_READ_CACHE_PAGES
+#define CACHE_PAGE_SIZE		CONFIG_SPI_FLASH_READ_CACHE_PAGE_SIZE
+#define CACHE_READAHEAD_MAX	MAX(CACHE_PAGES / 2, 1)
+
+struct cache_slot {
+	size_t page;		/* Page number plus one, 0 if empty. */
+	uint32_t last_use;
+};
+
+static struct {
+	uint8_t *data;
+	int no_room;
+	uint32_t clock;
+	size_t next_page;
+	size_t readahead;
+	struct cache_slot slots[MAX(CACHE_PAGES, 1)];
+	/* Statistics reported through the console. */
+	uint32_t hits;
+	uint32_t misses;
+	size_t flash_bytes;
+} cache;
+
+static void cache_invalidate(size_t offset, size_t size)
+{
+	size_t first = offset / CACHE_PAGE_SIZE;
+	size_t last = (offset + size - 1) / CACHE_PAGE_SIZE;
+	int i;
+
+	if (size == 0)
+		return;
+
+	for (i = 0; i < CACHE_PAGES; i++) {
+		size_t page = cache.slots[i].page;
+
+		if (page != 0 && page - 1 >= first && page - 1 <= last)
+			cache.slots[i].page = 0;
+	}
+	cache.next_page = 0;
+	cache.readahead = 0;
+}
+
+/* Forget the cache buffer. The pool is about to be reinitialized. */
+static void cache_reset(void)
+{
+	cache_invalidate(0, CONFIG_ROM_SIZE);
+	cache.data = NULL;
+	cache.no_room = 0;
+}
+
+static int cache_lookup(size_t page)
+{
+	int i;
+
+	for (i = 0; i < CACHE_PAGES; i++) {
+		if (cache.slots[i].page == page + 1)
+			return i;
+	}
+	return -1;
+}
+
+/* Fill the cache starting at page. Returns the slot of page or -1. */
+static int cache_fill(size_t page)
+{
+	size_t count = 1;
+	size_t max_pages = CONFIG_ROM_SIZE / CACHE_PAGE_SIZE;
+	uint32_t best_age = UINT32_MAX;
+	int best = 0;
+	int i, j;
+
+	if (page != 0 && page == cache.next_page)
+		count = MIN(MAX(cache.readahead * 2, 1), CACHE_READAHEAD_MAX);
+	count = MIN(count, max_pages - page);
+
+	/* Don't read ahead into pages which are already cached. */
+	for (i = 1; i < count; i++) {
+		if (cache_lookup(page + i) >= 0) {
+			count = i;
+			break;
+		}
+	}
+
+	/* Evict the run of slots whose newest page is the least recent. */
+	for (i = 0; i + count <= CACHE_PAGES; i++) {
+		uint32_t age = 0;
+
+		for (j = i; j < i + count; j++) {
+			if (cache.slots[j].page != 0)
+				age = MAX(age, cache.slots[j].last_use);
+		}
+		if (age < best_age) {
+			best_age = age;
+			best = i;
+		}
+	}
+
+	for (i = best; i < best + count; i++)
+		cache.slots[i].page = 0;
+
+	if (spi_read_flash(&cache.data[best * CACHE_PAGE_SIZE],
+			   page * CACHE_PAGE_SIZE,
+			   count * CACHE_PAGE_SIZE) < 0)
+		return -1;
+
+	cache.clock++;
+	for (i = 0; i < count; i++) {
+		cache.slots[best + i].page = page + i + 1;
+		cache.slots[best + i].last_use = cache.clock;
+	}
+	cache.next_page = page + count;
+	cache.readahead = count;
+
+	return best;
+}
+
+static int cache_available(void)
+{
+	if (cache.data != NULL)
+		return 1;
+	if (cache.no_room || mdev.pool.buf == NULL)
+		return 0;
+
+	cache.data = mem_pool_alloc(&mdev.pool, CACHE_PAGES * CACHE_PAGE_SIZE);
+	if (cache.data == NULL)
+		cache.no_room = 1;
+
+	return cache.data != NULL;
+}
+
+static ssize_t cache_readat(uint8_t *b, size_t offset, size_t size)
+{
+	size_t remaining = size;
+
+	while (remaining) {
+		size_t page = offset / CACHE_PAGE_SIZE;
+		size_t page_offset = offset % CACHE_PAGE_SIZE;
+		size_t len = MIN(remaining, CACHE_PAGE_SIZE - page_offset);
+		int slot;
+
+		slot = cache_lookup(page);
+		if (slot >= 0) {
+			cache.hits++;
+			cache.slots[slot].last_use = ++cache.clock;
+		} else {
+			cache.misses++;
+			slot = cache_fill(page);
+			if (slot < 0)
+				return -1;
+		}
+
+		memcpy(b, &cache.data[slot * CACHE_PAGE_SIZE + page_offset],
+		       len);
+		b += len;
+		offset += len;
+		remaining -= len;
+	}
+
+	return size;
+}
+
+static void cache_report(void)
+{
+	if (CACHE_PAGES == 0)
+		return;
+
+	printk(BIOS_DEBUG, "SPI read cache: %u hits, %u misses, "
+	       "%zu bytes read from flash\n", cache.hits, cache.misses,
+	       cache.flash_bytes);
+}
+
+static ssize_t spi_read_flash(void *b, size_t offset, size_t size)
 {
 	struct stopwatch sw;
 	bool show = SPI_SPEED_DEBUG && size >= 4 * KiB;
@@ -49,6 +231,7 @@ static ssize_t spi_readat(const struct region_device *rd, void *b,
 		stopwatch_init(&sw);
 	if (spi_flash_read(spi_flash_info, offset, size, b))
 		return -1;
+	cache.flash_bytes += size;
 	if (show) {
 		long usecs;
 
@@ -65,9 +248,19 @@ static ssize_t spi_readat(const struct region_device *rd, void *b,
 	return size;
 }
 
+static ssize_t spi_readat(const struct region_device *rd, void *b,
+				size_t offset, size_t size)
+{
+	if (CACHE_PAGES == 0 || size >= CACHE_PAGE_SIZE || !cache_available())
+		return spi_read_flash(b, offset, size);
+
+	return cache_readat(b, offset, size);
+}
+
 static ssize_t spi_writeat(const struct region_device *rd, const void *b,
 				size_t offset, size_t size)
 {
+	cache_invalidate(offset, size);
 	if (spi_flash_write(spi_flash_info, offset, size, b))
 		return -1;
 	return size;
@@ -76,14 +269,32 @@ static ssize_t spi_writeat(const struct region_device *rd, const void *b,
 static ssize_t spi_eraseat(const struct region_device *rd,
 				size_t offset, size_t size)
 {
+	cache_invalidate(offset, size);
 	if (spi_flash_erase(spi_flash_info, offset, size))
 		return -1;
 	return size;
 }
 
+static void *spi_mmap(const struct region_device *rd, size_t offset,
+			size_t size)
+{
+	void *mapping = mmap_helper_rdev_mmap(rd, offset, size);
+
+	if (mapping != NULL || cache.data == NULL)
+		return mapping;
+
+	/* Mappings take priority over the read cache. */
+	mem_pool_free(&mdev.pool, cache.data);
+	cache_invalidate(0, CONFIG_ROM_SIZE);
+	cache.data = NULL;
+	cache.no_room = 1;
+
+	return mmap_helper_rdev_mmap(rd, offset, size);
+}
+
 /* Provide all operations on the same device. */
 static const struct region_device_ops spi_ops = {
-	.mmap = mmap_helper_rdev_mmap,
+	.mmap = spi_mmap,
 	.munmap = mmap_helper_rdev_munmap,
 	.readat = spi_readat,
 	.writeat = spi_writeat,
@@ -101,12 +312,23 @@ static void switch_to_postram_cache(int unused)
 	 * being overwritten if spi_flash was not accessed before dram was up.
 	 */
 	boot_device_init();
-	if (_preram_cbfs_cache != _postram_cbfs_cache)
+	cache_report();
+	if (_preram_cbfs_cache != _postram_cbfs_cache) {
+		cache_reset();
 		mmap_helper_device_init(&mdev, _postram_cbfs_cache,
 					_postram_cbfs_cache_size);
+	}
 }
 ROMSTAGE_CBMEM_INIT_HOOK(switch_to_postram_cache);
 
+#if ENV_RAMSTAGE
+static void report_cache_stats(void *unused)
+{
+	cache_report();
+}
+BOOT_STATE_INIT_ENTRY(BS_PAYLOAD_BOOT, BS_ON_ENTRY, report_cache_stats, NULL);
+#endif
+
 void boot_device_init(void)
 {
 	int bus = CONFIG_BOOT_DEVICE_SPI_FLASH_BUS;
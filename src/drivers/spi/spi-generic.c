@@ -41,3 +41,21 @@ int spi_xfer(const struct spi_slave *slave, const void *dout, size_t bytesout,
 
 	return -1;
 }
+
+unsigned int spi_ctrlr_read_modes(const struct spi_slave *slave)
+{
+	const struct spi_ctrlr *ctrlr = slave->ctrlr;
+	if (ctrlr && ctrlr->xfer_read)
+		return ctrlr->read_modes;
+	return 0;
+}
+
+int spi_xfer_read(const struct spi_slave *slave, const struct spi_read_op *op,
+		  void *din, size_t bytesin)
+{
+	const struct spi_ctrlr *ctrlr = slave->ctrlr;
+	if (ctrlr && ctrlr->xfer_read)
+		return ctrlr->xfer_read(slave, op, din, bytesin);
+
+	return -1;
+}
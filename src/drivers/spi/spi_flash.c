@@ -149,6 +149,188 @@ int spi_flash_cmd_read_slow(const struct spi_flash *flash, u32 offset,
 					offset, len, data);
 }
 
+static int spi_flash_cmd_read_multi(const struct spi_flash *flash, u32 offset,
+			size_t len, void *data)
+{
+	struct spi_read_op op;
+	int ret;
+
+	op.opcode = flash->read_cmd;
+	op.addr = offset;
+	op.addr_lines = 1;
+	op.data_lines = 1;
+	op.dummy_cycles = flash->read_dummy_cycles;
+
+	switch (flash->read_mode) {
+	case SPI_READ_MODE_1_4_4:
+		op.addr_lines = 4;
+		/* fall through */
+	case SPI_READ_MODE_1_1_4:
+		op.data_lines = 4;
+		break;
+	case SPI_READ_MODE_1_2_2:
+		op.addr_lines = 2;
+		/* fall through */
+	case SPI_READ_MODE_1_1_2:
+		op.data_lines = 2;
+		break;
+	}
+
+	if (spi_claim_bus(flash->spi))
+		return -1;
+	ret = spi_xfer_read(flash->spi, &op, data, len);
+	spi_release_bus(flash->spi);
+
+	if (ret)
+		printk(BIOS_WARNING, "SF: Failed multi-I/O read (%zu bytes): %d\n",
+				len, ret);
+
+	return ret;
+}
+
+/*
+ * SFDP (JESD216) support. Only the JEDEC basic flash parameter table is
+ * consulted, which all revisions place in the first parameter header.
+ */
+#define SFDP_SIGNATURE		0x50444653
+#define SFDP_BFPT_ID		0xff00
+#define SFDP_BFPT_MAX_DWORDS	15
+
+struct sfdp_read_mode {
+	unsigned int mode;
+	const char *name;
+	u8 dword;	/* 1-based BFPT dword holding opcode and cycles */
+	u8 shift;	/* Bit position of the settings within the dword */
+	u8 support_bit;	/* Bit in BFPT dword 1 advertising the mode */
+};
+
+/* Ordered from fastest to slowest. */
+static const struct sfdp_read_mode sfdp_read_modes[] = {
+	{ SPI_READ_MODE_1_4_4, "1-4-4", 3, 0, 21 },
+	{ SPI_READ_MODE_1_1_4, "1-1-4", 3, 16, 22 },
+	{ SPI_READ_MODE_1_2_2, "1-2-2", 4, 16, 20 },
+	{ SPI_READ_MODE_1_1_2, "1-1-2", 4, 0, 16 },
+};
+
+static u32 sfdp_dword(const u8 *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((u32)p[3] << 24);
+}
+
+static int sfdp_read(struct spi_slave *spi, u32 addr, void *buf, size_t len)
+{
+	u8 cmd[5];
+
+	cmd[0] = CMD_READ_SFDP;
+	cmd[4] = 0x00;
+
+	return spi_flash_cmd_read_array(spi, cmd, sizeof(cmd), addr, len, buf);
+}
+
+/*
+ * Check that Quad modes can be used without touching the status
+ * registers. Parts whose Quad Enable bit isn't set are left alone.
+ */
+static int sfdp_quad_enabled(struct spi_slave *spi, const u32 *bfpt,
+			     size_t dwords)
+{
+	u8 status;
+
+	/* Rev 0 tables don't describe the Quad Enable bit. */
+	if (dwords < 15)
+		return 0;
+
+	switch ((bfpt[14] >> 20) & 0x7) {
+	case 0:
+		return 1;
+	case 2:
+		if (spi_flash_cmd(spi, CMD_READ_STATUS, &status, 1))
+			return 0;
+		return !!(status & (1 << 6));
+	case 3:
+		if (spi_flash_cmd(spi, CMD_READ_STATUS2_ALT, &status, 1))
+			return 0;
+		return !!(status & (1 << 7));
+	case 1:
+	case 4:
+	case 5:
+		if (spi_flash_cmd(spi, CMD_READ_STATUS2, &status, 1))
+			return 0;
+		return !!(status & (1 << 1));
+	default:
+		return 0;
+	}
+}
+
+static void spi_flash_setup_read_mode(struct spi_flash *flash)
+{
+	struct spi_slave *spi = flash->spi;
+	u8 buf[SFDP_BFPT_MAX_DWORDS * 4];
+	u32 bfpt[SFDP_BFPT_MAX_DWORDS];
+	unsigned int modes;
+	size_t dwords;
+	u32 ptp;
+	int i;
+
+	if (!IS_ENABLED(CONFIG_SPI_FLASH_SFDP))
+		return;
+
+	/* Drivers with their own read routine or slow reads know better. */
+	if (flash->internal_read != spi_flash_cmd_read_fast)
+		return;
+
+	modes = spi_ctrlr_read_modes(spi);
+	if (!modes)
+		return;
+
+	/* SFDP header followed by the first parameter header. */
+	if (sfdp_read(spi, 0, buf, 16))
+		return;
+	if (sfdp_dword(buf) != SFDP_SIGNATURE || buf[5] != 1 ||
+	    (buf[8] | (buf[15] << 8)) != SFDP_BFPT_ID || buf[10] != 1) {
+		printk(BIOS_DEBUG, "SF: No usable SFDP tables\n");
+		return;
+	}
+
+	dwords = MIN(buf[11], SFDP_BFPT_MAX_DWORDS);
+	ptp = buf[12] | (buf[13] << 8) | (buf[14] << 16);
+	if (dwords < 9 || sfdp_read(spi, ptp, buf, dwords * 4))
+		return;
+	for (i = 0; i < dwords; i++)
+		bfpt[i] = sfdp_dword(&buf[i * 4]);
+
+	/* 3-byte addressing is required. */
+	if (((bfpt[0] >> 17) & 0x3) == 2)
+		return;
+
+	if ((modes & (SPI_READ_MODE_1_1_4 | SPI_READ_MODE_1_4_4)) &&
+	    !sfdp_quad_enabled(spi, bfpt, dwords))
+		modes &= ~(SPI_READ_MODE_1_1_4 | SPI_READ_MODE_1_4_4);
+
+	for (i = 0; i < ARRAY_SIZE(sfdp_read_modes); i++) {
+		const struct sfdp_read_mode *m = &sfdp_read_modes[i];
+		u32 settings;
+
+		if (!(modes & m->mode) || !(bfpt[0] & (1 << m->support_bit)))
+			continue;
+
+		settings = bfpt[m->dword - 1] >> m->shift;
+		if (((settings >> 8) & 0xff) == 0)
+			continue;
+
+		flash->read_cmd = (settings >> 8) & 0xff;
+		flash->read_mode = m->mode;
+		/* Wait and mode bit cycles are both sent as dummy cycles. */
+		flash->read_dummy_cycles = (settings & 0x1f) +
+					   ((settings >> 5) & 0x7);
+		flash->internal_read = spi_flash_cmd_read_multi;
+
+		printk(BIOS_INFO, "SF: Using %s read, opcode %02x, %d dummy cycles\n",
+		       m->name, flash->read_cmd, flash->read_dummy_cycles);
+		return;
+	}
+}
+
 int spi_flash_cmd_poll_bit(const struct spi_flash *flash, unsigned long timeout,
 			   u8 cmd, u8 poll_bit)
 {
@@ -371,6 +553,8 @@ struct spi_flash *spi_flash_probe(unsigned int bus, unsigned int cs)
 	printk(BIOS_INFO, "SF: Detected %s with sector size 0x%x, total 0x%x\n",
 			flash->name, flash->sector_size, flash->size);
 
+	spi_flash_setup_read_mode(flash);
+
 	/*
 	 * Only set the global spi_flash_dev if this is the boot
 	 * device's bus and it's previously unset while in ramstage.
@@ -24,6 +24,12 @@
 #define CMD_READ_ARRAY_LEGACY		0xe8
 
 #define CMD_READ_STATUS			0x05
+#define CMD_READ_STATUS2		0x35
+/* Reads status register 2 on parts whose JESD216B Quad Enable
+ * Requirements are 3. The standard names no such part, and no vendor
+ * is known to use it. */
+#define CMD_READ_STATUS2_ALT		0x3f
+#define CMD_READ_SFDP			0x5a
 #define CMD_WRITE_ENABLE		0x06
 
 #define CMD_BLOCK_ERASE			0xD8
@@ -42,8 +42,9 @@ size_t cbfs_boot_load_struct(const char *name, void *buf, size_t buf_size);
 /* Load |in_size| bytes from |rdev| at |offset| to the |buffer_size| bytes
  * large |buffer|, decompressing it according to |compression| in the process.
  * Returns the decompressed file size, or 0 on error.
- * LZMA files will be mapped for decompression. LZ4 files will be decompressed
- * in-place with the buffer size requirements outlined in compression.h. */
+ * LZ4 files will be decompressed in-place with the buffer size requirements
+ * outlined in compression.h. LZMA files will be decompressed in-place as far
+ * as the buffer allows and from a mapping after that, see ulzman_rdev(). */
 size_t cbfs_load_and_decompress(const struct region_device *rdev, size_t offset,
 	size_t in_size, void *buffer, size_t buffer_size, uint32_t compression);
 
@@ -47,6 +47,7 @@
 #ifndef DEVICE_EARLY_SMBUS_H
 #define DEVICE_EARLY_SMBUS_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 /**
@@ -65,6 +66,15 @@ int smbus_is_busy(u32 smbus_dev);
 int smbus_wait_until_ready(u32 smbus_dev);
 u8 smbus_read_byte(u32 smbus_dev, u8 addr, u8 offset);
 u8 smbus_write_byte(u32 smbus_dev, u8 addr, u8 offset, u8 value);
+/**
+ * Read len bytes starting at offset with a single I2C block read. Controllers
+ * that cannot do this don't need to implement it; the default fails, so
+ * callers fall back to smbus_read_byte().
+ *
+ * @return Number of bytes read, or a negative value on error
+ */
+int smbus_i2c_block_read(u32 smbus_dev, u8 addr, u8 offset, u8 *buf,
+			 size_t len);
 void smbus_delay(void);
 
 #endif				/* DEVICE_EARLY_SMBUS_H */
@@ -1,5 +1,19 @@
 #ifndef IP_CHECKSUM_H
 #define IP_CHECKSUM_H
-unsigned long compute_ip_checksum(void *addr, unsigned long length);
-unsigned long add_ip_checksums(unsigned long offset, unsigned long sum, unsigned long new);
+
+#include <commonlib/checksum.h>
+
+static inline unsigned long compute_ip_checksum(const void *addr,
+						unsigned long length)
+{
+	return ip_checksum(addr, length);
+}
+
+static inline unsigned long add_ip_checksums(unsigned long offset,
+					     unsigned long sum,
+					     unsigned long new)
+{
+	return ip_checksum_add(offset, sum, new);
+}
+
 #endif /* IP_CHECKSUM_H */
@@ -23,6 +23,26 @@
 /* Defined in src/lib/lzma.c. Returns decompressed size or 0 on error. */
 size_t ulzman(const void *src, size_t srcn, void *dst, size_t dstn);
 
+/* Defined in src/lib/lzma.c. Same as ulzman() for the srcn bytes at offset
+ * in rdev. They are read to the end of dst and decompressed in place, as far
+ * as the output doesn't catch up with them, and the rest from a mapping. */
+struct region_device;
+size_t ulzman_rdev(const struct region_device *rdev, size_t offset,
+		   size_t srcn, void *dst, size_t dstn);
+/* Same as ulzman_rdev() for srcn bytes that have already been read to the
+ * end of dst. */
+size_t ulzman_in_place(const struct region_device *rdev, size_t offset,
+		       size_t srcn, void *dst, size_t dstn);
+
+/* Defined in src/lib/zstd.c. Decompresses the Zstandard frame of srcn bytes
+ * at src into dst, returns the output size or 0 on error. */
+size_t uzstdn(const void *src, size_t srcn, void *dst, size_t dstn);
+/* Same as ulzman_rdev() and ulzman_in_place() for a Zstandard frame. */
+size_t uzstdn_rdev(const struct region_device *rdev, size_t offset,
+		   size_t srcn, void *dst, size_t dstn);
+size_t uzstdn_in_place(const struct region_device *rdev, size_t offset,
+		       size_t srcn, void *dst, size_t dstn);
+
 /* Defined in src/lib/ramtest.c */
 void ram_check(unsigned long start, unsigned long stop);
 int ram_check_nodie(unsigned long start, unsigned long stop);
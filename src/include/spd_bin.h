@@ -17,6 +17,7 @@
 #define SPD_BIN_H
 
 #include <arch/early_variables.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <commonlib/region.h>
 
@@ -41,6 +42,14 @@
 #define DDR4_SPD_PART_LEN	20
 #define LPDDR4_SPD_PART_OFF	329
 #define LPDDR4_SPD_PART_LEN	20
+/* Manufacturer, location, date and serial number, followed by the CRC */
+#define DDR3_SPD_ID_OFF		117
+#define DDR3_SPD_ID_LEN		11
+#define DDR4_SPD_CRC_OFF	126
+#define DDR4_SPD_CRC_LEN	2
+/* Manufacturer, location, date and serial number */
+#define DDR4_SPD_ID_OFF		320
+#define DDR4_SPD_ID_LEN		9
 
 struct spd_block {
 	u8 *spd_array[CONFIG_DIMM_MAX];
@@ -54,4 +63,18 @@ int get_spd_cbfs_rdev(struct region_device *spd_rdev, u8 spd_index);
 void dump_spd_info(struct spd_block *blk);
 void get_spd_smbus(struct spd_block *blk);
 
+#if IS_ENABLED(CONFIG_SPD_CACHE)
+/* Fill spd with the SPDs of all slots from RW_SPD_CACHE.
+ * Return 0 on success & -1 if the cache is empty or invalid */
+int spd_cache_load(u8 *spd, size_t size);
+/* Replace the contents of RW_SPD_CACHE with the SPDs of all slots */
+void spd_cache_save(const u8 *spd, size_t size);
+#else
+static inline int spd_cache_load(u8 *spd, size_t size)
+{
+	return -1;
+}
+static inline void spd_cache_save(const u8 *spd, size_t size) {}
+#endif
+
 #endif
@@ -36,18 +36,54 @@ struct spi_slave {
 	const struct spi_ctrlr *ctrlr;
 };
 
+/*-----------------------------------------------------------------------
+ * Multi-I/O read modes, named after the number of data lines used for the
+ * opcode, address and data phases respectively.
+ */
+#define SPI_READ_MODE_1_1_2	(1 << 0)
+#define SPI_READ_MODE_1_2_2	(1 << 1)
+#define SPI_READ_MODE_1_1_4	(1 << 2)
+#define SPI_READ_MODE_1_4_4	(1 << 3)
+
+/*-----------------------------------------------------------------------
+ * Description of a multi-I/O read. The opcode is always sent on a single
+ * line followed by a 24-bit address.
+ *
+ * opcode:	Read command.
+ * addr:	Address to read from.
+ * addr_lines:	Number of lines used for the address phase.
+ * dummy_cycles: Clock cycles between address and data. Includes the mode
+ *		bit cycles, which the controller drives low.
+ * data_lines:	Number of lines used for the data phase.
+ */
+struct spi_read_op {
+	uint8_t opcode;
+	uint32_t addr;
+	uint8_t addr_lines;
+	uint8_t dummy_cycles;
+	uint8_t data_lines;
+};
+
 /*-----------------------------------------------------------------------
  * Representation of a SPI contoller.
  *
  * claim_bus:	Claim SPI bus and prepare for communication.
  * release_bus: Release SPI bus.
  * xfer:	SPI transfer
+ * read_modes:	SPI_READ_MODE_* flags the controller can perform with
+ *		xfer_read.
+ * xfer_read:	Multi-I/O read. The controller is responsible for splitting
+ *		the transfer if it can't handle bytesin in one go.
  */
 struct spi_ctrlr {
 	int (*claim_bus)(const struct spi_slave *slave);
 	void (*release_bus)(const struct spi_slave *slave);
 	int (*xfer)(const struct spi_slave *slave, const void *dout,
 		    size_t bytesout, void *din, size_t bytesin);
+	unsigned int read_modes;
+	int (*xfer_read)(const struct spi_slave *slave,
+			 const struct spi_read_op *op, void *din,
+			 size_t bytesin);
 };
 
 /*-----------------------------------------------------------------------
@@ -115,6 +151,28 @@ void spi_release_bus(const struct spi_slave *slave);
 int spi_xfer(const struct spi_slave *slave, const void *dout, size_t bytesout,
 	     void *din, size_t bytesin);
 
+/*-----------------------------------------------------------------------
+ * Multi-I/O read modes supported by the controller of a slave.
+ *
+ *   slave:	The SPI slave
+ *
+ *   Returns: SPI_READ_MODE_* flags, 0 if only single line reads work.
+ */
+unsigned int spi_ctrlr_read_modes(const struct spi_slave *slave);
+
+/*-----------------------------------------------------------------------
+ * Multi-I/O read
+ *
+ *   slave:	The SPI slave to read from. The bus must be claimed.
+ *   op:	Opcode, address and line configuration of the read.
+ *   din:	Pointer to a string of bytes that will be filled in.
+ *   bytesin:	How many bytes to read.
+ *
+ *   Returns: 0 on success, not 0 on failure
+ */
+int spi_xfer_read(const struct spi_slave *slave, const struct spi_read_op *op,
+		  void *din, size_t bytesin);
+
 unsigned int spi_crop_chunk(unsigned int cmd_len, unsigned int buf_len);
 
 /*-----------------------------------------------------------------------
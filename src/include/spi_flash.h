@@ -30,6 +30,10 @@ struct spi_flash {
 	u32 sector_size;
 	u8 erase_cmd;
 	u8 status_cmd;
+	/* Multi-I/O read negotiated at probe time, if any. */
+	u8 read_cmd;
+	u8 read_mode;
+	u8 read_dummy_cycles;
 	/*
 	 * Internal functions are expected to be called ONLY by spi flash
 	 * driver. External components should only use the public API calls
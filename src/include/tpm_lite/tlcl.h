@@ -151,4 +151,11 @@ uint32_t tlcl_extend(int pcr_num, const uint8_t *in_digest,
  */
 uint32_t tlcl_get_permanent_flags(TPM_PERMANENT_FLAGS *pflags);
 
+/**
+ * Drop all NV contents cached by tlcl_read(), so that the next read of every
+ * space goes out to the TPM.  Use this before retrying a read whose data did
+ * not check out.
+ */
+void tlcl_cache_flush(void);
+
 #endif  /* TPM_LITE_TLCL_H_ */
@@ -16,6 +16,7 @@
 #ifndef __TRACE_H
 #define __TRACE_H
 
+#include <stdint.h>
 
 #ifdef __PRE_RAM__
 
@@ -35,6 +36,10 @@ void __cyg_profile_func_exit( void *, void * )
 
 extern volatile int trace_dis;
 
+/* Only record functions in [start, end). An end of 0 means no limit. */
+void trace_set_filter(uintptr_t start, uintptr_t end)
+				__attribute__ ((no_instrument_function));
+
 #define DISABLE_TRACE  do { trace_dis = 1; } while (0);
 #define ENABLE_TRACE    do { trace_dis = 0; } while (0);
 #define DISABLE_TRACE_ON_FUNCTION  __attribute__ ((no_instrument_function));
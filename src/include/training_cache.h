@@ -0,0 +1,94 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _TRAINING_CACHE_H_
+#define _TRAINING_CACHE_H_
+
+#include <commonlib/region.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Memory training data saved in a flash region, shared by the raminit
+ * paths that want to skip training on the next boot. The region holds an
+ * index of the saved entries followed by their data; the newest complete
+ * entry is the current one.
+ */
+
+/* Entry flags */
+#define TRAINING_CACHE_LZ4	(1 << 0)	/* data is stored as an LZ4 frame */
+
+struct training_cache_entry {
+	int slot;		/* position in the index */
+	size_t offset;		/* of the stored data in the region */
+	size_t stored_size;	/* bytes in the region */
+	size_t size;		/* bytes of data */
+	uint32_t version;	/* chosen by the caller */
+	uint32_t hash;		/* training_cache_hash() of the data */
+	uint32_t flags;
+};
+
+enum training_cache_result {
+	TRAINING_CACHE_WRITE_FAILURE	= -1,
+	TRAINING_CACHE_ERASE_FAILURE	= -2,
+	TRAINING_CACHE_OTHER_FAILURE	= -3,
+	TRAINING_CACHE_UPDATED		= 0,
+	TRAINING_CACHE_UP_TO_DATE	= 1,
+};
+
+/*
+ * Locate a training cache region, either the FMAP area fmap_name or the
+ * CBFS file cbfs_name of type mrc_cache, in that order. Either name may be
+ * NULL. Returns 0 on success, < 0 on error.
+ */
+int training_cache_locate(const char *fmap_name, const char *cbfs_name,
+			  struct region_device *rdev);
+int training_cache_locate_rw(const char *fmap_name, const char *cbfs_name,
+			     struct region_device *rdev);
+
+/*
+ * Find the newest entry whose stored data is intact. Returns 0 on success,
+ * < 0 if the region holds no such entry.
+ */
+int training_cache_find(const struct region_device *rdev,
+			struct training_cache_entry *entry);
+
+/*
+ * Map the data of an uncompressed entry. The mapping is never released,
+ * so that it can be handed to code that runs before RAM is up. Returns
+ * NULL for compressed entries or on error.
+ */
+void *training_cache_map(const struct region_device *rdev,
+			 const struct training_cache_entry *entry);
+
+/*
+ * Copy the data of an entry, decompressing it if needed, into buf.
+ * Returns the size of the data or < 0 on error.
+ */
+ssize_t training_cache_load(const struct region_device *rdev,
+			    const struct training_cache_entry *entry,
+			    void *buf, size_t size);
+
+/*
+ * Append data as the new current entry, unless the current entry already
+ * holds the same data and version. The region is only erased once its
+ * index or data area is full.
+ */
+enum training_cache_result training_cache_update(
+	const struct region_device *rdev, uint32_t version,
+	const void *data, size_t size, uint32_t flags);
+
+/* Hash used to check entries, xxHash32 with a seed of 0. */
+uint32_t training_cache_hash(const void *data, size_t size);
+
+#endif /* _TRAINING_CACHE_H_ */
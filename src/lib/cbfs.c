@@ -109,16 +109,30 @@ size_t cbfs_load_and_decompress(const struct region_device *rdev, size_t offset,
 		if ((ENV_ROMSTAGE || ENV_POSTCAR)
 			&& !IS_ENABLED(CONFIG_COMPRESS_RAMSTAGE))
 			return 0;
-		void *map = rdev_mmap(rdev, offset, in_size);
-		if (map == NULL)
-			return 0;
 
-		/* Note: timestamp not useful for memory-mapped media (x86) */
+		/* Like LZ4, decompress in-place from the end of the buffer as
+		 * far as there is room, which keeps the decoder's input out of
+		 * slow memory-mapped flash (x86). The timestamps include the
+		 * reading of the compressed data. */
 		timestamp_add_now(TS_START_ULZMA);
-		out_size = ulzman(map, in_size, buffer, buffer_size);
+		out_size = ulzman_rdev(rdev, offset, in_size, buffer,
+				       buffer_size);
 		timestamp_add_now(TS_END_ULZMA);
 
-		rdev_munmap(rdev, map);
+		return out_size;
+
+	case CBFS_COMPRESS_ZSTD:
+		if (ENV_BOOTBLOCK || ENV_VERSTAGE)
+			return 0;
+		/* Only built when cbfstool may compress with Zstandard. */
+		if (!IS_ENABLED(CONFIG_DECOMPRESS_ZSTD))
+			return 0;
+
+		/* Decompressed in-place the same way as LZMA. */
+		timestamp_add_now(TS_START_UZSTD);
+		out_size = uzstdn_rdev(rdev, offset, in_size, buffer,
+				       buffer_size);
+		timestamp_add_now(TS_END_UZSTD);
 
 		return out_size;
 
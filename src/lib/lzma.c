@@ -1,57 +1,154 @@
 /*
- * coreboot interface to memory-saving variant of LZMA decoder
+ * coreboot interface to the LZMA decoder in commonlib
  *
  * Copyright (C) 2006 Carl-Daniel Hailfinger
  * Released under the GNU GPL v2 or later
- *
- * Parts of this file are based on C/7zip/Compress/LZMA_C/LzmaTest.c from the LZMA
- * SDK 4.42, which is written and distributed to public domain by Igor Pavlov.
- *
  */
 
+#include <commonlib/lzma_decoder.h>
+#include <commonlib/region.h>
 #include <console/console.h>
-#include <string.h>
 #include <lib.h>
-#include <timestamp.h>
+#include <stdint.h>
 
-#include "lzmadecode.h"
+#define LZMA_PROBS_COUNT \
+	(LZMA_PROBS_SIZE(CONFIG_LZMA_MAX_LC_LP) / sizeof(uint16_t))
 
-size_t ulzman(const void *src, size_t srcn, void *dst, size_t dstn)
+/* Reads the header and prepares decoding into dst. Returns the output
+ * size, or 0 on error, including a known size that does not fit dstn. */
+static size_t lzma_start(struct lzma_decoder *d, uint16_t *probs,
+			 const void *header, void *dst, size_t dstn)
 {
-	unsigned char properties[LZMA_PROPERTIES_SIZE];
-	const int data_offset = LZMA_PROPERTIES_SIZE + 8;
-	UInt32 outSize;
-	SizeT inProcessed;
-	SizeT outProcessed;
-	int res;
-	CLzmaDecoderState state;
-	SizeT mallocneeds;
-	MAYBE_STATIC unsigned char scratchpad[15980];
-	const unsigned char *cp;
-
-	memcpy(properties, src, LZMA_PROPERTIES_SIZE);
-	/* The outSize in LZMA stream is a 64bit integer stored in little-endian
-	 * (ref: lzma.cc@LZMACompress: put_64). To prevent accessing by
-	 * unaligned memory address and to load in correct endianness, read each
-	 * byte and re-construct. */
-	cp = src + LZMA_PROPERTIES_SIZE;
-	outSize = cp[3] << 24 | cp[2] << 16 | cp[1] << 8 | cp[0];
-	if (LzmaDecodeProperties(&state.Properties, properties,
-				 LZMA_PROPERTIES_SIZE) != LZMA_RESULT_OK) {
+	if (lzma_decoder_header(d, header)) {
 		printk(BIOS_WARNING, "lzma: Incorrect stream properties.\n");
 		return 0;
 	}
-	mallocneeds = (LzmaGetNumProbs(&state.Properties) * sizeof(CProb));
-	if (mallocneeds > 15980) {
-		printk(BIOS_WARNING, "lzma: Decoder scratchpad too small!\n");
+	if (lzma_decoder_probs_size(d) > LZMA_PROBS_COUNT * sizeof(*probs)) {
+		printk(BIOS_WARNING, "lzma: Decoder scratchpad too small for "
+		       "lc + lp = %u!\n", d->lc + d->lp);
+		return 0;
+	}
+
+	if (d->out_size != LZMA_SIZE_UNKNOWN && d->out_size > dstn) {
+		printk(BIOS_WARNING, "lzma: Output of %llu bytes does not fit "
+		       "in %zu.\n", (unsigned long long)d->out_size, dstn);
+		return 0;
+	}
+
+	lzma_decoder_init(d, probs, dst, dstn);
+	return MIN(d->out_size, dstn);
+}
+
+static size_t decompress(uint16_t *probs, const void *src, size_t srcn,
+			 void *dst, size_t dstn)
+{
+	struct lzma_decoder d;
+	size_t out_size;
+
+	if (srcn < LZMA_HEADER_SIZE)
+		return 0;
+	out_size = lzma_start(&d, probs, src, dst, dstn);
+	if (!out_size)
+		return 0;
+
+	d.in = (const uint8_t *)src + LZMA_HEADER_SIZE;
+	d.in_size = srcn - LZMA_HEADER_SIZE;
+	if (lzma_decode(&d, out_size, 1) == LZMA_ERROR) {
+		printk(BIOS_WARNING, "lzma: Decoding error at byte %zu\n",
+		       d.total);
+		return 0;
+	}
+	return d.pos;
+}
+
+static size_t decompress_in_place(uint16_t *probs,
+				  const struct region_device *rdev,
+				  size_t offset, size_t srcn, void *dst,
+				  size_t dstn)
+{
+	const uint8_t *src = (uint8_t *)dst + dstn - srcn;
+	struct lzma_decoder d;
+	enum lzma_status status;
+	size_t out_size, used;
+
+	if (srcn < LZMA_HEADER_SIZE || srcn > dstn)
+		return 0;
+	out_size = lzma_start(&d, probs, src, dst, dstn);
+	if (!out_size)
 		return 0;
+
+	d.in = src + LZMA_HEADER_SIZE;
+	d.in_size = srcn - LZMA_HEADER_SIZE;
+	status = lzma_decode_in_place(&d, out_size);
+	used = d.in - src;
+
+	/* Decode what is left straight from the boot device. */
+	if (status == LZMA_OK && d.pos < out_size) {
+		void *map;
+
+		printk(BIOS_DEBUG, "lzma: Not enough room to decode in place "
+		       "after byte %zu\n", d.pos);
+		map = rdev_mmap(rdev, offset + used, srcn - used);
+		if (map == NULL)
+			return 0;
+		d.in = map;
+		d.in_size = srcn - used;
+		status = lzma_decode(&d, out_size, 1);
+		rdev_munmap(rdev, map);
 	}
-	state.Probs = (CProb *)scratchpad;
-	res = LzmaDecode(&state, src + data_offset, srcn - data_offset,
-			 &inProcessed, dst, outSize, &outProcessed);
-	if (res != 0) {
-		printk(BIOS_WARNING, "lzma: Decoding error = %d\n", res);
+
+	if (status == LZMA_ERROR) {
+		printk(BIOS_WARNING, "lzma: Decoding error at byte %zu\n",
+		       d.total);
 		return 0;
 	}
-	return outProcessed;
+	return d.pos;
+}
+
+/* All entry points share one scratchpad: decodes src if it is not NULL,
+ * otherwise the srcn bytes at offset in rdev that were read to the end of
+ * dst. */
+static size_t lzma_run(const struct region_device *rdev, size_t offset,
+		       const void *src, size_t srcn, void *dst, size_t dstn)
+{
+	MAYBE_STATIC uint16_t probs[LZMA_PROBS_COUNT];
+
+	if (src != NULL)
+		return decompress(probs, src, srcn, dst, dstn);
+	return decompress_in_place(probs, rdev, offset, srcn, dst, dstn);
+}
+
+size_t ulzman(const void *src, size_t srcn, void *dst, size_t dstn)
+{
+	return lzma_run(NULL, 0, src, srcn, dst, dstn);
+}
+
+size_t ulzman_in_place(const struct region_device *rdev, size_t offset,
+		       size_t srcn, void *dst, size_t dstn)
+{
+	return lzma_run(rdev, offset, NULL, srcn, dst, dstn);
+}
+
+size_t ulzman_rdev(const struct region_device *rdev, size_t offset,
+		   size_t srcn, void *dst, size_t dstn)
+{
+	size_t out_size;
+	void *map;
+
+	if (srcn <= dstn) {
+		/* One bulk read to the end of dst, instead of having the
+		 * decoder read the boot device a byte at a time. */
+		uint8_t *src = (uint8_t *)dst + dstn - srcn;
+
+		if (rdev_readat(rdev, src, offset, srcn) != srcn)
+			return 0;
+		return ulzman_in_place(rdev, offset, srcn, dst, dstn);
+	}
+
+	map = rdev_mmap(rdev, offset, srcn);
+	if (map == NULL)
+		return 0;
+	out_size = ulzman(map, srcn, dst, dstn);
+	rdev_munmap(rdev, map);
+	return out_size;
 }
@@ -130,3 +130,8 @@ uint32_t tlcl_extend(int pcr_num, const uint8_t* in_digest,
 	VBDEBUG("MOCK_TPM: %s\n", __func__);
 	return TPM_E_NO_DEVICE;
 }
+
+void tlcl_cache_flush(void)
+{
+	VBDEBUG("MOCK_TPM: %s\n", __func__);
+}
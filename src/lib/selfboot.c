@@ -42,6 +42,11 @@ struct segment {
 	int compression;
 };
 
+/* The payload is not mapped as a whole. Each segment is read straight to its
+ * destination with one bulk read, compressed ones to the end of it, and
+ * decompressed in place from there. s_srcaddr is the offset of the segment
+ * data in the payload. */
+
 static void segment_insert_before(struct segment *seg, struct segment *new)
 {
 	new->next = seg;
@@ -237,22 +242,26 @@ static void cbfs_decode_payload_segment(struct cbfs_payload_segment *segment,
 
 static int build_self_segment_list(
 	struct segment *head,
-	struct cbfs_payload *cbfs_payload, uintptr_t *entry)
+	const struct region_device *rdev, uintptr_t *entry)
 {
 	struct segment *new;
-	struct cbfs_payload_segment *current_segment, *first_segment, segment;
+	struct cbfs_payload_segment current_segment, segment;
+	size_t offset;
 
 	memset(head, 0, sizeof(*head));
 	head->next = head->prev = head;
 
-	first_segment = &cbfs_payload->segments;
-
-	for (current_segment = first_segment;; ++current_segment) {
+	for (offset = 0;; offset += sizeof(current_segment)) {
 		printk(BIOS_DEBUG,
-			"Loading segment from ROM address 0x%p\n",
-			current_segment);
+			"Loading segment from payload offset 0x%zx\n",
+			offset);
 
-		cbfs_decode_payload_segment(&segment, current_segment);
+		if (rdev_readat(rdev, &current_segment, offset,
+				sizeof(current_segment)) != sizeof(current_segment)) {
+			printk(BIOS_EMERG, "Payload segment list truncated\n");
+			return -1;
+		}
+		cbfs_decode_payload_segment(&segment, &current_segment);
 
 		switch (segment.type) {
 		case PAYLOAD_SEGMENT_PARAMS:
@@ -269,20 +278,20 @@ static int build_self_segment_list(
 			new->s_dstaddr = segment.load_addr;
 			new->s_memsz = segment.mem_len;
 			new->compression = segment.compression;
-			new->s_srcaddr = (uintptr_t)
-				((unsigned char *)first_segment)
-				+ segment.offset;
+			new->s_srcaddr = segment.offset;
 			new->s_filesz = segment.len;
 
 			printk(BIOS_DEBUG, "  New segment dstaddr 0x%lx memsize 0x%lx srcaddr 0x%lx filesize 0x%lx\n",
 				new->s_dstaddr, new->s_memsz, new->s_srcaddr, new->s_filesz);
 
-			/* Clean up the values */
+			/* The data is read to the end of the destination, so
+			 * it must fit. Cutting it short would truncate a
+			 * compressed stream. */
 			if (new->s_filesz > new->s_memsz)  {
-				new->s_filesz = new->s_memsz;
-				printk(BIOS_DEBUG,
-					"  cleaned up filesize 0x%lx\n",
-					new->s_filesz);
+				printk(BIOS_EMERG,
+					"Segment data larger than memory size\n");
+				free(new);
+				return -1;
 			}
 			break;
 
@@ -292,9 +301,7 @@ static int build_self_segment_list(
 
 			new = malloc(sizeof(*new));
 			new->s_filesz = 0;
-			new->s_srcaddr = (uintptr_t)
-				((unsigned char *)first_segment)
-				+ segment.offset;
+			new->s_srcaddr = segment.offset;
 			new->s_dstaddr = segment.load_addr;
 			new->s_memsz = segment.mem_len;
 			new->compression = CBFS_COMPRESS_NONE;
@@ -358,11 +365,83 @@ static int payload_targets_usable_ram(struct segment *head)
 	return 1;
 }
 
-static int load_self_segments(struct segment *head, struct prog *payload,
+/* Where the data of seg is read to, or NULL if it is decompressed from the
+ * boot device. Uncompressed data goes right to the destination, LZMA and
+ * Zstandard data to the end of it. cbfstool does not check that payload
+ * segments leave LZ4 the margin it needs to decompress in place, so LZ4
+ * data is never read ahead. */
+static void *segment_read_addr(const struct segment *seg)
+{
+	switch (seg->compression) {
+	case CBFS_COMPRESS_NONE:
+		return (void *)seg->s_dstaddr;
+	case CBFS_COMPRESS_LZ4:
+		return NULL;
+	default:
+		return (void *)(seg->s_dstaddr + seg->s_memsz - seg->s_filesz);
+	}
+}
+
+/* Decompress the data of seg that was read to the end of its destination.
+ * Returns the decompressed size or -1 on error. */
+static ssize_t segment_decompress(const struct region_device *rdev,
+				  const struct segment *seg)
+{
+	void *dest = (void *)seg->s_dstaddr;
+	size_t len = seg->s_filesz;
+	size_t memsz = seg->s_memsz;
+
+	switch (seg->compression) {
+	case CBFS_COMPRESS_LZMA:
+		printk(BIOS_DEBUG, "using LZMA\n");
+		timestamp_add_now(TS_START_ULZMA);
+		len = ulzman_in_place(rdev, seg->s_srcaddr, len, dest, memsz);
+		timestamp_add_now(TS_END_ULZMA);
+		break;
+	case CBFS_COMPRESS_ZSTD:
+		if (!IS_ENABLED(CONFIG_DECOMPRESS_ZSTD)) {
+			printk(BIOS_ERR, "Zstandard support is not built in\n");
+			return -1;
+		}
+		printk(BIOS_DEBUG, "using Zstandard\n");
+		timestamp_add_now(TS_START_UZSTD);
+		len = uzstdn_in_place(rdev, seg->s_srcaddr, len, dest, memsz);
+		timestamp_add_now(TS_END_UZSTD);
+		break;
+	case CBFS_COMPRESS_LZ4: {
+		void *map;
+
+		printk(BIOS_DEBUG, "using LZ4\n");
+		timestamp_add_now(TS_START_ULZ4F);
+		map = rdev_mmap(rdev, seg->s_srcaddr, len);
+		if (map == NULL)
+			return -1;
+		len = ulz4fn(map, len, dest, memsz);
+		rdev_munmap(rdev, map);
+		timestamp_add_now(TS_END_ULZ4F);
+		break;
+	}
+	case CBFS_COMPRESS_NONE:
+		printk(BIOS_DEBUG, "it's not compressed!\n");
+		return len;
+	default:
+		printk(BIOS_INFO,  "CBFS:  Unknown compression type %d\n",
+		       seg->compression);
+		return -1;
+	}
+
+	if (!len) /* Decompression Error. */
+		return -1;
+	return len;
+}
+
+static int load_self_segments(struct segment *head,
+			      const struct region_device *rdev,
 			      bool check_regions)
 {
 	struct segment *ptr;
 	unsigned long bounce_high = lb_end;
+	int bounce = 0;
 
 	if (check_regions) {
 		if (!payload_targets_usable_ram(head))
@@ -382,18 +461,27 @@ static int load_self_segments(struct segment *head, struct prog *payload,
 
 		if (!overlaps_coreboot(ptr))
 			continue;
+		bounce = 1;
 		if (ptr->s_dstaddr + ptr->s_memsz > bounce_high)
 			bounce_high = ptr->s_dstaddr + ptr->s_memsz;
 	}
-	get_bounce_buffer(bounce_high - lb_start);
-	if (!bounce_buffer) {
-		printk(BIOS_ERR, "Could not find a bounce buffer...\n");
-		return 0;
+
+	/* Without a segment on top of coreboot there is nothing to bounce,
+	 * and coreboot need not be copied around when the payload starts. */
+	if (!bounce) {
+		bounce_buffer = ~0UL;
+		bounce_size = 0;
+	} else {
+		get_bounce_buffer(bounce_high - lb_start);
+		if (!bounce_buffer) {
+			printk(BIOS_ERR, "Could not find a bounce buffer...\n");
+			return 0;
+		}
 	}
 
 	for(ptr = head->next; ptr != head; ptr = ptr->next) {
-		unsigned char *dest, *src, *middle, *end;
-		size_t len, memsz;
+		unsigned char *dest, *middle, *end;
+		ssize_t len;
 		printk(BIOS_DEBUG, "Loading Segment: addr: 0x%016lx memsz: 0x%016lx filesz: 0x%016lx\n",
 			ptr->s_dstaddr, ptr->s_memsz, ptr->s_filesz);
 
@@ -409,47 +497,29 @@ static int load_self_segments(struct segment *head, struct prog *payload,
 
 		/* Compute the boundaries of the segment */
 		dest = (unsigned char *)(ptr->s_dstaddr);
-		src = (unsigned char *)(ptr->s_srcaddr);
-		len = ptr->s_filesz;
-		memsz = ptr->s_memsz;
-		end = dest + memsz;
-
-		/* Copy data from the initial buffer */
-		switch(ptr->compression) {
-			case CBFS_COMPRESS_LZMA: {
-				printk(BIOS_DEBUG, "using LZMA\n");
-				timestamp_add_now(TS_START_ULZMA);
-				len = ulzman(src, len, dest, memsz);
-				timestamp_add_now(TS_END_ULZMA);
-				if (!len) /* Decompression Error. */
-					return 0;
-				break;
-			}
-			case CBFS_COMPRESS_LZ4: {
-				printk(BIOS_DEBUG, "using LZ4\n");
-				timestamp_add_now(TS_START_ULZ4F);
-				len = ulz4fn(src, len, dest, memsz);
-				timestamp_add_now(TS_END_ULZ4F);
-				if (!len) /* Decompression Error. */
-					return 0;
-				break;
-			}
-			case CBFS_COMPRESS_NONE: {
-				printk(BIOS_DEBUG, "it's not compressed!\n");
-				memcpy(dest, src, len);
-				break;
-			}
-			default:
-				printk(BIOS_INFO,  "CBFS:  Unknown compression type %d\n", ptr->compression);
-				return -1;
+		end = dest + ptr->s_memsz;
+
+		/* Read the data from the boot device */
+		if (ptr->s_filesz && segment_read_addr(ptr) &&
+		    rdev_readat(rdev, segment_read_addr(ptr),
+				ptr->s_srcaddr, ptr->s_filesz) != ptr->s_filesz) {
+			printk(BIOS_ERR, "Could not read segment data at "
+			       "offset 0x%lx\n", ptr->s_srcaddr);
+			return 0;
 		}
+		timestamp_add_now(TS_PAYLOAD_SEGMENT_READ);
+
+		len = segment_decompress(rdev, ptr);
+		if (len < 0)
+			return 0;
+
 		/* Calculate middle after any changes to len. */
 		middle = dest + len;
 		printk(BIOS_SPEW, "[ 0x%08lx, %08lx, 0x%08lx) <- %08lx\n",
 			(unsigned long)dest,
 			(unsigned long)middle,
 			(unsigned long)end,
-			(unsigned long)src);
+			ptr->s_srcaddr);
 
 		/* Zero the extra bytes between middle & end */
 		if (middle < end) {
@@ -485,6 +555,7 @@ static int load_self_segments(struct segment *head, struct prog *payload,
 		 */
 		prog_segment_loaded((uintptr_t)dest, ptr->s_memsz,
 				ptr->next == head ? SEG_FINAL : 0);
+		timestamp_add_now(TS_PAYLOAD_SEGMENT_LOADED);
 	}
 
 	return 1;
@@ -494,31 +565,19 @@ void *selfload(struct prog *payload, bool check_regions)
 {
 	uintptr_t entry = 0;
 	struct segment head;
-	void *data;
-
-	data = rdev_mmap_full(prog_rdev(payload));
-
-	if (data == NULL)
-		return NULL;
 
 	/* Preprocess the self segments */
-	if (!build_self_segment_list(&head, data, &entry))
-		goto out;
+	if (build_self_segment_list(&head, prog_rdev(payload), &entry) <= 0)
+		return NULL;
 
 	/* Load the segments */
-	if (!load_self_segments(&head, payload, check_regions))
-		goto out;
+	if (!load_self_segments(&head, prog_rdev(payload), check_regions))
+		return NULL;
 
 	printk(BIOS_SPEW, "Loaded segments\n");
 
-	rdev_munmap(prog_rdev(payload), data);
-
 	/* Update the payload's area with the bounce buffer information. */
 	prog_set_area(payload, (void *)(uintptr_t)bounce_buffer, bounce_size);
 
 	return (void *)entry;
-
-out:
-	rdev_munmap(prog_rdev(payload), data);
-	return NULL;
 }
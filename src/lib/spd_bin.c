@@ -123,9 +123,33 @@ int get_spd_cbfs_rdev(struct region_device *spd_rdev, u8 spd_index)
 							CONFIG_DIMM_SPD_SIZE);
 }
 
+int __attribute__((weak)) smbus_i2c_block_read(u32 smbus_dev, u8 addr,
+						u8 offset, u8 *buf, size_t len)
+{
+	return -1;
+}
+
+/* Use a block read if the controller can, one transaction per byte if not. */
+static void spd_read(u8 addr, u8 offset, u8 *buf, size_t len)
+{
+	size_t i;
+
+	if (smbus_i2c_block_read(0, addr, offset, buf, len) == (int)len)
+		return;
+
+	for (i = 0; i < len; i++)
+		buf[i] = smbus_read_byte(0, addr, offset + i);
+}
+
+/* DDR4 modules have a 512 byte SPD, only half of it is visible at a time. */
+static int spd_is_ddr4(const u8 *spd)
+{
+	return spd[SPD_DRAM_TYPE] == SPD_DRAM_DDR4 &&
+		CONFIG_DIMM_SPD_SIZE >= SPD_PAGE_LEN_DDR4;
+}
+
 static void get_spd(u8 *spd, u8 addr)
 {
-	u16 i;
 	/* Assuming addr is 8 bit address, make it 7 bit */
 	addr = addr >> 1;
 	if (smbus_read_byte(0, addr, 0)  == 0xff) {
@@ -136,33 +160,73 @@ static void get_spd(u8 *spd, u8 addr)
 		return;
 	}
 
-	for (i = 0; i < SPD_PAGE_LEN; i++)
-		spd[i] = smbus_read_byte(0, addr, i);
-	/* Check if module is DDR4, DDR4 spd is 512 byte. */
-	if (spd[SPD_DRAM_TYPE] == SPD_DRAM_DDR4 &&
-		CONFIG_DIMM_SPD_SIZE >= SPD_DRAM_DDR4) {
+	spd_read(addr, 0, spd, SPD_PAGE_LEN);
+	if (spd_is_ddr4(spd)) {
 		/* Switch to page 1 */
 		smbus_write_byte(0, SPD_PAGE_1, 0, 0);
-		for (i = 0; i < SPD_PAGE_LEN; i++)
-			spd[i+SPD_PAGE_LEN] = smbus_read_byte(0, addr, i);
+		spd_read(addr, 0, spd + SPD_PAGE_LEN, SPD_PAGE_LEN);
 		/* Restore to page 0 */
 		smbus_write_byte(0, SPD_PAGE_0, 0, 0);
 	}
 }
 
+/*
+ * Check that the dimm at addr is the one a cached spd was read from. Only
+ * the serial number and the CRC are read back; the CRC covers everything
+ * raminit looks at.
+ */
+static int spd_cache_matches(const u8 *spd, u8 addr)
+{
+	u8 id[DDR3_SPD_ID_LEN];
+	int match;
+
+	addr = addr >> 1;
+	if (smbus_read_byte(0, addr, 0) == 0xff)
+		return spd[SPD_DRAM_TYPE] == 0;
+	if (spd[SPD_DRAM_TYPE] == 0)
+		return 0;
+
+	if (!spd_is_ddr4(spd)) {
+		spd_read(addr, DDR3_SPD_ID_OFF, id, DDR3_SPD_ID_LEN);
+		return !memcmp(id, &spd[DDR3_SPD_ID_OFF], DDR3_SPD_ID_LEN);
+	}
+
+	spd_read(addr, DDR4_SPD_CRC_OFF, id, DDR4_SPD_CRC_LEN);
+	if (memcmp(id, &spd[DDR4_SPD_CRC_OFF], DDR4_SPD_CRC_LEN))
+		return 0;
+
+	smbus_write_byte(0, SPD_PAGE_1, 0, 0);
+	spd_read(addr, DDR4_SPD_ID_OFF - SPD_PAGE_LEN, id, DDR4_SPD_ID_LEN);
+	smbus_write_byte(0, SPD_PAGE_0, 0, 0);
+	match = !memcmp(id, &spd[DDR4_SPD_ID_OFF], DDR4_SPD_ID_LEN);
+	return match;
+}
+
 void get_spd_smbus(struct spd_block *blk)
 {
 	u8 i, j;
 	unsigned char *spd_data_ptr = car_get_var_ptr(&spd_data);
+	int cached = !spd_cache_load(spd_data_ptr, sizeof(spd_data));
+	int dirty = 0;
 
 	for (i = 0 ; i < CONFIG_DIMM_MAX; i++) {
-		get_spd(spd_data_ptr + i * CONFIG_DIMM_SPD_SIZE,
-			0xA0 + (i << 1));
-		blk->spd_array[i] = spd_data_ptr + i * CONFIG_DIMM_SPD_SIZE;
+		u8 *spd = spd_data_ptr + i * CONFIG_DIMM_SPD_SIZE;
+		const u8 addr = 0xA0 + (i << 1);
+
+		if (cached && spd_cache_matches(spd, addr)) {
+			printk(BIOS_DEBUG, "SPD @ 0x%02X: cached\n", addr);
+		} else {
+			get_spd(spd, addr);
+			dirty = 1;
+		}
+		blk->spd_array[i] = spd;
 	}
 
 	for (j = i; j < CONFIG_DIMM_MAX; j++)
 		blk->spd_array[j] = NULL;
 
+	if (dirty)
+		spd_cache_save(spd_data_ptr, sizeof(spd_data));
+
 	update_spd_len(blk);
 }
@@ -0,0 +1,97 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Copy of the SPDs of all DIMM slots in the FMAP region RW_SPD_CACHE. The
+ * cache only says what was in the slots on an earlier boot; get_spd_smbus()
+ * checks each slot against the DIMM that is there now before using it.
+ */
+
+#include <console/console.h>
+#include <fmap.h>
+#include <ip_checksum.h>
+#include <spd_bin.h>
+
+#define SPD_CACHE_REGION	"RW_SPD_CACHE"
+#define SPD_CACHE_SIGNATURE	0x43445053	/* 'SPDC' */
+#define SPD_CACHE_VERSION	1
+
+struct spd_cache_header {
+	uint32_t signature;
+	uint16_t version;
+	uint16_t checksum;	/* of the SPD data */
+	uint16_t num_slots;
+	uint16_t slot_size;
+} __attribute__((packed));
+
+int spd_cache_load(u8 *spd, size_t size)
+{
+	struct region_device rdev;
+	struct spd_cache_header h;
+
+	if (fmap_locate_area_as_rdev(SPD_CACHE_REGION, &rdev) < 0) {
+		printk(BIOS_ERR, "SPD cache: %s not found\n", SPD_CACHE_REGION);
+		return -1;
+	}
+
+	if (rdev_readat(&rdev, &h, 0, sizeof(h)) != sizeof(h) ||
+	    h.signature != SPD_CACHE_SIGNATURE ||
+	    h.version != SPD_CACHE_VERSION ||
+	    h.num_slots != CONFIG_DIMM_MAX ||
+	    h.slot_size != CONFIG_DIMM_SPD_SIZE) {
+		printk(BIOS_DEBUG, "SPD cache: empty\n");
+		return -1;
+	}
+
+	if (rdev_readat(&rdev, spd, sizeof(h), size) != size ||
+	    compute_ip_checksum(spd, size) != h.checksum) {
+		printk(BIOS_ERR, "SPD cache: corrupted\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+void spd_cache_save(const u8 *spd, size_t size)
+{
+	struct region_device rdev;
+	struct spd_cache_header h = {
+		.signature = SPD_CACHE_SIGNATURE,
+		.version = SPD_CACHE_VERSION,
+		.num_slots = CONFIG_DIMM_MAX,
+		.slot_size = CONFIG_DIMM_SPD_SIZE,
+	};
+
+	if (fmap_locate_area_as_rdev_rw(SPD_CACHE_REGION, &rdev) < 0)
+		return;
+
+	if (sizeof(h) + size > region_device_sz(&rdev)) {
+		printk(BIOS_ERR, "SPD cache: %zu bytes don't fit in %s\n",
+		       sizeof(h) + size, SPD_CACHE_REGION);
+		return;
+	}
+
+	h.checksum = compute_ip_checksum((void *)spd, size);
+
+	/* The header goes last so an interrupted update is never used. */
+	if (rdev_eraseat(&rdev, 0, region_device_sz(&rdev)) !=
+	    region_device_sz(&rdev) ||
+	    rdev_writeat(&rdev, spd, sizeof(h), size) != size ||
+	    rdev_writeat(&rdev, &h, 0, sizeof(h)) != sizeof(h)) {
+		printk(BIOS_ERR, "SPD cache: update of %s failed\n",
+		       SPD_CACHE_REGION);
+		return;
+	}
+
+	printk(BIOS_INFO, "SPD cache: updated\n");
+}
@@ -25,7 +25,8 @@
 #include <rules.h>
 #include <smp/node.h>
 
-#define MAX_TIMESTAMPS 84
+/* TPM_COMMAND_TIMESTAMPS adds two entries for each TPM command. */
+#define MAX_TIMESTAMPS (IS_ENABLED(CONFIG_TPM_COMMAND_TIMESTAMPS) ? 212 : 84)
 
 /* When changing this number, adjust TIMESTAMP() size ASSERT() in memlayout.h */
 #define MAX_BSS_TIMESTAMP_CACHE 16
@@ -20,6 +20,7 @@
 #include <tpm_lite/tlcl.h>
 #include <tpm.h>
 #include <vb2_api.h>
+#include "tlcl_cache.h"
 #include "tlcl_internal.h"
 #include "tlcl_structures.h"
 
@@ -37,7 +38,12 @@ static int tpm_send_receive(const uint8_t *request,
 				uint32_t *response_length)
 {
 	size_t len = *response_length;
-	if (tis_sendrecv(request, request_length, response, &len))
+	int rv;
+
+	tlcl_cmd_start();
+	rv = tis_sendrecv(request, request_length, response, &len);
+	tlcl_cmd_end();
+	if (rv)
 		return VB2_ERROR_UNKNOWN;
 	/* check 64->32bit overflow and (re)check response buffer overflow */
 	if (len > *response_length)
@@ -159,11 +165,13 @@ uint32_t tlcl_lib_init(void) {
 
 uint32_t tlcl_startup(void) {
 	VBDEBUG("TPM: Startup\n");
+	tlcl_cache_flush();
 	return send(tpm_startup_cmd.buffer);
 }
 
 uint32_t tlcl_resume(void) {
   VBDEBUG("TPM: Resume\n");
+  tlcl_cache_flush();
   return send(tpm_resume_cmd.buffer);
 }
 
@@ -186,6 +194,8 @@ uint32_t tlcl_define_space(uint32_t index, uint32_t perm, uint32_t size)
 {
 	struct s_tpm_nv_definespace_cmd cmd;
 	VBDEBUG("TPM: TlclDefineSpace(0x%x, 0x%x, %d)\n", index, perm, size);
+	/* Defining TPM_NV_INDEX_LOCK changes who may read every space. */
+	tlcl_cache_flush();
 	memcpy(&cmd, &tpm_nv_definespace_cmd, sizeof(cmd));
 	to_tpm_uint32(cmd.buffer + tpm_nv_definespace_cmd.index, index);
 	to_tpm_uint32(cmd.buffer + tpm_nv_definespace_cmd.perm, perm);
@@ -201,6 +211,7 @@ uint32_t tlcl_write(uint32_t index, const void* data, uint32_t length)
 			kTpmRequestHeaderLength + kWriteInfoLength + length;
 
 	VBDEBUG("TPM: tlcl_write(0x%x, %d)\n", index, length);
+	tlcl_cache_invalidate(index);
 	memcpy(&cmd, &tpm_nv_write_cmd, sizeof(cmd));
 	assert(total_length <= TPM_LARGE_ENOUGH_COMMAND_SIZE);
 	set_tpm_command_size(cmd.buffer, total_length);
@@ -219,6 +230,11 @@ uint32_t tlcl_read(uint32_t index, void* data, uint32_t length)
 	uint32_t result_length;
 	uint32_t result;
 
+	if (!tlcl_cache_lookup(index, data, length)) {
+		VBDEBUG("TPM: tlcl_read(0x%x, %d) cached\n", index, length);
+		return TPM_SUCCESS;
+	}
+
 	VBDEBUG("TPM: tlcl_read(0x%x, %d)\n", index, length);
 	memcpy(&cmd, &tpm_nv_read_cmd, sizeof(cmd));
 	to_tpm_uint32(cmd.buffer + tpm_nv_read_cmd.index, index);
@@ -230,6 +246,8 @@ uint32_t tlcl_read(uint32_t index, void* data, uint32_t length)
 		from_tpm_uint32(nv_read_cursor, &result_length);
 		nv_read_cursor += sizeof(uint32_t);
 		memcpy(data, nv_read_cursor, result_length);
+		if (result_length == length)
+			tlcl_cache_update(index, data, length);
 	}
 
 	return result;
@@ -258,6 +276,7 @@ uint32_t tlcl_set_nv_locked(void) {
 
 uint32_t tlcl_force_clear(void) {
 	VBDEBUG("TPM: Force clear\n");
+	tlcl_cache_flush();
 	return send(tpm_forceclear_cmd.buffer);
 }
 
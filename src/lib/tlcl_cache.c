@@ -0,0 +1,93 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <arch/early_variables.h>
+#include <string.h>
+#include <tpm_lite/tlcl.h>
+
+#include "tlcl_cache.h"
+
+/*
+ * Large enough for the firmware, kernel and recovery hash spaces. Bigger
+ * reads are always sent to the TPM.
+ */
+#define TLCL_CACHE_ENTRIES	4
+#define TLCL_CACHE_DATA_SIZE	32
+
+struct tlcl_cache_entry {
+	uint32_t index;
+	uint32_t length;	/* 0 if the entry is unused */
+	uint8_t data[TLCL_CACHE_DATA_SIZE];
+};
+
+static struct tlcl_cache_entry tlcl_cache[TLCL_CACHE_ENTRIES] CAR_GLOBAL;
+
+static struct tlcl_cache_entry *cache_find(uint32_t index)
+{
+	struct tlcl_cache_entry *cache = car_get_var_ptr(tlcl_cache);
+	int i;
+
+	for (i = 0; i < TLCL_CACHE_ENTRIES; i++) {
+		if (cache[i].length && cache[i].index == index)
+			return &cache[i];
+	}
+	return NULL;
+}
+
+int tlcl_cache_lookup(uint32_t index, void *data, uint32_t length)
+{
+	struct tlcl_cache_entry *e = cache_find(index);
+
+	/* A shorter read returns the start of the space, as on the TPM. */
+	if (!e || length > e->length)
+		return -1;
+
+	memcpy(data, e->data, length);
+	return 0;
+}
+
+void tlcl_cache_update(uint32_t index, const void *data, uint32_t length)
+{
+	struct tlcl_cache_entry *cache = car_get_var_ptr(tlcl_cache);
+	struct tlcl_cache_entry *e;
+	int i;
+
+	if (length == 0 || length > TLCL_CACHE_DATA_SIZE)
+		return;
+
+	e = cache_find(index);
+	for (i = 0; !e && i < TLCL_CACHE_ENTRIES; i++) {
+		if (!cache[i].length)
+			e = &cache[i];
+	}
+	/* Full: vboot only uses a handful of spaces, so just recycle one. */
+	if (!e)
+		e = &cache[index % TLCL_CACHE_ENTRIES];
+
+	e->index = index;
+	e->length = length;
+	memcpy(e->data, data, length);
+}
+
+void tlcl_cache_invalidate(uint32_t index)
+{
+	struct tlcl_cache_entry *e = cache_find(index);
+
+	if (e)
+		e->length = 0;
+}
+
+void tlcl_cache_flush(void)
+{
+	memset(car_get_var_ptr(tlcl_cache), 0, sizeof(tlcl_cache));
+}
@@ -0,0 +1,49 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef __SRC_LIB_TLCL_CACHE_H
+#define __SRC_LIB_TLCL_CACHE_H
+
+#include <stdint.h>
+#include <timestamp.h>
+
+/*
+ * NV read cache shared by the TPM1.2 and TPM2 tlcl implementations. Reads
+ * of small NV spaces are remembered until the space is written, redefined
+ * or locked, so that the repeated secdata reads done by vboot only go out
+ * to the TPM once.
+ */
+
+/* Copy a cached NV space into data. Returns 0 on a hit, -1 on a miss. */
+int tlcl_cache_lookup(uint32_t index, void *data, uint32_t length);
+
+/* Remember the contents of an NV space after a successful read. */
+void tlcl_cache_update(uint32_t index, const void *data, uint32_t length);
+
+/* Forget a single NV space. */
+void tlcl_cache_invalidate(uint32_t index);
+
+/* Wrap a single TPM transaction in timestamps. */
+static inline void tlcl_cmd_start(void)
+{
+	if (IS_ENABLED(CONFIG_TPM_COMMAND_TIMESTAMPS))
+		timestamp_add_now(TS_START_TPMCMD);
+}
+
+static inline void tlcl_cmd_end(void)
+{
+	if (IS_ENABLED(CONFIG_TPM_COMMAND_TIMESTAMPS))
+		timestamp_add_now(TS_END_TPMCMD);
+}
+
+#endif /* __SRC_LIB_TLCL_CACHE_H */
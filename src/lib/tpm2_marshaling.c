@@ -7,539 +7,427 @@
 #include <arch/early_variables.h>
 #include <commonlib/endian.h>
 #include <console/console.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "tpm2_marshaling.h"
 
-static uint16_t tpm_tag CAR_GLOBAL;  /* Depends on the command type. */
-
 /*
- * Each unmarshaling function receives a pointer to the buffer pointer and a
- * pointer to the size of data still in the buffer. The function extracts data
- * from the buffer and adjusts both buffer pointer and remaining data size.
- *
- * Should there be not enough data in the buffer to unmarshal the required
- * object, the remaining data size is set to -1 to indicate the error. The
- * remaining data size is expected to be set to zero once the last data item
- * has been extracted from the receive buffer.
+ * Commands and responses are described by tables of fields instead of
+ * marshaling code. Each field names an operation and, where the operation
+ * reads or fills in a structure member, the offset of that member in the
+ * command structure passed to tpm_marshal_command() or in struct
+ * tpm2_response. One small interpreter walks the tables in both
+ * directions, so adding a command means adding a table.
  */
-static uint16_t unmarshal_u16(void **buffer, int *buffer_space)
-{
-	uint16_t value;
-
-	if (*buffer_space < 0)
-		return 0;
-
-	if (*buffer_space < sizeof(value)) {
-		*buffer_space = -1; /* Indicate a failure. */
-		return 0;
-	}
-
-	value = read_be16(*buffer);
-	*buffer = (void *) ((uintptr_t) (*buffer) + sizeof(value));
-	*buffer_space -= sizeof(value);
-
-	return value;
-}
-
-static uint16_t unmarshal_u32(void **buffer, int *buffer_space)
-{
-	uint32_t value;
-
-	if (*buffer_space < 0)
-		return 0;
-
-	if (*buffer_space < sizeof(value)) {
-		*buffer_space = -1; /* Indicate a failure. */
-		return 0;
-	}
-
-	value = read_be32(*buffer);
-	*buffer = (void *) ((uintptr_t) (*buffer) + sizeof(value));
-	*buffer_space -= sizeof(value);
-
-	return value;
-}
-
-static uint8_t unmarshal_u8(void **buffer, int *buffer_space)
+enum tpm2_op {
+	OP_END,		/* end of the table */
+	OP_SKIP_REST,	/* end of the table, ignore any trailing data */
+	OP_U8,		/* uint8_t member */
+	OP_U16,		/* uint16_t member */
+	OP_U32,		/* uint32_t member */
+	OP_TPM2B,	/* TPM2B member, its data is not copied on unmarshal */
+	OP_PLATFORM,	/* TPM_RH_PLATFORM handle */
+	OP_PW_SESSION,	/* authorization area with an empty password */
+	OP_SIZE16,	/* 16 bit size of the fields up to OP_SIZE16_END */
+	OP_SIZE16_END,
+	OP_DIGESTS,	/* TPML_DIGEST_VALUES member, sha256 only */
+	OP_PROPERTIES,	/* TPMS_CAPABILITY_DATA with TPM properties */
+};
+
+struct tpm2_field {
+	uint8_t op;
+	uint8_t offset;
+};
+
+/* Fails the build if a member is out of reach of the uint8_t offset. */
+#define FIELD_OFFSET(type, member)					\
+	(offsetof(type, member) + 0 * sizeof(struct {			\
+		_Static_assert((uint8_t)offsetof(type, member) ==	\
+			       offsetof(type, member),			\
+			       #type "." #member " is too far in");	\
+		int unused;						\
+	}))
+
+#define F(op, type, member)	{ op, FIELD_OFFSET(type, member) }
+#define F_OP(op)		{ op, 0 }
+#define R(op, member)		F(op, struct tpm2_response, member)
+
+struct tpm2_command_desc {
+	TPM_CC code;
+	const struct tpm2_field *command;
+	const struct tpm2_field *response;
+};
+
+static const struct tpm2_field startup_cmd[] = {
+	F(OP_U16, struct tpm2_startup, startup_type),
+	F_OP(OP_END),
+};
+
+static const struct tpm2_field get_capability_cmd[] = {
+	F(OP_U32, struct tpm2_get_capability, capability),
+	F(OP_U32, struct tpm2_get_capability, property),
+	F(OP_U32, struct tpm2_get_capability, propertyCount),
+	F_OP(OP_END),
+};
+
+static const struct tpm2_field get_capability_rsp[] = {
+	R(OP_U8, gc.more_data),
+	R(OP_PROPERTIES, gc.cd),
+	F_OP(OP_END),
+};
+
+static const struct tpm2_field nv_read_cmd[] = {
+	F_OP(OP_PLATFORM),
+	F(OP_U32, struct tpm2_nv_read_cmd, nvIndex),
+	F_OP(OP_PW_SESSION),
+	F(OP_U16, struct tpm2_nv_read_cmd, size),
+	F(OP_U16, struct tpm2_nv_read_cmd, offset),
+	F_OP(OP_END),
+};
+
+static const struct tpm2_field nv_read_rsp[] = {
+	R(OP_U32, nvr.params_size),
+	R(OP_TPM2B, nvr.buffer),
+	/* The authorization area that follows is not interesting. */
+	F_OP(OP_SKIP_REST),
+};
+
+static const struct tpm2_field nv_define_space_cmd[] = {
+	F_OP(OP_PLATFORM),
+	F_OP(OP_PW_SESSION),
+	F(OP_TPM2B, struct tpm2_nv_define_space_cmd, auth),
+	F_OP(OP_SIZE16),
+	F(OP_U32, struct tpm2_nv_define_space_cmd, publicInfo.nvIndex),
+	F(OP_U16, struct tpm2_nv_define_space_cmd, publicInfo.nameAlg),
+	F(OP_U32, struct tpm2_nv_define_space_cmd, publicInfo.attributes),
+	F(OP_TPM2B, struct tpm2_nv_define_space_cmd, publicInfo.authPolicy),
+	F(OP_U16, struct tpm2_nv_define_space_cmd, publicInfo.dataSize),
+	F_OP(OP_SIZE16_END),
+	F_OP(OP_END),
+};
+
+static const struct tpm2_field nv_write_cmd[] = {
+	F_OP(OP_PLATFORM),
+	F(OP_U32, struct tpm2_nv_write_cmd, nvIndex),
+	F_OP(OP_PW_SESSION),
+	F(OP_TPM2B, struct tpm2_nv_write_cmd, data),
+	F(OP_U16, struct tpm2_nv_write_cmd, offset),
+	F_OP(OP_END),
+};
+
+static const struct tpm2_field nv_write_lock_cmd[] = {
+	F_OP(OP_PLATFORM),
+	F(OP_U32, struct tpm2_nv_write_lock_cmd, nvIndex),
+	F_OP(OP_PW_SESSION),
+	F_OP(OP_END),
+};
+
+static const struct tpm2_field self_test_cmd[] = {
+	F(OP_U8, struct tpm2_self_test, yes_no),
+	F_OP(OP_END),
+};
+
+static const struct tpm2_field clear_cmd[] = {
+	F_OP(OP_PLATFORM),
+	F_OP(OP_PW_SESSION),
+	F_OP(OP_END),
+};
+
+static const struct tpm2_field pcr_extend_cmd[] = {
+	F(OP_U32, struct tpm2_pcr_extend_cmd, pcrHandle),
+	F_OP(OP_PW_SESSION),
+	F(OP_DIGESTS, struct tpm2_pcr_extend_cmd, digests),
+	F_OP(OP_END),
+};
+
+static const struct tpm2_field empty_rsp[] = {
+	F_OP(OP_END),
+};
+
+/* Session data included in the response can be safely ignored. */
+static const struct tpm2_field session_rsp[] = {
+	F_OP(OP_SKIP_REST),
+};
+
+static const struct tpm2_command_desc tpm2_commands[] = {
+	{ TPM2_Startup, startup_cmd, empty_rsp },
+	{ TPM2_GetCapability, get_capability_cmd, get_capability_rsp },
+	{ TPM2_NV_Read, nv_read_cmd, nv_read_rsp },
+	{ TPM2_NV_DefineSpace, nv_define_space_cmd, session_rsp },
+	{ TPM2_NV_Write, nv_write_cmd, session_rsp },
+	{ TPM2_NV_WriteLock, nv_write_lock_cmd, session_rsp },
+	{ TPM2_SelfTest, self_test_cmd, NULL },
+	{ TPM2_Clear, clear_cmd, session_rsp },
+	{ TPM2_PCR_Extend, pcr_extend_cmd, session_rsp },
+};
+
+static const struct tpm2_command_desc *find_command(TPM_CC command)
 {
-	uint8_t value;
-
-	if (*buffer_space < 0)
-		return 0;
+	int i;
 
-	if (*buffer_space < sizeof(value)) {
-		*buffer_space = -1; /* Indicate a failure. */
-		return 0;
+	for (i = 0; i < ARRAY_SIZE(tpm2_commands); i++) {
+		if (tpm2_commands[i].code == command)
+			return &tpm2_commands[i];
 	}
-
-	value = ((uint8_t *)(*buffer))[0];
-	*buffer = (void *) ((uintptr_t) (*buffer) + sizeof(value));
-	*buffer_space -= sizeof(value);
-
-	return value;
+	return NULL;
 }
 
-#define unmarshal_TPM_CAP(a, b) unmarshal_u32(a, b)
-#define unmarshal_TPM_CC(a, b) unmarshal_u32(a, b)
-#define unmarshal_TPM_PT(a, b) unmarshal_u32(a, b)
-#define unmarshal_TPM_HANDLE(a, b) unmarshal_u32(a, b)
-
 /*
- * Each marshaling function receives a pointer to the buffer to marshal into,
- * a pointer to the data item to be marshaled, and a pointer to the remaining
- * room in the buffer.
+ * A window into the command/response buffer. Running past the end of the
+ * buffer sets cur to NULL, which makes every following access fail as well,
+ * so the callers only need to check once at the end.
  */
+struct tpm2_stream {
+	uint8_t *cur;
+	uint8_t *end;
+};
 
- /*
-  * Marshaling an arbitrary blob requires its size in addition to common
-  * parameter set.
-  */
-static void marshal_blob(void **buffer, void *blob,
-			 size_t blob_size, size_t *buffer_space)
-{
-	if (*buffer_space < blob_size) {
-		*buffer_space = -1;
-		return;
-	}
-
-	memcpy(*buffer, blob, blob_size);
-	*buffer_space -= blob_size;
-	*buffer = (void *)((uintptr_t)(*buffer) + blob_size);
-}
-
-static void marshal_u8(void **buffer, uint8_t value, size_t *buffer_space)
+static uint8_t *stream_take(struct tpm2_stream *s, size_t size)
 {
-	uint8_t *bp = *buffer;
-
-	if (*buffer_space < sizeof(value)) {
-		*buffer_space = 0;
-		return;
-	}
-
-	*bp++ = value;
-	*buffer = bp;
-	*buffer_space -= sizeof(value);
-}
+	uint8_t *p = s->cur;
 
-static void marshal_u16(void **buffer, uint16_t value, size_t *buffer_space)
-{
-	if (*buffer_space < sizeof(value)) {
-		*buffer_space = 0;
-		return;
+	if (!p || size > s->end - p) {
+		s->cur = NULL;
+		return NULL;
 	}
-	write_be16(*buffer, value);
-	*buffer = (void *)((uintptr_t)(*buffer) + sizeof(value));
-	*buffer_space -= sizeof(value);
+	s->cur = p + size;
+	return p;
 }
 
-static void marshal_u32(void **buffer, uint32_t value, size_t *buffer_space)
+static void put_u8(struct tpm2_stream *s, uint8_t value)
 {
-	if (*buffer_space < sizeof(value)) {
-		*buffer_space = 0;
-		return;
-	}
+	uint8_t *p = stream_take(s, sizeof(value));
 
-	write_be32(*buffer, value);
-	*buffer = (void *)((uintptr_t)(*buffer) + sizeof(value));
-	*buffer_space -= sizeof(value);
+	if (p)
+		*p = value;
 }
 
-#define marshal_TPM_HANDLE(a, b, c) marshal_u32(a, b, c)
-#define marshal_TPMI_RH_NV_AUTH(a, b, c) marshal_TPM_HANDLE(a, b, c)
-#define marshal_TPMI_RH_NV_INDEX(a, b, c) marshal_TPM_HANDLE(a, b, c)
-#define marshal_TPMI_SH_AUTH_SESSION(a, b, c) marshal_TPM_HANDLE(a, b, c)
-#define marshal_TPMI_ALG_HASH(a, b, c) marshal_u16(a, b, c)
-
-static void marshal_startup(void **buffer,
-			   struct tpm2_startup *cmd_body,
-			   size_t *buffer_space)
+static void put_u16(struct tpm2_stream *s, uint16_t value)
 {
-	marshal_u16(buffer, cmd_body->startup_type, buffer_space);
-}
+	uint8_t *p = stream_take(s, sizeof(value));
 
-static void marshal_get_capability(void **buffer,
-				   struct tpm2_get_capability *cmd_body,
-				   size_t *buffer_space)
-{
-	marshal_u32(buffer, cmd_body->capability, buffer_space);
-	marshal_u32(buffer, cmd_body->property, buffer_space);
-	marshal_u32(buffer, cmd_body->propertyCount, buffer_space);
+	if (p)
+		write_be16(p, value);
 }
 
-static void marshal_TPM2B(void **buffer,
-			  TPM2B *data,
-			  size_t *buffer_space)
+static void put_u32(struct tpm2_stream *s, uint32_t value)
 {
-	size_t total_size = data->size + sizeof(data->size);
-
-	if (total_size > *buffer_space) {
-		*buffer_space = 0;
-		return;
-	}
-	marshal_u16(buffer, data->size, buffer_space);
-	memcpy(*buffer, data->buffer, data->size);
-	*buffer = ((uint8_t *)(*buffer)) + data->size;
-	*buffer_space -= data->size;
-}
+	uint8_t *p = stream_take(s, sizeof(value));
 
-static void marshal_TPMA_NV(void **buffer,
-			    TPMA_NV *nv,
-			    size_t *buffer_space)
-{
-	marshal_u32(buffer, *((uint32_t *)nv), buffer_space);
+	if (p)
+		write_be32(p, value);
 }
 
-static void marshal_TPMS_NV_PUBLIC(void **buffer,
-				   TPMS_NV_PUBLIC *nvpub,
-				   size_t *buffer_space)
+static void put_blob(struct tpm2_stream *s, const void *blob, size_t size)
 {
-	marshal_TPM_HANDLE(buffer, nvpub->nvIndex, buffer_space);
-	marshal_TPMI_ALG_HASH(buffer, nvpub->nameAlg, buffer_space);
-	marshal_TPMA_NV(buffer, &nvpub->attributes, buffer_space);
-	marshal_TPM2B(buffer, &nvpub->authPolicy.b, buffer_space);
-	marshal_u16(buffer, nvpub->dataSize, buffer_space);
-}
+	uint8_t *p = stream_take(s, size);
 
-static void marshal_TPMT_HA(void **buffer,
-			    TPMT_HA *tpmtha,
-			    size_t *buffer_space)
-{
-	marshal_TPMI_ALG_HASH(buffer, tpmtha->hashAlg, buffer_space);
-	marshal_blob(buffer, tpmtha->digest.sha256,
-		     sizeof(tpmtha->digest.sha256),
-		     buffer_space);
+	if (p && size)
+		memcpy(p, blob, size);
 }
 
-static void marshal_TPML_DIGEST_VALUES(void **buffer,
-				       TPML_DIGEST_VALUES *dvalues,
-				       size_t *buffer_space)
+static uint8_t get_u8(struct tpm2_stream *s)
 {
-	int i;
+	uint8_t *p = stream_take(s, sizeof(uint8_t));
 
-	marshal_u32(buffer, dvalues->count, buffer_space);
-	for (i = 0; i < dvalues->count; i++)
-		marshal_TPMT_HA(buffer, &dvalues->digests[i], buffer_space);
+	return p ? *p : 0;
 }
 
-static void marshal_session_header(void **buffer,
-				   struct tpm2_session_header *session_header,
-				   size_t *buffer_space)
+static uint16_t get_u16(struct tpm2_stream *s)
 {
-	size_t base_size;
-	void *size_location = *buffer;
-
-	/* Skip room for the session header size. */
-	if (*buffer_space < sizeof(uint32_t)) {
-		*buffer_space = 0;
-		return;
-	}
-
-	*buffer_space -= sizeof(uint32_t);
-	*buffer = (void *)(((uintptr_t) *buffer) + sizeof(uint32_t));
-
-	base_size = *buffer_space;
-
-	marshal_u32(buffer, session_header->session_handle, buffer_space);
-	marshal_u16(buffer, session_header->nonce_size, buffer_space);
-	marshal_blob(buffer, session_header->nonce,
-		     session_header->nonce_size, buffer_space);
-	marshal_u8(buffer, session_header->session_attrs, buffer_space);
-	marshal_u16(buffer, session_header->auth_size, buffer_space);
-	marshal_blob(buffer, session_header->auth,
-		     session_header->auth_size, buffer_space);
-
-	if (!*buffer_space)
-		return;  /* The structure did not fit. */
+	uint8_t *p = stream_take(s, sizeof(uint16_t));
 
-	/* Paste in the session size. */
-	marshal_u32(&size_location, base_size - *buffer_space, &base_size);
+	return p ? read_be16(p) : 0;
 }
 
-/*
- * Common session header can include one or two handles and an empty
- * session_header structure.
- */
-static void marshal_common_session_header(void **buffer,
-					  const uint32_t *handles,
-					  size_t handle_count,
-					  size_t *buffer_space)
+static uint32_t get_u32(struct tpm2_stream *s)
 {
-	int i;
-	struct tpm2_session_header session_header;
-
-	car_set_var(tpm_tag, TPM_ST_SESSIONS);
+	uint8_t *p = stream_take(s, sizeof(uint32_t));
 
-	for (i = 0; i < handle_count; i++)
-		marshal_TPM_HANDLE(buffer, handles[i], buffer_space);
-
-	memset(&session_header, 0, sizeof(session_header));
-	session_header.session_handle = TPM_RS_PW;
-	marshal_session_header(buffer, &session_header, buffer_space);
+	return p ? read_be32(p) : 0;
 }
 
-static void marshal_nv_define_space(void **buffer,
-				    struct tpm2_nv_define_space_cmd *nvd_in,
-				    size_t *buffer_space)
+static void marshal_fields(struct tpm2_stream *s, const struct tpm2_field *f,
+			   const uint8_t *body, uint16_t *tag)
 {
-	void *size_location;
-	size_t base_size;
-	size_t sizeof_nv_public_size = sizeof(uint16_t);
-	const uint32_t handle[] = { TPM_RH_PLATFORM };
-
-	marshal_common_session_header(buffer, handle,
-				      ARRAY_SIZE(handle), buffer_space);
-	marshal_TPM2B(buffer, &nvd_in->auth.b, buffer_space);
-
-	/* This is where the TPMS_NV_PUBLIC size will be stored. */
-	size_location = *buffer;
+	uint8_t *size_location = NULL;
+
+	for (; f->op != OP_END; f++) {
+		const void *member = body ? body + f->offset : NULL;
+
+		switch (f->op) {
+		case OP_U8:
+			put_u8(s, *(const uint8_t *)member);
+			break;
+		case OP_U16:
+			put_u16(s, *(const uint16_t *)member);
+			break;
+		case OP_U32: {
+			uint32_t value;
+
+			/* Also used for the TPMA_NV bit field. */
+			memcpy(&value, member, sizeof(value));
+			put_u32(s, value);
+			break;
+		}
+		case OP_TPM2B: {
+			const TPM2B *b = member;
 
-	/* Allocate room for the size. */
-	*buffer = ((uint8_t *)(*buffer)) + sizeof(uint16_t);
+			put_u16(s, b->size);
+			put_blob(s, b->buffer, b->size);
+			break;
+		}
+		case OP_PLATFORM:
+			put_u32(s, TPM_RH_PLATFORM);
+			break;
+		case OP_PW_SESSION:
+			*tag = TPM_ST_SESSIONS;
+			/* Handle, nonce size, attributes and auth size. */
+			put_u32(s, 9);
+			put_u32(s, TPM_RS_PW);
+			put_u16(s, 0);
+			put_u8(s, 0);
+			put_u16(s, 0);
+			break;
+		case OP_SIZE16:
+			size_location = stream_take(s, sizeof(uint16_t));
+			break;
+		case OP_SIZE16_END:
+			if (size_location && s->cur)
+				write_be16(size_location, s->cur -
+					   size_location - sizeof(uint16_t));
+			break;
+		case OP_DIGESTS: {
+			const TPML_DIGEST_VALUES *d = member;
+			int i;
 
-	if (*buffer_space < sizeof_nv_public_size) {
-		*buffer_space = 0;
-		return;
+			if (d->count > ARRAY_SIZE(d->digests)) {
+				s->cur = NULL;
+				break;
+			}
+			put_u32(s, d->count);
+			for (i = 0; i < d->count; i++) {
+				put_u16(s, d->digests[i].hashAlg);
+				put_blob(s, d->digests[i].digest.sha256,
+					 sizeof(d->digests[i].digest.sha256));
+			}
+			break;
+		}
+		default:
+			s->cur = NULL;
+			break;
+		}
 	}
-	*buffer_space -= sizeof_nv_public_size;
-	base_size = *buffer_space;
-
-	marshal_TPMS_NV_PUBLIC(buffer, &nvd_in->publicInfo, buffer_space);
-	if (!*buffer_space)
-		return;
-
-	base_size = base_size - *buffer_space;
-	marshal_u16(&size_location, base_size, &sizeof_nv_public_size);
-}
-
-static void marshal_nv_write(void **buffer,
-			     struct tpm2_nv_write_cmd *command_body,
-			     size_t *buffer_space)
-{
-	uint32_t handles[] = { TPM_RH_PLATFORM, command_body->nvIndex };
-
-	marshal_common_session_header(buffer, handles,
-				      ARRAY_SIZE(handles), buffer_space);
-	marshal_TPM2B(buffer, &command_body->data.b, buffer_space);
-	marshal_u16(buffer, command_body->offset, buffer_space);
-}
-
-static void marshal_nv_write_lock(void **buffer,
-				  struct tpm2_nv_write_lock_cmd *command_body,
-				  size_t *buffer_space)
-{
-	uint32_t handles[] = { TPM_RH_PLATFORM, command_body->nvIndex };
-	marshal_common_session_header(buffer, handles,
-				      ARRAY_SIZE(handles), buffer_space);
-}
-
-static void marshal_pcr_extend(void **buffer,
-			       struct tpm2_pcr_extend_cmd *command_body,
-			       size_t *buffer_space)
-{
-	uint32_t handle = command_body->pcrHandle;
-
-	marshal_common_session_header(buffer, &handle, 1, buffer_space);
-	marshal_TPML_DIGEST_VALUES(buffer,
-				   &command_body->digests, buffer_space);
-}
-
-static void marshal_nv_read(void **buffer,
-			    struct tpm2_nv_read_cmd *command_body,
-			    size_t *buffer_space)
-{
-	uint32_t handles[] = { TPM_RH_PLATFORM, command_body->nvIndex };
-
-	marshal_common_session_header(buffer, handles,
-				      ARRAY_SIZE(handles), buffer_space);
-	marshal_u16(buffer, command_body->size, buffer_space);
-	marshal_u16(buffer, command_body->offset, buffer_space);
-}
-
-/* TPM2_Clear command does not require paramaters. */
-static void marshal_clear(void **buffer, size_t *buffer_space)
-{
-	const uint32_t handle[] = { TPM_RH_PLATFORM };
-
-	marshal_common_session_header(buffer, handle,
-				      ARRAY_SIZE(handle), buffer_space);
-}
-
-static void marshal_selftest(void **buffer,
-			     struct tpm2_self_test *command_body,
-			     size_t *buffer_space)
-{
-	marshal_u8(buffer, command_body->yes_no, buffer_space);
 }
 
 int tpm_marshal_command(TPM_CC command, void *tpm_command_body,
 			void *buffer, size_t buffer_size)
 {
-	void *cmd_body = (uint8_t *)buffer + sizeof(struct tpm_header);
-	size_t max_body_size = buffer_size - sizeof(struct tpm_header);
-	size_t body_size = max_body_size;
-
-	/* Will be modified when marshaling some commands. */
-	car_set_var(tpm_tag, TPM_ST_NO_SESSIONS);
-
-	switch (command) {
-	case TPM2_Startup:
-		marshal_startup(&cmd_body, tpm_command_body, &body_size);
-		break;
-
-	case TPM2_GetCapability:
-		marshal_get_capability(&cmd_body, tpm_command_body,
-				       &body_size);
-		break;
-
-	case TPM2_NV_Read:
-		marshal_nv_read(&cmd_body, tpm_command_body, &body_size);
-		break;
-
-	case TPM2_NV_DefineSpace:
-		marshal_nv_define_space(&cmd_body,
-					tpm_command_body, &body_size);
-		break;
-
-	case TPM2_NV_Write:
-		marshal_nv_write(&cmd_body, tpm_command_body, &body_size);
-		break;
-
-	case TPM2_NV_WriteLock:
-		marshal_nv_write_lock(&cmd_body, tpm_command_body, &body_size);
-		break;
-
-	case TPM2_SelfTest:
-		marshal_selftest(&cmd_body, tpm_command_body, &body_size);
-		break;
-
-	case TPM2_Clear:
-		marshal_clear(&cmd_body, &body_size);
-		break;
-
-	case TPM2_PCR_Extend:
-		marshal_pcr_extend(&cmd_body, tpm_command_body, &body_size);
-		break;
-
-	default:
-		body_size = 0;
+	const struct tpm2_command_desc *desc = find_command(command);
+	struct tpm2_stream s;
+	uint16_t tag = TPM_ST_NO_SESSIONS;
+	size_t marshaled_size;
+
+	if (!desc) {
 		printk(BIOS_INFO, "%s:%d:Request to marshal unsupported command %#x\n",
 		       __FILE__, __LINE__, command);
+		return -1;
 	}
 
-	if (body_size > 0) {
-		size_t marshaled_size;
-		size_t header_room = sizeof(struct tpm_header);
-
-		/* See how much room was taken by marshaling. */
-		marshaled_size = max_body_size - body_size;
+	s.cur = buffer;
+	s.end = (uint8_t *)buffer + buffer_size;
 
-		/* Total size includes the header size. */
-		marshaled_size += sizeof(struct tpm_header);
+	/* The header is filled in once the size is known. */
+	stream_take(&s, sizeof(struct tpm_header));
+	marshal_fields(&s, desc->command, tpm_command_body, &tag);
+	if (!s.cur)
+		return -1;
 
-		uint16_t tpm_tag_value = car_get_var(tpm_tag);
+	marshaled_size = s.cur - (uint8_t *)buffer;
 
-		marshal_u16(&buffer, tpm_tag_value, &header_room);
-		marshal_u32(&buffer, marshaled_size, &header_room);
-		marshal_u32(&buffer, command, &header_room);
-		return marshaled_size;
-	}
+	s.cur = buffer;
+	put_u16(&s, tag);
+	put_u32(&s, marshaled_size);
+	put_u32(&s, command);
 
-	return -1;
+	return marshaled_size;
 }
 
-static void unmarshal_get_capability(void **buffer, int *size,
-				     struct get_cap_response *gcr)
+static void unmarshal_properties(struct tpm2_stream *s,
+				 TPMS_CAPABILITY_DATA *cd)
 {
+	TPML_TAGGED_TPM_PROPERTY *props = &cd->data.tpmProperties;
 	int i;
 
-	gcr->more_data = unmarshal_u8(buffer, size);
-
-	gcr->cd.capability = unmarshal_TPM_CAP(buffer, size);
-	if (*size < 0)
-		return;
-
-	switch (gcr->cd.capability) {
-	case TPM_CAP_TPM_PROPERTIES:
-		gcr->cd.data.tpmProperties.count =
-			unmarshal_u32(buffer, size);
-		if (*size < 0)
-			return;
-		if (gcr->cd.data.tpmProperties.count > ARRAY_SIZE
-		    (gcr->cd.data.tpmProperties.tpmProperty)) {
-			printk(BIOS_INFO, "%s:%s:%d - %d - too many properties\n",
-			       __FILE__, __func__, __LINE__,
-			       gcr->cd.data.tpmProperties.count);
-			*size = -1;
-			return;
-		}
-		for (i = 0; i < gcr->cd.data.tpmProperties.count; i++) {
-			TPMS_TAGGED_PROPERTY *pp;
-
-			pp = gcr->cd.data.tpmProperties.tpmProperty + i;
-			pp->property = unmarshal_TPM_PT(buffer, size);
-			pp->value = unmarshal_u32(buffer, size);
-		}
-		break;
-	default:
+	cd->capability = get_u32(s);
+	if (s->cur && cd->capability != TPM_CAP_TPM_PROPERTIES) {
 		printk(BIOS_ERR,
 		       "%s:%d - unable to unmarshal capability response",
 		       __func__, __LINE__);
-		printk(BIOS_ERR, " for %d\n", gcr->cd.capability);
-		*size = -1;
-		break;
+		printk(BIOS_ERR, " for %d\n", cd->capability);
+		s->cur = NULL;
+		return;
 	}
-}
 
-static void unmarshal_TPM2B_MAX_NV_BUFFER(void **buffer,
-					  int *size,
-					  TPM2B_MAX_NV_BUFFER *nv_buffer)
-{
-	nv_buffer->t.size = unmarshal_u16(buffer, size);
-	if ((*size < 0) || (nv_buffer->t.size > *size)) {
-		printk(BIOS_ERR, "%s:%d - "
-		       "size mismatch: expected %d, remaining %d\n",
-		       __func__, __LINE__, nv_buffer->t.size, *size);
-		*size = -1;
+	props->count = get_u32(s);
+	if (props->count > ARRAY_SIZE(props->tpmProperty)) {
+		printk(BIOS_INFO, "%s:%s:%d - %d - too many properties\n",
+		       __FILE__, __func__, __LINE__, props->count);
+		s->cur = NULL;
 		return;
 	}
 
-	nv_buffer->t.buffer = *buffer;
-
-	*buffer = ((uint8_t *)(*buffer)) + nv_buffer->t.size;
-	*size -= nv_buffer->t.size;
+	for (i = 0; s->cur && i < props->count; i++) {
+		props->tpmProperty[i].property = get_u32(s);
+		props->tpmProperty[i].value = get_u32(s);
+	}
 }
 
-static void unmarshal_nv_read(void **buffer, int *size,
-			      struct nv_read_response *nvr)
+/*
+ * Returns 0 if the whole response was consumed, -1 otherwise. Variable
+ * sized data is not copied: TPM2B buffers point into the response.
+ */
+static int unmarshal_fields(struct tpm2_stream *s, const struct tpm2_field *f,
+			    uint8_t *resp)
 {
-	/* Total size of the parameter field. */
-	nvr->params_size = unmarshal_u32(buffer, size);
-	unmarshal_TPM2B_MAX_NV_BUFFER(buffer, size, &nvr->buffer);
-
-	if (nvr->params_size !=
-	    (nvr->buffer.t.size + sizeof(nvr->buffer.t.size))) {
-		printk(BIOS_ERR,
-		       "%s:%d - parameter/buffer %d/%d size mismatch",
-		       __func__, __LINE__, nvr->params_size,
-		       nvr->buffer.t.size);
-		return;
+	for (; f->op != OP_END; f++) {
+		void *member = resp + f->offset;
+
+		switch (f->op) {
+		case OP_SKIP_REST:
+			return s->cur ? 0 : -1;
+		case OP_U8:
+			*(uint8_t *)member = get_u8(s);
+			break;
+		case OP_U16:
+			*(uint16_t *)member = get_u16(s);
+			break;
+		case OP_U32:
+			*(uint32_t *)member = get_u32(s);
+			break;
+		case OP_TPM2B: {
+			TPM2B *b = member;
+
+			b->size = get_u16(s);
+			b->buffer = stream_take(s, b->size);
+			if (!s->cur)
+				printk(BIOS_ERR, "%s:%d - size mismatch: "
+				       "TPM2B of %d bytes does not fit\n",
+				       __func__, __LINE__, b->size);
+			break;
+		}
+		case OP_PROPERTIES:
+			unmarshal_properties(s, member);
+			break;
+		default:
+			s->cur = NULL;
+			break;
+		}
 	}
 
-	if (*size < 0)
-		return;
-	/*
-	 * Let's ignore the authorisation section. It should be 5 bytes total,
-	 * just confirm that this is the case and report any discrepancy.
-	 */
-	if (*size != 5)
-		printk(BIOS_ERR,
-		       "%s:%d - unexpected authorisation seciton size %d\n",
-		       __func__, __LINE__, *size);
-
-	*buffer = ((uint8_t *)(*buffer)) + *size;
-	*size = 0;
+	return (s->cur && s->cur == s->end) ? 0 : -1;
 }
 
 struct tpm2_response *tpm_unmarshal_response(TPM_CC command,
@@ -548,20 +436,20 @@ struct tpm2_response *tpm_unmarshal_response(TPM_CC command,
 {
 	static struct tpm2_response tpm2_static_resp CAR_GLOBAL;
 	struct tpm2_response *tpm2_resp = car_get_var_ptr(&tpm2_static_resp);
-	/*
-	 * Should be 0 when done, positive and negaitive values indicate
-	 * unmarshaling errors.
-	 */
-	int cr_size = in_size;
+	const struct tpm2_command_desc *desc;
+	struct tpm2_stream s;
 
-	if ((cr_size < 0) || (in_size < sizeof(struct tpm_header)))
+	if (in_size < sizeof(struct tpm_header))
 		return NULL;
 
-	tpm2_resp->hdr.tpm_tag = unmarshal_u16(&response_body, &cr_size);
-	tpm2_resp->hdr.tpm_size = unmarshal_u32(&response_body, &cr_size);
-	tpm2_resp->hdr.tpm_code = unmarshal_TPM_CC(&response_body, &cr_size);
+	s.cur = response_body;
+	s.end = (uint8_t *)response_body + in_size;
 
-	if (!cr_size) {
+	tpm2_resp->hdr.tpm_tag = get_u16(&s);
+	tpm2_resp->hdr.tpm_size = get_u32(&s);
+	tpm2_resp->hdr.tpm_code = get_u32(&s);
+
+	if (s.cur == s.end) {
 		if (tpm2_resp->hdr.tpm_size != sizeof(tpm2_resp->hdr))
 			printk(BIOS_ERR,
 			       "%s: size mismatch in response to command %#x\n",
@@ -569,56 +457,40 @@ struct tpm2_response *tpm_unmarshal_response(TPM_CC command,
 		return tpm2_resp;
 	}
 
-	switch (command) {
-	case TPM2_Startup:
-		break;
-
-	case TPM2_GetCapability:
-		unmarshal_get_capability(&response_body, &cr_size,
-					 &tpm2_resp->gc);
-		break;
-
-	case TPM2_NV_Read:
-		unmarshal_nv_read(&response_body, &cr_size,
-				  &tpm2_resp->nvr);
-		break;
-
-	case TPM2_Clear:
-	case TPM2_NV_DefineSpace:
-	case TPM2_NV_Write:
-	case TPM2_NV_WriteLock:
-	case TPM2_PCR_Extend:
-		/* Session data included in response can be safely ignored. */
-		cr_size = 0;
-		break;
-
-	default:
-		{
-			int i;
+	desc = find_command(command);
+	if (!desc || !desc->response) {
+		size_t i;
 
-			printk(BIOS_INFO, "%s:%d:"
-			       "Request to unmarshal unexpected command %#x,"
-			       " code %#x",
-			       __func__, __LINE__, command,
-			       tpm2_resp->hdr.tpm_code);
-
-			for (i = 0; i < cr_size; i++) {
-				if (!(i % 16))
-					printk(BIOS_INFO, "\n");
-				printk(BIOS_INFO, "%2.2x ",
-				       ((uint8_t *)response_body)[i]);
-			}
+		printk(BIOS_INFO, "%s:%d:"
+		       "Request to unmarshal unexpected command %#x,"
+		       " code %#x",
+		       __func__, __LINE__, command,
+		       tpm2_resp->hdr.tpm_code);
+
+		for (i = 0; i < s.end - s.cur; i++) {
+			if (!(i % 16))
+				printk(BIOS_INFO, "\n");
+			printk(BIOS_INFO, "%2.2x ", s.cur[i]);
 		}
 		printk(BIOS_INFO, "\n");
 		return NULL;
 	}
 
-	if (cr_size) {
+	if (unmarshal_fields(&s, desc->response, (uint8_t *)tpm2_resp)) {
 		printk(BIOS_INFO,
 		       "%s:%d got %d bytes back in response to %#x,"
-		       " failed to parse (%d)\n",
-		       __func__, __LINE__, tpm2_resp->hdr.tpm_size,
-		       command, cr_size);
+		       " failed to parse\n",
+		       __func__, __LINE__, tpm2_resp->hdr.tpm_size, command);
+		return NULL;
+	}
+
+	if (command == TPM2_NV_Read &&
+	    tpm2_resp->nvr.params_size !=
+	    tpm2_resp->nvr.buffer.t.size + sizeof(uint16_t)) {
+		printk(BIOS_ERR,
+		       "%s:%d - parameter/buffer %d/%d size mismatch\n",
+		       __func__, __LINE__, tpm2_resp->nvr.params_size,
+		       tpm2_resp->nvr.buffer.t.size);
 		return NULL;
 	}
 
@@ -13,6 +13,7 @@
 #include <tpm.h>
 #include <vb2_api.h>
 
+#include "tlcl_cache.h"
 #include "tpm2_marshaling.h"
 
 /*
@@ -25,6 +26,7 @@ static void *tpm_process_command(TPM_CC command, void *command_body)
 {
 	ssize_t out_size;
 	size_t in_size;
+	int rv;
 	/* Command/response buffer. */
 	static uint8_t cr_buffer[TPM_BUFFER_SIZE] CAR_GLOBAL;
 
@@ -39,8 +41,10 @@ static void *tpm_process_command(TPM_CC command, void *command_body)
 	}
 
 	in_size = sizeof(cr_buffer);
-	if (tis_sendrecv(cr_buffer_ptr, out_size,
-			 cr_buffer_ptr, &in_size)) {
+	tlcl_cmd_start();
+	rv = tis_sendrecv(cr_buffer_ptr, out_size, cr_buffer_ptr, &in_size);
+	tlcl_cmd_end();
+	if (rv) {
 		printk(BIOS_ERR, "tpm transaction failed\n");
 		return NULL;
 	}
@@ -60,6 +64,7 @@ static uint32_t tlcl_send_startup(TPM_SU type)
 	struct tpm2_startup startup;
 	struct tpm2_response *response;
 
+	tlcl_cache_flush();
 	startup.startup_type = type;
 	response = tpm_process_command(TPM2_Startup, &startup);
 
@@ -124,6 +129,7 @@ uint32_t tlcl_force_clear(void)
 {
 	struct tpm2_response *response;
 
+	tlcl_cache_flush();
 	response = tpm_process_command(TPM2_Clear, NULL);
 	printk(BIOS_INFO, "%s: response is %x\n",
 	       __func__, response ? response->hdr.tpm_code : -1);
@@ -188,6 +194,9 @@ uint32_t tlcl_read(uint32_t index, void *data, uint32_t length)
 	struct tpm2_nv_read_cmd nv_readc;
 	struct tpm2_response *response;
 
+	if (!tlcl_cache_lookup(index, data, length))
+		return TPM_SUCCESS;
+
 	memset(&nv_readc, 0, sizeof(nv_readc));
 
 	nv_readc.nvIndex = HR_NV_INDEX + index;
@@ -219,6 +228,7 @@ uint32_t tlcl_read(uint32_t index, void *data, uint32_t length)
 		return TPM_E_READ_EMPTY;
 
 	memcpy(data, response->nvr.buffer.t.buffer, length);
+	tlcl_cache_update(index, data, length);
 
 	return TPM_SUCCESS;
 }
@@ -256,6 +266,7 @@ uint32_t tlcl_lock_nv_write(uint32_t index)
 		.nvIndex = HR_NV_INDEX + index,
 	};
 
+	tlcl_cache_invalidate(index);
 	response = tpm_process_command(TPM2_NV_WriteLock, &nv_wl);
 
 	printk(BIOS_INFO, "%s: response is %x\n",
@@ -277,6 +288,7 @@ uint32_t tlcl_write(uint32_t index, const void *data, uint32_t length)
 	struct tpm2_nv_write_cmd nv_writec;
 	struct tpm2_response *response;
 
+	tlcl_cache_invalidate(index);
 	memset(&nv_writec, 0, sizeof(nv_writec));
 
 	nv_writec.nvIndex = HR_NV_INDEX + index;
@@ -319,6 +331,8 @@ uint32_t tlcl_define_space(uint32_t space_index, size_t space_size)
 		.TPMA_NV_PLATFORMCREATE = 1,
 	};
 
+	tlcl_cache_invalidate(space_index);
+
 	/* Prepare the define space command structure. */
 	memset(&nvds_cmd, 0, sizeof(nvds_cmd));
 
@@ -14,11 +14,131 @@
  */
 
 #include <types.h>
+#if IS_ENABLED(CONFIG_ARCH_RAMSTAGE_X86_32) || \
+	IS_ENABLED(CONFIG_ARCH_RAMSTAGE_X86_64)
+#include <arch/cpu.h>
+#define HAVE_CPU_INDEX 1
+#endif
+#include <cbmem.h>
+#include <commonlib/trace_serialized.h>
 #include <console/console.h>
+#include <symbols.h>
+#include <timestamp.h>
 #include <trace.h>
 
 int volatile trace_dis = 0;
 
+#if IS_ENABLED(CONFIG_TRACE_CBMEM)
+
+#define NO_TRACE __attribute__ ((no_instrument_function))
+
+static struct trace_buffer *trace_buf;
+static uintptr_t trace_filter_start = CONFIG_TRACE_FILTER_START;
+static uintptr_t trace_filter_end = CONFIG_TRACE_FILTER_END;
+/* Set while a CPU is inside the tracer to drop calls made from it. */
+static uint8_t trace_busy[CONFIG_MAX_CPUS];
+
+static inline NO_TRACE unsigned int trace_cpu(void)
+{
+#ifdef HAVE_CPU_INDEX
+	return cpu_index();
+#else
+	return 0;
+#endif
+}
+
+static NO_TRACE void trace_record(void *func, uint64_t flags)
+{
+	struct trace_ring *ring;
+	struct trace_entry *entry;
+	unsigned int cpu;
+	uint64_t head;
+
+	if (trace_dis || trace_buf == NULL)
+		return;
+
+	if ((uintptr_t)func < trace_filter_start ||
+	    (trace_filter_end && (uintptr_t)func >= trace_filter_end))
+		return;
+
+	cpu = trace_cpu();
+	if (cpu >= CONFIG_MAX_CPUS || trace_busy[cpu])
+		return;
+	trace_busy[cpu] = 1;
+
+	/*
+	 * Each ring only has a single writer, so advancing head after the
+	 * record is filled in is enough for the ring to stay consistent.
+	 */
+	ring = trace_buffer_ring(trace_buf, cpu);
+	head = ring->head;
+	entry = &ring->entries[head & (CONFIG_TRACE_CBMEM_ENTRIES - 1)];
+	entry->func = (uintptr_t)func;
+	entry->stamp = (timestamp_get() & ~TRACE_EXIT) | flags;
+	ring->head = head + 1;
+
+	trace_busy[cpu] = 0;
+}
+
+void __cyg_profile_func_enter(void *func, void *callsite)
+{
+	trace_record(func, 0);
+}
+
+void __cyg_profile_func_exit(void *func, void *callsite)
+{
+	trace_record(func, TRACE_EXIT);
+}
+
+void trace_set_filter(uintptr_t start, uintptr_t end)
+{
+	trace_filter_start = start;
+	trace_filter_end = end;
+	if (trace_buf) {
+		trace_buf->filter_start = start;
+		trace_buf->filter_end = end;
+	}
+}
+
+static NO_TRACE void trace_init(int is_recovery)
+{
+	struct trace_buffer *buf;
+	size_t ring_size;
+	int i;
+
+	_Static_assert(!(CONFIG_TRACE_CBMEM_ENTRIES &
+			 (CONFIG_TRACE_CBMEM_ENTRIES - 1)),
+		       "TRACE_CBMEM_ENTRIES must be a power of 2");
+
+	ring_size = sizeof(struct trace_ring) +
+		CONFIG_TRACE_CBMEM_ENTRIES * sizeof(struct trace_entry);
+
+	buf = cbmem_add(CBMEM_ID_TRACE,
+			sizeof(*buf) + CONFIG_MAX_CPUS * ring_size);
+	if (buf == NULL) {
+		printk(BIOS_ERR, "TRACE: Unable to allocate CBMEM buffer\n");
+		return;
+	}
+
+	buf->magic = TRACE_BUFFER_MAGIC;
+	buf->version = TRACE_BUFFER_VERSION;
+	buf->num_cpus = CONFIG_MAX_CPUS;
+	buf->ring_entries = CONFIG_TRACE_CBMEM_ENTRIES;
+	buf->tick_freq_mhz = timestamp_tick_freq_mhz();
+	buf->program_base = (uintptr_t)_program;
+	buf->filter_start = trace_filter_start;
+	buf->filter_end = trace_filter_end;
+	for (i = 0; i < CONFIG_MAX_CPUS; i++) {
+		trace_buffer_ring(buf, i)->head = 0;
+		trace_buffer_ring(buf, i)->reserved = 0;
+	}
+
+	trace_buf = buf;
+}
+RAMSTAGE_CBMEM_INIT_HOOK(trace_init)
+
+#else
+
 void __cyg_profile_func_enter(void *func, void *callsite)
 {
 
@@ -33,3 +153,9 @@ void __cyg_profile_func_enter(void *func, void *callsite)
 void __cyg_profile_func_exit(void *func, void *callsite)
 {
 }
+
+void trace_set_filter(uintptr_t start, uintptr_t end)
+{
+}
+
+#endif
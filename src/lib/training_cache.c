@@ -0,0 +1,595 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * The first TC_INDEX_SIZE bytes of the region are the index: a header and
+ * an array of records, one per saved entry, filled in order. Entry data is
+ * appended behind the index. Only when the index or the data area is full
+ * is the whole region erased and the index started over, so an update
+ * normally only programs erased flash.
+ *
+ * An entry is written data first, then its record, then the commit word of
+ * its record. An update that is interrupted leaves the previous entry as
+ * the newest complete one, and the dirty flash behind it is noticed and
+ * erased by the next update.
+ */
+
+#include <boot_device.h>
+#include <cbfs.h>
+#include <commonlib/checksum.h>
+#include <commonlib/compression.h>
+#include <commonlib/endian.h>
+#include <commonlib/helpers.h>
+#include <console/console.h>
+#include <fmap.h>
+#include <string.h>
+#include <training_cache.h>
+
+#define TC_SIGNATURE		0x58494354	/* 'TCIX' */
+#define TC_FORMAT		1
+#define TC_INDEX_SIZE		0x1000
+#define TC_DATA_ALIGN		16
+#define TC_COMMITTED		0x54494d43	/* 'CMIT' */
+#define TC_CHUNK		256		/* for reading back flash */
+
+struct tc_header {
+	uint32_t signature;
+	uint16_t format;
+	uint16_t record_size;
+	uint32_t index_size;
+	uint32_t erase_count;	/* how often the region was started over */
+} __attribute__((packed));
+
+struct tc_record {
+	uint32_t offset;
+	uint32_t stored_size;
+	uint32_t size;
+	uint32_t version;
+	uint32_t hash;		/* of the data */
+	uint32_t stored_hash;	/* of the bytes in the region */
+	uint32_t flags;
+	uint32_t commit;
+} __attribute__((packed));
+
+#define TC_MAX_RECORDS \
+	((TC_INDEX_SIZE - sizeof(struct tc_header)) / sizeof(struct tc_record))
+
+uint32_t training_cache_hash(const void *data, size_t size)
+{
+	return xxh32(data, size, 0);
+}
+
+/*
+ * Greedy LZ4 compressor. The data is split into independent blocks so
+ * that it can be compressed and written one block at a time. Unless
+ * TRAINING_CACHE_COMPRESS is set, nothing calls it and its buffers are
+ * left out.
+ */
+#define LZ4F_MAGIC		0x184d2204
+#define LZ4F_FLG		0x60	/* version 1, independent blocks */
+#define LZ4F_BD			0x40	/* 64 KiB maximum block size */
+#define LZ4F_HEADER_SIZE	7
+#define LZ4_BLOCK_SIZE		0x4000
+#define LZ4_UNCOMPRESSED	(1U << 31)
+#define LZ4_HASH_BITS		12
+#define LZ4_HASH_PRIME		2654435761U
+#define LZ4_MIN_MATCH		4
+#define LZ4_LAST_LITERALS	5	/* a block ends in at least 5 literals */
+#define LZ4_MF_LIMIT		12	/* and has no match in its last 12 bytes */
+
+static uint16_t lz4_table[1 << LZ4_HASH_BITS];
+static uint8_t lz4_out[LZ4_BLOCK_SIZE];
+
+static uint8_t *lz4_put_length(uint8_t *op, size_t len)
+{
+	for (; len >= 255; len -= 255)
+		*op++ = 255;
+	*op++ = len;
+	return op;
+}
+
+/* Returns the compressed size, or 0 if it would not fit in dstn bytes. */
+static size_t lz4_compress_block(const uint8_t *src, size_t n, uint8_t *dst,
+				 size_t dstn)
+{
+	const uint8_t *ip = src;
+	const uint8_t *anchor = src;
+	const uint8_t *const iend = src + n;
+	const uint8_t *const match_limit = iend - LZ4_LAST_LITERALS;
+	uint8_t *op = dst;
+	uint8_t *const oend = dst + dstn;
+	size_t lit;
+
+	memset(lz4_table, 0, sizeof(lz4_table));
+
+	while (n > LZ4_MF_LIMIT && ip < iend - LZ4_MF_LIMIT) {
+		const uint32_t seq = read_le32(ip);
+		const uint32_t h = (seq * LZ4_HASH_PRIME) >> (32 - LZ4_HASH_BITS);
+		const uint8_t *ref = src + lz4_table[h];
+		const uint8_t *mp;
+		size_t mlen;
+		uint8_t *token;
+
+		lz4_table[h] = ip - src;
+		if (ref >= ip || read_le32(ref) != seq) {
+			ip++;
+			continue;
+		}
+
+		mp = ip + LZ4_MIN_MATCH;
+		ref += LZ4_MIN_MATCH;
+		while (mp < match_limit && *mp == *ref) {
+			mp++;
+			ref++;
+		}
+
+		lit = ip - anchor;
+		mlen = mp - ip - LZ4_MIN_MATCH;
+		if ((size_t)(oend - op) <
+		    1 + lit / 255 + 1 + lit + 2 + mlen / 255 + 1)
+			return 0;
+
+		token = op++;
+		*token = MIN(lit, 15) << 4 | MIN(mlen, 15);
+		if (lit >= 15)
+			op = lz4_put_length(op, lit - 15);
+		memcpy(op, anchor, lit);
+		op += lit;
+		write_le16(op, mp - ref);
+		op += 2;
+		if (mlen >= 15)
+			op = lz4_put_length(op, mlen - 15);
+
+		ip = anchor = mp;
+	}
+
+	lit = iend - anchor;
+	if ((size_t)(oend - op) < 1 + lit / 255 + 1 + lit)
+		return 0;
+	*op++ = MIN(lit, 15) << 4;
+	if (lit >= 15)
+		op = lz4_put_length(op, lit - 15);
+	memcpy(op, anchor, lit);
+	op += lit;
+
+	return op - dst;
+}
+
+/* Largest LZ4 frame tc_write_lz4() can produce for size bytes. */
+static size_t lz4_frame_bound(size_t size)
+{
+	return LZ4F_HEADER_SIZE + size +
+		DIV_ROUND_UP(size, LZ4_BLOCK_SIZE) * sizeof(uint32_t) +
+		sizeof(uint32_t);
+}
+
+static int tc_write(const struct region_device *rdev, const void *data,
+		    size_t offset, size_t size, struct xxh32_ctx *s)
+{
+	xxh32_update(s, data, size);
+	return rdev_writeat(rdev, data, offset, size) == size ? 0 : -1;
+}
+
+/* Returns the size of the frame written at offset, or < 0 on error. */
+static ssize_t tc_write_lz4(const struct region_device *rdev, size_t offset,
+			    const uint8_t *data, size_t size, struct xxh32_ctx *s)
+{
+	uint8_t word[LZ4F_HEADER_SIZE];
+	size_t in, pos = offset;
+
+	write_le32(word, LZ4F_MAGIC);
+	word[4] = LZ4F_FLG;
+	word[5] = LZ4F_BD;
+	word[6] = training_cache_hash(&word[4], 2) >> 8;
+	if (tc_write(rdev, word, pos, LZ4F_HEADER_SIZE, s) < 0)
+		return -1;
+	pos += LZ4F_HEADER_SIZE;
+
+	for (in = 0; in < size; ) {
+		const size_t len = MIN(size - in, LZ4_BLOCK_SIZE);
+		size_t block = lz4_compress_block(data + in, len, lz4_out,
+						  len - 1);
+		const void *src = lz4_out;
+
+		if (!block) {
+			block = len;
+			src = data + in;
+			write_le32(word, block | LZ4_UNCOMPRESSED);
+		} else {
+			write_le32(word, block);
+		}
+
+		if (tc_write(rdev, word, pos, sizeof(uint32_t), s) < 0 ||
+		    tc_write(rdev, src, pos + sizeof(uint32_t), block, s) < 0)
+			return -1;
+		pos += sizeof(uint32_t) + block;
+		in += len;
+	}
+
+	write_le32(word, 0);
+	if (tc_write(rdev, word, pos, sizeof(uint32_t), s) < 0)
+		return -1;
+	pos += sizeof(uint32_t);
+
+	return pos - offset;
+}
+
+static size_t tc_record_offset(int slot)
+{
+	return sizeof(struct tc_header) + slot * sizeof(struct tc_record);
+}
+
+static int tc_read_header(const struct region_device *rdev,
+			  struct tc_header *h)
+{
+	if (region_device_sz(rdev) <= TC_INDEX_SIZE ||
+	    rdev_readat(rdev, h, 0, sizeof(*h)) != sizeof(*h))
+		return -1;
+
+	if (h->signature != TC_SIGNATURE || h->format != TC_FORMAT ||
+	    h->record_size != sizeof(struct tc_record) ||
+	    h->index_size != TC_INDEX_SIZE)
+		return -1;
+
+	return 0;
+}
+
+static int tc_read_record(const struct region_device *rdev, int slot,
+			  struct tc_record *r)
+{
+	if (rdev_readat(rdev, r, tc_record_offset(slot), sizeof(*r)) !=
+	    sizeof(*r))
+		return -1;
+	return 0;
+}
+
+static int tc_is_erased(const struct region_device *rdev, size_t offset,
+			size_t size)
+{
+	uint8_t buf[TC_CHUNK];
+	size_t i, len;
+
+	for (; size; offset += len, size -= len) {
+		len = MIN(size, sizeof(buf));
+		if (rdev_readat(rdev, buf, offset, len) != len)
+			return 0;
+		for (i = 0; i < len; i++)
+			if (buf[i] != 0xff)
+				return 0;
+	}
+	return 1;
+}
+
+/*
+ * Records are written in order, so the used ones are a prefix of the
+ * index and their number can be found by bisection. Returns < 0 on error.
+ */
+static int tc_count_records(const struct region_device *rdev)
+{
+	struct tc_record r;
+	int lo = 0, hi = TC_MAX_RECORDS;
+
+	while (lo < hi) {
+		const int mid = lo + (hi - lo) / 2;
+		const uint8_t *p = (const uint8_t *)&r;
+		size_t i;
+
+		if (tc_read_record(rdev, mid, &r) < 0)
+			return -1;
+
+		for (i = 0; i < sizeof(r) && p[i] == 0xff; i++)
+			;
+		if (i == sizeof(r))
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return lo;
+}
+
+/* Check that the stored bytes of a record are where it says they are. */
+static int tc_record_in_bounds(const struct region_device *rdev,
+			       const struct tc_record *r)
+{
+	const size_t size = region_device_sz(rdev);
+
+	return r->offset >= TC_INDEX_SIZE && r->offset <= size &&
+		r->stored_size <= size - r->offset;
+}
+
+static int tc_record_valid(const struct region_device *rdev,
+			   const struct tc_record *r)
+{
+	if (r->commit != TC_COMMITTED || !r->size ||
+	    !tc_record_in_bounds(rdev, r))
+		return 0;
+
+	if (r->flags & ~TRAINING_CACHE_LZ4)
+		return 0;
+
+	if (!(r->flags & TRAINING_CACHE_LZ4) && r->stored_size != r->size)
+		return 0;
+
+	return 1;
+}
+
+static int tc_check_stored(const struct region_device *rdev,
+			   const struct tc_record *r)
+{
+	uint8_t buf[TC_CHUNK];
+	struct xxh32_ctx s;
+	size_t pos, len;
+
+	xxh32_init(&s, 0);
+	for (pos = 0; pos < r->stored_size; pos += len) {
+		len = MIN(r->stored_size - pos, sizeof(buf));
+		if (rdev_readat(rdev, buf, r->offset + pos, len) != len)
+			return -1;
+		xxh32_update(&s, buf, len);
+	}
+
+	return xxh32_final(&s) == r->stored_hash ? 0 : -1;
+}
+
+int training_cache_find(const struct region_device *rdev,
+			struct training_cache_entry *entry)
+{
+	struct tc_header h;
+	struct tc_record r;
+	int slot;
+
+	if (tc_read_header(rdev, &h) < 0)
+		return -1;
+
+	for (slot = tc_count_records(rdev) - 1; slot >= 0; slot--) {
+		if (tc_read_record(rdev, slot, &r) < 0)
+			return -1;
+
+		if (!tc_record_valid(rdev, &r))
+			continue;
+
+		if (tc_check_stored(rdev, &r) < 0) {
+			printk(BIOS_ERR, "Training cache: entry %d corrupted\n",
+			       slot);
+			continue;
+		}
+
+		entry->slot = slot;
+		entry->offset = r.offset;
+		entry->stored_size = r.stored_size;
+		entry->size = r.size;
+		entry->version = r.version;
+		entry->hash = r.hash;
+		entry->flags = r.flags;
+		return 0;
+	}
+
+	return -1;
+}
+
+void *training_cache_map(const struct region_device *rdev,
+			 const struct training_cache_entry *entry)
+{
+	if (entry->flags & TRAINING_CACHE_LZ4)
+		return NULL;
+
+	return rdev_mmap(rdev, entry->offset, entry->size);
+}
+
+ssize_t training_cache_load(const struct region_device *rdev,
+			    const struct training_cache_entry *entry,
+			    void *buf, size_t size)
+{
+	void *stored;
+	size_t len;
+
+	if (entry->size > size)
+		return -1;
+
+	stored = rdev_mmap(rdev, entry->offset, entry->stored_size);
+	if (stored == NULL)
+		return -1;
+
+	if (entry->flags & TRAINING_CACHE_LZ4) {
+		len = ulz4fn(stored, entry->stored_size, buf, entry->size);
+	} else {
+		memcpy(buf, stored, entry->size);
+		len = entry->size;
+	}
+	rdev_munmap(rdev, stored);
+
+	if (len != entry->size || training_cache_hash(buf, len) != entry->hash) {
+		printk(BIOS_ERR, "Training cache: entry %d does not match\n",
+		       entry->slot);
+		return -1;
+	}
+
+	return len;
+}
+
+/*
+ * Find the slot and data offset for the next entry. Returns < 0 if the
+ * index is full or not usable.
+ */
+static int tc_next_slot(const struct region_device *rdev, size_t *offset)
+{
+	struct tc_header h;
+	struct tc_record r;
+	int used;
+
+	if (tc_read_header(rdev, &h) < 0)
+		return -1;
+
+	used = tc_count_records(rdev);
+	if (used < 0 || used == TC_MAX_RECORDS)
+		return -1;
+
+	if (!used) {
+		*offset = TC_INDEX_SIZE;
+		return 0;
+	}
+
+	if (tc_read_record(rdev, used - 1, &r) < 0 ||
+	    !tc_record_in_bounds(rdev, &r))
+		return -1;
+
+	*offset = ALIGN_UP(r.offset + r.stored_size, TC_DATA_ALIGN);
+	return used;
+}
+
+/* Erase the region unless it already is, and write an empty index. */
+static int tc_start_over(const struct region_device *rdev)
+{
+	const size_t size = region_device_sz(rdev);
+	struct tc_header h = {
+		.signature = TC_SIGNATURE,
+		.format = TC_FORMAT,
+		.record_size = sizeof(struct tc_record),
+		.index_size = TC_INDEX_SIZE,
+	};
+	struct tc_header old;
+
+	if (!tc_read_header(rdev, &old))
+		h.erase_count = old.erase_count + 1;
+
+	if (!tc_is_erased(rdev, 0, size) &&
+	    rdev_eraseat(rdev, 0, size) != size)
+		return -1;
+
+	printk(BIOS_DEBUG, "Training cache: region erased %u times\n",
+	       h.erase_count);
+
+	return rdev_writeat(rdev, &h, 0, sizeof(h)) == sizeof(h) ? 0 : -1;
+}
+
+enum training_cache_result training_cache_update(
+	const struct region_device *rdev, uint32_t version,
+	const void *data, size_t size, uint32_t flags)
+{
+	struct training_cache_entry current;
+	struct tc_record r = {
+		.size = size,
+		.version = version,
+		.hash = training_cache_hash(data, size),
+		.flags = flags,
+	};
+	const uint32_t commit = TC_COMMITTED;
+	const size_t bound = (flags & TRAINING_CACHE_LZ4) ?
+		lz4_frame_bound(size) : size;
+	struct xxh32_ctx s;
+	size_t offset;
+	int slot;
+
+	if ((flags & TRAINING_CACHE_LZ4) &&
+	    !IS_ENABLED(CONFIG_TRAINING_CACHE_COMPRESS)) {
+		printk(BIOS_ERR, "Training cache: compression not built in\n");
+		return TRAINING_CACHE_OTHER_FAILURE;
+	}
+
+	if (!size || (flags & ~TRAINING_CACHE_LZ4) ||
+	    bound > region_device_sz(rdev) ||
+	    TC_INDEX_SIZE > region_device_sz(rdev) - bound) {
+		printk(BIOS_ERR, "Training cache: %zu bytes don't fit\n", size);
+		return TRAINING_CACHE_OTHER_FAILURE;
+	}
+
+	if (!training_cache_find(rdev, &current) &&
+	    current.version == version && current.size == size &&
+	    current.hash == r.hash && current.flags == flags)
+		return TRAINING_CACHE_UP_TO_DATE;
+
+	slot = tc_next_slot(rdev, &offset);
+	if (slot < 0 || offset > region_device_sz(rdev) - bound ||
+	    !tc_is_erased(rdev, tc_record_offset(slot), sizeof(r)) ||
+	    !tc_is_erased(rdev, offset, bound)) {
+		if (tc_start_over(rdev) < 0) {
+			printk(BIOS_ERR, "Training cache: erase failed\n");
+			return TRAINING_CACHE_ERASE_FAILURE;
+		}
+		slot = 0;
+		offset = TC_INDEX_SIZE;
+	}
+
+	xxh32_init(&s, 0);
+	if (IS_ENABLED(CONFIG_TRAINING_CACHE_COMPRESS) &&
+	    (flags & TRAINING_CACHE_LZ4)) {
+		const ssize_t stored = tc_write_lz4(rdev, offset, data, size,
+						    &s);
+		if (stored < 0)
+			goto write_failure;
+		r.stored_size = stored;
+	} else {
+		if (tc_write(rdev, data, offset, size, &s) < 0)
+			goto write_failure;
+		r.stored_size = size;
+	}
+	r.offset = offset;
+	r.stored_hash = xxh32_final(&s);
+
+	if (rdev_writeat(rdev, &r, tc_record_offset(slot),
+			 offsetof(struct tc_record, commit)) !=
+	    offsetof(struct tc_record, commit) ||
+	    rdev_writeat(rdev, &commit, tc_record_offset(slot) +
+			 offsetof(struct tc_record, commit), sizeof(commit)) !=
+	    sizeof(commit))
+		goto write_failure;
+
+	printk(BIOS_DEBUG, "Training cache: wrote entry %d, %u of %zu bytes\n",
+	       slot, r.stored_size, size);
+	return TRAINING_CACHE_UPDATED;
+
+write_failure:
+	printk(BIOS_ERR, "Training cache: write failed\n");
+	return TRAINING_CACHE_WRITE_FAILURE;
+}
+
+static int tc_locate_region(const char *fmap_name, const char *cbfs_name,
+			    struct region *region)
+{
+	uint32_t type = CBFS_TYPE_MRC_CACHE;
+	struct region_device data;
+	struct cbfsf fh;
+
+	if (fmap_name != NULL && !fmap_locate_area(fmap_name, region))
+		return 0;
+
+	if (cbfs_name == NULL || cbfs_boot_locate(&fh, cbfs_name, &type))
+		return -1;
+
+	cbfs_file_data(&data, &fh);
+	region->offset = region_device_offset(&data);
+	region->size = region_device_sz(&data);
+	return 0;
+}
+
+int training_cache_locate(const char *fmap_name, const char *cbfs_name,
+			  struct region_device *rdev)
+{
+	struct region region;
+
+	if (tc_locate_region(fmap_name, cbfs_name, &region) < 0)
+		return -1;
+
+	return boot_device_ro_subregion(&region, rdev);
+}
+
+int training_cache_locate_rw(const char *fmap_name, const char *cbfs_name,
+			     struct region_device *rdev)
+{
+	struct region region;
+
+	if (tc_locate_region(fmap_name, cbfs_name, &region) < 0)
+		return -1;
+
+	return boot_device_rw_subregion(&region, rdev);
+}
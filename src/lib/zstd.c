@@ -0,0 +1,127 @@
+/*
+ * coreboot interface to the Zstandard decoder in commonlib
+ *
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <commonlib/region.h>
+#include <commonlib/zstd_decoder.h>
+#include <console/console.h>
+#include <lib.h>
+#include <stdint.h>
+
+static size_t decompress(uint64_t *workspace, const void *src, size_t srcn,
+			 void *dst, size_t dstn)
+{
+	struct zstd_decoder d;
+
+	zstd_decoder_init(&d, workspace, dst, dstn);
+	d.in = src;
+	d.in_size = srcn;
+	if (zstd_decode(&d) != ZSTD_STATUS_END) {
+		printk(BIOS_WARNING, "zstd: Decoding error at byte %zu\n",
+		       d.pos);
+		return 0;
+	}
+	return d.pos;
+}
+
+static size_t decompress_in_place(uint64_t *workspace,
+				  const struct region_device *rdev,
+				  size_t offset, size_t srcn, void *dst,
+				  size_t dstn)
+{
+	const uint8_t *src = (uint8_t *)dst + dstn - srcn;
+	enum zstd_status status;
+	struct zstd_decoder d;
+	size_t used;
+
+	if (srcn > dstn)
+		return 0;
+
+	zstd_decoder_init(&d, workspace, dst, dstn);
+	d.in = src;
+	d.in_size = srcn;
+	status = zstd_decode_in_place(&d);
+	used = d.in - src;
+
+	/* Decode what is left straight from the boot device. */
+	if (status == ZSTD_STATUS_OK) {
+		void *map;
+
+		printk(BIOS_DEBUG, "zstd: Not enough room to decode in place "
+		       "after byte %zu\n", d.pos);
+		map = rdev_mmap(rdev, offset + used, srcn - used);
+		if (map == NULL)
+			return 0;
+		d.in = map;
+		d.in_size = srcn - used;
+		status = zstd_decode(&d);
+		rdev_munmap(rdev, map);
+	}
+
+	if (status != ZSTD_STATUS_END) {
+		printk(BIOS_WARNING, "zstd: Decoding error at byte %zu\n",
+		       d.pos);
+		return 0;
+	}
+	return d.pos;
+}
+
+/* All entry points share one workspace: decodes src if it is not NULL,
+ * otherwise the srcn bytes at offset in rdev that were read to the end of
+ * dst. */
+static size_t zstd_run(const struct region_device *rdev, size_t offset,
+		       const void *src, size_t srcn, void *dst, size_t dstn)
+{
+	MAYBE_STATIC uint64_t workspace[ZSTD_WORKSPACE_SIZE / sizeof(uint64_t)
+					+ 1];
+
+	if (src != NULL)
+		return decompress(workspace, src, srcn, dst, dstn);
+	return decompress_in_place(workspace, rdev, offset, srcn, dst, dstn);
+}
+
+size_t uzstdn(const void *src, size_t srcn, void *dst, size_t dstn)
+{
+	return zstd_run(NULL, 0, src, srcn, dst, dstn);
+}
+
+size_t uzstdn_in_place(const struct region_device *rdev, size_t offset,
+		       size_t srcn, void *dst, size_t dstn)
+{
+	return zstd_run(rdev, offset, NULL, srcn, dst, dstn);
+}
+
+size_t uzstdn_rdev(const struct region_device *rdev, size_t offset,
+		   size_t srcn, void *dst, size_t dstn)
+{
+	size_t out_size;
+	void *map;
+
+	if (srcn <= dstn) {
+		/* One bulk read to the end of dst, instead of having the
+		 * decoder read the boot device piecemeal. */
+		uint8_t *src = (uint8_t *)dst + dstn - srcn;
+
+		if (rdev_readat(rdev, src, offset, srcn) != srcn)
+			return 0;
+		return uzstdn_in_place(rdev, offset, srcn, dst, dstn);
+	}
+
+	map = rdev_mmap(rdev, offset, srcn);
+	if (map == NULL)
+		return 0;
+	out_size = uzstdn(map, srcn, dst, dstn);
+	rdev_munmap(rdev, map);
+	return out_size;
+}
@@ -17,149 +17,37 @@
 #include <string.h>
 #include <bootstate.h>
 #include <console/console.h>
-#include <cbfs.h>
-#include <fmap.h>
-#include <ip_checksum.h>
-#include <device/device.h>
 #include <cbmem.h>
-#include <spi-generic.h>
-#include <spi_flash.h>
+#include <training_cache.h>
 #include "mrc_cache.h"
 
-/* convert a pointer to flash area into the offset inside the flash */
-static inline u32 to_flash_offset(struct spi_flash *flash, void *p) {
-	return ((u32)p + flash->size);
-}
-
-static struct mrc_data_container *next_mrc_block(
-	struct mrc_data_container *mrc_cache)
-{
-	/* MRC data blocks are aligned within the region */
-	u32 mrc_size = sizeof(*mrc_cache) + mrc_cache->mrc_data_size;
-	if (mrc_size & (MRC_DATA_ALIGN - 1UL)) {
-		mrc_size &= ~(MRC_DATA_ALIGN - 1UL);
-		mrc_size += MRC_DATA_ALIGN;
-	}
-
-	u8 *region_ptr = (u8*)mrc_cache;
-	region_ptr += mrc_size;
-	return (struct mrc_data_container *)region_ptr;
-}
-
-static int is_mrc_cache(struct mrc_data_container *mrc_cache)
-{
-	return (!!mrc_cache) && (mrc_cache->mrc_signature == MRC_DATA_SIGNATURE);
-}
-
-/* Right now, the offsets for the MRC cache area are hard-coded in the
- * northbridge Kconfig if CONFIG_CHROMEOS is not set. In order to make
- * this more flexible, there are two of options:
- *  - Have each mainboard Kconfig supply a hard-coded offset
- *  - Use CBFS
- */
-static u32 get_mrc_cache_region(struct mrc_data_container **mrc_region_ptr)
-{
-	size_t region_size = 0;
-	*mrc_region_ptr = NULL;
-
-	if (IS_ENABLED(CONFIG_CHROMEOS)) {
-		struct region_device rdev;
-
-		if (fmap_locate_area_as_rdev("RW_MRC_CACHE", &rdev) == 0) {
-			region_size = region_device_sz(&rdev);
-			*mrc_region_ptr = rdev_mmap_full(&rdev);
-		}
-	} else {
-		*mrc_region_ptr = cbfs_boot_map_with_leak("mrc.cache",
-							CBFS_TYPE_MRC_CACHE,
-							&region_size);
-	}
-	return region_size;
-}
+#define MRC_CACHE_FMAP_NAME	"RW_MRC_CACHE"
+#define MRC_CACHE_CBFS_NAME	"mrc.cache"
 
 /*
- * Find the largest index block in the MRC cache. Return NULL if non is
- * found.
+ * Right now, the MRC cache area is the RW_MRC_CACHE FMAP region if
+ * CONFIG_CHROMEOS is set and the mrc.cache CBFS file otherwise.
  */
-static struct mrc_data_container *find_current_mrc_cache_local
-	(struct mrc_data_container *mrc_cache, u32 region_size)
+static int get_mrc_cache_region(struct region_device *rdev, int writable)
 {
-	u32 region_end;
-	u32 entry_id = 0;
-	struct mrc_data_container *mrc_next = mrc_cache;
-
-	region_end = (u32) mrc_cache + region_size;
-
-	/* Search for the last filled entry in the region */
-	while (is_mrc_cache(mrc_next)) {
-		entry_id++;
-		mrc_cache = mrc_next;
-		mrc_next = next_mrc_block(mrc_next);
-		if ((u32)mrc_next >= region_end) {
-			/* Stay in the MRC data region */
-			break;
-		}
-	}
-
-	if (entry_id == 0) {
-		printk(BIOS_ERR, "%s: No valid MRC cache found.\n", __func__);
-		return NULL;
-	}
+	const char *fmap_name = NULL;
+	const char *cbfs_name = MRC_CACHE_CBFS_NAME;
 
-	/* Verify checksum */
-	if (mrc_cache->mrc_checksum !=
-	    compute_ip_checksum(mrc_cache->mrc_data,
-				mrc_cache->mrc_data_size)) {
-		printk(BIOS_ERR, "%s: MRC cache checksum mismatch\n", __func__);
-		return NULL;
-	}
-
-	printk(BIOS_DEBUG, "%s: picked entry %u from cache block\n", __func__,
-	       entry_id - 1);
-
-	return mrc_cache;
-}
-
-/* SPI code needs malloc/free.
- * Also unknown if writing flash from XIP-flash code is a good idea
- */
-
-/* find the first empty block in the MRC cache area.
- * If there's none, return NULL.
- *
- * @mrc_cache_base - base address of the MRC cache area
- * @mrc_cache - current entry (for which we need to find next)
- * @region_size - total size of the MRC cache area
- */
-static struct mrc_data_container *find_next_mrc_cache
-		(struct mrc_data_container *mrc_cache_base,
-		 struct mrc_data_container *mrc_cache,
-		 u32 region_size)
-{
-	u32 region_end = (u32) mrc_cache_base + region_size;
-
-	mrc_cache = next_mrc_block(mrc_cache);
-	if ((u32)mrc_cache >= region_end) {
-		/* Crossed the boundary */
-		mrc_cache = NULL;
-		printk(BIOS_DEBUG, "%s: no available entries found\n",
-		       __func__);
-	} else {
-		printk(BIOS_DEBUG,
-		       "%s: picked next entry from cache block at %p\n",
-		       __func__, mrc_cache);
+	if (IS_ENABLED(CONFIG_CHROMEOS)) {
+		fmap_name = MRC_CACHE_FMAP_NAME;
+		cbfs_name = NULL;
 	}
 
-	return mrc_cache;
+	if (writable)
+		return training_cache_locate_rw(fmap_name, cbfs_name, rdev);
+	return training_cache_locate(fmap_name, cbfs_name, rdev);
 }
 
 static void update_mrc_cache(void *unused)
 {
 	printk(BIOS_DEBUG, "Updating MRC cache data.\n");
 	struct mrc_data_container *current = cbmem_find(CBMEM_ID_MRCDATA);
-	struct mrc_data_container *cache, *cache_base;
-	u32 cache_size;
-	int ret;
+	struct region_device rdev;
 
 	if (!current) {
 		printk(BIOS_ERR, "No MRC cache in cbmem. Can't update flash.\n");
@@ -170,86 +58,59 @@ static void update_mrc_cache(void *unused)
 		return;
 	}
 
-	cache_size = get_mrc_cache_region(&cache_base);
-	if (cache_base == NULL) {
+	if (get_mrc_cache_region(&rdev, 1)) {
 		printk(BIOS_ERR, "%s: could not find MRC cache area\n",
 		       __func__);
 		return;
 	}
 
-	/*
-	 * we need to:
-	 */
-	//  0. compare MRC data to last mrc-cache block (exit if same)
-	cache = find_current_mrc_cache_local(cache_base, cache_size);
-
-	if (cache && (cache->mrc_data_size == current->mrc_data_size) &&
-			(memcmp(cache, current, cache->mrc_data_size) == 0)) {
+	switch (training_cache_update(&rdev, 0, current,
+			sizeof(*current) + current->mrc_data_size, 0)) {
+	case TRAINING_CACHE_UP_TO_DATE:
 		printk(BIOS_DEBUG,
 			"MRC data in flash is up to date. No update.\n");
-		return;
-	}
-
-	//  1. use spi_flash_probe() to find the flash, then
-	spi_init();
-	struct spi_flash *flash = spi_flash_probe(0, 0);
-	if (!flash) {
-		printk(BIOS_DEBUG, "Could not find SPI device\n");
-		return;
-	}
-
-	//  2. look up the first unused block
-	if (cache)
-		cache = find_next_mrc_cache(cache_base, cache, cache_size);
-
-	/*
-	 * 3. if no such place exists, erase entire mrc-cache range & use
-	 * block 0. First time around the erase is not needed, but this is a
-	 * small overhead for simpler code.
-	 */
-	if (!cache) {
-		printk(BIOS_DEBUG,
-		       "Need to erase the MRC cache region of %d bytes at %p\n",
-		       cache_size, cache_base);
-
-		spi_flash_erase(flash, to_flash_offset(flash, cache_base),
-				cache_size);
-
-		/* we will start at the beginning again */
-		cache = cache_base;
-	}
-	//  4. write mrc data with flash->write()
-	printk(BIOS_DEBUG, "Finally: write MRC cache update to flash at %p\n",
-	       cache);
-	ret = spi_flash_write(flash, to_flash_offset(flash, cache),
-			current->mrc_data_size + sizeof(*current), current);
-
-	if (ret)
-		printk(BIOS_WARNING, "Writing the MRC cache failed with ret %d\n",
-				ret);
-	else
+		break;
+	case TRAINING_CACHE_UPDATED:
 		printk(BIOS_DEBUG, "Successfully wrote MRC cache\n");
+		break;
+	default:
+		printk(BIOS_WARNING, "Writing the MRC cache failed\n");
+		break;
+	}
 }
 
 BOOT_STATE_INIT_ENTRY(BS_WRITE_TABLES, BS_ON_ENTRY, update_mrc_cache, NULL);
 
 struct mrc_data_container *find_current_mrc_cache(void)
 {
-	struct mrc_data_container *cache_base;
-	u32 cache_size;
+	struct training_cache_entry entry;
+	struct mrc_data_container *cache;
+	struct region_device rdev;
 
-	cache_size = get_mrc_cache_region(&cache_base);
-	if (cache_base == NULL) {
+	if (get_mrc_cache_region(&rdev, 0)) {
 		printk(BIOS_ERR, "%s: could not find MRC cache area\n",
 		       __func__);
 		return NULL;
 	}
 
-	/*
-	 * we need to:
-	 */
-	//  0. compare MRC data to last mrc-cache block (exit if same)
-	return find_current_mrc_cache_local(cache_base, cache_size);
+	if (training_cache_find(&rdev, &entry)) {
+		printk(BIOS_ERR, "%s: No valid MRC cache found.\n", __func__);
+		return NULL;
+	}
+
+	/* The data is handed to MRC as is, so it is never compressed. */
+	cache = training_cache_map(&rdev, &entry);
+	if (cache == NULL || entry.size < sizeof(*cache) ||
+	    cache->mrc_signature != MRC_DATA_SIGNATURE ||
+	    entry.size != sizeof(*cache) + cache->mrc_data_size) {
+		printk(BIOS_ERR, "%s: MRC cache entry invalid\n", __func__);
+		return NULL;
+	}
+
+	printk(BIOS_DEBUG, "%s: picked entry %d from cache block\n", __func__,
+	       entry.slot);
+
+	return cache;
 }
 
 struct mrc_data_container *
@@ -278,7 +139,7 @@ store_current_mrc_cache(void *data, unsigned length)
 	if (output_len > length)
 		memset(mrcdata->mrc_data+length, 0, output_len - length);
 
-	mrcdata->mrc_checksum = compute_ip_checksum(mrcdata->mrc_data,
+	mrcdata->mrc_checksum = training_cache_hash(mrcdata->mrc_data,
 			     mrcdata->mrc_data_size);
 
 	return mrcdata;
@@ -19,30 +19,21 @@
 #include <cbmem.h>
 #include <elog.h>
 #include <fmap.h>
-#include <ip_checksum.h>
+#include <training_cache.h>
 #include <vboot/vboot_common.h>
 
 #include "mrc_cache.h"
 #include "nvm.h"
 
-#define MRC_DATA_ALIGN           0x1000
 #define MRC_DATA_SIGNATURE       (('M'<<0)|('R'<<8)|('C'<<16)|('D'<<24))
 
-/* The mrc_data_region describes the larger non-volatile area to store
- * mrc_saved_data objects.*/
+/* The mrc_data_region describes the memory-mapped area that gets
+ * protected once the cache is up to date. */
 struct mrc_data_region {
 	void *base;
 	uint32_t size;
 };
 
-enum result {
-	WRITE_FAILURE		= -1,
-	ERASE_FAILURE		= -2,
-	OTHER_FAILURE		= -3,
-	UPDATE_SUCCESS		= 0,
-	ALREADY_UPTODATE	= 1
-};
-
 /* common code */
 static int mrc_cache_get_region(const char *name,
 				struct mrc_data_region *region)
@@ -74,6 +65,17 @@ static int mrc_cache_get_region(const char *name,
 	return 0;
 }
 
+/*
+ * Other builds fall back to the mrc.cache file that is placed at
+ * CONFIG_MRC_SETTINGS_CACHE_BASE, which only backs the default cache.
+ */
+static const char *mrc_cache_cbfs_name(const char *name)
+{
+	if (IS_ENABLED(CONFIG_CHROMEOS) || strcmp(name, DEFAULT_MRC_CACHE))
+		return NULL;
+	return "mrc.cache";
+}
+
 /* Protect mrc region with a Protected Range Register */
 static int __protect_mrc_cache(const struct mrc_data_region *region,
 			       const char *name)
@@ -106,100 +108,46 @@ static int protect_mrc_cache(const char *name)
 	return __protect_mrc_cache(&region, name);
 }
 
-static int mrc_cache_in_region(const struct mrc_data_region *region,
-                               const struct mrc_saved_data *cache)
+static int mrc_cache_valid(const struct mrc_saved_data *cache, size_t size)
 {
-	uintptr_t region_end;
-	uintptr_t cache_end;
-
-	if ((uintptr_t)cache < (uintptr_t)region->base)
-		return 0;
-
-	region_end = (uintptr_t)region->base;
-	region_end += region->size;
-
-	if ((uintptr_t)cache >= region_end)
+	if (size < sizeof(*cache))
 		return 0;
 
-	if ((sizeof(*cache) + (uintptr_t)cache) >= region_end)
-		return 0;
-
-	cache_end = (uintptr_t)cache;
-	cache_end += cache->size + sizeof(*cache);
-
-	if (cache_end > region_end)
-		return 0;
-
-	return 1;
-}
-
-static int mrc_cache_valid(const struct mrc_data_region *region,
-                           const struct mrc_saved_data *cache)
-{
-	uint32_t checksum;
-
 	if (cache->signature != MRC_DATA_SIGNATURE)
 		return 0;
 
-	if (cache->size > region->size)
-		return 0;
-
-	checksum = compute_ip_checksum((void *)&cache->data[0], cache->size);
-
-	if (cache->checksum != checksum)
+	if (cache->size != size - sizeof(*cache))
 		return 0;
 
 	return 1;
 }
 
-static const struct mrc_saved_data *
-next_cache_block(const struct mrc_saved_data *cache)
-{
-	uintptr_t next = (uintptr_t)cache;
-
-	next += ALIGN(cache->size + sizeof(*cache), MRC_DATA_ALIGN);
-
-	return (const struct mrc_saved_data *)next;
-}
-
 /* Locate the most recently saved MRC data. */
-static int __mrc_cache_get_current(const struct mrc_data_region *region,
+static int __mrc_cache_get_current(const struct region_device *rdev,
                                    const struct mrc_saved_data **cache,
                                    uint32_t version)
 {
+	struct training_cache_entry entry;
 	const struct mrc_saved_data *msd;
-	const struct mrc_saved_data *verified_cache;
-	int slot = 0;
-
-	msd = region->base;
-
-	verified_cache = NULL;
 
-	while (mrc_cache_in_region(region, msd) &&
-	       mrc_cache_valid(region, msd)) {
-		verified_cache = msd;
-		msd = next_cache_block(msd);
-		slot++;
-	}
-
-	/*
-	 * Update pointer to the most recently saved MRC data before returning
-	 * any error. This ensures that the caller can use next available slot
-	 * if required.
-	 */
-	*cache = verified_cache;
+	*cache = NULL;
 
-	if (verified_cache == NULL)
+	if (training_cache_find(rdev, &entry) < 0)
 		return -1;
 
-	if (verified_cache->version != version) {
+	if (entry.version != version) {
 		printk(BIOS_DEBUG, "MRC: cache version mismatch: %x vs %x\n",
-			verified_cache->version, version);
+			entry.version, version);
 		return -1;
 	}
 
-	printk(BIOS_DEBUG, "MRC: cache slot %d @ %p\n", slot-1, verified_cache);
+	msd = training_cache_map(rdev, &entry);
+	if (msd == NULL || !mrc_cache_valid(msd, entry.size))
+		return -1;
+
+	printk(BIOS_DEBUG, "MRC: cache slot %d @ %p\n", entry.slot, msd);
 
+	*cache = msd;
 	return 0;
 }
 
@@ -207,7 +155,7 @@ int mrc_cache_get_current_from_region(const struct mrc_saved_data **cache,
 				      uint32_t version,
 				      const char *region_name)
 {
-	struct mrc_data_region region;
+	struct region_device rdev;
 
 	if (!region_name) {
 		printk(BIOS_ERR, "MRC: Requires memory retraining.\n");
@@ -216,13 +164,14 @@ int mrc_cache_get_current_from_region(const struct mrc_saved_data **cache,
 
 	printk(BIOS_ERR, "MRC: Using data from %s\n", region_name);
 
-	if (mrc_cache_get_region(region_name, &region) < 0) {
+	if (training_cache_locate(region_name,
+				  mrc_cache_cbfs_name(region_name), &rdev)) {
 		printk(BIOS_ERR, "MRC: Region %s not found. "
 		       "Requires memory retraining.\n", region_name);
 		return -1;
 	}
 
-	if (__mrc_cache_get_current(&region, cache, version) < 0) {
+	if (__mrc_cache_get_current(&rdev, cache, version) < 0) {
 		printk(BIOS_ERR, "MRC: Valid slot not found in %s."
 		       "Requires memory retraining.\n", region_name);
 		return -1;
@@ -245,12 +194,12 @@ int mrc_cache_get_current(const struct mrc_saved_data **cache)
 
 int mrc_cache_get_vardata(const struct mrc_saved_data **cache, uint32_t version)
 {
-	struct mrc_data_region region;
+	struct region_device rdev;
 
-	if (mrc_cache_get_region(VARIABLE_MRC_CACHE, &region) < 0)
+	if (training_cache_locate(VARIABLE_MRC_CACHE, NULL, &rdev))
 		return -1;
 
-	return __mrc_cache_get_current(&region, cache, version);
+	return __mrc_cache_get_current(&rdev, cache, version);
 }
 
 /* Fill in mrc_saved_data structure with payload. */
@@ -261,8 +210,7 @@ static void mrc_cache_fill(struct mrc_saved_data *cache, const void *data,
 	cache->size = size;
 	cache->version = version;
 	memcpy(&cache->data[0], data, size);
-	cache->checksum = compute_ip_checksum((void *)&cache->data[0],
-	                                      cache->size);
+	cache->checksum = training_cache_hash(&cache->data[0], cache->size);
 }
 
 static int _mrc_stash_data(const void *data, size_t size, uint32_t version,
@@ -308,53 +256,8 @@ int mrc_cache_stash_data(const void *data, size_t size)
 	return mrc_cache_stash_data_with_version(data, size, 0);
 }
 
-static int mrc_slot_valid(const struct mrc_data_region *region,
-                          const struct mrc_saved_data *slot,
-                          const struct mrc_saved_data *to_save)
-{
-	uintptr_t region_begin;
-	uintptr_t region_end;
-	uintptr_t slot_end;
-	uintptr_t slot_begin;
-	uint32_t size;
-
-	region_begin = (uintptr_t)region->base;
-	region_end = region_begin + region->size;
-	slot_begin = (uintptr_t)slot;
-	size = to_save->size + sizeof(*to_save);
-	slot_end = slot_begin + size;
-
-	if (slot_begin < region_begin || slot_begin >= region_end)
-		return 0;
-
-	if (size > region->size)
-		return 0;
-
-	if (slot_end > region_end || slot_end < region_begin)
-		return 0;
-
-	if (!nvm_is_erased(slot, size))
-		return 0;
-
-	return 1;
-}
-
-static const struct mrc_saved_data *
-mrc_cache_next_slot(const struct mrc_data_region *region,
-                    const struct mrc_saved_data *current_slot)
-{
-	const struct mrc_saved_data *next_slot;
-
-	if (current_slot == NULL) {
-		next_slot = region->base;
-	} else {
-		next_slot = next_cache_block(current_slot);
-	}
-
-	return next_slot;
-}
-
-static void log_event_cache_update(uint8_t slot, enum result res)
+static void log_event_cache_update(uint8_t slot,
+				   enum training_cache_result res)
 {
 	const int type = ELOG_TYPE_MEM_CACHE_UPDATE;
 	struct elog_event_mem_cache_update event = {
@@ -363,12 +266,12 @@ static void log_event_cache_update(uint8_t slot, enum result res)
 
 	/* Filter through interesting events only */
 	switch (res) {
-	case WRITE_FAILURE:				/* fall-through */
-	case ERASE_FAILURE:				/* fall-through */
-	case OTHER_FAILURE:				/* fall-through */
+	case TRAINING_CACHE_WRITE_FAILURE:		/* fall-through */
+	case TRAINING_CACHE_ERASE_FAILURE:		/* fall-through */
+	case TRAINING_CACHE_OTHER_FAILURE:		/* fall-through */
 		event.status = ELOG_MEM_CACHE_UPDATE_STATUS_FAIL;
 		break;
-	case UPDATE_SUCCESS:
+	case TRAINING_CACHE_UPDATED:
 		event.status = ELOG_MEM_CACHE_UPDATE_STATUS_SUCCESS;
 		break;
 	default:
@@ -379,63 +282,45 @@ static void log_event_cache_update(uint8_t slot, enum result res)
 		printk(BIOS_ERR, "Failed to log mem cache update event.\n");
 }
 
-static int update_mrc_cache_type(uint32_t cbmem_id, const char *region_name)
+static enum training_cache_result update_mrc_cache_type(uint32_t cbmem_id,
+						const char *region_name)
 {
 	const struct mrc_saved_data *current_boot;
-	const struct mrc_saved_data *current_saved;
-	const struct mrc_saved_data *next_slot;
-	struct mrc_data_region region;
-	int res;
+	struct region_device rdev;
+	enum training_cache_result res;
+	size_t size;
 
 	printk(BIOS_DEBUG, "MRC: Updating cache data.\n");
 
 	printk(BIOS_ERR, "MRC: Cache region selected - %s\n", region_name);
 
-	if (mrc_cache_get_region(region_name, &region)) {
+	if (training_cache_locate_rw(region_name,
+				     mrc_cache_cbfs_name(region_name), &rdev)) {
 		printk(BIOS_ERR, "MRC: Could not obtain cache region.\n");
-		return OTHER_FAILURE;
+		return TRAINING_CACHE_OTHER_FAILURE;
 	}
 
 	current_boot = cbmem_find(cbmem_id);
 	if (!current_boot) {
 		printk(BIOS_ERR, "MRC: No cache in cbmem.\n");
-		return OTHER_FAILURE;
+		return TRAINING_CACHE_OTHER_FAILURE;
 	}
 
-	if (!mrc_cache_valid(&region, current_boot)) {
+	size = sizeof(*current_boot) + current_boot->size;
+	if (!mrc_cache_valid(current_boot, size) ||
+	    current_boot->checksum !=
+	    training_cache_hash(&current_boot->data[0], current_boot->size)) {
 		printk(BIOS_ERR, "MRC: Cache data in cbmem invalid.\n");
-		return OTHER_FAILURE;
+		return TRAINING_CACHE_OTHER_FAILURE;
 	}
 
-	current_saved = NULL;
-
-	if (!__mrc_cache_get_current(&region, &current_saved,
-					current_boot->version)) {
-		if (current_saved->size == current_boot->size &&
-		    !memcmp(&current_saved->data[0], &current_boot->data[0],
-		            current_saved->size)) {
-			printk(BIOS_DEBUG, "MRC: Cache up to date.\n");
-			return ALREADY_UPTODATE;
-		}
-	}
-
-	next_slot = mrc_cache_next_slot(&region, current_saved);
-
-	if (!mrc_slot_valid(&region, next_slot, current_boot)) {
-		printk(BIOS_DEBUG, "MRC: Slot @ %p is invalid.\n", next_slot);
-		if (!nvm_is_erased(region.base, region.size)) {
-			if (nvm_erase(region.base, region.size) < 0) {
-				printk(BIOS_DEBUG, "MRC: Failure erasing "
-				       "region %s.\n", region_name);
-				return ERASE_FAILURE;
-			}
-		}
-		next_slot = region.base;
-	}
+	/* FSP reads the data in place, so it is stored uncompressed. */
+	res = training_cache_update(&rdev, current_boot->version, current_boot,
+				    size, 0);
+	if (res == TRAINING_CACHE_UP_TO_DATE)
+		printk(BIOS_DEBUG, "MRC: Cache up to date.\n");
 
-	res = nvm_write((void *)next_slot, current_boot, current_boot->size
-			 + sizeof(*current_boot));
-	return res < 0 ? WRITE_FAILURE : UPDATE_SUCCESS;
+	return res;
 }
 
 static void protect_mrc_region(void)
@@ -461,7 +346,7 @@ static void update_mrc_cache(void *unused)
 {
 	uint8_t slot;
 	const char *region_name;
-	enum result res;
+	enum training_cache_result res;
 
 	/* First update either recovery or default cache */
 	if (vboot_recovery_mode_enabled() &&
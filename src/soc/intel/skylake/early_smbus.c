@@ -28,3 +28,9 @@ u8 smbus_write_byte(u32 smbus_dev, u8 addr, u8 offset, u8 value)
 {
 	return do_smbus_write_byte(SMBUS_BASE_ADDRESS, addr, offset, value);
 }
+
+int smbus_i2c_block_read(u32 smbus_dev, u8 addr, u8 offset, u8 *buf,
+			 size_t len)
+{
+	return do_i2c_block_read(SMBUS_BASE_ADDRESS, addr, offset, buf, len);
+}
@@ -19,6 +19,8 @@
 #ifndef _SOC_SMBUS_H_
 #define _SOC_SMBUS_H_
 
+#include <stdint.h>
+
 /* PCI Configuration Space (D31:F3): SMBus */
 #define SMB_BASE		0x20
 #define HOSTC			0x40
@@ -58,5 +60,7 @@ int do_smbus_read_byte(unsigned smbus_base, unsigned device,
 		       unsigned address);
 int do_smbus_write_byte(unsigned smbus_base, unsigned device,
 			unsigned address, unsigned data);
+int do_i2c_block_read(unsigned smbus_base, unsigned device,
+		      unsigned offset, u8 *buf, unsigned bytes);
 
 #endif
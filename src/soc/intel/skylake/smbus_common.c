@@ -148,3 +148,62 @@ int do_smbus_write_byte(unsigned smbus_base, unsigned device,
 
 	return 0;
 }
+
+int do_i2c_block_read(unsigned smbus_base, unsigned device,
+		      unsigned offset, u8 *buf, unsigned bytes)
+{
+	unsigned loops = SMBUS_TIMEOUT;
+	unsigned char status;
+	unsigned bytes_read = 0;
+
+	if (!bytes)
+		return 0;
+
+	if (smbus_wait_until_ready(smbus_base) < 0)
+		return SMBUS_WAIT_UNTIL_READY_TIMEOUT;
+
+	/* Setup transaction */
+	/* Disable interrupts */
+	outb(inb(smbus_base + SMBHSTCTL) & (~1), smbus_base + SMBHSTCTL);
+	/* Set the device I'm talking too, the R/W bit stays clear */
+	outb((device & 0x7f) << 1, smbus_base + SMBXMITADD);
+	/* For I2C reads the offset goes into DATA1 */
+	outb(offset & 0xff, smbus_base + SMBHSTDAT1);
+	/* Set up for an I2C block read, flag the last byte if it's the only */
+	outb((inb(smbus_base + SMBHSTCTL) & 0xc3) | (0x6 << 2) |
+	     (bytes == 1 ? (1 << 5) : 0), smbus_base + SMBHSTCTL);
+	/* Clear any lingering errors, so the transaction will run */
+	outb(inb(smbus_base + SMBHSTSTAT), smbus_base + SMBHSTSTAT);
+
+	/* Start the command */
+	outb((inb(smbus_base + SMBHSTCTL) | 0x40),
+	     smbus_base + SMBHSTCTL);
+
+	while (bytes_read < bytes) {
+		smbus_delay();
+		if (--loops == 0)
+			return SMBUS_WAIT_UNTIL_DONE_TIMEOUT;
+
+		status = inb(smbus_base + SMBHSTSTAT);
+		/* Failed, bus error or device error */
+		if (status & ((1 << 4) | (1 << 3) | (1 << 2)))
+			return SMBUS_ERROR;
+		/* Wait for byte done */
+		if (!(status & (1 << 7)))
+			continue;
+
+		buf[bytes_read++] = inb(smbus_base + SMBBLKDAT);
+		/* The controller has to know before it reads the last byte */
+		if (bytes_read == bytes - 1)
+			outb(inb(smbus_base + SMBHSTCTL) | (1 << 5),
+			     smbus_base + SMBHSTCTL);
+		/* Clear byte done to get the next one */
+		outb(1 << 7, smbus_base + SMBHSTSTAT);
+		loops = SMBUS_TIMEOUT;
+	}
+
+	if (smbus_wait_until_ready(smbus_base) < 0)
+		return SMBUS_WAIT_UNTIL_READY_TIMEOUT;
+
+	return bytes_read;
+}
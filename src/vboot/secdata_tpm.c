@@ -66,6 +66,8 @@ static uint32_t read_space_firmware(struct vb2_context *ctx)
 			return TPM_SUCCESS;
 
 		VBDEBUG("TPM: %s() - bad CRC\n", __func__);
+		/* Read the space again rather than the cached copy. */
+		tlcl_cache_flush();
 	}
 
 	VBDEBUG("TPM: %s() - too many bad CRCs, giving up\n", __func__);
@@ -0,0 +1,75 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* Helpers of the host benchmarks, which "make bench" runs on BENCH_FILES. */
+
+#ifndef TESTS_BENCH_H
+#define TESTS_BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Best of this many runs, unless the benchmark is told otherwise. */
+#define BENCH_RUNS	15
+
+static inline uint64_t bench_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* MB/s (10^6 bytes per second) for size bytes in ns nanoseconds. */
+static inline double bench_mbps(size_t size, uint64_t ns)
+{
+	return ns ? size * 1000.0 / ns : 0;
+}
+
+/* Reads all of path into a new buffer, or exits. */
+static inline uint8_t *bench_read_file(const char *path, size_t *size)
+{
+	FILE *f = fopen(path, "rb");
+	uint8_t *buf;
+	long len;
+
+	if (!f || fseek(f, 0, SEEK_END) || (len = ftell(f)) < 0 ||
+	    fseek(f, 0, SEEK_SET)) {
+		perror(path);
+		exit(1);
+	}
+	buf = malloc(len + 1);
+	if (!buf || fread(buf, 1, len, f) != (size_t)len) {
+		perror(path);
+		exit(1);
+	}
+	fclose(f);
+	*size = len;
+	return buf;
+}
+
+/* The last component of path, for tables. */
+static inline const char *bench_name(const char *path)
+{
+	const char *p, *name = path;
+
+	for (p = path; *p; p++) {
+		if (*p == '/')
+			name = p + 1;
+	}
+	return name;
+}
+
+#endif /* TESTS_BENCH_H */
@@ -0,0 +1,188 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * The decompression checks of "cbfstool verify" on a 64 KiB CBFS region:
+ * files, stages and payload segments that expand to a megabyte, far past
+ * the region, must pass. Files that decompress to another size than they
+ * claim, claim more than any file can be, or are corrupted must fail.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "cbfs.h"
+#include "cbfs_image.h"
+
+#define REGION_SIZE	(64 * KiB)
+#define DATA_SIZE	(1 * MiB)
+
+static struct cbfs_image image;
+static char data[DATA_SIZE];
+static char packed[DATA_SIZE];
+static int packed_size;
+
+/* Compresses data with cbfstool's LZMA. It packs into a few KiB. */
+static void make_data(void)
+{
+	comp_func_ptr compress = compression_function(CBFS_COMPRESS_LZMA);
+	size_t i;
+
+	for (i = 0; i < DATA_SIZE; i++)
+		data[i] = i % 4096 < 64 ? (char)(i * 7 / 3) : (char)(i >> 12);
+	assert(compress);
+	assert(compress(data, DATA_SIZE, packed, &packed_size) == 0);
+	assert(packed_size < REGION_SIZE / 4);
+}
+
+/* Puts a file of type with the len bytes at content at the start of the
+ * region, compressed as a whole with decompressed_size if that is not 0. */
+static struct cbfs_file *put_file(uint32_t type, const void *content,
+				  size_t len, uint32_t decompressed_size)
+{
+	struct cbfs_file *header = cbfs_create_file_header(type, len, "test");
+	struct cbfs_file *entry = (struct cbfs_file *)image.buffer.data;
+
+	if (decompressed_size) {
+		struct cbfs_file_attr_compression *attr =
+			(struct cbfs_file_attr_compression *)
+			cbfs_add_file_attr(header,
+					   CBFS_FILE_ATTR_TAG_COMPRESSION,
+					   sizeof(*attr));
+
+		assert(attr);
+		attr->compression = htonl(CBFS_COMPRESS_LZMA);
+		attr->decompressed_size = htonl(decompressed_size);
+	}
+
+	memset(image.buffer.data, 0xff, REGION_SIZE);
+	assert(ntohl(header->offset) + len <= REGION_SIZE);
+	memcpy(entry, header, ntohl(header->offset));
+	memcpy(CBFS_SUBHEADER(entry), content, len);
+	free(header);
+	return entry;
+}
+
+/* The files have no hash attributes, so nothing is hashed. */
+int vb2_digest_buffer(const uint8_t *buf, uint32_t size,
+		      enum vb2_hash_algorithm hash_alg, uint8_t *digest,
+		      uint32_t digest_size)
+{
+	abort();
+}
+
+static enum cbfs_check check(struct cbfs_file *entry)
+{
+	struct cbfs_entry_checks checks;
+
+	cbfs_verify_entry(&image, entry, &checks);
+	assert(checks.hash == CBFS_CHECK_NONE);
+	return checks.compression;
+}
+
+static void test_raw(void)
+{
+	struct cbfs_file *entry;
+
+	entry = put_file(CBFS_COMPONENT_RAW, packed, packed_size, DATA_SIZE);
+	assert(check(entry) == CBFS_CHECK_OK);
+
+	/* The recorded size must be exact. */
+	entry = put_file(CBFS_COMPONENT_RAW, packed, packed_size,
+			 DATA_SIZE + 1);
+	assert(check(entry) == CBFS_CHECK_FAILED);
+	entry = put_file(CBFS_COMPONENT_RAW, packed, packed_size,
+			 DATA_SIZE - 1);
+	assert(check(entry) == CBFS_CHECK_FAILED);
+
+	/* More than the cap is never decompressed. */
+	entry = put_file(CBFS_COMPONENT_RAW, packed, packed_size, 1u << 31);
+	assert(check(entry) == CBFS_CHECK_FAILED);
+
+	/* Neither is damaged data. */
+	packed[packed_size / 2] ^= 0x55;
+	entry = put_file(CBFS_COMPONENT_RAW, packed, packed_size, DATA_SIZE);
+	assert(check(entry) == CBFS_CHECK_FAILED);
+	packed[packed_size / 2] ^= 0x55;
+}
+
+/* A stage with a megabyte of code and as much bss. */
+static void test_stage(void)
+{
+	static char stage[sizeof(struct cbfs_stage) + DATA_SIZE];
+	struct cbfs_stage *s = (struct cbfs_stage *)stage;
+	struct cbfs_file *entry;
+
+	s->compression = htole32(CBFS_COMPRESS_LZMA);
+	s->entry = htole64(0x100000);
+	s->load = htole64(0x100000);
+	s->len = htole32(packed_size);
+	s->memlen = htole32(2 * DATA_SIZE);
+	memcpy(stage + sizeof(*s), packed, packed_size);
+	entry = put_file(CBFS_COMPONENT_STAGE, stage,
+			 sizeof(*s) + packed_size, 0);
+	assert(check(entry) == CBFS_CHECK_OK);
+
+	/* Code that is larger than memlen fails. */
+	s->memlen = htole32(DATA_SIZE - 1);
+	entry = put_file(CBFS_COMPONENT_STAGE, stage,
+			 sizeof(*s) + packed_size, 0);
+	assert(check(entry) == CBFS_CHECK_FAILED);
+}
+
+/* A payload with a code segment of a megabyte. */
+static void test_payload(void)
+{
+	static char payload[2 * sizeof(struct cbfs_payload_segment) +
+			    DATA_SIZE];
+	struct cbfs_payload_segment *seg =
+		(struct cbfs_payload_segment *)payload;
+	struct cbfs_file *entry;
+	size_t len = 2 * sizeof(*seg) + packed_size;
+
+	memset(payload, 0, sizeof(payload));
+	seg[0].type = htonl(PAYLOAD_SEGMENT_CODE);
+	seg[0].compression = htonl(CBFS_COMPRESS_LZMA);
+	seg[0].offset = htonl(2 * sizeof(*seg));
+	seg[0].load_addr = htonll(0x100000);
+	seg[0].len = htonl(packed_size);
+	seg[0].mem_len = htonl(DATA_SIZE);
+	seg[1].type = htonl(PAYLOAD_SEGMENT_ENTRY);
+	seg[1].load_addr = htonll(0x100000);
+	memcpy(payload + 2 * sizeof(*seg), packed, packed_size);
+	entry = put_file(CBFS_COMPONENT_PAYLOAD, payload, len, 0);
+	assert(check(entry) == CBFS_CHECK_OK);
+
+	seg[0].mem_len = htonl(DATA_SIZE / 2);
+	entry = put_file(CBFS_COMPONENT_PAYLOAD, payload, len, 0);
+	assert(check(entry) == CBFS_CHECK_FAILED);
+}
+
+int main(void)
+{
+	image.buffer.data = malloc(REGION_SIZE);
+	image.buffer.size = REGION_SIZE;
+	assert(image.buffer.data);
+
+	make_data();
+	test_raw();
+	test_stage();
+	test_payload();
+
+	free(image.buffer.data);
+	printf("cbfs-verify-test: passed\n");
+	return 0;
+}
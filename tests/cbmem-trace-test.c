@@ -0,0 +1,143 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Folding of cbmem's function traces. Calls nest deeper than the
+ * TRACE_MAX_DEPTH frames fold_trace() records, once through one recursive
+ * function and once through distinct ones, and then return. A call made
+ * afterwards must be charged to the stack it was made from.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define main cbmem_main
+#include "../util/cbmem/cbmem.c"
+#undef main
+
+#define RING_ENTRIES	1024
+#define NESTED		300
+
+#define FUNC_MAIN	0x1000
+#define FUNC_LEAF	0x3000
+#define FUNC_RECURSE	0x2000
+#define FUNC_DISTINCT	0x10000
+
+static struct trace_buffer *trace;
+static uint64_t stamp;
+
+static void record(uint64_t func, int exit_rec)
+{
+	struct trace_ring *ring = trace_buffer_ring(trace, 0);
+	struct trace_entry *e = &ring->entries[ring->head++];
+
+	assert(ring->head <= RING_ENTRIES);
+	e->func = func;
+	e->stamp = ++stamp | (exit_rec ? TRACE_EXIT : 0);
+}
+
+static void new_trace(void)
+{
+	size_t size = sizeof(*trace) + sizeof(struct trace_ring) +
+		RING_ENTRIES * sizeof(struct trace_entry);
+
+	free(trace);
+	trace = calloc(1, size);
+	assert(trace);
+	trace->magic = TRACE_BUFFER_MAGIC;
+	trace->version = TRACE_BUFFER_VERSION;
+	trace->num_cpus = 1;
+	trace->ring_entries = RING_ENTRIES;
+	trace->tick_freq_mhz = 1;
+	assert(trace_buffer_valid(trace, size));
+	stamp = 0;
+}
+
+static uint64_t find_stack(const struct folded_stack *stacks, size_t n,
+			   const char *path)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		if (!strcmp(stacks[i].path, path))
+			return stacks[i].ticks;
+	}
+	return 0;
+}
+
+/*
+ * main calls NESTED levels of func(level), which all return, then calls
+ * the leaf and returns itself.
+ */
+static void test_deep(uint64_t (*func)(int level))
+{
+	struct folded_stack *stacks;
+	uint64_t total = 0;
+	size_t n, i;
+	int level;
+
+	new_trace();
+	record(FUNC_MAIN, 0);
+	for (level = 0; level < NESTED; level++)
+		record(func(level), 0);
+	for (level = NESTED - 1; level >= 0; level--)
+		record(func(level), 1);
+	record(FUNC_LEAF, 0);
+	record(FUNC_LEAF, 1);
+	record(FUNC_MAIN, 1);
+
+	stacks = fold_trace(trace, &n);
+	for (i = 0; i < n; i++) {
+		total += stacks[i].ticks;
+		/* The leaf only ever runs under main. */
+		if (strstr(stacks[i].path, "0x3000"))
+			assert(!strcmp(stacks[i].path, "cpu0;0x1000;0x3000"));
+		free(stacks[i].path);
+	}
+	free(stacks);
+
+	/* Every record but the first ends a span spent inside main. */
+	assert(total == stamp - 1);
+
+	stacks = fold_trace(trace, &n);
+	assert(find_stack(stacks, n, "cpu0;0x1000;0x3000") == 1);
+	/* main runs alone before the first call and after each return. */
+	assert(find_stack(stacks, n, "cpu0;0x1000") == 3);
+	for (i = 0; i < n; i++)
+		free(stacks[i].path);
+	free(stacks);
+}
+
+static uint64_t recursive(int level)
+{
+	return FUNC_RECURSE;
+}
+
+static uint64_t distinct(int level)
+{
+	return FUNC_DISTINCT + level;
+}
+
+int main(void)
+{
+	timestamp_set_tick_freq(1);
+
+	test_deep(recursive);
+	test_deep(distinct);
+
+	free(trace);
+	printf("cbmem-trace-test: passed\n");
+	return 0;
+}
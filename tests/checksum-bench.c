@@ -0,0 +1,160 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Speed of the shared checksums against the loops they replaced: the IP
+ * checksum byte loop of src/lib/compute_ip_checksum.c and the bitwise CRC
+ * of the DDR3 SPD code. Both pairs must agree. Data is random, at a few
+ * sizes from a network packet up to a large CBMEM table. Built like
+ * checksum-test, once as the compiler targets the host and once scalar.
+ *
+ *   checksum-bench [-r runs]
+ */
+
+#include <assert.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/commonlib/checksum.c"
+#include "bench.h"
+
+#define BUF_SIZE	(4 << 20)
+/* Bytes checksummed per timed run, whatever the size of each call */
+#define RUN_BYTES	(16 << 20)
+
+/* compute_ip_checksum() as it was, with the same types. */
+static unsigned long old_ip_checksum(void *addr, unsigned long length)
+{
+	uint8_t *ptr;
+	volatile union {
+		uint8_t  byte[2];
+		uint16_t word;
+	} value;
+	unsigned long sum;
+	unsigned long i;
+
+	sum = 0;
+	ptr = addr;
+	for (i = 0; i < length; i++) {
+		unsigned long v;
+		v = ptr[i];
+		if (i & 1)
+			v <<= 8;
+		sum += v;
+		if (sum > 0xFFFF)
+			sum = (sum + (sum >> 16)) & 0xFFFF;
+	}
+	value.byte[0] = sum & 0xff;
+	value.byte[1] = (sum >> 8) & 0xff;
+	return (~value.word) & 0xFFFF;
+}
+
+/* crc16() of src/device/dram/ddr3.c as it was. */
+static uint16_t old_crc16(const uint8_t *ptr, int n_crc)
+{
+	int i;
+	uint16_t crc = 0;
+
+	while (--n_crc >= 0) {
+		crc = crc ^ ((int)*ptr++ << 8);
+		for (i = 0; i < 8; ++i)
+			if (crc & 0x8000)
+				crc = (crc << 1) ^ 0x1021;
+			else
+				crc = crc << 1;
+	}
+	return crc;
+}
+
+enum func { OLD_IP, NEW_IP, OLD_CRC, NEW_CRC, XXH32, FUNCS };
+
+static const char *const names[FUNCS] = {
+	"ip old", "ip new", "crc16 old", "crc16 new", "xxh32",
+};
+
+static uint8_t buf[BUF_SIZE];
+
+static uint32_t run_func(enum func f, const uint8_t *p, size_t size)
+{
+	switch (f) {
+	case OLD_IP:
+		return old_ip_checksum((void *)p, size);
+	case NEW_IP:
+		return ip_checksum(p, size);
+	case OLD_CRC:
+		return old_crc16(p, size);
+	case NEW_CRC:
+		return crc16_ccitt(0, p, size);
+	default:
+		return xxh32(p, size, 0);
+	}
+}
+
+/* Best time of runs runs of RUN_BYTES in calls of size bytes each. */
+static uint64_t bench_func(enum func f, size_t size, int runs)
+{
+	size_t calls = RUN_BYTES / size, i;
+	uint64_t best = UINT64_MAX;
+	volatile uint32_t sink;
+	int run;
+
+	for (run = 0; run < runs; run++) {
+		uint64_t start = bench_now_ns(), ns;
+
+		for (i = 0; i < calls; i++)
+			sink = run_func(f, buf + (i * size) % BUF_SIZE, size);
+		ns = bench_now_ns() - start;
+		if (ns < best)
+			best = ns;
+	}
+	(void)sink;
+	return best;
+}
+
+int main(int argc, char **argv)
+{
+	static const size_t sizes[] = { 64, 1500, 64 << 10, 4 << 20 };
+	int runs = BENCH_RUNS;
+	size_t i, s;
+	int opt, f;
+
+	while ((opt = getopt(argc, argv, "r:")) != -1) {
+		if (opt != 'r' || (runs = atoi(optarg)) < 1) {
+			fprintf(stderr, "usage: %s [-r runs]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	srand(1);
+	for (i = 0; i < BUF_SIZE; i++)
+		buf[i] = rand();
+	for (s = 0; s < ARRAY_SIZE(sizes); s++) {
+		assert(old_ip_checksum(buf, sizes[s]) ==
+		       ip_checksum(buf, sizes[s]));
+		assert(old_crc16(buf, sizes[s]) ==
+		       crc16_ccitt(0, buf, sizes[s]));
+	}
+
+	printf("%-8s", "size");
+	for (f = 0; f < FUNCS; f++)
+		printf(" %11s", names[f]);
+	printf("    (MB/s)\n");
+	for (s = 0; s < ARRAY_SIZE(sizes); s++) {
+		printf("%-8zu", sizes[s]);
+		for (f = 0; f < FUNCS; f++)
+			printf(" %11.0f", bench_mbps(RUN_BYTES / sizes[s] *
+				sizes[s], bench_func(f, sizes[s], runs)));
+		printf("\n");
+	}
+	return 0;
+}
@@ -0,0 +1,148 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * The shared checksums against straightforward bit and byte loops, for
+ * every alignment, for lengths around the vector and word sizes, and for
+ * data fed to the contexts in random pieces. Built once as the compiler
+ * targets the host, and once with the vector path disabled.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/commonlib/checksum.c"
+
+#define BUF_SIZE	(1 << 20)
+
+/* RFC 1071, one byte at a time, in native byte order. */
+static uint16_t ref_ip_checksum(const uint8_t *p, size_t size)
+{
+	const uint16_t one = 1;
+	const int little = *(const uint8_t *)&one;
+	uint32_t sum = 0;
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		sum += (i & 1) == little ? p[i] << 8 : p[i];
+		sum = (sum & 0xffff) + (sum >> 16);
+	}
+	return ~sum;
+}
+
+static uint16_t ref_crc16_ccitt(const uint8_t *p, size_t size)
+{
+	uint16_t crc = 0;
+	int i;
+
+	while (size--) {
+		crc ^= *p++ << 8;
+		for (i = 0; i < 8; i++)
+			crc = crc & 0x8000 ? crc << 1 ^ 0x1021 : crc << 1;
+	}
+	return crc;
+}
+
+static void test_vectors(void)
+{
+	assert(xxh32("", 0, 0) == 0x02cc5d05);
+	assert(xxh32("abc", 3, 0) == 0x32d153ff);
+	assert(xxh32("Nobody inspects the spammish repetition", 39, 0) ==
+	       0xe2293b2f);
+	assert(crc16_ccitt(0, "123456789", 9) == 0x31c3);
+	assert(ip_checksum("", 0) == 0xffff);
+}
+
+static void test_alignments(const uint8_t *buf)
+{
+	size_t offset, size;
+
+	for (offset = 0; offset < 32; offset++) {
+		for (size = 0; size < 600; size++) {
+			const uint8_t *p = buf + offset;
+
+			assert(ip_checksum(p, size) ==
+			       ref_ip_checksum(p, size));
+			assert(crc16_ccitt(0, p, size) ==
+			       ref_crc16_ccitt(p, size));
+		}
+	}
+}
+
+static void test_pieces(const uint8_t *buf)
+{
+	int i;
+
+	for (i = 0; i < 2000; i++) {
+		size_t offset = rand() % 64;
+		size_t size = rand() % (i < 1800 ? 4096 : BUF_SIZE - 64);
+		size_t split = size ? rand() % size : 0;
+		const uint8_t *p = buf + offset;
+		struct ip_checksum_ctx ip;
+		struct xxh32_ctx xxh;
+		uint16_t sum = ip_checksum(p, size);
+		size_t pos, n;
+
+		if (size < 0x10000)
+			assert(sum == ref_ip_checksum(p, size));
+
+		ip_checksum_init(&ip);
+		xxh32_init(&xxh, i);
+		for (pos = 0; pos < size; pos += n) {
+			n = rand() % 8 ? rand() % 300 : rand() % 200000;
+			n = MIN(n, size - pos);
+			ip_checksum_update(&ip, p + pos, n);
+			xxh32_update(&xxh, p + pos, n);
+		}
+		assert(ip_checksum_final(&ip) == sum);
+		assert(xxh32_final(&xxh) == xxh32(p, size, i));
+
+		assert(ip_checksum_add(split, ip_checksum(p, split),
+				       ip_checksum(p + split, size - split)) ==
+		       sum);
+	}
+}
+
+int main(void)
+{
+	uint8_t *buf = malloc(BUF_SIZE);
+	size_t i;
+
+	assert(buf != NULL);
+	srand(1);
+	for (i = 0; i < BUF_SIZE; i++)
+		buf[i] = rand();
+	/* Long runs of 0xff carry out of every lane. */
+	memset(buf + 1000, 0xff, 70000);
+
+	test_vectors();
+	test_alignments(buf);
+	test_alignments(buf + 1000);
+	test_pieces(buf);
+
+	memset(buf, 0xff, BUF_SIZE);
+	assert(ip_checksum(buf + 1, BUF_SIZE - 3) ==
+	       ref_ip_checksum(buf + 1, BUF_SIZE - 3));
+	memset(buf, 0, BUF_SIZE);
+	assert(ip_checksum(buf + 3, BUF_SIZE - 3) == 0xffff);
+
+	free(buf);
+#ifdef IPC_VECTOR
+	printf("checksum-test: vector passed\n");
+#else
+	printf("checksum-test: scalar passed\n");
+#endif
+	return 0;
+}
@@ -0,0 +1,198 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Ratio and decompression speed of the CBFS compression algorithms on
+ * the given files, usually stages and payloads. Each file is compressed
+ * with cbfstool's settings and decompressed with the decoders coreboot
+ * runs, ulzman(), ulz4fn() and uzstdn(), whose output must match the file.
+ * Speeds are of the decompressed output, best of a number of runs.
+ *
+ *   compress-bench [-r runs] file...
+ */
+
+#include <assert.h>
+#include <lib.h>
+#include <string.h>
+#include <unistd.h>
+#include <commonlib/compression.h>
+#include <commonlib/lzma_decoder.h>
+
+#include "../util/cbfstool/lzma/C/LzmaEnc.h"
+#include "../util/cbfstool/lz4/lib/lz4frame.h"
+#include "../util/cbfstool/zstd/lib/zstd.h"
+#include "bench.h"
+
+static void *sz_alloc(void *p, size_t size)
+{
+	return malloc(size);
+}
+
+static void sz_free(void *p, void *address)
+{
+	free(address);
+}
+
+static struct ISzAlloc alloc = { sz_alloc, sz_free };
+
+/* As util/cbfstool/lzma/lzma.c does. */
+static size_t lzma_compress(const void *src, size_t len, void *dst,
+			    size_t dstn)
+{
+	struct CLzmaEncProps props;
+	size_t props_size = LZMA_PROPS_SIZE;
+	size_t size = dstn - LZMA_HEADER_SIZE;
+	uint8_t *out = dst;
+	int i;
+
+	LzmaEncProps_Init(&props);
+	props.dictSize = len;
+	props.lc = 1;
+	props.lp = 0;
+	props.pb = 0;
+	props.fb = 273;
+	props.algo = 1;
+	props.level = 9;
+	props.btMode = 1;
+	props.numHashBytes = 4;
+	props.mc = 0;
+	props.numThreads = 1;
+	if (LzmaEncode(out + LZMA_HEADER_SIZE, &size, src, len, &props, out,
+		       &props_size, 0, NULL, &alloc, &alloc) != SZ_OK)
+		return 0;
+	for (i = 0; i < 8; i++)
+		out[LZMA_PROPS_SIZE + i] = (uint64_t)len >> (8 * i);
+	return LZMA_HEADER_SIZE + size;
+}
+
+/* As lz4_compress() in util/cbfstool/compress.c does. */
+static size_t lz4_compress(const void *src, size_t len, void *dst,
+			   size_t dstn)
+{
+	LZ4F_preferences_t prefs = {
+		.compressionLevel = 20,
+		.frameInfo = {
+			.blockSizeID = max4MB,
+			.blockMode = blockIndependent,
+			.contentChecksumFlag = noContentChecksum,
+		},
+	};
+	size_t size = LZ4F_compressFrame(dst, dstn, src, len, &prefs);
+
+	return LZ4F_isError(size) ? 0 : size;
+}
+
+/* As zstd_compress() in util/cbfstool/compress.c does. */
+static size_t zstd_compress(const void *src, size_t len, void *dst,
+			    size_t dstn)
+{
+	ZSTD_CCtx *cctx = ZSTD_createCCtx();
+	size_t size;
+
+	assert(cctx);
+	ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel,
+			       ZSTD_maxCLevel());
+	ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 0);
+	ZSTD_CCtx_setParameter(cctx, ZSTD_c_contentSizeFlag, 1);
+	size = ZSTD_compress2(cctx, dst, dstn, src, len);
+	ZSTD_freeCCtx(cctx);
+	return ZSTD_isError(size) ? 0 : size;
+}
+
+static const struct algo {
+	const char *name;
+	size_t (*compress)(const void *src, size_t len, void *dst,
+			   size_t dstn);
+	size_t (*decompress)(const void *src, size_t srcn, void *dst,
+			     size_t dstn);
+} algos[] = {
+	{ "LZMA", lzma_compress, ulzman },
+	{ "LZ4", lz4_compress, ulz4fn },
+	{ "ZSTD", zstd_compress, uzstdn },
+};
+
+static void bench_file(const char *path, int runs)
+{
+	size_t size, packed_size, bound, i;
+	uint8_t *data, *packed, *out;
+	int run;
+
+	data = bench_read_file(path, &size);
+	bound = size + size / 4 + 64 * 1024;
+	packed = malloc(bound);
+	out = malloc(size + 1);
+	assert(packed && out);
+
+	printf("%-20s %9zu", bench_name(path), size);
+	for (i = 0; i < ARRAY_SIZE(algos); i++) {
+		const struct algo *a = &algos[i];
+		uint64_t best = UINT64_MAX;
+
+		packed_size = a->compress(data, size, packed, bound);
+		if (!packed_size) {
+			fprintf(stderr, "%s: %s compression failed\n", path,
+				a->name);
+			exit(1);
+		}
+		for (run = 0; run < runs; run++) {
+			uint64_t start, ns;
+
+			memset(out, 0, size);
+			start = bench_now_ns();
+			if (a->decompress(packed, packed_size, out,
+					  size) != size ||
+			    memcmp(out, data, size)) {
+				fprintf(stderr, "%s: %s output differs\n",
+					path, a->name);
+				exit(1);
+			}
+			ns = bench_now_ns() - start;
+			if (ns < best)
+				best = ns;
+		}
+		printf("  %5.1f%% %7.0fMB/s", packed_size * 100.0 / size,
+		       bench_mbps(size, best));
+	}
+	printf("\n");
+
+	free(out);
+	free(packed);
+	free(data);
+}
+
+int main(int argc, char **argv)
+{
+	int runs = BENCH_RUNS;
+	size_t i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "r:")) != -1) {
+		if (opt != 'r' || (runs = atoi(optarg)) < 1) {
+			fprintf(stderr, "usage: %s [-r runs] file...\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	if (optind == argc) {
+		fprintf(stderr, "usage: %s [-r runs] file...\n", argv[0]);
+		return 1;
+	}
+
+	printf("%-20s %9s", "file", "size");
+	for (i = 0; i < ARRAY_SIZE(algos); i++)
+		printf("  %-18s", algos[i].name);
+	printf("\n");
+	for (; optind < argc; optind++)
+		bench_file(argv[optind], runs);
+	return 0;
+}
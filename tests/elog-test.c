@@ -0,0 +1,221 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Event log over many boots on a simulated RW_ELOG, where writes can only
+ * clear bits and erases are 4KiB aligned. The mirror must always match
+ * the flash, with or without the write cursor index.
+ */
+
+#ifndef TEST_ELOG_INDEX
+#define TEST_ELOG_INDEX 1
+#endif
+#define CONFIG_ELOG 1
+#define CONFIG_ELOG_INDEX TEST_ELOG_INDEX
+#define CONFIG_HAVE_ACPI_RESUME 0
+#define CONFIG_ARCH_X86 0
+#define CONFIG_ELOG_BOOT_COUNT 0
+
+#include <kconfig.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/drivers/elog/elog.c"
+
+#define NV_SIZE		(8 * KiB)
+#define LOG_SIZE	(4 * KiB)
+#define BOOTS		400
+
+static u8 nv[NV_SIZE];
+static size_t nv_bytes_read;
+
+static void *nv_mmap(const struct region_device *rd, size_t offset,
+		     size_t size)
+{
+	return &nv[offset];
+}
+
+static int nv_munmap(const struct region_device *rd, void *mapping)
+{
+	return 0;
+}
+
+static ssize_t nv_readat(const struct region_device *rd, void *b,
+			 size_t offset, size_t size)
+{
+	memcpy(b, &nv[offset], size);
+	nv_bytes_read += size;
+	return size;
+}
+
+/* Like NOR flash, programming can only clear bits. */
+static ssize_t nv_writeat(const struct region_device *rd, const void *b,
+			  size_t offset, size_t size)
+{
+	const u8 *data = b;
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		nv[offset + i] &= data[i];
+	return size;
+}
+
+static ssize_t nv_eraseat(const struct region_device *rd, size_t offset,
+			  size_t size)
+{
+	assert(offset % (4 * KiB) == 0 && size % (4 * KiB) == 0);
+	memset(&nv[offset], 0xff, size);
+	return size;
+}
+
+static const struct region_device_ops nv_ops = {
+	.mmap = nv_mmap,
+	.munmap = nv_munmap,
+	.readat = nv_readat,
+	.writeat = nv_writeat,
+	.eraseat = nv_eraseat,
+};
+
+static struct region_device nv_rdev = REGION_DEV_INIT(&nv_ops, 0, NV_SIZE);
+
+int fmap_locate_area_as_rdev_rw(const char *name, struct region_device *area)
+{
+	assert(!strcmp(name, "RW_ELOG"));
+	return rdev_chain(area, &nv_rdev, 0, NV_SIZE);
+}
+
+const struct region_device *boot_device_ro(void)
+{
+	return NULL;
+}
+
+void *cbmem_add(u32 id, u64 size)
+{
+	return NULL;
+}
+
+void hexdump(const void *memory, size_t length)
+{
+}
+
+/* Forget everything that lives in RAM. */
+static void reboot(void)
+{
+	elog_initialized = ELOG_UNINITIALIZED;
+	free(mirror_dev.base);
+	mirror_dev.base = NULL;
+	index_present = 0;
+	index_next_entry = ELOG_INDEX_INVALID;
+	mirror_last_write = 0;
+	nv_last_write = 0;
+	mirror_last_event = 0;
+	mirror_unread = 0;
+	nv_bytes_read = 0;
+}
+
+static int count_events(const u8 *log)
+{
+	size_t offset = sizeof(struct elog_header);
+	int count = 0;
+
+	while (log[offset] != ELOG_TYPE_EOL) {
+		offset += log[offset + 1];
+		count++;
+	}
+	return count;
+}
+
+static void check_mirror(void)
+{
+	assert(elog_mirror_load_unread() == 0);
+	assert(!memcmp(mirror_dev.base, nv, LOG_SIZE));
+}
+
+/* Firmware without the index appends an event behind its back. */
+static void append_unindexed_event(void)
+{
+	u8 *event = &nv[mirror_last_write];
+	u8 sum = 0;
+	int i;
+
+	memset(event, 0, 12);
+	event[0] = 0x99;
+	event[1] = 12;
+	for (i = 0; i < 11; i++)
+		sum += event[i];
+	event[11] = -sum;
+}
+
+int main(void)
+{
+	size_t read_most = 0;
+	int quick_inits = 0;
+	int boot, events, i;
+
+	memset(nv, 0xff, sizeof(nv));
+	srand(3);
+
+	for (boot = 0; boot < BOOTS; boot++) {
+		reboot();
+		assert(elog_init() == 0);
+		if (nv_bytes_read < 512)
+			quick_inits++;
+		else
+			read_most = MAX(read_most, nv_bytes_read);
+		check_mirror();
+
+		for (i = rand() % 4; i > 0; i--) {
+			u32 data = rand();
+
+			elog_add_event_raw(0x80 + rand() % 8, &data,
+					   rand() % 5);
+		}
+		assert(!memcmp(mirror_dev.base, nv, LOG_SIZE));
+
+		if (boot == 200 || boot == 201) {
+			events = count_events(nv);
+			append_unindexed_event();
+			reboot();
+			assert(elog_init() == 0);
+			check_mirror();
+			/* The appended event plus this boot's. */
+			assert(count_events(nv) == events + 2);
+		}
+	}
+	printf("%d of %d inits read less than 512 bytes, full scans read "
+	       "%zu\n", quick_inits, BOOTS, read_most);
+	if (CONFIG_ELOG_INDEX)
+		assert(quick_inits > BOOTS * 3 / 4);
+
+	/* A stale last index entry falls back to the full scan. */
+	if (CONFIG_ELOG_INDEX) {
+		u8 *index = &nv[LOG_SIZE + 8];
+
+		for (i = 0; index[4 * i + 2] != 0xff ||
+			    index[4 * i + 3] != 0xff; i++)
+			;
+		assert(i > 0);
+		index[4 * (i - 1)] &= 0x10;
+	}
+	events = count_events(nv);
+	reboot();
+	assert(elog_init() == 0);
+	check_mirror();
+	assert(count_events(nv) == events + 1);
+
+	printf("elog-test: index %s passed\n",
+	       CONFIG_ELOG_INDEX ? "on" : "off");
+	return 0;
+}
@@ -0,0 +1,26 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* The host assert.h, which aborts the test, plus what the coreboot one
+ * provides. */
+
+#ifndef TESTS_ASSERT_H
+#define TESTS_ASSERT_H
+
+#include_next <assert.h>
+#include <console/console.h>
+
+#define ASSERT(x) assert(x)
+#define BUG() abort()
+
+#endif
@@ -0,0 +1 @@
+/* Tests define the CONFIG_ options they need before including kconfig.h. */
@@ -0,0 +1,36 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* Host stand-in for console/console.h. The console is quiet, so that a
+ * test only prints its own results, but formats are still checked. */
+
+#ifndef TESTS_CONSOLE_CONSOLE_H
+#define TESTS_CONSOLE_CONSOLE_H
+
+#include <commonlib/loglevel.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static inline void __attribute__((format(printf, 2, 3)))
+printk(int level, const char *fmt, ...)
+{
+}
+
+static inline void __attribute__((noreturn)) die(const char *msg)
+{
+	fprintf(stderr, "die: %s", msg);
+	abort();
+}
+
+#endif
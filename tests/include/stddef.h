@@ -0,0 +1,28 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* The host stddef.h plus what the coreboot one adds to it. */
+
+#include_next <stddef.h>
+
+#if !defined(TESTS_STDDEF_H) && !defined(__need_size_t) && \
+	!defined(__need_wchar_t) && !defined(__need_NULL)
+#define TESTS_STDDEF_H
+
+#include <sys/types.h>
+#include <commonlib/helpers.h>
+
+#define ROMSTAGE_CONST
+#define MAYBE_STATIC static
+
+#endif
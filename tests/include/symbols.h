@@ -0,0 +1,32 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* Host stand-in for symbols.h. The memory layout regions are variables
+ * that a test points at buffers of its own. _program and _eprogram are
+ * left to the test, which needs them as addresses in one buffer. */
+
+#ifndef TESTS_SYMBOLS_H
+#define TESTS_SYMBOLS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DECLARE_TEST_REGION(name)		\
+	extern uint8_t *_##name;		\
+	extern size_t _##name##_size;
+
+DECLARE_TEST_REGION(cbfs_cache)
+DECLARE_TEST_REGION(preram_cbfs_cache)
+DECLARE_TEST_REGION(postram_cbfs_cache)
+
+#endif
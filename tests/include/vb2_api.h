@@ -0,0 +1,39 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/* Host stand-in for the vboot API, which is not part of this tree. Only
+ * the names used by the headers the tests include are provided. */
+
+#ifndef TESTS_VB2_API_H
+#define TESTS_VB2_API_H
+
+enum vb2_hash_algorithm {
+	VB2_HASH_INVALID = 0,
+	VB2_HASH_SHA1 = 1,
+	VB2_HASH_SHA256 = 2,
+	VB2_HASH_SHA512 = 3,
+};
+
+#define VB2_SUCCESS		0
+#define VB2_ERROR_UNKNOWN	0x10000
+
+#define VB2_MAX_DIGEST_SIZE	64
+
+#include <stdint.h>
+
+/* Tests that link code hashing CBFS files provide this. */
+int vb2_digest_buffer(const uint8_t *buf, uint32_t size,
+		      enum vb2_hash_algorithm hash_alg, uint8_t *digest,
+		      uint32_t digest_size);
+
+#endif
@@ -0,0 +1,193 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * The LZMA decoder against the LZMA SDK 4.40 decoder it replaced, kept in
+ * lzma-ref/. Each file is compressed with cbfstool's settings and decoded
+ * by ulzman() and by the old ulzman(), whose outputs must both match the
+ * file. Speeds are of the decompressed output, best of a number of runs.
+ * Build lzma-small-bench for the decoder with LZMA_SMALL_DECODER.
+ *
+ *   lzma-bench [-r runs] file...
+ */
+
+#include <assert.h>
+#include <lib.h>
+#include <string.h>
+#include <unistd.h>
+#include <commonlib/compression.h>
+#include <commonlib/lzma_decoder.h>
+
+#include "../util/cbfstool/lzma/C/LzmaEnc.h"
+#include "lzma-ref/lzmadecode.h"
+#include "bench.h"
+
+static void *sz_alloc(void *p, size_t size)
+{
+	return malloc(size);
+}
+
+static void sz_free(void *p, void *address)
+{
+	free(address);
+}
+
+static struct ISzAlloc alloc = { sz_alloc, sz_free };
+
+/* As util/cbfstool/lzma/lzma.c does. */
+static size_t lzma_compress(const void *src, size_t len, void *dst,
+			    size_t dstn)
+{
+	struct CLzmaEncProps props;
+	size_t props_size = LZMA_PROPS_SIZE;
+	size_t size = dstn - LZMA_HEADER_SIZE;
+	uint8_t *out = dst;
+	int i;
+
+	LzmaEncProps_Init(&props);
+	props.dictSize = len;
+	props.lc = 1;
+	props.lp = 0;
+	props.pb = 0;
+	props.fb = 273;
+	props.algo = 1;
+	props.level = 9;
+	props.btMode = 1;
+	props.numHashBytes = 4;
+	props.mc = 0;
+	props.numThreads = 1;
+	if (LzmaEncode(out + LZMA_HEADER_SIZE, &size, src, len, &props, out,
+		       &props_size, 0, NULL, &alloc, &alloc) != SZ_OK)
+		return 0;
+	for (i = 0; i < 8; i++)
+		out[LZMA_PROPS_SIZE + i] = (uint64_t)len >> (8 * i);
+	return LZMA_HEADER_SIZE + size;
+}
+
+/* ulzman() as it was before the shared decoder, without the messages. */
+static size_t ref_ulzman(const void *src, size_t srcn, void *dst,
+			 size_t dstn)
+{
+	static unsigned char scratchpad[15980];
+	const unsigned char *cp = (const unsigned char *)src +
+		LZMA_PROPERTIES_SIZE;
+	CLzmaDecoderState state;
+	SizeT in_processed, out_processed;
+	UInt32 out_size;
+
+	out_size = cp[3] << 24 | cp[2] << 16 | cp[1] << 8 | cp[0];
+	if (LzmaDecodeProperties(&state.Properties, src,
+				 LZMA_PROPERTIES_SIZE) != LZMA_RESULT_OK ||
+	    LzmaGetNumProbs(&state.Properties) * sizeof(CProb) >
+	    sizeof(scratchpad))
+		return 0;
+	state.Probs = (CProb *)scratchpad;
+	if (LzmaDecode(&state, (const unsigned char *)src + LZMA_HEADER_SIZE,
+		       srcn - LZMA_HEADER_SIZE, &in_processed, dst, out_size,
+		       &out_processed))
+		return 0;
+	return out_processed;
+}
+
+static const struct decoder {
+	const char *name;
+	size_t (*decompress)(const void *src, size_t srcn, void *dst,
+			     size_t dstn);
+} decoders[] = {
+	{ "old", ref_ulzman },
+	{ "new", ulzman },
+};
+
+/* Best time of runs decodes of packed with dec, checking the output. */
+static uint64_t bench_decoder(const struct decoder *dec, const char *path,
+			      const uint8_t *packed, size_t packed_size,
+			      const uint8_t *data, size_t size, uint8_t *out,
+			      int runs)
+{
+	uint64_t best = UINT64_MAX;
+	int run;
+
+	for (run = 0; run < runs; run++) {
+		uint64_t start, ns;
+
+		memset(out, 0, size);
+		start = bench_now_ns();
+		if (dec->decompress(packed, packed_size, out, size) != size ||
+		    memcmp(out, data, size)) {
+			fprintf(stderr, "%s: %s decoder output differs\n",
+				path, dec->name);
+			exit(1);
+		}
+		ns = bench_now_ns() - start;
+		if (ns < best)
+			best = ns;
+	}
+	return best;
+}
+
+static void bench_file(const char *path, int runs)
+{
+	uint64_t ns[ARRAY_SIZE(decoders)];
+	size_t size, packed_size, bound, i;
+	uint8_t *data, *packed, *out;
+
+	data = bench_read_file(path, &size);
+	bound = size + size / 4 + 64 * 1024;
+	packed = malloc(bound);
+	out = malloc(size + 1);
+	assert(packed && out);
+
+	packed_size = lzma_compress(data, size, packed, bound);
+	if (!packed_size) {
+		fprintf(stderr, "%s: compression failed\n", path);
+		exit(1);
+	}
+	printf("%-20s %9zu %9zu", bench_name(path), size, packed_size);
+	for (i = 0; i < ARRAY_SIZE(decoders); i++) {
+		ns[i] = bench_decoder(&decoders[i], path, packed, packed_size,
+				      data, size, out, runs);
+		printf("  %7.0fMB/s", bench_mbps(size, ns[i]));
+	}
+	printf("  %6.2fx\n", ns[1] ? (double)ns[0] / ns[1] : 0);
+
+	free(out);
+	free(packed);
+	free(data);
+}
+
+int main(int argc, char **argv)
+{
+	int runs = BENCH_RUNS;
+	size_t i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "r:")) != -1) {
+		if (opt != 'r' || (runs = atoi(optarg)) < 1) {
+			fprintf(stderr, "usage: %s [-r runs] file...\n",
+				argv[0]);
+			return 1;
+		}
+	}
+	if (optind == argc) {
+		fprintf(stderr, "usage: %s [-r runs] file...\n", argv[0]);
+		return 1;
+	}
+
+	printf("%-20s %9s %9s", "file", "size", "packed");
+	for (i = 0; i < ARRAY_SIZE(decoders); i++)
+		printf("  %11s", decoders[i].name);
+	printf("  %7s\n", "speedup");
+	for (; optind < argc; optind++)
+		bench_file(argv[optind], runs);
+	return 0;
+}
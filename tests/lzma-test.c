@@ -0,0 +1,321 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * LZMA decoder against streams from cbfstool's encoder, with several lc, lp
+ * and pb settings and with end markers: whole buffers, a ring buffer fed in
+ * small pieces, decoding in place and corrupted or truncated input. The
+ * coreboot wrappers must refuse output that does not fit their buffer.
+ */
+
+#ifndef TEST_SMALL_DECODER
+#define TEST_SMALL_DECODER 0
+#endif
+#define CONFIG_LZMA_SMALL_DECODER TEST_SMALL_DECODER
+#define CONFIG_LZMA_MAX_LC_LP 8
+
+#include <kconfig.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/commonlib/lzma_decoder.c"
+#include "../src/lib/lzma.c"
+#include "../util/cbfstool/lzma/C/LzmaEnc.h"
+
+#define DATA_SIZE	(192 * 1024)
+#define DICT_SIZE	(64 * 1024)
+
+static uint8_t data[DATA_SIZE];
+static uint8_t packed[DATA_SIZE + DATA_SIZE / 8 + 1024];
+static size_t packed_size;
+static uint8_t out[DATA_SIZE + 4096];
+
+static void *sz_alloc(void *p, size_t size)
+{
+	return malloc(size);
+}
+
+static void sz_free(void *p, void *address)
+{
+	free(address);
+}
+
+static struct ISzAlloc alloc = { sz_alloc, sz_free };
+
+/* Code, tables and text alike: runs, copies and noise. */
+static void make_data(void)
+{
+	size_t pos = 0;
+
+	srand(5);
+	while (pos < DATA_SIZE) {
+		size_t n = 1 + rand() % 2000, i;
+
+		if (n > DATA_SIZE - pos)
+			n = DATA_SIZE - pos;
+		switch (rand() % 4) {
+		case 0:
+			memset(data + pos, rand() % 3 ? 0 : 0xff, n);
+			break;
+		case 1:
+			for (i = 0; i < n; i++)
+				data[pos + i] = rand();
+			break;
+		case 2:
+			for (i = 0; i < n; i++)
+				data[pos + i] = "coreboot "[rand() % 9];
+			break;
+		default:
+			/* Older data, a few bytes changed. */
+			if (pos > 0) {
+				size_t from = rand() % pos;
+
+				for (i = 0; i < n; i++)
+					data[pos + i] = data[from + i];
+				data[pos + rand() % n] ^= 0x10;
+			}
+			break;
+		}
+		pos += n;
+	}
+}
+
+static void encode(int lc, int lp, int pb, int end_mark)
+{
+	struct CLzmaEncProps props;
+	size_t props_size = LZMA_PROPS_SIZE;
+	size_t size = sizeof(packed) - LZMA_HEADER_SIZE;
+	uint64_t out_size = end_mark ? LZMA_SIZE_UNKNOWN : DATA_SIZE;
+	int i;
+
+	LzmaEncProps_Init(&props);
+	props.level = 5;
+	props.dictSize = DICT_SIZE;
+	props.lc = lc;
+	props.lp = lp;
+	props.pb = pb;
+	props.numThreads = 1;
+	assert(LzmaEncode(packed + LZMA_HEADER_SIZE, &size, data, DATA_SIZE,
+			  &props, packed, &props_size, end_mark, NULL, &alloc,
+			  &alloc) == SZ_OK);
+	for (i = 0; i < 8; i++)
+		packed[LZMA_PROPS_SIZE + i] = out_size >> (8 * i);
+	packed_size = LZMA_HEADER_SIZE + size;
+}
+
+static void *start(struct lzma_decoder *d, void *window, size_t window_size)
+{
+	void *probs;
+
+	assert(lzma_decoder_header(d, packed) == 0);
+	probs = malloc(lzma_decoder_probs_size(d));
+	lzma_decoder_init(d, probs, window, window_size);
+	d->in = packed + LZMA_HEADER_SIZE;
+	d->in_size = packed_size - LZMA_HEADER_SIZE;
+	return probs;
+}
+
+static void test_whole(int end_mark)
+{
+	struct lzma_decoder d;
+	void *probs = start(&d, out, sizeof(out));
+	enum lzma_status status;
+
+	/* Without an end marker, the caller stops at the size it knows. */
+	memset(out, 0xaa, sizeof(out));
+	status = lzma_decode(&d, end_mark ? sizeof(out) : DATA_SIZE, 1);
+	assert(status == (end_mark ? LZMA_END : LZMA_OK));
+	assert(d.pos == DATA_SIZE);
+	assert(!memcmp(out, data, DATA_SIZE));
+	/* At most the flush of the range coder is left. */
+	assert(d.in_size < 5);
+	free(probs);
+}
+
+/* A window as large as the dictionary, input in pieces, output taken in
+ * pieces that end anywhere, like libpayload's lzma_stream. */
+static void test_stream(void)
+{
+	static uint8_t window[DICT_SIZE];
+	static uint8_t in[8192];
+	struct lzma_decoder d;
+	void *probs = start(&d, window, sizeof(window));
+	size_t fed = LZMA_HEADER_SIZE, done = 0;
+
+	d.in = in;
+	d.in_size = 0;
+	while (done < DATA_SIZE) {
+		size_t from = d.pos, end;
+		enum lzma_status status;
+		int last = fed == packed_size;
+
+		end = d.pos + 1 + rand() % 5000;
+		if (end > sizeof(window))
+			end = sizeof(window);
+		status = lzma_decode(&d, end, last);
+		assert(status != LZMA_ERROR);
+		assert(!memcmp(window + from, data + done, d.pos - from));
+		done += d.pos - from;
+
+		if (status == LZMA_NEED_INPUT) {
+			size_t n = 1 + rand() % 3000;
+
+			assert(!last);
+			memmove(in, d.in, d.in_size);
+			if (n > sizeof(in) - d.in_size)
+				n = sizeof(in) - d.in_size;
+			if (n > packed_size - fed)
+				n = packed_size - fed;
+			memcpy(in + d.in_size, packed + fed, n);
+			fed += n;
+			d.in = in;
+			d.in_size += n;
+		}
+		if (d.pos == sizeof(window))
+			d.pos = 0;
+	}
+	assert(done == DATA_SIZE);
+	free(probs);
+}
+
+/* Input at the end of the output buffer, as selfboot loads segments. */
+static void test_in_place(size_t margin)
+{
+	static uint8_t buf[DATA_SIZE + 4096];
+	size_t size = DATA_SIZE + margin;
+	const uint8_t *src = buf + size - packed_size;
+	enum lzma_status status;
+	struct lzma_decoder d;
+	void *probs;
+
+	memcpy(buf + size - packed_size, packed, packed_size);
+	assert(lzma_decoder_header(&d, src) == 0);
+	probs = malloc(lzma_decoder_probs_size(&d));
+	lzma_decoder_init(&d, probs, buf, size);
+	d.in = src + LZMA_HEADER_SIZE;
+	d.in_size = packed_size - LZMA_HEADER_SIZE;
+	status = lzma_decode_in_place(&d, DATA_SIZE);
+	assert(status == LZMA_OK);
+	if (d.pos < DATA_SIZE) {
+		/* Finish from the original, as ulzman_in_place() does. */
+		d.in = packed + (d.in - src);
+		status = lzma_decode(&d, DATA_SIZE, 1);
+		assert(status == LZMA_OK);
+	}
+	assert(d.pos == DATA_SIZE);
+	assert(!memcmp(buf, data, DATA_SIZE));
+	free(probs);
+}
+
+/* Damaged streams may decode to garbage, but never out of bounds. */
+static void test_damage(void)
+{
+	static uint8_t good[sizeof(packed)];
+	size_t good_size = packed_size;
+	int i, errors = 0;
+
+	memcpy(good, packed, good_size);
+	for (i = 0; i < 200; i++) {
+		struct lzma_decoder d;
+		enum lzma_status status;
+		size_t cut = 0;
+		void *probs;
+
+		memcpy(packed, good, good_size);
+		packed_size = good_size;
+		if (i % 2) {
+			cut = 8 + rand() % (good_size - LZMA_HEADER_SIZE - 8);
+			packed_size -= cut;
+		} else {
+			packed[LZMA_HEADER_SIZE + rand() %
+			       (good_size - LZMA_HEADER_SIZE)] ^= 1 << rand() % 8;
+		}
+
+		probs = start(&d, out, sizeof(out));
+		status = lzma_decode(&d, DATA_SIZE, 1);
+		assert(d.pos <= DATA_SIZE);
+		if (cut)
+			assert(status == LZMA_ERROR || d.pos < DATA_SIZE);
+		if (status == LZMA_ERROR)
+			errors++;
+		free(probs);
+	}
+	memcpy(packed, good, good_size);
+	packed_size = good_size;
+	printf("damaged streams: %d of 200 failed to decode\n", errors);
+	assert(errors > 100);
+}
+
+/* The wrappers decode all of a stream or fail, never a truncated part. */
+static void test_wrappers(void)
+{
+	static uint8_t buf[DATA_SIZE + 4096];
+	struct mem_region_device mdev;
+	const struct region_device *rdev = &mdev.rdev;
+	size_t n;
+
+	mem_region_device_ro_init(&mdev, packed, packed_size);
+
+	memset(out, 0, sizeof(out));
+	assert(ulzman(packed, packed_size, out, DATA_SIZE) == DATA_SIZE);
+	assert(!memcmp(out, data, DATA_SIZE));
+	assert(ulzman_rdev(rdev, 0, packed_size, buf, sizeof(buf)) ==
+	       DATA_SIZE);
+	assert(!memcmp(buf, data, DATA_SIZE));
+
+	/* The header says DATA_SIZE, so one byte less must fail. */
+	n = DATA_SIZE - 1;
+	assert(ulzman(packed, packed_size, out, n) == 0);
+	memcpy(buf + n - packed_size, packed, packed_size);
+	assert(ulzman_in_place(rdev, 0, packed_size, buf, n) == 0);
+	assert(ulzman_rdev(rdev, 0, packed_size, buf, n) == 0);
+	/* Too small to even hold the input, so it is mapped instead. */
+	assert(ulzman_rdev(rdev, 0, packed_size, buf, packed_size - 1) == 0);
+}
+
+int main(void)
+{
+	static const int settings[][3] = {
+		{ 1, 0, 0 },	/* cbfstool */
+		{ 3, 0, 2 },	/* LZMA SDK default */
+		{ 0, 2, 0 },
+		{ 4, 0, 0 },
+		{ 3, 1, 2 },
+		{ 8, 0, 4 },
+	};
+	int i;
+
+	make_data();
+	for (i = 0; i < ARRAY_SIZE(settings); i++) {
+		encode(settings[i][0], settings[i][1], settings[i][2], 0);
+		printf("lc=%d lp=%d pb=%d: %d -> %zu bytes\n", settings[i][0],
+		       settings[i][1], settings[i][2], DATA_SIZE, packed_size);
+		test_whole(0);
+		test_stream();
+		test_in_place(4096);
+		encode(settings[i][0], settings[i][1], settings[i][2], 1);
+		test_whole(1);
+	}
+
+	/* No margin needs a second pass from the original input. */
+	encode(1, 0, 0, 0);
+	test_in_place(0);
+	test_wrappers();
+	test_damage();
+
+	printf("lzma-test: %s decoder passed\n",
+	       SMALL_DECODER ? "small" : "fast");
+	return 0;
+}
@@ -0,0 +1,212 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * The memory-mapped image files of cbfstool, ifdtool and ifwitool, on a
+ * file in /tmp: only changed blocks of dirty ranges are written, changes
+ * that are not flushed never reach the file, read-only and empty files
+ * behave, and partitioned_file writes back only buffers that come from
+ * its own image.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+#include "partitioned_file.h"
+#include "cbfs_sections.h"
+
+#define IMAGE_SIZE	(1024 * 1024)
+#define BLOCK		4096
+
+static char filename[] = "/tmp/mapped-file-test.XXXXXX";
+static uint8_t expected[IMAGE_SIZE];
+
+/* Reads the file as it is on disk and compares it to expected. */
+static void check_file(size_t size)
+{
+	static uint8_t buf[IMAGE_SIZE + 1];
+	FILE *f = fopen(filename, "rb");
+
+	assert(f);
+	assert(fread(buf, 1, sizeof(buf), f) == size);
+	fclose(f);
+	assert(!memcmp(buf, expected, size));
+}
+
+static void test_flush(void)
+{
+	struct mapped_file *file;
+	uint8_t *data, block[BLOCK];
+	size_t i;
+
+	file = mapped_file_create(filename, IMAGE_SIZE);
+	assert(file);
+	assert(mapped_file_size(file) == IMAGE_SIZE);
+	data = mapped_file_data(file);
+	for (i = 0; i < IMAGE_SIZE; i++)
+		assert(data[i] == 0);
+
+	/* Every block changes, so all of them are written. */
+	for (i = 0; i < IMAGE_SIZE; i++)
+		expected[i] = data[i] = 1 + i % 251;
+	assert(mapped_file_mark_dirty(file, 0, IMAGE_SIZE) == 0);
+	assert(mapped_file_flush(file) == IMAGE_SIZE);
+	check_file(IMAGE_SIZE);
+
+	/* Two bytes across a block boundary in a dirty megabyte. */
+	expected[3 * BLOCK - 1] = data[3 * BLOCK - 1] = 0;
+	expected[3 * BLOCK] = data[3 * BLOCK] = 0;
+	assert(mapped_file_mark_dirty(file, 0, IMAGE_SIZE) == 0);
+	assert(mapped_file_flush(file) == 2 * BLOCK);
+	check_file(IMAGE_SIZE);
+
+	/* Nothing is dirty after a flush. */
+	assert(mapped_file_flush(file) == 0);
+
+	/* Separate and overlapping ranges, merged before they are written. */
+	data[100] = expected[100] = 0xaa;
+	data[20 * BLOCK] = expected[20 * BLOCK] = 0xbb;
+	assert(mapped_file_mark_dirty(file, 20 * BLOCK, 10) == 0);
+	assert(mapped_file_mark_dirty(file, 50, 100) == 0);
+	assert(mapped_file_mark_dirty(file, 0, 60) == 0);
+	assert(mapped_file_mark_dirty(file, 20 * BLOCK - 5, 8) == 0);
+	/* The five bytes in the block before the second change are equal. */
+	assert(mapped_file_flush(file) == 150 + 10);
+	check_file(IMAGE_SIZE);
+
+	/* Updates only touch the blocks that really change. */
+	memcpy(block, &expected[5 * BLOCK], BLOCK);
+	assert(mapped_file_update(file, 5 * BLOCK, block, BLOCK) == 0);
+	assert(mapped_file_flush(file) == 0);
+	expected[5 * BLOCK + BLOCK / 2] ^= 0xff;
+	assert(mapped_file_update(file, 5 * BLOCK - 10,
+				  &expected[5 * BLOCK - 10], BLOCK + 20) == 0);
+	assert(mapped_file_flush(file) == BLOCK);
+	check_file(IMAGE_SIZE);
+
+	/* Ranges outside of the file are refused. */
+	assert(mapped_file_mark_dirty(file, IMAGE_SIZE, 1) == -1);
+	assert(mapped_file_mark_dirty(file, 1, SIZE_MAX) == -1);
+	assert(mapped_file_update(file, IMAGE_SIZE - 1, block, 2) == -1);
+
+	/* Changes that are not flushed are dropped on close. */
+	data[7] ^= 0xff;
+	data[IMAGE_SIZE - 1] ^= 0xff;
+	assert(mapped_file_mark_dirty(file, 0, 8) == 0);
+	mapped_file_close(file);
+	check_file(IMAGE_SIZE);
+
+	file = mapped_file_open(filename, true);
+	assert(file);
+	assert(!memcmp(mapped_file_data(file), expected, IMAGE_SIZE));
+	mapped_file_close(file);
+}
+
+static void test_read_only(void)
+{
+	struct mapped_file *file;
+	uint8_t *data;
+
+	file = mapped_file_open(filename, false);
+	assert(file);
+	data = mapped_file_data(file);
+	assert(!memcmp(data, expected, IMAGE_SIZE));
+
+	/* The view can be changed, the file cannot. */
+	data[0] ^= 0xff;
+	assert(mapped_file_mark_dirty(file, 0, 1) == 0);
+	assert(mapped_file_flush(file) == -1);
+	mapped_file_close(file);
+	check_file(IMAGE_SIZE);
+}
+
+/* Empty files cannot be mapped and are read instead. */
+static void test_empty(void)
+{
+	struct mapped_file *file;
+
+	file = mapped_file_create(filename, 0);
+	assert(file);
+	assert(mapped_file_size(file) == 0);
+	assert(mapped_file_mark_dirty(file, 0, 0) == 0);
+	assert(mapped_file_mark_dirty(file, 0, 1) == -1);
+	assert(mapped_file_flush(file) == 0);
+	mapped_file_close(file);
+	check_file(0);
+}
+
+static void test_partitioned(void)
+{
+	struct buffer image, other, part;
+	partitioned_file_t *file;
+	uint8_t copy[16];
+
+	/* A new flat image is erased flash. */
+	file = partitioned_file_create_flat(filename, IMAGE_SIZE);
+	assert(file);
+	partitioned_file_close(file);
+	memset(expected, 0xff, IMAGE_SIZE);
+	check_file(IMAGE_SIZE);
+
+	file = partitioned_file_reopen(filename, true);
+	assert(file);
+	assert(!partitioned_file_is_partitioned(file));
+	assert(partitioned_file_read_region(&image, file,
+					    SECTION_NAME_PRIMARY_CBFS));
+	assert(image.size == IMAGE_SIZE);
+
+	/* A part of the image goes back to where it came from. */
+	buffer_splice(&part, &image, 0x8000, 0x1000);
+	memset(part.data + 0x10, 0x12, 2);
+	memset(&expected[0x8010], 0x12, 2);
+	assert(partitioned_file_write_region(file, &part));
+	check_file(IMAGE_SIZE);
+
+	/* A copy of the same data lives elsewhere and is refused. */
+	memcpy(copy, part.data, sizeof(copy));
+	buffer_init(&other, NULL, copy, sizeof(copy));
+	other.offset = 0x8000;
+	assert(!partitioned_file_write_region(file, &other));
+
+	/* So is a buffer that runs off the end of the image. */
+	buffer_splice(&part, &image, IMAGE_SIZE - 0x100, 0x100);
+	part.size = 0x200;
+	assert(!partitioned_file_write_region(file, &part));
+	check_file(IMAGE_SIZE);
+
+	/* Changes that were not written back are lost. */
+	image.data[0x20] = 0;
+	partitioned_file_close(file);
+	check_file(IMAGE_SIZE);
+}
+
+int main(void)
+{
+	int fd = mkstemp(filename);
+
+	assert(fd >= 0);
+	close(fd);
+
+	test_flush();
+	test_read_only();
+	test_empty();
+	test_partitioned();
+
+	unlink(filename);
+	printf("mapped-file-test: passed\n");
+	return 0;
+}
@@ -0,0 +1,460 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * SELF payloads built in memory, loaded into a buffer that stands in for
+ * RAM with coreboot in the middle of it: uncompressed, LZMA, Zstandard and
+ * LZ4 segments, with and without room to decompress in place, segments
+ * that bounce around coreboot, and payloads that must not load.
+ */
+
+#define CONFIG_COLLECT_TIMESTAMPS 1
+
+#include <kconfig.h>
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RAM_SIZE	(1024 * 1024)
+#define PROGRAM_OFFSET	(512 * 1024)
+#define PROGRAM_SIZE	(64 * 1024)
+#define PROGRAM_END	(PROGRAM_OFFSET + PROGRAM_SIZE)
+
+/* The memory payloads load to, coreboot being where the linker put it,
+ * and the bounce buffer at the top, where bootmem allocates it. */
+static struct {
+	uint8_t below[PROGRAM_OFFSET];
+	uint8_t program[PROGRAM_SIZE];
+	uint8_t above[RAM_SIZE - PROGRAM_END];
+	uint8_t bounce[PROGRAM_SIZE + 256 * 1024];
+} __attribute__((aligned(4096))) ram;
+
+#define _program	ram.program
+#define _eprogram	ram.above
+
+/* coreboot never frees, so segments come from a pool emptied per load. */
+static uint8_t heap[16 * 1024];
+static size_t heap_used;
+
+static void *test_malloc(size_t size)
+{
+	void *p = &heap[heap_used];
+
+	heap_used += ALIGN_UP(size, 16);
+	assert(heap_used <= sizeof(heap));
+	return p;
+}
+
+static void test_free(void *p)
+{
+}
+
+#define malloc test_malloc
+#define free test_free
+#include "../src/lib/selfboot.c"
+#undef malloc
+#undef free
+
+#include <commonlib/lzma_decoder.h>
+#include "../util/cbfstool/lzma/C/LzmaEnc.h"
+#include "../util/cbfstool/lz4/lib/lz4frame.h"
+#include "../util/cbfstool/zstd/lib/zstd.h"
+
+#define FILL		0x5a	/* RAM before loading */
+#define COREBOOT	0xcb	/* coreboot, which must survive any load */
+
+const struct mem_region_device addrspace_32bit =
+	MEM_REGION_DEV_RO_INIT(0, ~(size_t)0);
+
+static uint8_t expected[RAM_SIZE];
+static uint8_t data[256 * 1024];
+static uint8_t self[512 * 1024];
+static size_t self_size, header_size;
+static int maps, segments_loaded, final_segments;
+static int timestamps[TS_PAYLOAD_SEGMENT_LOADED + 1];
+
+void *bootmem_allocate_buffer(size_t size)
+{
+	assert(size <= sizeof(ram.bounce));
+	return ram.bounce;
+}
+
+int bootmem_region_targets_usable_ram(uint64_t start, uint64_t size)
+{
+	return start >= (uintptr_t)&ram &&
+	       start + size <= (uintptr_t)ram.bounce;
+}
+
+void bootmem_add_range(uint64_t start, uint64_t size, uint32_t type)
+{
+}
+
+void bootmem_dump_ranges(void)
+{
+}
+
+int arch_supports_bounce_buffer(void)
+{
+	return 1;
+}
+
+void prog_segment_loaded(uintptr_t start, size_t size, int flags)
+{
+	segments_loaded++;
+	if (flags & SEG_FINAL)
+		final_segments++;
+}
+
+void timestamp_add_now(enum timestamp_id id)
+{
+	if (id < ARRAY_SIZE(timestamps))
+		timestamps[id]++;
+}
+
+/* The payload in CBFS. Mappings are counted, since a payload that is
+ * decompressed in place needs none. */
+static void *self_mmap(const struct region_device *rd, size_t offset,
+		       size_t size)
+{
+	maps++;
+	return &self[offset];
+}
+
+static int self_munmap(const struct region_device *rd, void *mapping)
+{
+	return 0;
+}
+
+static ssize_t self_readat(const struct region_device *rd, void *b,
+			   size_t offset, size_t size)
+{
+	memcpy(b, &self[offset], size);
+	return size;
+}
+
+static const struct region_device_ops self_ops = {
+	.mmap = self_mmap,
+	.munmap = self_munmap,
+	.readat = self_readat,
+};
+
+static void *sz_alloc(void *p, size_t size)
+{
+	return calloc(1, size);
+}
+
+static void sz_free(void *p, void *address)
+{
+	free(address);
+}
+
+static struct ISzAlloc alloc = { sz_alloc, sz_free };
+
+/* Compresses len bytes of src to dst as cbfstool does. Returns the size. */
+static size_t compress(int compression, uint8_t *dst, const uint8_t *src,
+		       size_t len)
+{
+	size_t size = sizeof(self) - self_size, props_size = LZMA_PROPS_SIZE;
+	struct CLzmaEncProps props;
+	int i;
+
+	switch (compression) {
+	case CBFS_COMPRESS_LZMA:
+		LzmaEncProps_Init(&props);
+		props.dictSize = len;
+		props.lc = 1;
+		props.lp = 0;
+		props.pb = 0;
+		props.numThreads = 1;
+		size -= LZMA_HEADER_SIZE;
+		assert(LzmaEncode(dst + LZMA_HEADER_SIZE, &size, src, len,
+				  &props, dst, &props_size, 0, NULL, &alloc,
+				  &alloc) == SZ_OK);
+		for (i = 0; i < 8; i++)
+			dst[LZMA_PROPS_SIZE + i] = (uint64_t)len >> (8 * i);
+		return LZMA_HEADER_SIZE + size;
+	case CBFS_COMPRESS_ZSTD:
+		size = ZSTD_compress(dst, size, src, len, 19);
+		assert(!ZSTD_isError(size));
+		return size;
+	case CBFS_COMPRESS_LZ4: {
+		LZ4F_preferences_t prefs = {
+			.compressionLevel = 20,
+			.frameInfo = {
+				.blockSizeID = max4MB,
+				.blockMode = blockIndependent,
+				.contentChecksumFlag = noContentChecksum,
+			},
+		};
+
+		size = LZ4F_compressFrame(dst, size, src, len, &prefs);
+		assert(!LZ4F_isError(size));
+		return size;
+	}
+	default:
+		memcpy(dst, src, len);
+		return len;
+	}
+}
+
+/* Code, tables and text alike: runs, copies and noise. It ends with zeroes
+ * and noise, which cannot be decompressed in place without a margin. */
+static void make_data(void)
+{
+	size_t pos = 0, end = sizeof(data) - 32 * 1024;
+
+	srand(9);
+	for (pos = end + 16 * 1024; pos < sizeof(data); pos++)
+		data[pos] = rand();
+	pos = 0;
+	while (pos < end) {
+		size_t n = 1 + rand() % 2000, i;
+
+		if (n > end - pos)
+			n = end - pos;
+		switch (rand() % 4) {
+		case 0:
+			memset(data + pos, rand() % 3 ? 0 : 0xff, n);
+			break;
+		case 1:
+			for (i = 0; i < n; i++)
+				data[pos + i] = rand();
+			break;
+		case 2:
+			for (i = 0; i < n; i++)
+				data[pos + i] = "coreboot "[rand() % 9];
+			break;
+		default:
+			if (pos > 0) {
+				size_t from = rand() % pos;
+
+				for (i = 0; i < n; i++)
+					data[pos + i] = data[from + i];
+			}
+			break;
+		}
+		pos += n;
+	}
+}
+
+/* Starts a payload with room for the headers of count segments. */
+static void new_payload(int count)
+{
+	header_size = self_size = count * sizeof(struct cbfs_payload_segment);
+	memset(self, 0, header_size);
+	memset(expected, FILL, sizeof(expected));
+}
+
+static void add_header(uint32_t type, uint32_t compression, size_t addr,
+		       size_t len, size_t mem_len)
+{
+	struct cbfs_payload_segment *seg = (void *)self;
+
+	while (seg->type)
+		seg++;
+	assert((uint8_t *)(seg + 1) <= self + header_size);
+	write_be32(&seg->type, type);
+	write_be32(&seg->compression, compression);
+	write_be32(&seg->offset, self_size);
+	write_be64(&seg->load_addr, (uintptr_t)&ram + addr);
+	write_be32(&seg->len, len);
+	write_be32(&seg->mem_len, mem_len);
+}
+
+/* Adds a segment loading the last len bytes of data at addr, followed by
+ * zeroes up to mem_len, and returns the size of its data in the payload. */
+static size_t add_segment(int compression, size_t addr, size_t len,
+			  size_t mem_len)
+{
+	const uint8_t *src = &data[sizeof(data) - len];
+	size_t size = compress(compression, &self[self_size], src, len);
+
+	add_header(PAYLOAD_SEGMENT_CODE, compression, addr, size, mem_len);
+	self_size += size;
+	memcpy(&expected[addr], src, len);
+	memset(&expected[addr + len], 0, mem_len - len);
+	return size;
+}
+
+static void add_bss(size_t addr, size_t mem_len)
+{
+	add_header(PAYLOAD_SEGMENT_BSS, CBFS_COMPRESS_NONE, addr, 0, mem_len);
+	memset(&expected[addr], 0, mem_len);
+}
+
+static void add_entry(size_t addr)
+{
+	add_header(PAYLOAD_SEGMENT_ENTRY, CBFS_COMPRESS_NONE, addr, 0, 0);
+}
+
+/* Loads the payload, and returns the entry point or NULL. */
+static void *load(struct prog *payload)
+{
+	memset(&ram, FILL, sizeof(ram));
+	memset(ram.program, COREBOOT, sizeof(ram.program));
+	memset(payload, 0, sizeof(*payload));
+	payload->rdev = (struct region_device)
+		REGION_DEV_INIT(&self_ops, 0, self_size);
+	heap_used = 0;
+	maps = segments_loaded = final_segments = 0;
+	memset(timestamps, 0, sizeof(timestamps));
+	return selfload(payload, true);
+}
+
+/* Checks RAM as the payload sees it, once coreboot is out of the way. */
+static void check_loaded(struct prog *payload, int bounced)
+{
+	size_t i;
+
+	assert(!memcmp(ram.below, expected, PROGRAM_OFFSET));
+	assert(!memcmp(ram.above, &expected[PROGRAM_END],
+		       RAM_SIZE - PROGRAM_END));
+	for (i = 0; i < PROGRAM_SIZE; i++)
+		assert(ram.program[i] == COREBOOT);
+
+	if (bounced) {
+		assert(prog_start(payload) == ram.bounce);
+		assert(!memcmp(ram.bounce, &expected[PROGRAM_OFFSET],
+			       PROGRAM_SIZE));
+	} else {
+		assert(prog_size(payload) == 0);
+	}
+	assert(final_segments == 1);
+	assert(timestamps[TS_PAYLOAD_SEGMENT_LOADED] == segments_loaded);
+	assert(timestamps[TS_PAYLOAD_SEGMENT_READ] == segments_loaded);
+}
+
+/* Segments away from coreboot, with and without room to decompress in
+ * place. Only a segment without room maps the payload, except with LZ4,
+ * which is always decompressed from the payload's mapping. */
+static void test_compression(int compression, const char *name)
+{
+	struct prog payload;
+	size_t size;
+
+	new_payload(5);
+	size = add_segment(compression, 0x1000, 100 * 1024, 150 * 1024);
+	add_bss(0x30000, 0x1234);
+	add_segment(CBFS_COMPRESS_NONE, 0x40000, 0x2345, 0x3000);
+	add_segment(compression, 0x60000, 90 * 1024, 90 * 1024);
+	add_entry(0x1000);
+
+	assert(load(&payload) == &ram.below[0x1000]);
+	check_loaded(&payload, 0);
+	assert(segments_loaded == 4);
+	printf("%s: %d -> %zu bytes, %d maps\n", name, 100 * 1024, size,
+	       maps);
+	if (compression == CBFS_COMPRESS_NONE)
+		assert(maps == 0);
+	else if (compression == CBFS_COMPRESS_LZ4)
+		assert(maps == 2);
+	else
+		assert(maps == 1);
+}
+
+/* Segments on top of coreboot load to the bounce buffer, the parts outside
+ * of coreboot to their destination. */
+static void test_bounce(void)
+{
+	struct prog payload;
+
+	/* Across coreboot, with zeroes from within it. */
+	new_payload(2);
+	add_segment(CBFS_COMPRESS_NONE, PROGRAM_OFFSET - 0x2000,
+		    0x5000, PROGRAM_SIZE + 0x4000);
+	add_entry(PROGRAM_OFFSET - 0x2000);
+	assert(load(&payload) == &ram.below[PROGRAM_OFFSET - 0x2000]);
+	check_loaded(&payload, 1);
+
+	/* Compressed from within coreboot to beyond it, and BSS. */
+	new_payload(4);
+	add_bss(PROGRAM_OFFSET - 0x100, 0x200);
+	add_segment(CBFS_COMPRESS_LZMA, PROGRAM_OFFSET + 0x1000, 80 * 1024,
+		    100 * 1024);
+	add_segment(CBFS_COMPRESS_ZSTD, 0x10000, 0x8000, 0x9000);
+	add_entry(0x10000);
+	assert(load(&payload) == &ram.below[0x10000]);
+	check_loaded(&payload, 1);
+}
+
+/* Payloads that are broken must not load. */
+static void test_broken(void)
+{
+	struct cbfs_payload_segment *seg = (void *)self;
+	struct prog payload;
+
+	/* Data larger than its memory, which would not fit in place. */
+	new_payload(2);
+	add_segment(CBFS_COMPRESS_LZMA, 0x1000, 0x4000, 0x4000);
+	add_entry(0x1000);
+	write_be32(&seg->mem_len, read_be32(&seg->len) - 1);
+	assert(!load(&payload));
+
+	/* The same for uncompressed data. */
+	new_payload(2);
+	add_segment(CBFS_COMPRESS_NONE, 0x1000, 0x4000, 0x4000);
+	add_entry(0x1000);
+	write_be32(&seg->mem_len, 0x3fff);
+	assert(!load(&payload));
+
+	/* No entry point before the end of the payload. */
+	new_payload(1);
+	add_segment(CBFS_COMPRESS_NONE, 0x1000, 0x10, 0x10);
+	self_size = header_size + 8;
+	assert(!load(&payload));
+
+	/* An unknown segment type. */
+	new_payload(2);
+	add_segment(CBFS_COMPRESS_NONE, 0x1000, 0x10, 0x10);
+	add_entry(0x1000);
+	write_be32(&seg->type, 0x12345678);
+	assert(!load(&payload));
+
+	/* Data beyond the end of the payload. */
+	new_payload(2);
+	add_segment(CBFS_COMPRESS_NONE, 0x1000, 0x100, 0x100);
+	add_entry(0x1000);
+	self_size -= 0x80;
+	assert(!load(&payload));
+
+	/* Damaged stream properties. */
+	new_payload(2);
+	add_segment(CBFS_COMPRESS_LZMA, 0x1000, 0x4000, 0x8000);
+	add_entry(0x1000);
+	self[header_size] = 225;
+	assert(!load(&payload));
+
+	/* An unknown compression. */
+	new_payload(2);
+	add_segment(CBFS_COMPRESS_NONE, 0x1000, 0x10, 0x10);
+	add_entry(0x1000);
+	write_be32(&seg->compression, 0x99);
+	assert(!load(&payload));
+}
+
+int main(void)
+{
+	make_data();
+
+	test_compression(CBFS_COMPRESS_NONE, "none");
+	test_compression(CBFS_COMPRESS_LZMA, "LZMA");
+	test_compression(CBFS_COMPRESS_ZSTD, "Zstandard");
+	test_compression(CBFS_COMPRESS_LZ4, "LZ4");
+	test_bounce();
+	test_broken();
+
+	printf("selfboot-test: passed\n");
+	return 0;
+}
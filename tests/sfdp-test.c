@@ -0,0 +1,256 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Read mode negotiation through SFDP, against a simulated W25Q128 and a
+ * controller that implements xfer_read() for the modes it is given.
+ */
+
+#define CONFIG_SPI_FLASH_SFDP 1
+#define CONFIG_SPI_FLASH_WINBOND 1
+#define CONFIG_SPI_FLASH_NO_FAST_READ 0
+#define CONFIG_SPI_ATOMIC_SEQUENCING 0
+#define CONFIG_DEBUG_SPI_FLASH 0
+#define CONFIG_BOOT_DEVICE_SPI_FLASH_BUS 0
+#define CONFIG_ROM_SIZE 0x1000000
+
+#include <kconfig.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../src/drivers/spi/spi_flash.c"
+#include "../src/drivers/spi/spi-generic.c"
+
+#define QER_NONE	0	/* no Quad Enable bit */
+#define QER_SR1_BIT6	2
+#define QER_SR2_BIT7	3	/* read with CMD_READ_STATUS2_ALT */
+#define QER_SR2_BIT1	4
+
+static u8 sfdp[256];
+static u8 flash_data[0x1000];
+static u8 status[256];		/* indexed by read status opcode */
+static u8 cmd[16];
+static struct spi_read_op last_op;
+static int multi_reads;
+
+static int test_xfer(const struct spi_slave *slave, const void *dout,
+		     size_t bytesout, void *din, size_t bytesin)
+{
+	static const u8 id[] = { 0xef, 0x40, 0x18, 0, 0 };
+	u32 addr;
+
+	if (bytesout) {
+		assert(bytesout <= sizeof(cmd));
+		memcpy(cmd, dout, bytesout);
+	}
+	if (!bytesin)
+		return 0;
+
+	addr = (cmd[1] << 16) | (cmd[2] << 8) | cmd[3];
+	switch (cmd[0]) {
+	case CMD_READ_ID:
+		memcpy(din, id, MIN(bytesin, sizeof(id)));
+		break;
+	case CMD_READ_SFDP:
+		assert(addr + bytesin <= sizeof(sfdp));
+		memcpy(din, sfdp + addr, bytesin);
+		break;
+	case CMD_READ_STATUS:
+	case CMD_READ_STATUS2:
+	case CMD_READ_STATUS2_ALT:
+		memset(din, status[cmd[0]], bytesin);
+		break;
+	case CMD_READ_ARRAY_FAST:
+		memcpy(din, flash_data + addr, bytesin);
+		break;
+	default:
+		/* Quad Enable is never written. */
+		assert(0);
+	}
+	return 0;
+}
+
+static int test_xfer_read(const struct spi_slave *slave,
+			  const struct spi_read_op *op, void *din,
+			  size_t bytesin)
+{
+	last_op = *op;
+	multi_reads++;
+	memcpy(din, flash_data + op->addr, bytesin);
+	return 0;
+}
+
+static struct spi_ctrlr ctrlr = {
+	.xfer = test_xfer,
+	.xfer_read = test_xfer_read,
+};
+
+int spi_setup_slave(unsigned int bus, unsigned int cs,
+		    struct spi_slave *slave)
+{
+	slave->bus = bus;
+	slave->cs = cs;
+	slave->ctrlr = &ctrlr;
+	return 0;
+}
+
+unsigned int spi_crop_chunk(unsigned int cmd_len, unsigned int buf_len)
+{
+	return buf_len;
+}
+
+void timer_monotonic_get(struct mono_time *mt)
+{
+	mt->microseconds = 0;
+}
+
+void udelay(unsigned int usecs)
+{
+}
+
+struct lb_record *lb_new_record(struct lb_header *header)
+{
+	return NULL;
+}
+
+void boot_device_init(void)
+{
+}
+
+int chipset_volatile_group_begin(const struct spi_flash *flash)
+{
+	return 0;
+}
+
+int chipset_volatile_group_end(const struct spi_flash *flash)
+{
+	return 0;
+}
+
+static void put32(u8 *p, u32 v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+/* SFDP header, one BFPT parameter header and a W25Q128 BFPT. */
+static void build_sfdp(int dwords, u32 qer, u32 dword1)
+{
+	int i;
+
+	memset(sfdp, 0xff, sizeof(sfdp));
+	memcpy(sfdp, "SFDP", 4);
+	sfdp[4] = 6;
+	sfdp[5] = 1;
+	sfdp[6] = 0;
+	sfdp[8] = 0;
+	sfdp[9] = 6;
+	sfdp[10] = 1;
+	sfdp[11] = dwords;
+	put32(&sfdp[12], 0xff000030);
+
+	put32(&sfdp[0x30], dword1);
+	put32(&sfdp[0x34], 0x07ffffff);
+	put32(&sfdp[0x38], 0x6b08eb44);
+	put32(&sfdp[0x3c], 0xbb423b08);
+	for (i = 4; i < 15; i++)
+		put32(&sfdp[0x30 + 4 * i], 0);
+	put32(&sfdp[0x30 + 4 * 14], qer << 20);
+}
+
+/* Probe with the given controller modes and check the read path. */
+static void check(const char *name, unsigned int modes, u8 opcode,
+		  unsigned int mode, int dummy_cycles)
+{
+	static struct spi_slave slave;
+	struct spi_flash *flash;
+	u8 buf[64];
+	int i;
+
+	for (i = 0; i < sizeof(flash_data); i++)
+		flash_data[i] = i * 7;
+	ctrlr.read_modes = modes;
+	multi_reads = 0;
+
+	flash = spi_flash_probe(0, 0);
+	assert(flash != NULL);
+	/* The probe leaves flash->spi pointing at its own stack. */
+	spi_setup_slave(0, 0, &slave);
+	flash->spi = &slave;
+	assert(!spi_flash_read(flash, 0x123, 40, buf));
+	assert(!memcmp(buf, flash_data + 0x123, 40));
+
+	if (!mode) {
+		assert(flash->internal_read == spi_flash_cmd_read_fast);
+		assert(multi_reads == 0);
+	} else {
+		assert(flash->internal_read == spi_flash_cmd_read_multi);
+		assert(flash->read_cmd == opcode);
+		assert(flash->read_mode == mode);
+		assert(flash->read_dummy_cycles == dummy_cycles);
+		assert(multi_reads == 1);
+		assert(last_op.opcode == opcode);
+		assert(last_op.addr == 0x123);
+		assert(last_op.dummy_cycles == dummy_cycles);
+	}
+	printf("%-24s ok\n", name);
+}
+
+int main(void)
+{
+	const unsigned int all = SPI_READ_MODE_1_1_2 | SPI_READ_MODE_1_2_2 |
+				 SPI_READ_MODE_1_1_4 | SPI_READ_MODE_1_4_4;
+	const unsigned int dual = SPI_READ_MODE_1_1_2 | SPI_READ_MODE_1_2_2;
+
+	build_sfdp(16, QER_SR2_BIT1, 0xfff120e5);
+	check("no controller modes", 0, 0, 0, 0);
+	check("dual controller", dual, 0xbb, SPI_READ_MODE_1_2_2, 4);
+	check("1-1-2 only", SPI_READ_MODE_1_1_2, 0x3b, SPI_READ_MODE_1_1_2, 8);
+
+	status[CMD_READ_STATUS2] = 0;
+	check("quad, QE clear", all, 0xbb, SPI_READ_MODE_1_2_2, 4);
+	status[CMD_READ_STATUS2] = 1 << 1;
+	check("quad, QE set", all, 0xeb, SPI_READ_MODE_1_4_4, 6);
+	check("1-1-4 only", SPI_READ_MODE_1_1_4, 0x6b, SPI_READ_MODE_1_1_4,
+	      8);
+
+	build_sfdp(16, QER_SR1_BIT6, 0xfff120e5);
+	status[CMD_READ_STATUS] = 1 << 6;
+	check("quad, QE in SR1", all, 0xeb, SPI_READ_MODE_1_4_4, 6);
+
+	build_sfdp(16, QER_SR2_BIT7, 0xfff120e5);
+	status[CMD_READ_STATUS2_ALT] = 0;
+	check("quad, QE clear in SR2 7", all, 0xbb, SPI_READ_MODE_1_2_2, 4);
+	status[CMD_READ_STATUS2_ALT] = 1 << 7;
+	check("quad, QE set in SR2 7", all, 0xeb, SPI_READ_MODE_1_4_4, 6);
+
+	build_sfdp(16, QER_NONE, 0xfff120e5);
+	check("quad, no QE bit", all, 0xeb, SPI_READ_MODE_1_4_4, 6);
+
+	/* Rev 0 tables lack the QE field, so only Dual is used. */
+	build_sfdp(9, QER_NONE, 0xfff120e5);
+	check("rev 0 table", all, 0xbb, SPI_READ_MODE_1_2_2, 4);
+
+	/* Parts that need 4-byte addresses keep fast reads. */
+	build_sfdp(16, QER_NONE, 0xfff520e5);
+	check("4-byte addressing", all, 0, 0, 0);
+
+	memset(sfdp, 0xff, sizeof(sfdp));
+	check("no SFDP", all, 0, 0, 0);
+
+	printf("sfdp-test: passed\n");
+	return 0;
+}
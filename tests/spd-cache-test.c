@@ -0,0 +1,176 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * SPD reads over a simulated SMBus with DDR3 and DDR4 modules, cached in a
+ * memory backed RW_SPD_CACHE. Every boot must hand raminit exactly what is
+ * in the slots, while warm boots only read the module IDs back.
+ *
+ * spd_bin.c is linked rather than included, so that the simulated block read
+ * replaces its weak default. The Makefile passes the config to both.
+ */
+
+#include <assert.h>
+#include <cbfs.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/lib/spd_cache.c"
+
+static u8 dimm[CONFIG_DIMM_MAX][SPD_PAGE_LEN_DDR4];
+static int populated[CONFIG_DIMM_MAX];
+static int page;
+static int block_reads;
+static size_t bytes_read;
+static u8 flash[4 * KiB];
+static struct mem_region_device mdev =
+	MEM_REGION_DEV_RW_INIT(flash, sizeof(flash));
+
+int fmap_locate_area_as_rdev(const char *name, struct region_device *area)
+{
+	assert(!strcmp(name, "RW_SPD_CACHE"));
+	return rdev_chain(area, &mdev.rdev, 0, sizeof(flash));
+}
+
+int fmap_locate_area_as_rdev_rw(const char *name, struct region_device *area)
+{
+	return fmap_locate_area_as_rdev(name, area);
+}
+
+int cbfs_boot_locate(struct cbfsf *fh, const char *name, uint32_t *type)
+{
+	return -1;
+}
+
+static int slot(u8 addr)
+{
+	if (addr < 0x50 || addr >= 0x50 + CONFIG_DIMM_MAX ||
+	    !populated[addr - 0x50])
+		return -1;
+	return addr - 0x50;
+}
+
+u8 smbus_read_byte(u32 smbus_dev, u8 addr, u8 offset)
+{
+	int s = slot(addr);
+
+	bytes_read++;
+	return s < 0 ? 0xff : dimm[s][page * SPD_PAGE_LEN + offset];
+}
+
+u8 smbus_write_byte(u32 smbus_dev, u8 addr, u8 offset, u8 value)
+{
+	if (addr == SPD_PAGE_0)
+		page = 0;
+	else if (addr == SPD_PAGE_1)
+		page = 1;
+	return 0;
+}
+
+int smbus_i2c_block_read(u32 smbus_dev, u8 addr, u8 offset, u8 *buf,
+			 size_t len)
+{
+	int s = slot(addr);
+
+	if (!block_reads || s < 0)
+		return -1;
+	assert(offset + len <= SPD_PAGE_LEN);
+	memcpy(buf, &dimm[s][page * SPD_PAGE_LEN + offset], len);
+	bytes_read += len;
+	return len;
+}
+
+static void insert_dimm(int s, u8 type, u32 serial)
+{
+	int i;
+
+	populated[s] = 1;
+	for (i = 0; i < sizeof(dimm[s]); i++)
+		dimm[s][i] = rand();
+	dimm[s][0] = 0x23;
+	dimm[s][SPD_DRAM_TYPE] = type;
+	if (type == SPD_DRAM_DDR4)
+		memcpy(&dimm[s][DDR4_SPD_ID_OFF + 5], &serial, 4);
+	else
+		memcpy(&dimm[s][DDR3_SPD_ID_OFF + 5], &serial, 4);
+}
+
+/* Returns the number of bytes read from the SMBus. */
+static size_t boot(void)
+{
+	static const u8 empty[SPD_PAGE_LEN_DDR4];
+	struct spd_block blk;
+	int i;
+
+	bytes_read = 0;
+	get_spd_smbus(&blk);
+
+	for (i = 0; i < CONFIG_DIMM_MAX; i++) {
+		size_t len = SPD_PAGE_LEN;
+
+		if (populated[i] && dimm[i][SPD_DRAM_TYPE] == SPD_DRAM_DDR4)
+			len = SPD_PAGE_LEN_DDR4;
+		assert(!memcmp(blk.spd_array[i],
+			       populated[i] ? dimm[i] : empty, len));
+	}
+	assert(page == 0);
+	return bytes_read;
+}
+
+int main(void)
+{
+	size_t cold, warm, n;
+
+	srand(5);
+	memset(flash, 0xff, sizeof(flash));
+	insert_dimm(0, SPD_DRAM_DDR4, 1);
+	insert_dimm(2, SPD_DRAM_DDR3, 2);
+
+	cold = boot();
+	warm = boot();
+	printf("cold boot read %zu bytes, warm boot %zu\n", cold, warm);
+	assert(warm < cold / 16);
+
+	/* Without block reads, the cache still works byte by byte. */
+	block_reads = 0;
+	memset(flash, 0xff, sizeof(flash));
+	assert(boot() == cold);
+	assert(boot() == warm);
+	block_reads = 1;
+
+	/* Only a slot that changed is read again, then all are cached. */
+	insert_dimm(2, SPD_DRAM_DDR3, 3);
+	n = boot();
+	assert(n > warm && n < cold);
+	assert(boot() == warm);
+
+	insert_dimm(0, SPD_DRAM_DDR4, 4);
+	assert(boot() > warm);
+	assert(boot() == warm);
+
+	/* Empty slots are checked too. */
+	populated[2] = 0;
+	boot();
+	insert_dimm(3, SPD_DRAM_DDR3, 5);
+	assert(boot() > warm);
+	n = boot();
+
+	/* A corrupted cache is read in full and rewritten. */
+	flash[200] ^= 1;
+	assert(boot() > n);
+	assert(boot() == n);
+
+	printf("spd-cache-test: passed\n");
+	return 0;
+}
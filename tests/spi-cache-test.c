@@ -0,0 +1,202 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Read cache and mappings of the SPI boot device, on a flash image in
+ * memory. Small reads, writes, erases and mappings released in random
+ * order must all see the same data as the flash, and the pool must be
+ * empty once every mapping is gone.
+ */
+
+#ifndef TEST_CACHE_PAGES
+#define TEST_CACHE_PAGES 8
+#endif
+#define CONFIG_SPI_FLASH_READ_CACHE_PAGES TEST_CACHE_PAGES
+#define CONFIG_SPI_FLASH_READ_CACHE_PAGE_SIZE 0x200
+#define CONFIG_ROM_SIZE (1 << 20)
+#define CONFIG_BOOT_DEVICE_SPI_FLASH_BUS 0
+
+#include <kconfig.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/drivers/spi/cbfs_spi.c"
+
+#define CACHE_SIZE	0x10000
+#define MAPS		64
+
+static uint8_t flash[CONFIG_ROM_SIZE];
+static uint8_t cbfs_cache[CACHE_SIZE] __attribute__((aligned(8)));
+static uint8_t postram_cache[CACHE_SIZE] __attribute__((aligned(8)));
+uint8_t *_cbfs_cache = cbfs_cache;
+size_t _cbfs_cache_size = sizeof(cbfs_cache);
+uint8_t *_preram_cbfs_cache = cbfs_cache;
+size_t _preram_cbfs_cache_size = sizeof(cbfs_cache);
+uint8_t *_postram_cbfs_cache = postram_cache;
+size_t _postram_cbfs_cache_size = sizeof(postram_cache);
+
+static struct spi_flash test_flash;
+static int flash_reads;
+
+void timer_monotonic_get(struct mono_time *mt)
+{
+	mt->microseconds = 0;
+}
+
+struct spi_flash *spi_flash_probe(unsigned int bus, unsigned int cs)
+{
+	return &test_flash;
+}
+
+int spi_flash_read(const struct spi_flash *f, u32 offset, size_t len,
+		   void *buf)
+{
+	assert(offset + len <= sizeof(flash));
+	flash_reads++;
+	memcpy(buf, flash + offset, len);
+	return 0;
+}
+
+int spi_flash_write(const struct spi_flash *f, u32 offset, size_t len,
+		    const void *buf)
+{
+	assert(offset + len <= sizeof(flash));
+	memcpy(flash + offset, buf, len);
+	return 0;
+}
+
+int spi_flash_erase(const struct spi_flash *f, u32 offset, size_t len)
+{
+	assert(offset + len <= sizeof(flash));
+	memset(flash + offset, 0xff, len);
+	return 0;
+}
+
+static void check_read(const struct region_device *rd, size_t offset,
+		       size_t size)
+{
+	uint8_t buf[4096];
+
+	assert(size <= sizeof(buf));
+	assert(rdev_readat(rd, buf, offset, size) == size);
+	assert(!memcmp(buf, flash + offset, size));
+}
+
+/* A CBFS walk reads small headers one after the other. */
+static void test_sequential(const struct region_device *rd)
+{
+	size_t offset;
+	int reads = 0;
+
+	flash_reads = 0;
+	for (offset = 0; offset < 64 * KiB; offset += 24, reads++)
+		check_read(rd, offset, 24);
+
+	printf("sequential: %d reads, %d from flash\n", reads, flash_reads);
+	if (CACHE_PAGES)
+		assert(flash_reads < reads / 16);
+}
+
+static void test_random(const struct region_device *rd)
+{
+	void *maps[MAPS] = { NULL };
+	uint8_t buf[4096];
+	int i, n;
+
+	for (i = 0; i < 200000; i++) {
+		size_t offset = rand() % (sizeof(flash) - sizeof(buf));
+		size_t size = 1 + rand() % ((rand() & 1) ? 64 : 3000);
+
+		n = rand() % MAPS;
+		switch (rand() % 7) {
+		case 0:
+		case 1:
+			check_read(rd, offset, size);
+			break;
+		case 2:
+			memset(buf, rand(), size);
+			assert(rdev_writeat(rd, buf, offset, size) == size);
+			break;
+		case 3:
+			assert(rdev_eraseat(rd, offset, size) == size);
+			break;
+		default:
+			if (maps[n] == NULL) {
+				maps[n] = rdev_mmap(rd, offset, size);
+				if (maps[n] != NULL)
+					assert(!memcmp(maps[n], flash + offset,
+						       size));
+			} else {
+				assert(!rdev_munmap(rd, maps[n]));
+				maps[n] = NULL;
+			}
+			break;
+		}
+	}
+
+	for (n = 0; n < MAPS; n++) {
+		if (maps[n] != NULL)
+			assert(!rdev_munmap(rd, maps[n]));
+	}
+
+	/* Only the read cache may be left in the pool. */
+	if (cache.data == NULL)
+		assert(mdev.pool.free_offset == 0);
+	else
+		assert(mdev.pool.last_alloc == cache.data - 8);
+	printf("random: %u hits, %u misses\n", cache.hits, cache.misses);
+}
+
+/* Mappings that need the whole pool take the space of the read cache. */
+static void test_mappings_win(const struct region_device *rd)
+{
+	void *map;
+
+	check_read(rd, 0x1000, 16);
+	map = rdev_mmap(rd, 0x2000, CACHE_SIZE - 64);
+	assert(map != NULL);
+	assert(cache.data == NULL);
+	check_read(rd, 0x1000, 16);
+	assert(!memcmp(map, flash + 0x2000, CACHE_SIZE - 64));
+	assert(!rdev_munmap(rd, map));
+	assert(mdev.pool.free_offset == 0);
+}
+
+int main(void)
+{
+	const struct region_device *rd;
+	size_t i;
+
+	srand(1);
+	for (i = 0; i < sizeof(flash); i++)
+		flash[i] = rand();
+
+	boot_device_init();
+	rd = boot_device_ro();
+	assert(rd != NULL);
+
+	test_sequential(rd);
+	test_random(rd);
+	test_mappings_win(rd);
+
+	/* Moving to the postram cache starts over with an empty pool. */
+	switch_to_postram_cache(0);
+	assert(mdev.pool.buf == postram_cache);
+	test_sequential(rd);
+	test_random(rd);
+
+	printf("spi-cache-test: %d cache pages passed\n", CACHE_PAGES);
+	return 0;
+}
@@ -0,0 +1,422 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * ACPI and SMBIOS table cache over several boots, with the tables landing
+ * at different addresses. Caches that were tampered with, including ones
+ * with a matching hash, must be rejected without touching memory outside
+ * of the destination.
+ */
+
+#define __RAMSTAGE__
+#define CONFIG_TABLE_CACHE 1
+#define CONFIG_HAVE_ACPI_TABLES 1
+#define CONFIG_STACK_SIZE 0x1000
+
+#include <kconfig.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "../src/arch/x86/table_cache.c"
+
+#define AREA_SIZE	0x10000
+#define PAGE_SIZE	0x1000
+
+const char coreboot_version[] = "4.6";
+const char coreboot_extra_version[] = "";
+const char coreboot_build[] = "build";
+const char coreboot_compile_time[] = "time";
+
+static struct resource domain_res = {
+	.base = 0x80000000,
+	.size = 0x200,
+	.flags = 7,
+};
+static struct device lpc = {
+	.vendor = 0x8086,
+	.device = 0x9d48,
+	.class = 0x601,
+	.enabled = 1,
+};
+static struct device domain = {
+	.next = &lpc,
+	.resource_list = &domain_res,
+	.enabled = 1,
+};
+struct device *all_devices = &domain;
+
+const char *dev_path(device_t dev)
+{
+	return dev == &lpc ? "PCI: 00:1f.0" : "DOMAIN: 0000";
+}
+
+struct cbmem_entry {
+	u32 id;
+	int present;
+	u8 data[64];
+};
+
+static struct cbmem_entry cbmem[] = {
+	{ .id = CBMEM_ID_CBTABLE, .present = 1 },
+	{ .id = CBMEM_ID_TCPA_LOG },
+	{ .id = CBMEM_ID_ACPI_GNVS },
+};
+
+const struct cbmem_entry *cbmem_entry_find(u32 id)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(cbmem); i++) {
+		if (cbmem[i].id == id && cbmem[i].present)
+			return &cbmem[i];
+	}
+	return NULL;
+}
+
+void *cbmem_entry_start(const struct cbmem_entry *entry)
+{
+	return (void *)entry->data;
+}
+
+u64 cbmem_entry_size(const struct cbmem_entry *entry)
+{
+	return sizeof(entry->data);
+}
+
+void *cbmem_top(void)
+{
+	return (void *)0x7f000000;
+}
+
+void *acpi_get_tcpa_log(u32 *size)
+{
+	cbmem[1].present = 1;
+	*size = sizeof(cbmem[1].data);
+	return cbmem[1].data;
+}
+
+static int generators_use_gnvs;
+
+static u8 flash[0x10000];
+static struct mem_region_device flash_mdev =
+	MEM_REGION_DEV_RW_INIT(flash, sizeof(flash));
+
+int fmap_locate_area_as_rdev_rw(const char *name, struct region_device *area)
+{
+	assert(!strcmp(name, TABLE_CACHE_REGION));
+	return rdev_chain(area, &flash_mdev.rdev, 0, sizeof(flash));
+}
+
+u8 acpi_checksum(u8 *table, u32 length)
+{
+	u8 sum = 0;
+
+	while (length--)
+		sum += *table++;
+	return -sum;
+}
+
+/* Offsets of the tables build_acpi() writes */
+enum {
+	RSDP = 0,
+	RSDT = 0x40,
+	XSDT = 0x80,
+	FACS = 0x100,
+	DSDT = 0x140,
+	FADT = 0x200,
+	SSDT = 0x400,
+	ACPI_END = 0x440,
+	SMBIOS_TABLE = 0x20,
+	SMBIOS_END = 0x60,
+};
+
+static void *at(unsigned long base, size_t offset)
+{
+	return (void *)(base + offset);
+}
+
+static void acpi_header(acpi_header_t *header, const char *signature,
+			u32 length)
+{
+	memcpy(header->signature, signature, 4);
+	header->length = length;
+	header->checksum = 0;
+	header->checksum = acpi_checksum((void *)header, length);
+}
+
+static unsigned long build_acpi(unsigned long base)
+{
+	acpi_rsdp_t *rsdp = at(base, RSDP);
+	acpi_rsdt_t *rsdt = at(base, RSDT);
+	acpi_xsdt_t *xsdt = at(base, XSDT);
+	acpi_fadt_t *fadt = at(base, FADT);
+	acpi_facs_t *facs = at(base, FACS);
+
+	assert(sizeof(*fadt) <= SSDT - FADT);
+	if (generators_use_gnvs)
+		cbmem[2].present = 1;
+	memset(at(base, 0), 0, ACPI_END);
+	memcpy(facs->signature, "FACS", 4);
+	facs->length = sizeof(*facs);
+	acpi_header(at(base, DSDT), "DSDT", 0x40);
+	acpi_header(at(base, SSDT), "SSDT", 0x40);
+
+	fadt->firmware_ctrl = base + FACS;
+	fadt->dsdt = base + DSDT;
+	fadt->x_firmware_ctl_l = base + FACS;
+	fadt->x_dsdt_l = base + DSDT;
+	acpi_header(&fadt->header, "FACP", sizeof(*fadt));
+
+	rsdt->entry[0] = base + FADT;
+	rsdt->entry[1] = base + SSDT;
+	acpi_header(&rsdt->header, "RSDT", sizeof(acpi_header_t) + 8);
+	xsdt->entry[0] = base + FADT;
+	xsdt->entry[1] = base + SSDT;
+	acpi_header(&xsdt->header, "XSDT", sizeof(acpi_header_t) + 16);
+
+	memcpy(rsdp->signature, RSDP_SIG, 8);
+	rsdp->length = sizeof(*rsdp);
+	rsdp->rsdt_address = base + RSDT;
+	rsdp->xsdt_address = base + XSDT;
+	rsdp->checksum = acpi_checksum((void *)rsdp, 20);
+	rsdp->ext_checksum = acpi_checksum((void *)rsdp, sizeof(*rsdp));
+
+	return base + ACPI_END;
+}
+
+static void check_acpi(unsigned long base)
+{
+	acpi_rsdp_t *rsdp = at(base, RSDP);
+	acpi_rsdt_t *rsdt = at(base, RSDT);
+	acpi_xsdt_t *xsdt = at(base, XSDT);
+	acpi_fadt_t *fadt = at(base, FADT);
+
+	assert(!acpi_checksum((void *)rsdp, 20));
+	assert(!acpi_checksum((void *)rsdp, sizeof(*rsdp)));
+	assert(rsdp->rsdt_address == base + RSDT);
+	assert(rsdp->xsdt_address == base + XSDT);
+	assert(!acpi_checksum((void *)rsdt, rsdt->header.length));
+	assert(rsdt->entry[0] == base + FADT);
+	assert(rsdt->entry[1] == base + SSDT);
+	assert(!acpi_checksum((void *)xsdt, xsdt->header.length));
+	assert(xsdt->entry[0] == base + FADT);
+	assert(xsdt->entry[1] == base + SSDT);
+	assert(!acpi_checksum((void *)fadt, fadt->header.length));
+	assert(fadt->firmware_ctrl == base + FACS);
+	assert(fadt->dsdt == base + DSDT);
+	assert(fadt->x_firmware_ctl_l == base + FACS);
+	assert(fadt->x_dsdt_l == base + DSDT);
+}
+
+static unsigned long build_smbios(unsigned long base)
+{
+	struct smbios_entry *se = at(base, 0);
+
+	memset(se, 0, SMBIOS_END);
+	memcpy(se->anchor, "_SM_", 4);
+	se->struct_table_address = base + SMBIOS_TABLE;
+	se->struct_table_length = SMBIOS_END - SMBIOS_TABLE;
+	strcpy(at(base, SMBIOS_TABLE), "type 0");
+	se->intermediate_checksum = smbios_checksum((u8 *)se + 0x10,
+						    sizeof(*se) - 0x10);
+	se->checksum = smbios_checksum((u8 *)se, sizeof(*se));
+
+	return base + SMBIOS_END;
+}
+
+static void check_smbios(unsigned long base)
+{
+	struct smbios_entry *se = at(base, 0);
+
+	assert(se->struct_table_address == base + SMBIOS_TABLE);
+	assert(!smbios_checksum((u8 *)se, sizeof(*se)));
+	assert(!strcmp(at(base, SMBIOS_TABLE), "type 0"));
+}
+
+/* Forget everything that lives in RAM. */
+static void reboot(void)
+{
+	memset(&cache, 0, sizeof(cache));
+	cbmem[1].present = 0;
+	cbmem[2].present = 0;
+}
+
+/* One boot of write_tables(), returns how many of the tables were restored */
+static int boot(unsigned long acpi, unsigned long smbios)
+{
+	unsigned long end;
+	int restored = 0;
+
+	reboot();
+	end = table_cache_restore(CBMEM_ID_ACPI, acpi, AREA_SIZE);
+	/* The TCPA log must exist whether or not the tables are restored. */
+	assert(cbmem[1].present);
+	if (end) {
+		assert(end == acpi + ACPI_END);
+		restored++;
+	} else {
+		end = build_acpi(acpi);
+		table_cache_save(CBMEM_ID_ACPI, acpi, end);
+	}
+	check_acpi(acpi);
+
+	end = table_cache_restore(CBMEM_ID_SMBIOS, smbios, AREA_SIZE);
+	if (end) {
+		assert(end == smbios + SMBIOS_END);
+		restored++;
+	} else {
+		end = build_smbios(smbios);
+		table_cache_save(CBMEM_ID_SMBIOS, smbios, end);
+	}
+	check_smbios(smbios);
+
+	table_cache_flush(NULL);
+	return restored;
+}
+
+static const struct table_cache_entry *flash_entry(uint32_t id)
+{
+	const struct table_cache_header *h = (void *)flash;
+	size_t i;
+
+	for (i = 0; i < h->num_entries; i++) {
+		if (h->entries[i].id == id)
+			return &h->entries[i];
+	}
+	assert(0);
+	return NULL;
+}
+
+/* Change cached data and fix up its hash, like an attacker would. */
+static void tamper(uint32_t id, size_t offset, u32 value)
+{
+	struct table_cache_entry *e = (void *)flash_entry(id);
+
+	memcpy(&flash[e->offset + offset], &value, sizeof(value));
+	e->hash = fnv1a(FNV_OFFSET_BASIS, &flash[e->offset], e->size);
+}
+
+static void test_tampered(unsigned long acpi, unsigned long smbios)
+{
+	static const struct {
+		uint32_t id;
+		size_t offset;
+		u32 value;
+	} cases[] = {
+		/* Lengths reaching past the end of the tables */
+		{ CBMEM_ID_ACPI, RSDT + 4, 0x10000 },
+		{ CBMEM_ID_ACPI, XSDT + 4, 0xffffffff },
+		{ CBMEM_ID_ACPI, FADT + 4, 0x2000 },
+		{ CBMEM_ID_ACPI, DSDT + 4, ACPI_END },
+		{ CBMEM_ID_ACPI, SSDT + 4, 0x41 },
+		/* Headers shorter than what is read from them */
+		{ CBMEM_ID_ACPI, RSDT + 4, 4 },
+		{ CBMEM_ID_ACPI, FADT + 4, sizeof(acpi_header_t) },
+		/* Pointers out of the tables */
+		{ CBMEM_ID_ACPI, RSDP + 16, 0x100000 },
+		{ CBMEM_ID_ACPI, RSDT + sizeof(acpi_header_t), 0x200000 },
+		{ CBMEM_ID_ACPI, XSDT + sizeof(acpi_header_t) + 8, 0 },
+		{ CBMEM_ID_ACPI, FADT + offsetof(acpi_fadt_t, dsdt), 0x1000 },
+		{ CBMEM_ID_ACPI, FADT + offsetof(acpi_fadt_t, firmware_ctrl),
+		  ACPI_END - 8 },
+		{ CBMEM_ID_ACPI, FADT + offsetof(acpi_fadt_t, x_dsdt_h), 1 },
+		{ CBMEM_ID_SMBIOS, offsetof(struct smbios_entry,
+					    struct_table_address), 0x1000 },
+		{ CBMEM_ID_SMBIOS, offsetof(struct smbios_entry,
+					    struct_table_length), 0x100 },
+		/* No RSDP or entry point */
+		{ CBMEM_ID_ACPI, RSDP, 0 },
+		{ CBMEM_ID_SMBIOS, 0, 0 },
+	};
+	static u8 saved[sizeof(flash)];
+	const struct table_cache_entry *e;
+	size_t i, old_base;
+	u32 value;
+
+	memcpy(saved, flash, sizeof(flash));
+	for (i = 0; i < ARRAY_SIZE(cases); i++) {
+		e = flash_entry(cases[i].id);
+		old_base = e->base;
+		value = cases[i].value;
+		/* Addresses are given relative to where the tables were. */
+		if (cases[i].offset % 4 == 0 && value >= 0x1000 &&
+		    value < 0x10000000)
+			value += old_base;
+		tamper(cases[i].id, cases[i].offset, value);
+
+		reboot();
+		if (cases[i].id == CBMEM_ID_ACPI)
+			assert(!table_cache_restore(CBMEM_ID_ACPI, acpi,
+						    AREA_SIZE));
+		else
+			assert(!table_cache_restore(CBMEM_ID_SMBIOS, smbios,
+						    AREA_SIZE));
+		memcpy(flash, saved, sizeof(flash));
+	}
+}
+
+int main(void)
+{
+	static u8 saved[sizeof(flash)];
+	unsigned long area[3];
+	u8 *mem;
+	int i;
+
+	/* ACPI pointers are 32 bits. Each area is followed by a guard page. */
+	mem = mmap(NULL, 3 * (AREA_SIZE + PAGE_SIZE), PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+	assert(mem != MAP_FAILED);
+	for (i = 0; i < 3; i++) {
+		area[i] = (unsigned long)mem + i * (AREA_SIZE + PAGE_SIZE);
+		assert(!mprotect((void *)(area[i] + AREA_SIZE), PAGE_SIZE,
+				 PROT_NONE));
+	}
+	memset(flash, 0xff, sizeof(flash));
+
+	assert(boot(area[0], area[1]) == 0);
+	memcpy(saved, flash, sizeof(flash));
+	/* Restoring in place and moved, and nothing written back. */
+	assert(boot(area[0], area[1]) == 2);
+	assert(boot(area[2], area[0]) == 2);
+	assert(boot(area[1], area[2]) == 2);
+	assert(!memcmp(saved, flash, sizeof(flash)));
+
+	/* A destination that is too small */
+	reboot();
+	assert(!table_cache_restore(CBMEM_ID_ACPI, area[0], ACPI_END - 1));
+
+	/* Corrupted data */
+	flash[flash_entry(CBMEM_ID_ACPI)->offset + SSDT + 20] ^= 1;
+	assert(boot(area[0], area[1]) == 1);
+	assert(boot(area[1], area[0]) == 2);
+
+	test_tampered(area[2], area[1]);
+
+	/* Changed hardware */
+	lpc.device = 0x9d4e;
+	assert(boot(area[0], area[1]) == 0);
+	assert(boot(area[0], area[1]) == 2);
+
+	/* A build whose ACPI generators set up GNVS only caches SMBIOS. */
+	memset(flash, 0xff, sizeof(flash));
+	generators_use_gnvs = 1;
+	assert(boot(area[0], area[1]) == 0);
+	assert(boot(area[0], area[1]) == 1);
+	assert(((struct table_cache_header *)flash)->num_entries == 1);
+	flash_entry(CBMEM_ID_SMBIOS);
+
+	printf("table-cache-test: passed\n");
+	return 0;
+}
@@ -0,0 +1,164 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * NV read cache of the TPM1.2 tlcl, against a software TPM that keeps a
+ * few NV spaces. Every read must return what the TPM holds, and reads are
+ * only allowed to skip the TPM while nothing could have changed the space.
+ */
+
+#define CONFIG_COLLECT_TIMESTAMPS 1
+#define CONFIG_TPM_COMMAND_TIMESTAMPS 1
+
+#include <kconfig.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../src/lib/tlcl.c"
+#include "../src/lib/tlcl_cache.c"
+
+#define TPM_ORD_NV_DEFINE_SPACE	0xcc
+#define TPM_ORD_NV_WRITE_VALUE	0xcd
+#define TPM_ORD_NV_READ_VALUE	0xcf
+
+#define SPACES		8
+#define SPACE_SIZE	64
+
+static u8 nv[SPACES][SPACE_SIZE];
+static int commands, reads, timestamps_started, timestamps_ended;
+
+void timestamp_add_now(enum timestamp_id id)
+{
+	if (id == TS_START_TPMCMD)
+		timestamps_started++;
+	else if (id == TS_END_TPMCMD)
+		timestamps_ended++;
+}
+
+int tis_init(void)
+{
+	return 0;
+}
+
+int tis_open(void)
+{
+	return 0;
+}
+
+int tis_sendrecv(const u8 *sendbuf, size_t send_size, u8 *recvbuf,
+		 size_t *recv_len)
+{
+	uint32_t ordinal, index, length = 0;
+
+	assert(timestamps_started == timestamps_ended + 1);
+	commands++;
+	from_tpm_uint32(sendbuf + 6, &ordinal);
+	assert(*recv_len >= 14 + SPACE_SIZE);
+	memset(recvbuf, 0, 10);
+
+	switch (ordinal) {
+	case TPM_ORD_NV_READ_VALUE:
+		reads++;
+		from_tpm_uint32(sendbuf + 10, &index);
+		from_tpm_uint32(sendbuf + 18, &length);
+		assert(index < SPACES && length <= SPACE_SIZE);
+		to_tpm_uint32(recvbuf + 10, length);
+		memcpy(recvbuf + 14, nv[index], length);
+		length += 4;
+		break;
+	case TPM_ORD_NV_WRITE_VALUE:
+		from_tpm_uint32(sendbuf + 10, &index);
+		from_tpm_uint32(sendbuf + 18, &length);
+		assert(index < SPACES && length <= SPACE_SIZE);
+		memcpy(nv[index], sendbuf + 22, length);
+		length = 0;
+		break;
+	}
+
+	recvbuf[1] = 0xc4;
+	to_tpm_uint32(recvbuf + 2, 10 + length);
+	*recv_len = 10 + length;
+	return 0;
+}
+
+static void check_read(uint32_t index, uint32_t length, int from_tpm)
+{
+	u8 buf[SPACE_SIZE];
+	int before = reads;
+
+	assert(tlcl_read(index, buf, length) == TPM_SUCCESS);
+	assert(!memcmp(buf, nv[index], length));
+	assert(reads - before == from_tpm);
+}
+
+int main(void)
+{
+	u8 data[SPACE_SIZE];
+	int i;
+
+	assert(tlcl_lib_init() == TPM_SUCCESS);
+	assert(tlcl_startup() == TPM_SUCCESS);
+
+	memcpy(data, "firmware space", 15);
+	assert(tlcl_write(1, data, 15) == TPM_SUCCESS);
+	check_read(1, 15, 1);
+	check_read(1, 15, 0);
+	/* Shorter reads return the start of the space. */
+	check_read(1, 5, 0);
+
+	/* Writes go through to the TPM and invalidate the space. */
+	data[0] = 'F';
+	assert(tlcl_write(1, data, 15) == TPM_SUCCESS);
+	check_read(1, 15, 1);
+	check_read(1, 15, 0);
+
+	/* Anything that may change what the TPM returns flushes everything. */
+	assert(tlcl_resume() == TPM_SUCCESS);
+	check_read(1, 15, 1);
+	assert(tlcl_set_nv_locked() == TPM_SUCCESS);
+	check_read(1, 15, 1);
+	assert(tlcl_define_space(2, 0, 10) == TPM_SUCCESS);
+	check_read(1, 15, 1);
+	assert(tlcl_force_clear() == TPM_SUCCESS);
+	check_read(1, 15, 1);
+	assert(tlcl_startup() == TPM_SUCCESS);
+	check_read(1, 15, 1);
+	tlcl_cache_flush();
+	check_read(1, 15, 1);
+
+	/* Longer than what was cached, or too big to cache at all. */
+	check_read(1, 20, 1);
+	check_read(1, 20, 0);
+	check_read(1, SPACE_SIZE, 1);
+	check_read(1, SPACE_SIZE, 1);
+
+	/* More spaces than cache entries, each read must still be right. */
+	for (i = 0; i < SPACES; i++) {
+		memset(data, 'a' + i, 32);
+		assert(tlcl_write(i, data, 32) == TPM_SUCCESS);
+	}
+	for (i = 0; i < 4 * SPACES; i++) {
+		u8 buf[32];
+
+		assert(tlcl_read(i * 3 % SPACES, buf, 32) == TPM_SUCCESS);
+		assert(!memcmp(buf, nv[i * 3 % SPACES], 32));
+	}
+
+	assert(timestamps_started == commands);
+	assert(timestamps_ended == commands);
+
+	printf("tlcl-test: %d TPM commands, %d NV reads, passed\n", commands,
+	       reads);
+	return 0;
+}
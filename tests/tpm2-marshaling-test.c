@@ -0,0 +1,285 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * TPM2 command marshaling and response parsing against hand-assembled
+ * commands from the TPM 2.0 Part 3 layouts, and a fuzzer that feeds the
+ * parser random responses in buffers of their exact size.
+ */
+
+#include <kconfig.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/lib/tpm2_marshaling.c"
+
+/* Authorization area with an empty password, 13 bytes */
+#define PW_SESSION	0, 0, 0, 9, 0x40, 0, 0, 9, 0, 0, 0, 0, 0
+#define PLATFORM	0x40, 0, 0, 0x0c
+
+static const u8 startup[] = {
+	0x80, 1, 0, 0, 0, 12, 0, 0, 0x01, 0x44,
+	0, 0,
+};
+
+static const u8 self_test[] = {
+	0x80, 1, 0, 0, 0, 11, 0, 0, 0x01, 0x43,
+	1,
+};
+
+static const u8 get_capability[] = {
+	0x80, 1, 0, 0, 0, 22, 0, 0, 0x01, 0x7a,
+	0, 0, 0, 6, 0, 0, 2, 0, 0, 0, 0, 1,
+};
+
+static const u8 nv_read[] = {
+	0x80, 2, 0, 0, 0, 35, 0, 0, 0x01, 0x4e,
+	PLATFORM, 0, 0, 0x10, 0x07, PW_SESSION,
+	0, 13, 0, 0,
+};
+
+static const u8 nv_write_lock[] = {
+	0x80, 2, 0, 0, 0, 31, 0, 0, 0x01, 0x38,
+	PLATFORM, 0, 0, 0x10, 0x07, PW_SESSION,
+};
+
+static const u8 clear[] = {
+	0x80, 2, 0, 0, 0, 27, 0, 0, 0x01, 0x26,
+	PLATFORM, PW_SESSION,
+};
+
+static const u8 nv_write[] = {
+	0x80, 2, 0, 0, 0, 38, 0, 0, 0x01, 0x37,
+	PLATFORM, 0, 0, 0x10, 0x07, PW_SESSION,
+	0, 3, 'a', 'b', 'c', 0, 2,
+};
+
+static const u8 nv_define_space[] = {
+	0x80, 2, 0, 0, 0, 49, 0, 0, 0x01, 0x2a,
+	PLATFORM, PW_SESSION,
+	0, 2, 'p', 'w',
+	0, 16, 0, 0, 0x10, 0x07, 0, 0x0b, 0, 1, 0, 1, 0, 2, 'p', 'o', 0, 13,
+};
+
+static const u8 pcr_extend[] = {
+	0x80, 2, 0, 0, 0, 65, 0, 0, 0x01, 0x82,
+	0, 0, 0, 2, PW_SESSION,
+	0, 0, 0, 1, 0, 0x0b,
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+	16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31,
+};
+
+/* Marshal into a buffer of every size up to the full one. */
+static void check_command(const char *name, TPM_CC code, void *body,
+			  const u8 *expected, size_t size)
+{
+	u8 buf[TPM_BUFFER_SIZE];
+	size_t i;
+
+	memset(buf, 0xaa, sizeof(buf));
+	assert(tpm_marshal_command(code, body, buf, sizeof(buf)) == size);
+	assert(!memcmp(buf, expected, size));
+
+	for (i = 0; i < size; i++)
+		assert(tpm_marshal_command(code, body, buf, i) < 0);
+	printf("%-16s ok\n", name);
+}
+
+static void test_commands(void)
+{
+	struct tpm2_startup startup_body = { .startup_type = TPM_SU_CLEAR };
+	struct tpm2_self_test self_test_body = { .yes_no = 1 };
+	struct tpm2_get_capability get_capability_body = {
+		.capability = TPM_CAP_TPM_PROPERTIES,
+		.property = TPM_PT_PERMANENT,
+		.propertyCount = 1,
+	};
+	struct tpm2_nv_read_cmd nv_read_body = {
+		.nvIndex = 0x1007,
+		.size = 13,
+	};
+	struct tpm2_nv_write_lock_cmd nv_write_lock_body = {
+		.nvIndex = 0x1007,
+	};
+	struct tpm2_nv_write_cmd nv_write_body = {
+		.nvIndex = 0x1007,
+		.data.t = { .size = 3, .buffer = (const u8 *)"abc" },
+		.offset = 2,
+	};
+	struct tpm2_nv_define_space_cmd nv_define_space_body = {
+		.auth.t = { .size = 2, .buffer = (const u8 *)"pw" },
+		.publicInfo = {
+			.nvIndex = 0x1007,
+			.nameAlg = TPM_ALG_SHA256,
+			.attributes = {
+				.TPMA_NV_PPWRITE = 1,
+				.TPMA_NV_PPREAD = 1,
+			},
+			.authPolicy.t = {
+				.size = 2,
+				.buffer = (const u8 *)"po",
+			},
+			.dataSize = 13,
+		},
+	};
+	struct tpm2_pcr_extend_cmd pcr_extend_body = {
+		.pcrHandle = 2,
+		.digests = {
+			.count = 1,
+			.digests[0].hashAlg = TPM_ALG_SHA256,
+		},
+	};
+	int i;
+
+	for (i = 0; i < SHA256_DIGEST_SIZE; i++)
+		pcr_extend_body.digests.digests[0].digest.sha256[i] = i;
+
+	check_command("Startup", TPM2_Startup, &startup_body, startup,
+		      sizeof(startup));
+	check_command("SelfTest", TPM2_SelfTest, &self_test_body, self_test,
+		      sizeof(self_test));
+	check_command("GetCapability", TPM2_GetCapability,
+		      &get_capability_body, get_capability,
+		      sizeof(get_capability));
+	check_command("NV_Read", TPM2_NV_Read, &nv_read_body, nv_read,
+		      sizeof(nv_read));
+	check_command("NV_WriteLock", TPM2_NV_WriteLock, &nv_write_lock_body,
+		      nv_write_lock, sizeof(nv_write_lock));
+	check_command("Clear", TPM2_Clear, NULL, clear, sizeof(clear));
+	check_command("NV_Write", TPM2_NV_Write, &nv_write_body, nv_write,
+		      sizeof(nv_write));
+	check_command("NV_DefineSpace", TPM2_NV_DefineSpace,
+		      &nv_define_space_body, nv_define_space,
+		      sizeof(nv_define_space));
+	check_command("PCR_Extend", TPM2_PCR_Extend, &pcr_extend_body,
+		      pcr_extend, sizeof(pcr_extend));
+}
+
+static void test_nv_read_response(void)
+{
+	u8 r[] = {
+		0x80, 2, 0, 0, 0, 25, 0, 0, 0, 0,
+		0, 0, 0, 6, 0, 4, 'a', 'b', 'c', 'd',
+		0, 0, 1, 0, 0,
+	};
+	struct tpm2_response *resp;
+
+	resp = tpm_unmarshal_response(TPM2_NV_Read, r, sizeof(r));
+	assert(resp != NULL);
+	assert(resp->hdr.tpm_size == sizeof(r));
+	assert(resp->nvr.buffer.t.size == 4);
+	/* The data is not copied. */
+	assert(resp->nvr.buffer.t.buffer == r + 16);
+
+	/* Parameter size that does not match the data */
+	r[13] = 7;
+	assert(!tpm_unmarshal_response(TPM2_NV_Read, r, sizeof(r)));
+	r[13] = 6;
+	/* Data reaching past the end of the response */
+	r[15] = 40;
+	assert(!tpm_unmarshal_response(TPM2_NV_Read, r, sizeof(r)));
+	r[15] = 4;
+	/* Received less than the data */
+	assert(!tpm_unmarshal_response(TPM2_NV_Read, r, 19));
+
+	/* Errors come without parameters. */
+	r[5] = 10;
+	r[9] = 0x8b;
+	resp = tpm_unmarshal_response(TPM2_NV_Read, r, 10);
+	assert(resp != NULL && resp->hdr.tpm_code == 0x8b);
+}
+
+static void test_get_capability_response(void)
+{
+	u8 r[] = {
+		0x80, 1, 0, 0, 0, 35, 0, 0, 0, 0,
+		1, 0, 0, 0, 6, 0, 0, 0, 2,
+		0, 0, 2, 0, 0, 0, 0, 5,
+		0, 0, 2, 1, 0xde, 0xad, 0xbe, 0xef,
+	};
+	struct tpm2_response *resp;
+
+	resp = tpm_unmarshal_response(TPM2_GetCapability, r, sizeof(r));
+	assert(resp != NULL);
+	assert(resp->gc.more_data == 1);
+	assert(resp->gc.cd.capability == TPM_CAP_TPM_PROPERTIES);
+	assert(resp->gc.cd.data.tpmProperties.count == 2);
+	assert(resp->gc.cd.data.tpmProperties.tpmProperty[0].property ==
+	       0x200);
+	assert(resp->gc.cd.data.tpmProperties.tpmProperty[0].value == 5);
+	assert(resp->gc.cd.data.tpmProperties.tpmProperty[1].property ==
+	       0x201);
+	assert(resp->gc.cd.data.tpmProperties.tpmProperty[1].value ==
+	       0xdeadbeef);
+
+	/* A count the response does not hold */
+	r[18] = 3;
+	assert(!tpm_unmarshal_response(TPM2_GetCapability, r, sizeof(r)));
+	r[18] = 0xff;
+	assert(!tpm_unmarshal_response(TPM2_GetCapability, r, sizeof(r)));
+	/* Trailing data */
+	r[18] = 1;
+	assert(!tpm_unmarshal_response(TPM2_GetCapability, r, sizeof(r)));
+}
+
+static const TPM_CC commands[] = {
+	TPM2_Startup, TPM2_GetCapability, TPM2_NV_Read, TPM2_NV_DefineSpace,
+	TPM2_NV_Write, TPM2_NV_WriteLock, TPM2_SelfTest, TPM2_Clear,
+	TPM2_PCR_Extend,
+};
+
+/* ASan catches any access past the end of the response. */
+static void fuzz_responses(void)
+{
+	struct tpm2_response *resp;
+	int round, parsed = 0;
+	size_t size, i;
+	u8 *r;
+
+	for (round = 0; round < 200000; round++) {
+		TPM_CC code = commands[rand() % ARRAY_SIZE(commands)];
+
+		size = rand() % 80;
+		r = malloc(size ? size : 1);
+		for (i = 0; i < size; i++)
+			r[i] = rand();
+		/* Mostly successful responses of the right size */
+		if (size >= 10 && rand() % 4) {
+			write_be32(r + 2, size);
+			write_be32(r + 6, 0);
+		}
+
+		resp = tpm_unmarshal_response(code, r, size);
+		if (resp)
+			parsed++;
+		if (resp && code == TPM2_NV_Read && !resp->hdr.tpm_code)
+			assert(resp->nvr.buffer.t.buffer +
+			       resp->nvr.buffer.t.size <= r + size);
+		free(r);
+	}
+	printf("fuzz: %d of %d responses parsed\n", parsed, round);
+}
+
+int main(void)
+{
+	srand(5);
+	test_commands();
+	test_nv_read_response();
+	test_get_capability_response();
+	fuzz_responses();
+
+	printf("tpm2-marshaling-test: passed\n");
+	return 0;
+}
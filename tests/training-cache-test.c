@@ -0,0 +1,314 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Training data cache on a simulated 64 KiB NOR flash region, where writes
+ * can only clear bits and erases are 4 KiB aligned. Every update must be
+ * found again intact, raw or LZ4 compressed, and a write that is cut off
+ * at any point must leave the previous entry current. Built once with the
+ * compressor and once without, where LZ4 updates must be refused.
+ */
+
+#ifndef TEST_COMPRESS
+#define TEST_COMPRESS 1
+#endif
+#define CONFIG_TRAINING_CACHE_COMPRESS TEST_COMPRESS
+
+#include <kconfig.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/lib/training_cache.c"
+
+#define FLASH_SIZE	(64 * KiB)
+
+static u8 flash[FLASH_SIZE];
+static size_t erases, bytes_read;
+static long write_budget = -1;	/* bytes left before the power is cut */
+
+static void *nor_mmap(const struct region_device *rd, size_t offset,
+		      size_t size)
+{
+	return &flash[offset];
+}
+
+static int nor_munmap(const struct region_device *rd, void *mapping)
+{
+	return 0;
+}
+
+static ssize_t nor_readat(const struct region_device *rd, void *b,
+			  size_t offset, size_t size)
+{
+	memcpy(b, &flash[offset], size);
+	bytes_read += size;
+	return size;
+}
+
+static ssize_t nor_writeat(const struct region_device *rd, const void *b,
+			   size_t offset, size_t size)
+{
+	const u8 *data = b;
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		if (write_budget == 0)
+			return -1;
+		if (write_budget > 0)
+			write_budget--;
+		flash[offset + i] &= data[i];
+	}
+	return size;
+}
+
+static ssize_t nor_eraseat(const struct region_device *rd, size_t offset,
+			   size_t size)
+{
+	assert(offset % (4 * KiB) == 0 && size % (4 * KiB) == 0);
+	memset(&flash[offset], 0xff, size);
+	erases += size / (4 * KiB);
+	return size;
+}
+
+static const struct region_device_ops nor_ops = {
+	.mmap = nor_mmap,
+	.munmap = nor_munmap,
+	.readat = nor_readat,
+	.writeat = nor_writeat,
+	.eraseat = nor_eraseat,
+};
+
+static struct region_device nor = REGION_DEV_INIT(&nor_ops, 0, FLASH_SIZE);
+
+int fmap_locate_area(const char *name, struct region *r)
+{
+	return -1;
+}
+
+int cbfs_boot_locate(struct cbfsf *fh, const char *name, uint32_t *type)
+{
+	return -1;
+}
+
+int boot_device_ro_subregion(const struct region *sub,
+			     struct region_device *subrd)
+{
+	return -1;
+}
+
+int boot_device_rw_subregion(const struct region *sub,
+			     struct region_device *subrd)
+{
+	return -1;
+}
+
+/* Training data is mostly small per-lane values that repeat. */
+static u8 *training_data(size_t size, unsigned int seed)
+{
+	u8 *p = malloc(size);
+	size_t i;
+
+	assert(p != NULL);
+	srand(seed);
+	for (i = 0; i < size; i++)
+		p[i] = i % 64 < 40 ? (i / 64) % 7 : rand() % 16;
+	return p;
+}
+
+static void check_current(uint32_t version, const u8 *data, size_t size)
+{
+	static u8 buf[FLASH_SIZE];
+	struct training_cache_entry e;
+
+	assert(!training_cache_find(&nor, &e));
+	assert(e.version == version && e.size == size);
+	if (!(e.flags & TRAINING_CACHE_LZ4))
+		assert(!memcmp(training_cache_map(&nor, &e), data, size));
+	else
+		assert(training_cache_map(&nor, &e) == NULL);
+	memset(buf, 0, size);
+	assert(training_cache_load(&nor, &e, buf, sizeof(buf)) == size);
+	assert(!memcmp(buf, data, size));
+}
+
+/* The layout this replaced: 4 KiB slots, all erased when one doesn't fit. */
+static size_t old_layout_erases(int updates, size_t size)
+{
+	size_t slot = ALIGN_UP(size + 16, 4 * KiB);
+	size_t next = 0, n = 0;
+
+	while (updates--) {
+		if (next + slot > FLASH_SIZE) {
+			n += FLASH_SIZE / (4 * KiB);
+			next = 0;
+		}
+		next += slot;
+	}
+	return n;
+}
+
+static void test_wear(uint32_t flags)
+{
+	int i;
+
+	memset(flash, 0xff, sizeof(flash));
+	erases = 0;
+	for (i = 0; i < 200; i++) {
+		u8 *d = training_data(6000, 100 + i);
+
+		assert(training_cache_update(&nor, 0, d, 6000, flags) ==
+		       TRAINING_CACHE_UPDATED);
+		check_current(0, d, 6000);
+		free(d);
+	}
+	printf("%s: 200 updates, %zu block erases, %zu with 4 KiB slots\n",
+	       flags & TRAINING_CACHE_LZ4 ? "lz4" : "raw", erases,
+	       old_layout_erases(200, 6000));
+	assert(erases < old_layout_erases(200, 6000));
+}
+
+/* Incompressible data, data larger than an LZ4 block and odd sizes. */
+static void test_lz4_sizes(void)
+{
+	size_t i, j;
+
+	for (i = 1; i < 40000; i = i * 3 + 1) {
+		u8 *d = malloc(i);
+
+		for (j = 0; j < i; j++)
+			d[j] = rand();
+		if (i > 100)
+			memset(d + i / 3, 'a', i / 4);
+		assert(training_cache_update(&nor, i, d, i,
+					     TRAINING_CACHE_LZ4) ==
+		       TRAINING_CACHE_UPDATED);
+		check_current(i, d, i);
+		free(d);
+	}
+}
+
+static void test_power_cut(void)
+{
+	static u8 saved[FLASH_SIZE];
+	u8 *old = training_data(3000, 7);
+	u8 *new = training_data(3000, 8);
+	struct training_cache_entry e;
+	long i;
+
+	memset(flash, 0xff, sizeof(flash));
+	assert(training_cache_update(&nor, 1, old, 3000, 0) ==
+	       TRAINING_CACHE_UPDATED);
+	memcpy(saved, flash, sizeof(flash));
+
+	for (i = 0; i < 3000 + sizeof(struct tc_record); i += 7) {
+		write_budget = i;
+		assert(training_cache_update(&nor, 2, new, 3000, 0) ==
+		       TRAINING_CACHE_WRITE_FAILURE);
+		write_budget = -1;
+		check_current(1, old, 3000);
+
+		/* The next boot cleans up and succeeds. */
+		assert(training_cache_update(&nor, 2, new, 3000, 0) ==
+		       TRAINING_CACHE_UPDATED);
+		check_current(2, new, 3000);
+		memcpy(flash, saved, sizeof(flash));
+	}
+
+	/* A flipped bit in the newest entry falls back to the one before. */
+	assert(training_cache_update(&nor, 2, new, 3000, 0) ==
+	       TRAINING_CACHE_UPDATED);
+	assert(!training_cache_find(&nor, &e));
+	flash[e.offset + 100] &= 0xfe;
+	check_current(1, old, 3000);
+	assert(training_cache_update(&nor, 2, new, 3000, 0) ==
+	       TRAINING_CACHE_UPDATED);
+	check_current(2, new, 3000);
+
+	free(old);
+	free(new);
+}
+
+static void test_index(void)
+{
+	struct training_cache_entry e;
+	uint32_t i;
+
+	memset(flash, 0xff, sizeof(flash));
+	for (i = 0; i < 120; i++)
+		assert(training_cache_update(&nor, i, &i, sizeof(i), 0) ==
+		       TRAINING_CACHE_UPDATED);
+	bytes_read = 0;
+	assert(!training_cache_find(&nor, &e));
+	assert(e.version == 119 && e.slot == 119);
+	printf("find with 120 entries read %zu bytes\n", bytes_read);
+	assert(bytes_read < 1024);
+
+	/* Once the index is full, it starts over. */
+	for (; i < TC_MAX_RECORDS + 10; i++)
+		assert(training_cache_update(&nor, i, &i, sizeof(i), 0) ==
+		       TRAINING_CACHE_UPDATED);
+	assert(!training_cache_find(&nor, &e));
+	assert(e.version == i - 1 && e.slot < 10);
+}
+
+int main(void)
+{
+	struct training_cache_entry e;
+	u8 *d;
+
+	assert(training_cache_hash("", 0) == 0x02cc5d05);
+	assert(training_cache_hash("abc", 3) == 0x32d153ff);
+	assert(training_cache_hash("Nobody inspects the spammish repetition",
+				   39) == 0xe2293b2f);
+
+	memset(flash, 0xff, sizeof(flash));
+	assert(training_cache_find(&nor, &e) < 0);
+
+	/* A region in the old format is erased on the first update. */
+	memset(flash, 0x5a, 64);
+	assert(training_cache_find(&nor, &e) < 0);
+	d = training_data(6000, 1);
+	assert(training_cache_update(&nor, 3, d, 6000, 0) ==
+	       TRAINING_CACHE_UPDATED);
+	check_current(3, d, 6000);
+	assert(training_cache_update(&nor, 3, d, 6000, 0) ==
+	       TRAINING_CACHE_UP_TO_DATE);
+	assert(training_cache_update(&nor, 4, d, 6000, 0) ==
+	       TRAINING_CACHE_UPDATED);
+	check_current(4, d, 6000);
+	free(d);
+
+	test_wear(0);
+	if (TEST_COMPRESS) {
+		test_wear(TRAINING_CACHE_LZ4);
+		test_lz4_sizes();
+	} else {
+		d = training_data(6000, 2);
+		assert(training_cache_update(&nor, 5, d, 6000,
+					     TRAINING_CACHE_LZ4) ==
+		       TRAINING_CACHE_OTHER_FAILURE);
+		free(d);
+	}
+	test_power_cut();
+	test_index();
+
+	d = calloc(1, FLASH_SIZE);
+	assert(training_cache_update(&nor, 0, d, FLASH_SIZE, 0) ==
+	       TRAINING_CACHE_OTHER_FAILURE);
+	free(d);
+
+	printf("training-cache-test: passed\n");
+	return 0;
+}
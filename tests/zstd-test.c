@@ -0,0 +1,238 @@
+/*
+ * This file is part of the coreboot project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Zstandard decoder against frames from the zstd library that cbfstool
+ * compresses with: several levels, checksums, frames without a content
+ * size, several frames in a row, decoding in place and corrupted or
+ * truncated input.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/commonlib/zstd_decoder.c"
+#include "../util/cbfstool/zstd/lib/zstd.h"
+
+#define DATA_SIZE	(320 * 1024)	/* several blocks */
+
+static uint8_t data[DATA_SIZE];
+static uint8_t packed[2 * DATA_SIZE];
+static size_t packed_size;
+static uint8_t out[DATA_SIZE + 4096];
+static uint64_t workspace[ZSTD_WORKSPACE_SIZE / sizeof(uint64_t) + 1];
+
+/* Code, tables and text alike: runs, copies and noise. */
+static void make_data(void)
+{
+	size_t pos = 0;
+
+	srand(7);
+	while (pos < DATA_SIZE) {
+		size_t n = 1 + rand() % 3000, i;
+
+		if (n > DATA_SIZE - pos)
+			n = DATA_SIZE - pos;
+		switch (rand() % 4) {
+		case 0:
+			memset(data + pos, rand() % 3 ? 0 : 0xff, n);
+			break;
+		case 1:
+			for (i = 0; i < n; i++)
+				data[pos + i] = rand();
+			break;
+		case 2:
+			for (i = 0; i < n; i++)
+				data[pos + i] = "coreboot "[rand() % 9];
+			break;
+		default:
+			/* Older data, a few bytes changed. */
+			if (pos > 0) {
+				size_t from = rand() % pos;
+
+				for (i = 0; i < n; i++)
+					data[pos + i] = data[from + i];
+				data[pos + rand() % n] ^= 0x10;
+			}
+			break;
+		}
+		pos += n;
+	}
+}
+
+/* Appends a frame of size bytes of data to packed. */
+static void encode(const uint8_t *src, size_t size, int level, int checksum,
+		   int content_size)
+{
+	ZSTD_CCtx *cctx = ZSTD_createCCtx();
+	size_t ret;
+
+	assert(cctx);
+	ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+	ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, checksum);
+	ZSTD_CCtx_setParameter(cctx, ZSTD_c_contentSizeFlag, content_size);
+	if (!content_size) {
+		/* Streaming leaves the size out of the frame header. */
+		ZSTD_inBuffer in = { src, size, 0 };
+		ZSTD_outBuffer o = { packed + packed_size,
+				     sizeof(packed) - packed_size, 0 };
+
+		ret = ZSTD_compressStream2(cctx, &o, &in, ZSTD_e_end);
+		assert(ret == 0);
+		ret = o.pos;
+	} else {
+		ret = ZSTD_compress2(cctx, packed + packed_size,
+				     sizeof(packed) - packed_size, src, size);
+		assert(!ZSTD_isError(ret));
+	}
+	packed_size += ret;
+	ZSTD_freeCCtx(cctx);
+}
+
+static enum zstd_status decode_to(size_t out_size)
+{
+	struct zstd_decoder d;
+
+	zstd_decoder_init(&d, workspace, out, out_size);
+	d.in = packed;
+	d.in_size = packed_size;
+	return zstd_decode(&d);
+}
+
+static size_t decode_all(size_t out_size)
+{
+	struct zstd_decoder d;
+
+	memset(out, 0xaa, sizeof(out));
+	zstd_decoder_init(&d, workspace, out, out_size);
+	d.in = packed;
+	d.in_size = packed_size;
+	assert(zstd_decode(&d) == ZSTD_STATUS_END);
+	assert(d.in_size == 0);
+	return d.pos;
+}
+
+static void test_levels(void)
+{
+	static const int levels[] = { 1, 3, 9, 19, 22 };
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(levels); i++) {
+		packed_size = 0;
+		encode(data, DATA_SIZE, levels[i], i % 2, 1);
+		printf("level %d: %d -> %zu bytes\n", levels[i], DATA_SIZE,
+		       packed_size);
+		assert(decode_all(sizeof(out)) == DATA_SIZE);
+		assert(!memcmp(out, data, DATA_SIZE));
+
+		/* One byte short of room fails, within the buffer. */
+		assert(decode_to(DATA_SIZE - 1) == ZSTD_STATUS_ERROR);
+	}
+}
+
+/* Frames back to back, with a skippable frame and one without a size. */
+static void test_frames(void)
+{
+	static const uint8_t skippable[] = {
+		0x50, 0x2a, 0x4d, 0x18, 4, 0, 0, 0, 'c', 'b', 'f', 's',
+	};
+
+	packed_size = 0;
+	encode(data, 1000, 3, 0, 1);
+	memcpy(packed + packed_size, skippable, sizeof(skippable));
+	packed_size += sizeof(skippable);
+	encode(data + 1000, 0, 3, 1, 1);
+	encode(data + 1000, DATA_SIZE - 1000, 19, 1, 0);
+	assert(decode_all(sizeof(out)) == DATA_SIZE);
+	assert(!memcmp(out, data, DATA_SIZE));
+}
+
+/* Input at the end of the output buffer, as selfboot loads segments. */
+static void test_in_place(size_t margin)
+{
+	static uint8_t buf[DATA_SIZE + 4096];
+	size_t size = DATA_SIZE + margin;
+	uint8_t *src = buf + size - packed_size;
+	enum zstd_status status;
+	struct zstd_decoder d;
+
+	memcpy(src, packed, packed_size);
+	zstd_decoder_init(&d, workspace, buf, size);
+	d.in = src;
+	d.in_size = packed_size;
+	status = zstd_decode_in_place(&d);
+	if (status == ZSTD_STATUS_OK) {
+		/* Finish from the original, as uzstdn_in_place() does. */
+		d.in = packed + (d.in - src);
+		status = zstd_decode(&d);
+	}
+	assert(status == ZSTD_STATUS_END);
+	assert(d.pos == DATA_SIZE);
+	assert(!memcmp(buf, data, DATA_SIZE));
+}
+
+/* Damaged frames may decode to garbage, but never out of bounds. */
+static void test_damage(void)
+{
+	static uint8_t good[sizeof(packed)];
+	size_t good_size = packed_size;
+	int i, errors = 0;
+
+	memcpy(good, packed, good_size);
+	for (i = 0; i < 300; i++) {
+		struct zstd_decoder d;
+		enum zstd_status status;
+		size_t cut = 0;
+
+		memcpy(packed, good, good_size);
+		packed_size = good_size;
+		if (i % 2) {
+			cut = 1 + rand() % (good_size - 1);
+			packed_size -= cut;
+		} else {
+			packed[rand() % good_size] ^= 1 << rand() % 8;
+		}
+
+		zstd_decoder_init(&d, workspace, out, DATA_SIZE);
+		d.in = packed;
+		d.in_size = packed_size;
+		status = zstd_decode(&d);
+		assert(d.pos <= DATA_SIZE);
+		if (cut)
+			assert(status == ZSTD_STATUS_ERROR);
+		if (status == ZSTD_STATUS_ERROR)
+			errors++;
+	}
+	memcpy(packed, good, good_size);
+	packed_size = good_size;
+	printf("damaged frames: %d of 300 failed to decode\n", errors);
+}
+
+int main(void)
+{
+	make_data();
+	test_levels();
+	test_frames();
+
+	packed_size = 0;
+	encode(data, DATA_SIZE, 19, 0, 1);
+	test_in_place(4096);
+	test_in_place(64);
+	test_in_place(0);
+	test_damage();
+
+	printf("zstd-test: passed\n");
+	return 0;
+}
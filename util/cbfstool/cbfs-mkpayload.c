@@ -222,6 +222,20 @@ int parse_elf_to_payload(const struct buffer *input, struct buffer *output,
 			segs[segments].len = len;
 		}
 
+		/* LZMA and Zstandard are decompressed in-place as far as
+		 * mem_len allows. */
+		if (segs[segments].compression == CBFS_COMPRESS_LZMA &&
+		    lzma_in_place_size(output->data + doffset, len) >
+		    segs[segments].mem_len)
+			INFO("Segment %d is too small to decompress LZMA in-place, the rest will be read from flash.\n",
+			     segments);
+		if (segs[segments].compression == CBFS_COMPRESS_ZSTD &&
+		    zstd_in_place_size(output->data + doffset, len,
+				       phdr[i].p_filesz) >
+		    segs[segments].mem_len)
+			INFO("Segment %d is too small to decompress Zstandard in-place, the rest will be read from flash.\n",
+			     segments);
+
 		doffset += segs[segments].len;
 		osize += segs[segments].len;
 
@@ -307,6 +307,47 @@ int parse_elf_to_stage(const struct buffer *input, struct buffer *output,
 		free(compare_buffer);
 	}
 
+	/* LZMA is decompressed in-place as far as the BSS allows it. */
+	if (algo == CBFS_COMPRESS_LZMA) {
+		size_t memlen = mem_end - data_start;
+		size_t in_place_size = lzma_in_place_size(
+				output->data + sizeof(struct cbfs_stage), outlen);
+
+		if (in_place_size == 0) {
+			ERROR("LZMA compression BUG! Report to mailing list.\n");
+			free(buffer);
+			goto err;
+		}
+		if (in_place_size > memlen) {
+			WARN("Not enough scratch space to decompress LZMA in-place, %zu bytes missing -- the rest will be read from flash.\n",
+			     in_place_size - memlen);
+		} else {
+			INFO("LZMA in-place margin: %zu bytes\n",
+			     memlen - in_place_size);
+		}
+	}
+
+	/* So is Zstandard, a block at a time. */
+	if (algo == CBFS_COMPRESS_ZSTD) {
+		size_t memlen = mem_end - data_start;
+		size_t in_place_size = zstd_in_place_size(
+				output->data + sizeof(struct cbfs_stage), outlen,
+				data_end - data_start);
+
+		if (in_place_size == 0) {
+			ERROR("Zstandard compression BUG! Report to mailing list.\n");
+			free(buffer);
+			goto err;
+		}
+		if (in_place_size > memlen) {
+			WARN("Not enough scratch space to decompress Zstandard in-place, %zu bytes missing -- the rest will be read from flash.\n",
+			     in_place_size - memlen);
+		} else {
+			INFO("Zstandard in-place margin: %zu bytes\n",
+			     memlen - in_place_size);
+		}
+	}
+
 	free(buffer);
 
 	/* Set up for output marshaling. */
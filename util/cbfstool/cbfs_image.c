@@ -56,6 +56,7 @@ static const struct typedesc_t types_cbfs_compression[] = {
 	{CBFS_COMPRESS_NONE, "none"},
 	{CBFS_COMPRESS_LZMA, "LZMA"},
 	{CBFS_COMPRESS_LZ4, "LZ4"},
+	{CBFS_COMPRESS_ZSTD, "ZSTD"},
 	{0, NULL},
 };
 
@@ -76,7 +77,7 @@ static int lookup_type_by_name(const struct typedesc_t *desc, const char *name)
 	return desc[i].name ? (int)desc[i].type : -1;
 }
 
-static const char *get_cbfs_entry_type_name(uint32_t type)
+const char *get_cbfs_entry_type_name(uint32_t type)
 {
 	return lookup_name_by_type(filetypes, type, "(unknown)");
 }
@@ -86,7 +87,12 @@ int cbfs_parse_comp_algo(const char *name)
 	return lookup_type_by_name(types_cbfs_compression, name);
 }
 
-static const char *get_hash_attr_name(uint16_t hash_type)
+const char *get_cbfs_comp_algo_name(uint32_t algo)
+{
+	return lookup_name_by_type(types_cbfs_compression, algo, "(unknown)");
+}
+
+const char *get_hash_attr_name(uint16_t hash_type)
 {
 	return lookup_name_by_type(types_cbfs_hash, hash_type, "(invalid)");
 }
@@ -1568,6 +1574,169 @@ int cbfs_merge_empty_entry(struct cbfs_image *image, struct cbfs_file *entry,
 	return 0;
 }
 
+static enum cbfs_check cbfs_check_worst(enum cbfs_check a, enum cbfs_check b)
+{
+	return a > b ? a : b;
+}
+
+static enum cbfs_check cbfs_verify_hashes(struct cbfs_file *entry)
+{
+	enum cbfs_check result = CBFS_CHECK_NONE;
+	struct cbfs_file_attr_hash *hash = NULL;
+	uint8_t local_hash[VB2_MAX_DIGEST_SIZE];
+
+	while ((hash = cbfs_file_get_next_hash(entry, hash)) != NULL) {
+		unsigned int hash_type = ntohl(hash->hash_type);
+		if (hash_type == VB2_HASH_INVALID ||
+		    hash_type >= CBFS_NUM_SUPPORTED_HASHES)
+			return CBFS_CHECK_FAILED;
+
+		size_t hash_len = widths_cbfs_hash[hash_type];
+		if (ntohl(hash->len) < sizeof(*hash) + hash_len)
+			return CBFS_CHECK_FAILED;
+
+		if (vb2_digest_buffer(CBFS_SUBHEADER(entry), ntohl(entry->len),
+			hash_type, local_hash, hash_len) != VB2_SUCCESS ||
+		    memcmp(local_hash, hash->hash_data, hash_len) != 0)
+			return CBFS_CHECK_FAILED;
+		result = CBFS_CHECK_OK;
+	}
+	return result;
+}
+
+/* No file, stage or payload segment decompresses to more than this. Any
+ * image can claim a larger size, so the scratch buffer stops here. */
+#define CBFS_VERIFY_MAX_OUTPUT	(256 * MiB)
+
+/* Decompresses in into a scratch buffer of out_size bytes, the size the
+ * image records. If exact is set, the data also has to fill the buffer
+ * completely. A recorded size beyond CBFS_VERIFY_MAX_OUTPUT fails if exact
+ * is set. Otherwise it includes bss, and the buffer stops at the cap, since
+ * bss is not needed to check the rest. */
+static enum cbfs_check cbfs_verify_decompress(uint32_t compression,
+	char *in, size_t in_size, size_t out_size, bool exact)
+{
+	decomp_func_ptr decompress;
+	size_t actual_size = 0;
+	char *out;
+	int ret;
+
+	if (compression == CBFS_COMPRESS_NONE)
+		return CBFS_CHECK_NONE;
+
+	decompress = decompression_function(compression);
+	if (decompress == NULL)
+		return CBFS_CHECK_FAILED;
+
+	if (out_size > CBFS_VERIFY_MAX_OUTPUT) {
+		if (exact)
+			return CBFS_CHECK_FAILED;
+		out_size = CBFS_VERIFY_MAX_OUTPUT;
+	}
+	out = malloc(out_size ? out_size : 1);
+	if (out == NULL)
+		return CBFS_CHECK_FAILED;
+	ret = decompress(in, in_size, out, out_size, &actual_size);
+	free(out);
+
+	if (ret || actual_size > out_size || (exact && actual_size != out_size))
+		return CBFS_CHECK_FAILED;
+	return CBFS_CHECK_OK;
+}
+
+static enum cbfs_check cbfs_verify_stage(char *data, size_t len)
+{
+	struct buffer reader;
+	uint32_t compression, memlen;
+
+	if (len < sizeof(struct cbfs_stage))
+		return CBFS_CHECK_FAILED;
+
+	/* The stage metadata is in little endian. */
+	buffer_init(&reader, NULL, data, len);
+	compression = xdr_le.get32(&reader);
+	xdr_le.get64(&reader);
+	xdr_le.get64(&reader);
+	xdr_le.get32(&reader);
+	memlen = xdr_le.get32(&reader);
+
+	return cbfs_verify_decompress(compression,
+		data + sizeof(struct cbfs_stage),
+		len - sizeof(struct cbfs_stage), memlen, false);
+}
+
+static enum cbfs_check cbfs_verify_payload(char *data, size_t len)
+{
+	struct cbfs_payload_segment *segments =
+		(struct cbfs_payload_segment *)data;
+	enum cbfs_check result = CBFS_CHECK_NONE;
+	size_t i;
+
+	for (i = 0; i < len / sizeof(*segments); i++) {
+		struct cbfs_payload_segment seg;
+		cbfs_decode_payload_segment(&seg, &segments[i]);
+
+		if (seg.type == PAYLOAD_SEGMENT_ENTRY)
+			return result;
+		if (seg.type != PAYLOAD_SEGMENT_CODE &&
+		    seg.type != PAYLOAD_SEGMENT_DATA)
+			continue;
+		if (seg.offset > len || seg.len > len - seg.offset)
+			return CBFS_CHECK_FAILED;
+
+		result = cbfs_check_worst(result,
+			cbfs_verify_decompress(seg.compression,
+				data + seg.offset, seg.len, seg.mem_len,
+				false));
+	}
+
+	/* Ran off the end of the file without finding the entry point. */
+	return CBFS_CHECK_FAILED;
+}
+
+void cbfs_verify_entry(struct cbfs_image *image, struct cbfs_file *entry,
+		       struct cbfs_entry_checks *checks)
+{
+	uint32_t addr = cbfs_get_entry_addr(image, entry);
+	uint32_t len = ntohl(entry->len);
+	uint32_t decompressed_size;
+	unsigned int compression;
+
+	checks->hash = CBFS_CHECK_NONE;
+	checks->compression = CBFS_CHECK_NONE;
+
+	/* Don't look at the data unless it lies within the image. */
+	if (ntohl(entry->offset) > image->buffer.size - addr ||
+	    len > image->buffer.size - addr - ntohl(entry->offset)) {
+		checks->hash = CBFS_CHECK_FAILED;
+		checks->compression = CBFS_CHECK_FAILED;
+		return;
+	}
+
+	checks->hash = cbfs_verify_hashes(entry);
+
+	compression = cbfs_file_get_compression_info(entry,
+		&decompressed_size);
+	if (compression != CBFS_COMPRESS_NONE) {
+		checks->compression = cbfs_verify_decompress(compression,
+			CBFS_SUBHEADER(entry), len, decompressed_size, true);
+		return;
+	}
+
+	switch (ntohl(entry->type)) {
+	case CBFS_COMPONENT_STAGE:
+		checks->compression = cbfs_verify_stage(CBFS_SUBHEADER(entry),
+							len);
+		break;
+	case CBFS_COMPONENT_PAYLOAD:
+		checks->compression = cbfs_verify_payload(
+			CBFS_SUBHEADER(entry), len);
+		break;
+	default:
+		break;
+	}
+}
+
 int cbfs_walk(struct cbfs_image *image, cbfs_entry_callback callback,
 	      void *arg)
 {
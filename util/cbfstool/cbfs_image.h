@@ -32,10 +32,19 @@ struct cbfs_image {
  * enum comp_algo if it's supported, or a number < 0 otherwise. */
 int cbfs_parse_comp_algo(const char *name);
 
+/* Return the name of a compression algorithm, or "(unknown)". */
+const char *get_cbfs_comp_algo_name(uint32_t algo);
+
 /* Given the string name of a hash algorithm, return the corresponding
  * id if it's supported, or a number < 0 otherwise. */
 int cbfs_parse_hash_algo(const char *name);
 
+/* Return the name of a CBFS file type, or "(unknown)". */
+const char *get_cbfs_entry_type_name(uint32_t type);
+
+/* Return the name of a hash algorithm id, or "(invalid)". */
+const char *get_hash_attr_name(uint16_t hash_type);
+
 /* Given a pointer, serialize the header from host-native byte format
  * to cbfs format, i.e. big-endian. */
 void cbfs_put_header(void *dest, const struct cbfs_header *header);
@@ -167,6 +176,29 @@ int cbfs_print_header_info(struct cbfs_image *image);
 int cbfs_print_entry_info(struct cbfs_image *image, struct cbfs_file *entry,
 			  void *arg);
 
+/* Outcome of one of the checks made by cbfs_verify_entry(). Ordered so that
+ * the worse of two outcomes is the larger value. */
+enum cbfs_check {
+	CBFS_CHECK_NONE,	/* Nothing to check */
+	CBFS_CHECK_OK,
+	CBFS_CHECK_FAILED,
+};
+
+struct cbfs_entry_checks {
+	/* All hash attributes match the file data. */
+	enum cbfs_check hash;
+	/* The data, stage or payload segments decompress to the sizes they
+	 * claim. */
+	enum cbfs_check compression;
+};
+
+/* Checks the hash attributes and compressed contents of entry. Only reads the
+ * image, so it may be called for several entries at once from different
+ * threads. Data is decompressed to the sizes the image records, which may
+ * be larger than the image, up to a fixed cap. */
+void cbfs_verify_entry(struct cbfs_image *image, struct cbfs_file *entry,
+		       struct cbfs_entry_checks *checks);
+
 /* Merge empty entries starting from given entry.
  * Returns 0 on success, otherwise non-zero. */
 int cbfs_merge_empty_entry(struct cbfs_image *image, struct cbfs_file *entry,
@@ -0,0 +1,373 @@
+/*
+ * cbfs_verify.c, check every CBFS in an image and digest its regions
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "cbfs_verify.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cbfs_image.h"
+#include "cbfs_sections.h"
+
+/* Upper bound for the thread pool, whatever the CPU count says. */
+#define VERIFY_MAX_THREADS	64
+
+enum region_kind {
+	REGION_RAW,
+	REGION_CBFS,
+	REGION_INVALID,
+};
+
+struct verify_region {
+	const char *name;
+	struct buffer buffer;
+	enum region_kind kind;
+	struct cbfs_image image;
+	/* Index of an earlier region covering the same bytes, or -1. Its
+	 * digest is reused, and if it is a CBFS, so are its files. */
+	long alias_of;
+	bool digest_ok;
+	uint8_t digest[VB2_MAX_DIGEST_SIZE];
+};
+
+struct verify_file {
+	struct verify_region *region;
+	struct cbfs_file *entry;
+	struct cbfs_entry_checks checks;
+};
+
+struct verify_context {
+	enum vb2_hash_algorithm hash;
+	struct verify_region *regions;
+	size_t num_regions;
+	struct verify_file *files;
+	size_t num_files;
+	size_t max_files;
+	bool out_of_memory;
+	/* Jobs are all region digests followed by all files. */
+	pthread_mutex_t lock;
+	size_t next_job;
+};
+
+static const char *const region_kind_names[] = {
+	[REGION_RAW] = "raw",
+	[REGION_CBFS] = "cbfs",
+	[REGION_INVALID] = "invalid",
+};
+
+static const char *const check_names[] = {
+	[CBFS_CHECK_NONE] = "none",
+	[CBFS_CHECK_OK] = "ok",
+	[CBFS_CHECK_FAILED] = "fail",
+};
+
+static int add_file(struct cbfs_image *image, struct cbfs_file *entry,
+		    void *arg)
+{
+	struct verify_context *ctx = arg;
+	struct verify_file *file;
+
+	(void)image;
+
+	if (ctx->num_files == ctx->max_files) {
+		size_t max = ctx->max_files ? ctx->max_files * 2 : 64;
+		struct verify_file *files;
+
+		files = realloc(ctx->files, max * sizeof(*files));
+		if (!files) {
+			ERROR("Out of memory while collecting files\n");
+			ctx->out_of_memory = true;
+			return -1;
+		}
+		ctx->files = files;
+		ctx->max_files = max;
+	}
+
+	file = &ctx->files[ctx->num_files++];
+	file->region = &ctx->regions[ctx->num_regions - 1];
+	file->entry = entry;
+	return 0;
+}
+
+/* Look for an earlier region with the same extent, which is an alias. */
+static long find_alias(const struct verify_context *ctx,
+		       const struct buffer *buffer)
+{
+	size_t i;
+
+	for (i = 0; i < ctx->num_regions; i++) {
+		const struct buffer *other = &ctx->regions[i].buffer;
+
+		if (other->offset == buffer->offset &&
+		    other->size == buffer->size)
+			return i;
+	}
+	return -1;
+}
+
+/* Whether name is one of the comma separated regions in list. */
+static bool in_region_list(const char *list, const char *name)
+{
+	size_t len = strlen(name);
+
+	while (list) {
+		if (!strncmp(list, name, len) &&
+		    (list[len] == ',' || list[len] == '\0'))
+			return true;
+		list = strchr(list, ',');
+		if (list)
+			list++;
+	}
+	return false;
+}
+
+/* Region setup and the file list are cheap, so they are done up front. */
+static int add_region(struct verify_context *ctx,
+		      const partitioned_file_t *file, const char *name,
+		      bool must_be_cbfs)
+{
+	struct verify_region *region = &ctx->regions[ctx->num_regions];
+
+	region->name = name;
+	region->kind = REGION_RAW;
+	if (!partitioned_file_read_region(&region->buffer, file, name))
+		return -1;
+
+	region->alias_of = find_alias(ctx, &region->buffer);
+	ctx->num_regions++;
+
+	/*
+	 * A legacy image is a CBFS with a master header somewhere in it. In
+	 * an FMAP, a CBFS is a leaf region that starts with a file header;
+	 * its parents may start with the same bytes, but are not CBFSes.
+	 * Where there has to be a CBFS, anything else is a broken one.
+	 */
+	if (partitioned_file_is_partitioned(file) &&
+	    (partitioned_file_region_contains_nested(file, name) ||
+	     !buffer_check_magic(&region->buffer, CBFS_FILE_MAGIC,
+				 strlen(CBFS_FILE_MAGIC)))) {
+		if (must_be_cbfs)
+			region->kind = REGION_INVALID;
+		return 0;
+	}
+
+	if (region->alias_of >= 0 &&
+	    ctx->regions[region->alias_of].kind != REGION_RAW) {
+		region->kind = ctx->regions[region->alias_of].kind;
+		return 0;
+	}
+
+	if (cbfs_image_from_buffer(&region->image, &region->buffer, ~0)) {
+		region->kind = REGION_INVALID;
+		return 0;
+	}
+	region->kind = REGION_CBFS;
+
+	cbfs_walk(&region->image, add_file, ctx);
+	return ctx->out_of_memory ? -1 : 0;
+}
+
+static void run_job(struct verify_context *ctx, size_t job)
+{
+	if (job < ctx->num_regions) {
+		struct verify_region *region = &ctx->regions[job];
+
+		if (region->alias_of >= 0)
+			return;
+		region->digest_ok = vb2_digest_buffer(
+			buffer_get(&region->buffer),
+			buffer_size(&region->buffer), ctx->hash,
+			region->digest, widths_cbfs_hash[ctx->hash]) ==
+				VB2_SUCCESS;
+	} else {
+		struct verify_file *file = &ctx->files[job - ctx->num_regions];
+
+		cbfs_verify_entry(&file->region->image, file->entry,
+				  &file->checks);
+	}
+}
+
+static void *verify_worker(void *arg)
+{
+	struct verify_context *ctx = arg;
+	const size_t num_jobs = ctx->num_regions + ctx->num_files;
+
+	for (;;) {
+		size_t job;
+
+		pthread_mutex_lock(&ctx->lock);
+		job = ctx->next_job++;
+		pthread_mutex_unlock(&ctx->lock);
+
+		if (job >= num_jobs)
+			break;
+		run_job(ctx, job);
+	}
+	return NULL;
+}
+
+static unsigned default_threads(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (cpus > 0)
+		return cpus;
+#endif
+	return 1;
+}
+
+/* The calling thread works too, so only threads - 1 are started. */
+static void run_jobs(struct verify_context *ctx, unsigned threads)
+{
+	pthread_t workers[VERIFY_MAX_THREADS];
+	unsigned i, started = 0;
+
+	if (!threads)
+		threads = default_threads();
+	if (threads > VERIFY_MAX_THREADS)
+		threads = VERIFY_MAX_THREADS;
+	if (threads > ctx->num_regions + ctx->num_files)
+		threads = ctx->num_regions + ctx->num_files;
+
+	pthread_mutex_init(&ctx->lock, NULL);
+	ctx->next_job = 0;
+
+	for (i = 1; i < threads; i++) {
+		if (pthread_create(&workers[started], NULL, verify_worker, ctx))
+			break;
+		started++;
+	}
+	DEBUG("Verifying with %u threads\n", started + 1);
+
+	verify_worker(ctx);
+	for (i = 0; i < started; i++)
+		pthread_join(workers[i], NULL);
+
+	pthread_mutex_destroy(&ctx->lock);
+}
+
+static size_t report(struct verify_context *ctx, FILE *out)
+{
+	const char *hash_name = get_hash_attr_name(ctx->hash);
+	const size_t hash_len = widths_cbfs_hash[ctx->hash];
+	size_t i, failures = 0;
+
+	for (i = 0; i < ctx->num_regions; i++) {
+		const struct verify_region *region = &ctx->regions[i];
+		struct verify_region *data = &ctx->regions[i];
+		char *digest;
+
+		if (region->alias_of >= 0)
+			data = &ctx->regions[region->alias_of];
+
+		digest = bintohex(data->digest, hash_len);
+		fprintf(out, "region\t%s\t0x%zx\t0x%zx\t%s\t%s\t%s\n",
+			region->name, region->buffer.offset,
+			region->buffer.size, region_kind_names[region->kind],
+			hash_name, data->digest_ok && digest ? digest : "-");
+		free(digest);
+
+		if ((region->alias_of < 0 && !data->digest_ok) ||
+		    region->kind == REGION_INVALID)
+			failures++;
+	}
+
+	for (i = 0; i < ctx->num_files; i++) {
+		struct verify_file *file = &ctx->files[i];
+		const char *name = file->entry->filename;
+
+		fprintf(out, "file\t%s\t%s\t0x%x\t%s\t%s\t%s\n",
+			file->region->name, *name ? name : "(empty)",
+			cbfs_get_entry_addr(&file->region->image, file->entry),
+			get_cbfs_entry_type_name(ntohl(file->entry->type)),
+			check_names[file->checks.hash],
+			check_names[file->checks.compression]);
+
+		if (file->checks.hash == CBFS_CHECK_FAILED ||
+		    file->checks.compression == CBFS_CHECK_FAILED)
+			failures++;
+	}
+
+	fprintf(out, "result\t%s\t%zu\t%zu\n", failures ? "fail" : "pass",
+		ctx->num_files, failures);
+	return failures;
+}
+
+/* Every region in the list has to exist, or it could never be checked. */
+static bool region_list_exists(const struct fmap *fmap, const char *list)
+{
+	char name[FMAP_STRLEN];
+
+	while (*list) {
+		size_t len = strcspn(list, ",");
+
+		if (!len || len >= sizeof(name)) {
+			ERROR("Invalid region name in -r list\n");
+			return false;
+		}
+		memcpy(name, list, len);
+		name[len] = '\0';
+		if (fmap ? !fmap_find_area(fmap, name) :
+			   strcmp(name, SECTION_NAME_PRIMARY_CBFS)) {
+			ERROR("The image has no '%s' region\n", name);
+			return false;
+		}
+		list += len;
+		if (*list)
+			list++;
+	}
+	return true;
+}
+
+int cbfs_verify_image(const partitioned_file_t *file, const char *cbfs_regions,
+		      enum vb2_hash_algorithm hash, unsigned threads,
+		      FILE *out)
+{
+	const struct fmap *fmap = partitioned_file_get_fmap(file);
+	struct verify_context ctx;
+	size_t num_regions = fmap ? fmap->nareas : 1;
+	size_t i, failures;
+
+	if (!region_list_exists(fmap, cbfs_regions))
+		return 1;
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.hash = hash;
+	ctx.regions = calloc(num_regions, sizeof(*ctx.regions));
+	if (!ctx.regions) {
+		ERROR("Out of memory while collecting regions\n");
+		return 1;
+	}
+
+	for (i = 0; i < num_regions; i++) {
+		const char *name = fmap ? (const char *)fmap->areas[i].name :
+					SECTION_NAME_PRIMARY_CBFS;
+
+		if (add_region(&ctx, file, name,
+			       in_region_list(cbfs_regions, name))) {
+			free(ctx.files);
+			free(ctx.regions);
+			return 1;
+		}
+	}
+
+	run_jobs(&ctx, threads);
+	failures = report(&ctx, out);
+
+	free(ctx.files);
+	free(ctx.regions);
+	return failures ? 1 : 0;
+}
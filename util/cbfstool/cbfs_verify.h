@@ -0,0 +1,52 @@
+/*
+ * cbfs_verify.h, check every CBFS in an image and digest its regions
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef CBFS_VERIFY_H_
+#define CBFS_VERIFY_H_
+
+#include <stdio.h>
+
+#include "cbfs.h"
+#include "partitioned_file.h"
+
+/**
+ * Verify a whole image: every FMAP region is digested, and every file in
+ * every CBFS region has its hash attributes checked and its compressed
+ * contents decompressed. A legacy image is treated as a single CBFS region.
+ * The work is spread across the given number of threads.
+ *
+ * The report is written as tab separated lines, in FMAP and then file
+ * order, no matter how the work was scheduled:
+ *
+ *   region <name> <offset> <size> <kind> <hash algorithm> <digest>
+ *   file <region> <name> <offset> <type> <hash> <compression>
+ *   result <pass|fail> <files> <failures>
+ *
+ * where kind is "cbfs", "raw" or "invalid" (the region looks like a CBFS but
+ * cannot be parsed, or is one of cbfs_regions and doesn't hold a CBFS), and
+ * the hash and compression columns of a file are "ok", "fail" or "none" if
+ * there was nothing to check. Data that would decompress to more than the
+ * size of its CBFS fails the compression check.
+ *
+ * @param file          Image to verify
+ * @param cbfs_regions  Comma separated regions that must hold a CBFS
+ * @param hash          Algorithm used for the region digests
+ * @param threads       Number of threads to use, 0 for one per online CPU
+ * @param out           Stream the report is written to
+ * @return              0 if every check passed, 1 otherwise
+ */
+int cbfs_verify_image(const partitioned_file_t *file, const char *cbfs_regions,
+		      enum vb2_hash_algorithm hash, unsigned threads,
+		      FILE *out);
+
+#endif
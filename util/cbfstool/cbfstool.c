@@ -21,12 +21,14 @@
 #include <string.h>
 #include <strings.h>
 #include <ctype.h>
+#include <inttypes.h>
 #include <unistd.h>
 #include <getopt.h>
 #include "common.h"
 #include "cbfs.h"
 #include "cbfs_image.h"
 #include "cbfs_sections.h"
+#include "cbfs_verify.h"
 #include "fit.h"
 #include "partitioned_file.h"
 #include <commonlib/fsp.h>
@@ -77,7 +79,10 @@ static struct param {
 	bool autogen_attr;
 	bool machine_parseable;
 	int fit_empty_entries;
+	unsigned threads;
 	enum comp_algo compression;
+	bool compression_auto;
+	struct load_model load_model;
 	enum vb2_hash_algorithm hash;
 	/* for linux payloads */
 	char *initrd;
@@ -87,6 +92,14 @@ static struct param {
 	/* All variables not listed are initialized as zero. */
 	.arch = CBFS_ARCHITECTURE_UNKNOWN,
 	.compression = CBFS_COMPRESS_NONE,
+	/* A SPI flash and decompressors running from cache. Zstandard is
+	 * only tried when its rate is given, since coreboot only builds its
+	 * decoder when asked to. */
+	.load_model = {
+		.flash = 20 * 1024 * 1024,
+		.lz4 = 400 * 1024 * 1024,
+		.lzma = 40 * 1024 * 1024,
+	},
 	.hash = VB2_HASH_INVALID,
 	.headeroffset = ~0,
 	.region_name = SECTION_NAME_PRIMARY_CBFS,
@@ -327,6 +340,143 @@ done:
 	return ret;
 }
 
+struct compression_choice {
+	enum comp_algo algo;
+	struct buffer buffer;
+	struct cbfs_file *header;
+	uint32_t offset;
+	uint64_t load_time;
+	bool converted;
+	bool fits;
+};
+
+/* NONE comes first, the others are measured against it. */
+static const enum comp_algo compression_choices[] = {
+	CBFS_COMPRESS_NONE,
+	CBFS_COMPRESS_LZ4,
+	CBFS_COMPRESS_LZMA,
+	CBFS_COMPRESS_ZSTD,
+};
+
+static bool choice_is_better(const struct compression_choice *c,
+			     const struct compression_choice *best)
+{
+	if (!c->converted)
+		return false;
+	if (!best)
+		return true;
+	if (c->fits != best->fits)
+		return c->fits;
+	/* If nothing fits, at least fail with the smallest. */
+	if (!c->fits)
+		return c->buffer.size < best->buffer.size;
+	if (c->load_time != best->load_time)
+		return c->load_time < best->load_time;
+	return c->buffer.size < best->buffer.size;
+}
+
+/*
+ * Converts the file with each algorithm and keeps the one that loads the
+ * fastest according to param.load_model, among those that fit into the
+ * region. The choice and the numbers behind it are reported.
+ */
+static int convert_with_best_compression(struct cbfs_image *image,
+			const char *filename, const char *name, uint32_t type,
+			uint32_t *offset, convert_buffer_t convert,
+			struct buffer *buffer, struct cbfs_file **header)
+{
+	struct compression_choice choices[ARRAY_SIZE(compression_choices)];
+	struct compression_choice *best = NULL;
+	size_t page_size = param.pagesize ? param.pagesize :
+						buffer_size(&image->buffer);
+	size_t i, size;
+
+	memset(choices, 0, sizeof(choices));
+	for (i = 0; i < ARRAY_SIZE(choices); i++) {
+		struct compression_choice *c = &choices[i];
+
+		c->algo = compression_choices[i];
+		if (!load_model_has(&param.load_model, c->algo))
+			continue;
+		c->offset = *offset;
+		if (buffer_from_file(&c->buffer, filename) != 0) {
+			ERROR("Could not load file '%s'.\n", filename);
+			break;
+		}
+		c->header = cbfs_create_file_header(type, c->buffer.size,
+						    name);
+
+		param.compression = c->algo;
+		if (convert(&c->buffer, &c->offset, c->header) != 0) {
+			WARN("Could not use %s compression for '%s'.\n",
+			     get_cbfs_comp_algo_name(c->algo), name);
+			continue;
+		}
+		c->converted = true;
+	}
+
+	/* The uncompressed data is what the loader ends up with, and every
+	 * load time depends on its size. */
+	if (!choices[0].converted) {
+		ERROR("Could not convert '%s' without compression.\n", name);
+		goto done;
+	}
+	size = choices[0].buffer.size;
+
+	for (i = 0; i < ARRAY_SIZE(choices); i++) {
+		struct compression_choice *c = &choices[i];
+		size_t metadata_size;
+
+		if (!c->converted)
+			continue;
+
+		metadata_size = ntohl(c->header->offset);
+		if (param.hash != VB2_HASH_INVALID)
+			metadata_size += sizeof(struct cbfs_file_attr_hash);
+		/* A fixed position is the same for all, so let adding fail. */
+		c->fits = *offset || (c->buffer.size <= page_size &&
+			cbfs_locate_entry(image, c->buffer.size,
+					  param.pagesize, param.alignment,
+					  metadata_size) != -1);
+		c->load_time = load_model_time(&param.load_model, c->algo,
+				c->buffer.size, size);
+
+		if (choice_is_better(c, best))
+			best = c;
+	}
+
+	if (best) {
+		LOG("Compression for '%s':", name);
+		for (i = 0; i < ARRAY_SIZE(choices); i++) {
+			const struct compression_choice *c = &choices[i];
+
+			if (!c->converted)
+				continue;
+			LOG("%s %s %zu bytes %" PRIu64 ".%01" PRIu64 " ms%s",
+			    i ? "," : "", get_cbfs_comp_algo_name(c->algo),
+			    c->buffer.size, c->load_time / 1000,
+			    c->load_time % 1000 / 100,
+			    c->fits ? "" : " (doesn't fit)");
+		}
+		LOG(" -> %s\n", get_cbfs_comp_algo_name(best->algo));
+
+		param.compression = best->algo;
+		*offset = best->offset;
+		*buffer = best->buffer;
+		*header = best->header;
+	}
+
+done:
+	for (i = 0; i < ARRAY_SIZE(choices); i++) {
+		if (&choices[i] == best)
+			continue;
+		free(choices[i].header);
+		buffer_delete(&choices[i].buffer);
+	}
+
+	return best ? 0 : -1;
+}
+
 static int cbfs_add_component(const char *filename,
 			      const char *name,
 			      uint32_t type,
@@ -359,18 +509,27 @@ static int cbfs_add_component(const char *filename,
 	}
 
 	struct buffer buffer;
-	if (buffer_from_file(&buffer, filename) != 0) {
-		ERROR("Could not load file '%s'.\n", filename);
-		return 1;
-	}
+	struct cbfs_file *header;
 
-	struct cbfs_file *header =
-		cbfs_create_file_header(type, buffer.size, name);
+	if (param.compression_auto && convert) {
+		if (convert_with_best_compression(&image, filename, name, type,
+					&offset, convert, &buffer, &header)) {
+			ERROR("Failed to parse file '%s'.\n", filename);
+			return 1;
+		}
+	} else {
+		if (buffer_from_file(&buffer, filename) != 0) {
+			ERROR("Could not load file '%s'.\n", filename);
+			return 1;
+		}
 
-	if (convert && convert(&buffer, &offset, header) != 0) {
-		ERROR("Failed to parse file '%s'.\n", filename);
-		buffer_delete(&buffer);
-		return 1;
+		header = cbfs_create_file_header(type, buffer.size, name);
+
+		if (convert && convert(&buffer, &offset, header) != 0) {
+			ERROR("Failed to parse file '%s'.\n", filename);
+			buffer_delete(&buffer);
+			return 1;
+		}
 	}
 
 	if (param.hash != VB2_HASH_INVALID)
@@ -670,7 +829,8 @@ static int cbfs_add_stage(void)
 			return 1;
 		}
 
-		if (param.compression != CBFS_COMPRESS_NONE) {
+		if (param.compression != CBFS_COMPRESS_NONE ||
+		    param.compression_auto) {
 			ERROR("Cannot specify compression for XIP.\n");
 			return 1;
 		}
@@ -1070,13 +1230,23 @@ static int cbfs_compact(void)
 	return cbfs_compact_instance(&image);
 }
 
+static int cbfs_verify(void)
+{
+	enum vb2_hash_algorithm hash = param.hash;
+
+	if (hash == VB2_HASH_INVALID)
+		hash = VB2_HASH_SHA256;
+	return cbfs_verify_image(param.image_file, param.region_name, hash,
+				 param.threads, stdout);
+}
+
 static const struct command commands[] = {
-	{"add", "H:r:f:n:t:c:b:a:yvA:gh?", cbfs_add, true, true},
-	{"add-flat-binary", "H:r:f:n:l:e:c:b:vA:gh?", cbfs_add_flat_binary,
+	{"add", "H:r:f:n:t:c:L:b:a:yvA:gh?", cbfs_add, true, true},
+	{"add-flat-binary", "H:r:f:n:l:e:c:L:b:vA:gh?", cbfs_add_flat_binary,
 				true, true},
-	{"add-payload", "H:r:f:n:t:c:b:C:I:vA:gh?", cbfs_add_payload,
+	{"add-payload", "H:r:f:n:t:c:L:b:C:I:vA:gh?", cbfs_add_payload,
 				true, true},
-	{"add-stage", "a:H:r:f:n:t:c:b:P:S:yvA:gh?", cbfs_add_stage,
+	{"add-stage", "a:H:r:f:n:t:c:L:b:P:S:yvA:gh?", cbfs_add_stage,
 				true, true},
 	{"add-int", "H:r:i:n:b:vgh?", cbfs_add_integer, true, true},
 	{"add-master-header", "H:r:vh?", cbfs_add_master_header, true, true},
@@ -1089,6 +1259,7 @@ static const struct command commands[] = {
 	{"read", "r:f:vh?", cbfs_read, true, false},
 	{"remove", "H:r:n:vh?", cbfs_remove, true, true},
 	{"update-fit", "H:r:n:x:vh?", cbfs_update_fit, true, true},
+	{"verify", "r:A:j:vh?", cbfs_verify, false, false},
 	{"write", "r:f:Fudvh?", cbfs_write, true, true},
 };
 
@@ -1113,7 +1284,9 @@ static struct option long_options[] = {
 	{"ignore-sec",    required_argument, 0, 'S' },
 	{"initrd",        required_argument, 0, 'I' },
 	{"int",           required_argument, 0, 'i' },
+	{"jobs",          required_argument, 0, 'j' },
 	{"load-address",  required_argument, 0, 'l' },
+	{"load-model",    required_argument, 0, 'L' },
 	{"machine",       required_argument, 0, 'm' },
 	{"name",          required_argument, 0, 'n' },
 	{"offset",        required_argument, 0, 'o' },
@@ -1169,7 +1342,8 @@ static int dispatch_command(struct command command)
 	}
 
 	if (command.function()) {
-		if (partitioned_file_is_partitioned(param.image_file)) {
+		if (command.accesses_region &&
+				partitioned_file_is_partitioned(param.image_file)) {
 			ERROR("Failed while operating on '%s' region!\n",
 							param.region_name);
 			ERROR("The image will be left unmodified.\n");
@@ -1242,7 +1416,17 @@ static void usage(char *name)
 	     " update-fit [-r image,regions] -n MICROCODE_BLOB_NAME \\\n"
 	     "        -x EMTPY_FIT_ENTRIES                                 "
 			"Updates the FIT table with microcode entries\n"
+	     " verify [-r image,regions] [-A hash] [-j jobs]               "
+			"Check all CBFS files and digest all regions\n"
 	     "\n"
+	     "COMPRESSION:\n"
+	     "  none, LZMA, LZ4, ZSTD, or auto to try each and keep the one\n"
+	     "  with the shortest load time that fits. The time is estimated\n"
+	     "  from -L|--load-model flash=RATE,lz4=RATE,lzma=RATE,zstd=RATE,\n"
+	     "  the bytes per second of reading the flash and of each\n"
+	     "  decompressor's output (K and M suffixes allowed, default\n"
+	     "  flash=20M,lz4=400M,lzma=40M). auto only tries ZSTD if\n"
+	     "  zstd=RATE is given.\n"
 	     "OFFSETs:\n"
 	     "  Numbers accompanying -b, -H, and -o switches* may be provided\n"
 	     "  in two possible formats: if their value is greater than\n"
@@ -1330,6 +1514,10 @@ int main(int argc, char **argv)
 							optarg);
 				break;
 			case 'c': {
+				if (!strcasecmp(optarg, "auto")) {
+					param.compression_auto = true;
+					break;
+				}
 				int algo = cbfs_parse_comp_algo(optarg);
 				if (algo >= 0)
 					param.compression = algo;
@@ -1338,6 +1526,10 @@ int main(int argc, char **argv)
 									optarg);
 				break;
 			}
+			case 'L':
+				if (load_model_parse(&param.load_model, optarg))
+					return 1;
+				break;
 			case 'A': {
 				int algo = cbfs_parse_hash_algo(optarg);
 				if (algo >= 0)
@@ -1476,6 +1668,14 @@ int main(int argc, char **argv)
 					return 1;
 				}
 				break;
+			case 'j':
+				param.threads = strtoul(optarg, &suffix, 0);
+				if (!*optarg || (suffix && *suffix)) {
+					ERROR("Invalid number of jobs '%s'.\n",
+						optarg);
+					return 1;
+				}
+				break;
 			case 'v':
 				verbose++;
 				break;
@@ -1534,6 +1734,15 @@ int main(int argc, char **argv)
 		if (!param.image_file)
 			return 1;
 
+		// verify looks at the whole image at once, the -r list only
+		// names the regions that must hold a CBFS.
+		if (commands[i].function == cbfs_verify) {
+			int ret = dispatch_command(commands[i]);
+
+			partitioned_file_close(param.image_file);
+			return ret;
+		}
+
 		unsigned num_regions = 1;
 		for (const char *list = strchr(param.region_name, ','); list;
 						list = strchr(list + 1, ','))
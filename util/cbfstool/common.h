@@ -164,11 +164,44 @@ enum comp_algo {
 	CBFS_COMPRESS_NONE = 0,
 	CBFS_COMPRESS_LZMA = 1,
 	CBFS_COMPRESS_LZ4 = 2,
+	CBFS_COMPRESS_ZSTD = 3,
 };
 
 comp_func_ptr compression_function(enum comp_algo algo);
 decomp_func_ptr decompression_function(enum comp_algo algo);
 
+/* Model of the time coreboot takes to load a file, for choosing its
+ * compression (-c auto). Rates are in bytes per second: of reading the boot
+ * media, and of the output of each decompressor. A zstd rate of 0 means
+ * that the loader cannot decompress Zstandard. */
+struct load_model {
+	uint64_t flash;
+	uint64_t lz4;
+	uint64_t lzma;
+	uint64_t zstd;
+};
+
+/* Parses "flash=RATE,lz4=RATE,lzma=RATE,zstd=RATE", where each RATE may have a K or M
+ * suffix, into model. Rates not given are left alone. Returns 0 on success,
+ * -1 on error. */
+int load_model_parse(struct load_model *model, const char *arg);
+
+/* Whether the loader of model can decompress algo. */
+bool load_model_has(const struct load_model *model, enum comp_algo algo);
+
+/* Estimated microseconds to load size bytes, stored in stored_size bytes
+ * compressed with algo. */
+uint64_t load_model_time(const struct load_model *model, enum comp_algo algo,
+			 size_t stored_size, size_t size);
+
+/* Smallest buffer that coreboot can decompress the LZMA data of in_len bytes
+ * at in entirely in-place in, with the data loaded to the end of the buffer.
+ * Returns 0 on error. */
+size_t lzma_in_place_size(const char *in, int in_len);
+
+/* The same for Zstandard data that decompresses to out_size bytes. */
+size_t zstd_in_place_size(const char *in, int in_len, size_t out_size);
+
 uint64_t intfiletype(const char *name);
 
 /* cbfs-mkpayload.c */
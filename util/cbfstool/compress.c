@@ -18,12 +18,17 @@
  * GNU General Public License for more details.
  */
 
+#include <ctype.h>
+#include <errno.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include "common.h"
 #include "lz4/lib/lz4frame.h"
+#include "zstd/lib/zstd.h"
 #include <commonlib/compression.h>
+#include <commonlib/lzma_decoder.h>
+#include <commonlib/zstd_decoder.h>
 
 static int lz4_compress(char *in, int in_len, char *out, int *out_len)
 {
@@ -67,6 +72,57 @@ static int lzma_decompress(char *in, int in_len, char *out, unused int out_len,
 {
 	return do_lzma_uncompress(out, out_len, in, in_len, actual_size);
 }
+static int zstd_compress(char *in, int in_len, char *out, int *out_len)
+{
+	ZSTD_CCtx *cctx = ZSTD_createCCtx();
+	size_t worst_size = ZSTD_compressBound(in_len);
+	void *bounce = malloc(worst_size);
+	size_t result;
+	int ret = -1;
+
+	/* The loaders check the CBFS hashes instead of the checksum. */
+	if (cctx && bounce &&
+	    !ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel,
+						 ZSTD_maxCLevel())) &&
+	    !ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag,
+						 0)) &&
+	    !ZSTD_isError(ZSTD_CCtx_setParameter(cctx,
+						 ZSTD_c_contentSizeFlag, 1))) {
+		result = ZSTD_compress2(cctx, bounce, worst_size, in, in_len);
+		if (!ZSTD_isError(result) && result < (size_t)in_len) {
+			memcpy(out, bounce, result);
+			*out_len = result;
+			ret = 0;
+		}
+	}
+
+	ZSTD_freeCCtx(cctx);
+	free(bounce);
+	return ret;
+}
+
+static int zstd_decompress(char *in, int in_len, char *out, int out_len,
+			   size_t *actual_size)
+{
+	void *workspace = malloc(ZSTD_WORKSPACE_SIZE);
+	struct zstd_decoder d;
+	enum zstd_status status;
+
+	if (!workspace)
+		return -1;
+	zstd_decoder_init(&d, workspace, out, out_len);
+	d.in = (const uint8_t *)in;
+	d.in_size = in_len;
+	status = zstd_decode(&d);
+	free(workspace);
+
+	if (status != ZSTD_STATUS_END)
+		return -1;
+	if (actual_size != NULL)
+		*actual_size = d.pos;
+	return 0;
+}
+
 static int none_compress(char *in, int in_len, char *out, int *out_len)
 {
 	memcpy(out, in, in_len);
@@ -83,6 +139,211 @@ static int none_decompress(char *in, int in_len, char *out, unused int out_len,
 	return 0;
 }
 
+/*
+ * The loader decodes in calls that stop where the unread input starts (see
+ * lzma_decode_in_place()), and gives up once the output has reached it. The
+ * input still unread when the output is at pos is the same however the calls
+ * were split, so decode one symbol at a time and find the position where the
+ * output comes closest to it.
+ */
+size_t lzma_in_place_size(const char *in, int in_len)
+{
+	struct lzma_decoder d;
+	const uint8_t *start = (const uint8_t *)in + LZMA_HEADER_SIZE;
+	void *probs, *window;
+	enum lzma_status status = LZMA_OK;
+	size_t out_size, ahead = 0;
+
+	if (in_len < LZMA_HEADER_SIZE || lzma_decoder_header(&d, in) ||
+	    d.out_size == LZMA_SIZE_UNKNOWN || d.out_size > INT32_MAX)
+		return 0;
+
+	out_size = d.out_size;
+	probs = malloc(lzma_decoder_probs_size(&d));
+	window = malloc(out_size ? out_size : 1);
+	if (!probs || !window) {
+		free(probs);
+		free(window);
+		return 0;
+	}
+
+	lzma_decoder_init(&d, probs, window, out_size);
+	d.in = start;
+	d.in_size = in_len - LZMA_HEADER_SIZE;
+	while (d.pos < out_size && status == LZMA_OK) {
+		size_t used = d.in - start;
+		/* The rest of a match reads no input, so skip to its end. */
+		size_t end = d.pos + (d.remain ? d.remain : 1);
+
+		if (end > out_size)
+			end = out_size;
+		if (end > used + ahead)
+			ahead = end - used;
+		status = lzma_decode(&d, end, 1);
+	}
+
+	free(probs);
+	free(window);
+	if (status == LZMA_ERROR || d.pos != out_size)
+		return 0;
+	if (ahead < LZMA_HEADER_SIZE)
+		ahead = LZMA_HEADER_SIZE;
+	return in_len - LZMA_HEADER_SIZE + ahead;
+}
+
+/* Returns whether the loader decodes the data entirely in-place in a buffer
+ * of size bytes, with the data loaded to its end. */
+static bool zstd_fits_in_place(const char *in, size_t in_len, size_t size,
+			       size_t out_size, void *workspace)
+{
+	struct zstd_decoder d;
+	uint8_t *buf = malloc(size);
+	bool fits;
+
+	if (!buf)
+		return false;
+	memcpy(buf + size - in_len, in, in_len);
+	zstd_decoder_init(&d, workspace, buf, out_size);
+	d.in = buf + size - in_len;
+	d.in_size = in_len;
+	fits = zstd_decode_in_place(&d) == ZSTD_STATUS_END;
+	free(buf);
+	return fits;
+}
+
+/*
+ * The loader decodes a block in-place only if all it may decode to ends below
+ * its input (see zstd_decode_in_place()), which gets easier the larger the
+ * buffer is. No buffer needs to be larger than the output and the input
+ * together, so search for the smallest one in between.
+ */
+size_t zstd_in_place_size(const char *in, int in_len, size_t out_size)
+{
+	void *workspace = malloc(ZSTD_WORKSPACE_SIZE);
+	size_t low, high;
+
+	if (!workspace)
+		return 0;
+
+	low = out_size > (size_t)in_len ? out_size : (size_t)in_len;
+	high = out_size + in_len;
+	if (!zstd_fits_in_place(in, in_len, high, out_size, workspace)) {
+		free(workspace);
+		return 0;
+	}
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+
+		if (zstd_fits_in_place(in, in_len, mid, out_size, workspace))
+			high = mid;
+		else
+			low = mid + 1;
+	}
+
+	free(workspace);
+	return low;
+}
+
+static int parse_rate(const char *str, uint64_t *rate)
+{
+	uint64_t unit = 1;
+	char *suffix;
+
+	/* strtoull() would take a sign or blanks before the digits. */
+	if (!isdigit((unsigned char)str[0]))
+		return -1;
+	errno = 0;
+	*rate = strtoull(str, &suffix, 0);
+	if (errno)
+		return -1;
+	switch (tolower((unsigned char)suffix[0])) {
+	case 'k':
+		unit = 1024;
+		suffix++;
+		break;
+	case 'm':
+		unit = 1024 * 1024;
+		suffix++;
+		break;
+	}
+	if (*suffix || *rate == 0 || *rate > UINT64_MAX / unit)
+		return -1;
+	*rate *= unit;
+	return 0;
+}
+
+int load_model_parse(struct load_model *model, const char *arg)
+{
+	char *copy = strdup(arg);
+	char *item, *save = NULL;
+	int ret = 0;
+
+	if (!copy)
+		return -1;
+
+	for (item = strtok_r(copy, ",", &save); item && !ret;
+	     item = strtok_r(NULL, ",", &save)) {
+		char *value = strchr(item, '=');
+		uint64_t *rate;
+
+		if (!value) {
+			ret = -1;
+			break;
+		}
+		*value++ = '\0';
+
+		if (!strcmp(item, "flash")) {
+			rate = &model->flash;
+		} else if (!strcmp(item, "lz4")) {
+			rate = &model->lz4;
+		} else if (!strcmp(item, "lzma")) {
+			rate = &model->lzma;
+		} else if (!strcmp(item, "zstd")) {
+			rate = &model->zstd;
+		} else {
+			ret = -1;
+			break;
+		}
+		ret = parse_rate(value, rate);
+	}
+
+	if (ret)
+		ERROR("Invalid load model '%s'.\n", arg);
+	free(copy);
+	return ret;
+}
+
+bool load_model_has(const struct load_model *model, enum comp_algo algo)
+{
+	switch (algo) {
+	case CBFS_COMPRESS_ZSTD:
+		return model->zstd != 0;
+	default:
+		return true;
+	}
+}
+
+uint64_t load_model_time(const struct load_model *model, enum comp_algo algo,
+			 size_t stored_size, size_t size)
+{
+	uint64_t time = stored_size * 1000000ULL / model->flash;
+
+	switch (algo) {
+	case CBFS_COMPRESS_LZ4:
+		time += size * 1000000ULL / model->lz4;
+		break;
+	case CBFS_COMPRESS_LZMA:
+		time += size * 1000000ULL / model->lzma;
+		break;
+	case CBFS_COMPRESS_ZSTD:
+		time += size * 1000000ULL / model->zstd;
+		break;
+	default:
+		break;
+	}
+	return time;
+}
+
 comp_func_ptr compression_function(enum comp_algo algo)
 {
 	comp_func_ptr compress;
@@ -96,6 +357,9 @@ comp_func_ptr compression_function(enum comp_algo algo)
 	case CBFS_COMPRESS_LZ4:
 		compress = lz4_compress;
 		break;
+	case CBFS_COMPRESS_ZSTD:
+		compress = zstd_compress;
+		break;
 	default:
 		ERROR("Unknown compression algorithm %d!\n", algo);
 		return NULL;
@@ -116,6 +380,9 @@ decomp_func_ptr decompression_function(enum comp_algo algo)
 	case CBFS_COMPRESS_LZ4:
 		decompress = lz4_decompress;
 		break;
+	case CBFS_COMPRESS_ZSTD:
+		decompress = zstd_decompress;
+		break;
 	default:
 		ERROR("Unknown compression algorithm %d!\n", algo);
 		return NULL;
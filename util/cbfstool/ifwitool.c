@@ -19,6 +19,7 @@
 #include <time.h>
 
 #include "common.h"
+#include "mapped_file.h"
 
 /*
  * BPDT is Boot Partition Descriptor Table. It is located at the start of a
@@ -362,6 +363,7 @@ const struct subpart_info {
 struct ifwi_image {
 	/* Data read from input file. */
 	struct buffer input_buff;
+	struct mapped_file *input_map;
 
 	/* BPDT header and entries. */
 	struct buffer bpdt;
@@ -857,12 +859,16 @@ static int ifwi_parse(void)
 	DEBUG("Parsing IFWI image...\n");
 	const char *image_name = param.image_name;
 
-	/* Read input file. */
+	/* Map input file. */
 	struct buffer *buff = &ifwi_image.input_buff;
-	if (buffer_from_file(buff, image_name)) {
+	ifwi_image.input_map = mapped_file_open(image_name, false);
+	if (!ifwi_image.input_map) {
 		ERROR("Failed to read input file %s.\n", image_name);
 		return -1;
 	}
+	buffer_init(buff, strdup(image_name),
+		    mapped_file_data(ifwi_image.input_map),
+		    mapped_file_size(ifwi_image.input_map));
 
 	INFO("Buffer %p size 0x%zx\n", buff->data, buff->size);
 
@@ -1173,6 +1179,38 @@ static void bpdt_write(struct buffer *dst, size_t offset, struct buffer *src)
  * While performing the above steps, make sure that any empty holes are filled
  * with FF.
  */
+/*
+ * When the image keeps its size, update the file in place: only the blocks
+ * that differ from what is on disk are written. Returns 0 on success, -1 if
+ * the file has to be rewritten.
+ */
+static int ifwi_write_in_place(const char *image_name, struct buffer *b)
+{
+	struct mapped_file *map;
+	ssize_t written;
+
+	if (strcmp(image_name, ifwi_image.input_buff.name))
+		return -1;
+
+	map = mapped_file_open(image_name, true);
+	if (!map)
+		return -1;
+
+	if (mapped_file_size(map) != buffer_size(b) ||
+	    mapped_file_update(map, 0, buffer_get(b), buffer_size(b))) {
+		mapped_file_close(map);
+		return -1;
+	}
+
+	written = mapped_file_flush(map);
+	mapped_file_close(map);
+	if (written < 0)
+		return -1;
+
+	DEBUG("Updated %zd of %zu bytes in place.\n", written, buffer_size(b));
+	return 0;
+}
+
 static void ifwi_write(const char *image_name)
 {
 	struct bpdt_entry *s = find_entry_by_type(S_BPDT_TYPE);
@@ -1248,7 +1286,8 @@ static void ifwi_write(const char *image_name)
 	bpdt_write(&ifwi, s->offset, &ifwi_image.subpart_buf[S_BPDT_TYPE]);
 	bpdt_write(&ifwi, 0, &ifwi_image.bpdt);
 
-	if (buffer_write_file(&b, image_name)) {
+	if (ifwi_write_in_place(image_name, &b) &&
+	    buffer_write_file(&b, image_name)) {
 		ERROR("File write error\n");
 		exit(-1);
 	}
@@ -0,0 +1,383 @@
+/*
+ * mapped_file.c, memory-mapped view of an image file with dirty tracking
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include "mapped_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__WIN32) || defined(__WIN64)
+#define HAVE_MMAP 0
+#else
+#define HAVE_MMAP 1
+#include <sys/mman.h>
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+/* Granularity at which dirty ranges are compared against the file. */
+#define MAPPED_FILE_BLOCK	4096
+
+struct mapped_range {
+	size_t start;
+	size_t end;
+};
+
+struct mapped_file {
+	char *data;		/* private, copy-on-write view */
+	const char *pristine;	/* shared read-only view, NULL if unknown */
+	size_t size;
+	int fd;
+	bool mapped;		/* data and pristine come from mmap() */
+	bool writable;
+	struct mapped_range *dirty;
+	size_t num_dirty;
+	size_t max_dirty;
+};
+
+static int read_all(int fd, char *buf, size_t size)
+{
+	while (size) {
+		ssize_t ret = read(fd, buf, size);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -1;
+		buf += ret;
+		size -= ret;
+	}
+	return 0;
+}
+
+static int write_all_at(int fd, const char *buf, size_t size, size_t offset)
+{
+	if (lseek(fd, offset, SEEK_SET) == (off_t)-1)
+		return -1;
+
+	while (size) {
+		ssize_t ret = write(fd, buf, size);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -1;
+		buf += ret;
+		size -= ret;
+	}
+	return 0;
+}
+
+static bool map_view(struct mapped_file *file)
+{
+#if HAVE_MMAP
+	void *data, *pristine = NULL;
+
+	if (!file->size)
+		return false;
+
+	data = mmap(NULL, file->size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+		    file->fd, 0);
+	if (data == MAP_FAILED)
+		return false;
+
+	if (file->writable) {
+		pristine = mmap(NULL, file->size, PROT_READ, MAP_SHARED,
+				file->fd, 0);
+		if (pristine == MAP_FAILED) {
+			munmap(data, file->size);
+			return false;
+		}
+	}
+
+	file->data = data;
+	file->pristine = pristine;
+	file->mapped = true;
+	return true;
+#else
+	return false;
+#endif
+}
+
+/* Fallback for files that cannot be mapped, like pipes or empty files. */
+static bool read_view(struct mapped_file *file)
+{
+	file->data = malloc(file->size ? file->size : 1);
+	if (!file->data)
+		return false;
+
+	if (lseek(file->fd, 0, SEEK_SET) == (off_t)-1 ||
+	    read_all(file->fd, file->data, file->size)) {
+		free(file->data);
+		file->data = NULL;
+		return false;
+	}
+	return true;
+}
+
+static struct mapped_file *setup_view(const char *filename, int fd,
+				      bool writable)
+{
+	struct mapped_file *file;
+	struct stat st;
+
+	if (fstat(fd, &st)) {
+		perror(filename);
+		close(fd);
+		return NULL;
+	}
+
+	file = calloc(1, sizeof(*file));
+	if (!file) {
+		fprintf(stderr, "E: Out of memory mapping %s\n", filename);
+		close(fd);
+		return NULL;
+	}
+	file->fd = fd;
+	file->size = st.st_size;
+	file->writable = writable;
+
+	if (!map_view(file) && !read_view(file)) {
+		fprintf(stderr, "E: Could not read %s\n", filename);
+		mapped_file_close(file);
+		return NULL;
+	}
+
+	return file;
+}
+
+struct mapped_file *mapped_file_open(const char *filename, bool write_access)
+{
+	int fd = open(filename, (write_access ? O_RDWR : O_RDONLY) | O_BINARY);
+
+	if (fd < 0) {
+		perror(filename);
+		return NULL;
+	}
+
+	return setup_view(filename, fd, write_access);
+}
+
+struct mapped_file *mapped_file_create(const char *filename, size_t size)
+{
+	int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC | O_BINARY, 0666);
+
+	if (fd < 0) {
+		perror(filename);
+		return NULL;
+	}
+
+	if (ftruncate(fd, size)) {
+		perror(filename);
+		close(fd);
+		return NULL;
+	}
+
+	return setup_view(filename, fd, true);
+}
+
+void *mapped_file_data(const struct mapped_file *file)
+{
+	return file->data;
+}
+
+size_t mapped_file_size(const struct mapped_file *file)
+{
+	return file->size;
+}
+
+int mapped_file_mark_dirty(struct mapped_file *file, size_t offset,
+			   size_t size)
+{
+	struct mapped_range *last;
+
+	if (offset > file->size || size > file->size - offset)
+		return -1;
+	if (!size)
+		return 0;
+
+	/* Writers tend to go front to back, so try extending the last one. */
+	last = file->num_dirty ? &file->dirty[file->num_dirty - 1] : NULL;
+	if (last && offset <= last->end && offset + size >= last->start) {
+		if (offset < last->start)
+			last->start = offset;
+		if (offset + size > last->end)
+			last->end = offset + size;
+		return 0;
+	}
+
+	if (file->num_dirty == file->max_dirty) {
+		size_t max = file->max_dirty ? file->max_dirty * 2 : 16;
+		struct mapped_range *dirty;
+
+		dirty = realloc(file->dirty, max * sizeof(*dirty));
+		if (!dirty)
+			return -1;
+		file->dirty = dirty;
+		file->max_dirty = max;
+	}
+
+	file->dirty[file->num_dirty].start = offset;
+	file->dirty[file->num_dirty].end = offset + size;
+	file->num_dirty++;
+	return 0;
+}
+
+int mapped_file_update(struct mapped_file *file, size_t offset,
+		       const void *src, size_t size)
+{
+	const char *in = src;
+	size_t pos, len;
+
+	if (offset > file->size || size > file->size - offset)
+		return -1;
+
+	for (pos = 0; pos < size; pos += len) {
+		len = MAPPED_FILE_BLOCK - (offset + pos) % MAPPED_FILE_BLOCK;
+		if (len > size - pos)
+			len = size - pos;
+
+		if (!memcmp(file->data + offset + pos, in + pos, len))
+			continue;
+
+		memcpy(file->data + offset + pos, in + pos, len);
+		if (mapped_file_mark_dirty(file, offset + pos, len))
+			return -1;
+	}
+	return 0;
+}
+
+static int compare_ranges(const void *a, const void *b)
+{
+	const struct mapped_range *ra = a, *rb = b;
+
+	if (ra->start != rb->start)
+		return ra->start < rb->start ? -1 : 1;
+	return 0;
+}
+
+/* Sort the dirty ranges and merge the ones that overlap or touch. */
+static void merge_dirty(struct mapped_file *file)
+{
+	size_t i, n = 0;
+
+	if (!file->num_dirty)
+		return;
+
+	qsort(file->dirty, file->num_dirty, sizeof(*file->dirty),
+	      compare_ranges);
+
+	for (i = 1; i < file->num_dirty; i++) {
+		struct mapped_range *r = &file->dirty[i];
+
+		if (r->start <= file->dirty[n].end) {
+			if (r->end > file->dirty[n].end)
+				file->dirty[n].end = r->end;
+		} else {
+			file->dirty[++n] = *r;
+		}
+	}
+	file->num_dirty = n + 1;
+}
+
+static bool block_changed(const struct mapped_file *file, size_t offset,
+			  size_t size)
+{
+	if (!file->pristine)
+		return true;
+	return memcmp(file->data + offset, file->pristine + offset, size) != 0;
+}
+
+ssize_t mapped_file_flush(struct mapped_file *file)
+{
+	size_t i, written = 0;
+
+	if (!file->writable) {
+		fprintf(stderr, "E: Image file was opened read-only\n");
+		return -1;
+	}
+
+	merge_dirty(file);
+
+	for (i = 0; i < file->num_dirty; i++) {
+		size_t pos = file->dirty[i].start;
+		const size_t end = file->dirty[i].end;
+		size_t run_start = pos, run_len = 0;
+
+		/*
+		 * Walk the range block by block and write every run of
+		 * consecutive changed blocks with a single call.
+		 */
+		while (pos < end) {
+			size_t len = MAPPED_FILE_BLOCK - pos % MAPPED_FILE_BLOCK;
+
+			if (len > end - pos)
+				len = end - pos;
+
+			if (block_changed(file, pos, len)) {
+				if (!run_len)
+					run_start = pos;
+				run_len += len;
+			} else if (run_len) {
+				if (write_all_at(file->fd,
+						 file->data + run_start,
+						 run_len, run_start))
+					goto error;
+				written += run_len;
+				run_len = 0;
+			}
+			pos += len;
+		}
+
+		if (run_len) {
+			if (write_all_at(file->fd, file->data + run_start,
+					 run_len, run_start))
+				goto error;
+			written += run_len;
+		}
+	}
+
+	file->num_dirty = 0;
+	return written;
+
+error:
+	perror("E: Failed to write image file");
+	return -1;
+}
+
+void mapped_file_close(struct mapped_file *file)
+{
+	if (!file)
+		return;
+
+#if HAVE_MMAP
+	if (file->mapped) {
+		munmap(file->data, file->size);
+		if (file->pristine)
+			munmap((void *)(uintptr_t)file->pristine, file->size);
+		file->data = NULL;
+	}
+#endif
+	free(file->data);
+	free(file->dirty);
+	close(file->fd);
+	free(file);
+}
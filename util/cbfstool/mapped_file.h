@@ -0,0 +1,91 @@
+/*
+ * mapped_file.h, memory-mapped view of an image file with dirty tracking
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/*
+ * The file is mapped privately: changes made through the view are
+ * copy-on-write and never reach the file by themselves. Callers mark the
+ * ranges they want to keep as dirty, and mapped_file_flush() writes back
+ * only those blocks of the dirty ranges whose contents actually differ from
+ * the file. Where mmap() is not available the file is read into memory
+ * instead, and dirty ranges are written back in full.
+ */
+struct mapped_file;
+
+/**
+ * Map an existing file.
+ * The view is always writable, but the file itself can only be updated if
+ * write_access is set.
+ *
+ * @param filename      Name of the file to map
+ * @param write_access  True if dirty ranges will be flushed back to the file
+ * @return              Caller-owned mapping, or NULL on error
+ */
+struct mapped_file *mapped_file_open(const char *filename, bool write_access);
+
+/**
+ * Create or truncate a file of the given size and map it for writing.
+ * The view is zero-filled.
+ *
+ * @param filename  Name of the file to create
+ * @param size      Size of the new file
+ * @return          Caller-owned mapping, or NULL on error
+ */
+struct mapped_file *mapped_file_create(const char *filename, size_t size);
+
+/** Return the start of the view. */
+void *mapped_file_data(const struct mapped_file *file);
+
+/** Return the size of the view, which is the size of the file. */
+size_t mapped_file_size(const struct mapped_file *file);
+
+/**
+ * Record that [offset, offset + size) of the view has to be written back on
+ * the next mapped_file_flush().
+ *
+ * @return 0 on success, -1 if the range is outside the file or on error
+ */
+int mapped_file_mark_dirty(struct mapped_file *file, size_t offset,
+			   size_t size);
+
+/**
+ * Copy size bytes from src into the view at offset. Blocks that already
+ * hold the same data are skipped, so only blocks that change are touched
+ * and marked dirty.
+ *
+ * @return 0 on success, -1 if the range is outside the file or on error
+ */
+int mapped_file_update(struct mapped_file *file, size_t offset,
+		       const void *src, size_t size);
+
+/**
+ * Write the changed blocks of all dirty ranges back to the file, and clear
+ * the dirty ranges.
+ *
+ * @return Number of bytes written to the file, or -1 on error
+ */
+ssize_t mapped_file_flush(struct mapped_file *file);
+
+/**
+ * Unmap and close the file. Dirty ranges that were not flushed are
+ * discarded, along with any other change made through the view.
+ */
+void mapped_file_close(struct mapped_file *file);
+
+#endif
@@ -16,6 +16,7 @@
 #include "partitioned_file.h"
 
 #include "cbfs_sections.h"
+#include "mapped_file.h"
 
 #include <assert.h>
 #include <stdlib.h>
@@ -24,9 +25,22 @@
 struct partitioned_file {
 	struct fmap *fmap;
 	struct buffer buffer;
-	FILE *stream;
+	struct mapped_file *map;
 };
 
+static bool map_buffer(struct partitioned_file *file, const char *filename)
+{
+	char *name = strdup(filename);
+
+	if (!name) {
+		ERROR("Failed to allocate image name\n");
+		return false;
+	}
+	buffer_init(&file->buffer, name, mapped_file_data(file->map),
+					mapped_file_size(file->map));
+	return true;
+}
+
 static bool fill_ones_through(struct partitioned_file *file)
 {
 	assert(file);
@@ -54,23 +68,14 @@ static partitioned_file_t *reopen_flat_file(const char *filename,
 {
 	assert(filename);
 	struct partitioned_file *file = calloc(1, sizeof(*file));
-	const char *access_mode;
 
 	if (!file) {
 		ERROR("Failed to allocate partitioned file structure\n");
 		return NULL;
 	}
 
-	if (buffer_from_file(&file->buffer, filename)) {
-		free(file);
-		return NULL;
-	}
-
-	access_mode = write_access ?  "rb+" : "rb";
-	file->stream = fopen(filename, access_mode);
-
-	if (!file->stream) {
-		perror(filename);
+	file->map = mapped_file_open(filename, write_access);
+	if (!file->map || !map_buffer(file, filename)) {
 		partitioned_file_close(file);
 		return NULL;
 	}
@@ -89,14 +94,8 @@ partitioned_file_t *partitioned_file_create_flat(const char *filename,
 		return NULL;
 	}
 
-	file->stream = fopen(filename, "wb");
-	if (!file->stream) {
-		perror(filename);
-		free(file);
-		return NULL;
-	}
-
-	if (buffer_create(&file->buffer, image_size, filename)) {
+	file->map = mapped_file_create(filename, image_size);
+	if (!file->map || !map_buffer(file, filename)) {
 		partitioned_file_close(file);
 		return NULL;
 	}
@@ -210,7 +209,7 @@ bool partitioned_file_write_region(partitioned_file_t *file,
 						const struct buffer *buffer)
 {
 	assert(file);
-	assert(file->stream);
+	assert(file->map);
 	assert(buffer);
 	assert(buffer->data);
 
@@ -223,14 +222,18 @@ bool partitioned_file_write_region(partitioned_file_t *file,
 		return false;
 	}
 
-	if (fseek(file->stream, buffer->offset, SEEK_SET)) {
-		ERROR("Failed to seek within image file\n");
+	/* Only the blocks that really changed end up being written. */
+	if (mapped_file_mark_dirty(file->map, buffer->offset, buffer->size)) {
+		ERROR("Failed to track modified part of image file\n");
 		return false;
 	}
-	if (!fwrite(buffer->data, buffer->size, 1, file->stream)) {
+	ssize_t written = mapped_file_flush(file->map);
+	if (written < 0) {
 		ERROR("Failed to write to image file\n");
 		return false;
 	}
+	DEBUG("Wrote %zd of %zu bytes back to image file\n", written,
+								buffer->size);
 	return true;
 }
 
@@ -272,11 +275,9 @@ void partitioned_file_close(partitioned_file_t *file)
 		return;
 
 	file->fmap = NULL;
-	buffer_delete(&file->buffer);
-	if (file->stream) {
-		fclose(file->stream);
-		file->stream = NULL;
-	}
+	/* The data belongs to the mapping, so don't use buffer_delete(). */
+	free(file->buffer.name);
+	mapped_file_close(file->map);
 	free(file);
 }
 
@@ -31,8 +31,12 @@
 #include <sys/mman.h>
 #include <libgen.h>
 #include <assert.h>
+#include <math.h>
+#include <elf.h>
 #include <commonlib/cbmem_id.h>
+#include <commonlib/checksum.h>
 #include <commonlib/timestamp_serialized.h>
+#include <commonlib/trace_serialized.h>
 #include <commonlib/coreboot_tables.h>
 
 #ifdef __OpenBSD__
@@ -60,25 +64,6 @@ static int mem_fd;
 static uint64_t lbtable_address;
 static size_t lbtable_size;
 
-/*
- * calculate ip checksum (16 bit quantities) on a passed in buffer. In case
- * the buffer length is odd last byte is excluded from the calculation
- */
-static u16 ipchcksum(const void *addr, unsigned size)
-{
-	const u16 *p = addr;
-	unsigned i, n = size / 2; /* don't expect odd sized blocks */
-	u32 sum = 0;
-
-	for (i = 0; i < n; i++)
-		sum += p[i];
-
-	sum = (sum >> 16) + (sum & 0xffff);
-	sum += (sum >> 16);
-	sum = ~sum & 0xffff;
-	return (u16) sum;
-}
-
 /*
  * Functions to map / unmap physical memory into virtual address space. These
  * functions always maps 1MB at a time and can only map one area at once.
@@ -279,12 +264,12 @@ static int parse_cbtable(u64 address, size_t table_size, uint8_t abort_on_failur
 		lbh = (struct lb_header *)(buf + i);
 		if (memcmp(lbh->signature, "LBIO", sizeof(lbh->signature)) ||
 		    !lbh->header_bytes ||
-		    ipchcksum(lbh, sizeof(*lbh))) {
+		    ip_checksum(lbh, sizeof(*lbh))) {
 			continue;
 		}
 		lbtable = buf + i + lbh->header_bytes;
 
-		if (ipchcksum(lbtable, lbh->table_bytes) !=
+		if (ip_checksum(lbtable, lbh->table_bytes) !=
 		    lbh->table_checksum) {
 			debug("Signature found, but wrong checksum.\n");
 			continue;
@@ -510,31 +495,95 @@ uint64_t timestamp_print_entry(uint32_t id, uint64_t stamp, uint64_t prev_stamp)
 	return step_time;
 }
 
-/* dump the timestamp table */
-static void dump_timestamps(int mach_readable)
+/*
+ * Copy the timestamp table out of CBMEM. Returns a malloc()ed buffer or NULL
+ * if the coreboot table does not point to one.
+ */
+static struct timestamp_table *read_timestamp_table(void)
 {
-	int i;
-	struct timestamp_table *tst_p;
+	struct timestamp_table *tst_p, *table;
 	size_t size;
-	uint64_t prev_stamp;
-	uint64_t total_time;
 
 	if (timestamps.tag != LB_TAG_TIMESTAMPS) {
 		fprintf(stderr, "No timestamps found in coreboot table.\n");
-		return;
+		return NULL;
 	}
 
 	size = sizeof(*tst_p);
 	tst_p = map_memory_size((unsigned long)timestamps.cbmem_addr, size, 1);
+	size += tst_p->num_entries * sizeof(tst_p->entries[0]);
+
+	unmap_memory();
+	tst_p = map_memory_size((unsigned long)timestamps.cbmem_addr, size, 1);
+
+	table = malloc(size);
+	if (!table) {
+		fprintf(stderr, "Not enough memory for timestamps.\n");
+		exit(1);
+	}
+	memcpy(table, tst_p, size);
+
+	unmap_memory();
+	return table;
+}
+
+/*
+ * Load a timestamp table saved with "cbmem -r 54494d45", the raw contents
+ * of the CBMEM_ID_TIMESTAMP entry. Exits on any error.
+ */
+static struct timestamp_table *load_timestamp_table(const char *filename)
+{
+	struct timestamp_table *table;
+	struct stat st;
+	size_t size;
+	FILE *f;
+
+	f = fopen(filename, "rb");
+	if (!f || fstat(fileno(f), &st)) {
+		fprintf(stderr, "Could not open %s: %s\n", filename,
+			strerror(errno));
+		exit(1);
+	}
+	size = st.st_size;
+	if (size < sizeof(*table)) {
+		fprintf(stderr, "%s is too small for a timestamp table\n",
+			filename);
+		exit(1);
+	}
+	table = malloc(size);
+	if (!table) {
+		fprintf(stderr, "Not enough memory for %s\n", filename);
+		exit(1);
+	}
+	if (fread(table, size, 1, f) != 1) {
+		fprintf(stderr, "Could not read %s: %s\n", filename,
+			strerror(errno));
+		exit(1);
+	}
+	fclose(f);
+
+	if (table->num_entries > table->max_entries ||
+	    sizeof(*table) + table->num_entries * sizeof(table->entries[0]) >
+	    size) {
+		fprintf(stderr, "%s: corrupt timestamp table (%u entries)\n",
+			filename, table->num_entries);
+		exit(1);
+	}
+	return table;
+}
+
+/* dump the timestamp table */
+static void dump_timestamps(const struct timestamp_table *tst_p,
+			    int mach_readable)
+{
+	int i;
+	uint64_t prev_stamp;
+	uint64_t total_time;
 
 	timestamp_set_tick_freq(tst_p->tick_freq_mhz);
 
 	if (!mach_readable)
 		printf("%d entries total:\n\n", tst_p->num_entries);
-	size += tst_p->num_entries * sizeof(tst_p->entries[0]);
-
-	unmap_memory();
-	tst_p = map_memory_size((unsigned long)timestamps.cbmem_addr, size, 1);
 
 	/* Report the base time within the table. */
 	prev_stamp = 0;
@@ -567,8 +616,928 @@ static void dump_timestamps(int mach_readable)
 		print_norm(total_time);
 		printf("\n");
 	}
+}
+
+/*
+ * Boot phases by timestamp ID range. The time between two timestamps is
+ * charged to the phase of the later one; IDs outside every range count
+ * as "other".
+ */
+static const struct timestamp_phase {
+	const char *name;
+	uint32_t first_id;
+	uint32_t last_id;
+} timestamp_phases[] = {
+	{ "bootblock",	TS_START_BOOTBLOCK,	TS_END_COPYROM },
+	{ "romstage",	TS_START_ROMSTAGE,	TS_END_COPYRAM },
+	{ "decompress",	TS_START_ULZMA,		TS_END_UZSTD },
+	{ "ramstage",	TS_START_RAMSTAGE,	TS_START_RAMSTAGE },
+	{ "ramstage",	TS_DEVICE_ENUMERATE,	TS_SELFBOOT_JUMP },
+	{ "tpm",	TS_END_TPMCMD,		TS_END_TPMCMD },
+	{ "verstage",	TS_START_COPYVER,	TS_START_TPMCMD },
+	{ "vpd",	TS_START_COPYVPD,	TS_END_COPYVPD_RW },
+	{ "fsp",	TS_FSP_MEMORY_INIT_START, 999 },
+	{ "payload",	TS_DC_START,		1999 },
+};
+
+#define MAX_PHASES (ARRAY_SIZE(timestamp_phases) + 1)
+
+static const char *timestamp_phase(uint32_t id)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(timestamp_phases); i++) {
+		if (id >= timestamp_phases[i].first_id &&
+		    id <= timestamp_phases[i].last_id)
+			return timestamp_phases[i].name;
+	}
+	return "other";
+}
+
+/* A timestamp table converted to microseconds. */
+struct timestamp_run {
+	int num_entries;
+	uint64_t base;		/* absolute time of the 1st timestamp */
+	uint32_t *ids;
+	uint64_t *stamps;	/* absolute time of each entry */
+};
+
+static void convert_timestamp_table(const struct timestamp_table *tst_p,
+				    struct timestamp_run *run)
+{
+	int i;
+
+	timestamp_set_tick_freq(tst_p->tick_freq_mhz);
+
+	run->num_entries = tst_p->num_entries;
+	run->base = arch_convert_raw_ts_entry(tst_p->base_time);
+	run->ids = calloc(run->num_entries + 1, sizeof(run->ids[0]));
+	run->stamps = calloc(run->num_entries + 1, sizeof(run->stamps[0]));
+	if (!run->ids || !run->stamps) {
+		fprintf(stderr, "Not enough memory for timestamps.\n");
+		exit(1);
+	}
+	for (i = 0; i < run->num_entries; i++) {
+		run->ids[i] = tst_p->entries[i].entry_id;
+		run->stamps[i] = arch_convert_raw_ts_entry(
+			tst_p->entries[i].entry_stamp + tst_p->base_time);
+	}
+}
+
+/* Time from the previous timestamp (or the base time) to entry i. */
+static uint64_t timestamp_step(const struct timestamp_run *run, int i)
+{
+	uint64_t prev = i ? run->stamps[i - 1] : run->base;
+
+	/* Guard against tables that were not recorded in order. */
+	return run->stamps[i] > prev ? run->stamps[i] - prev : 0;
+}
+
+struct phase_totals {
+	int count;
+	const char *names[MAX_PHASES];
+	uint64_t usecs[MAX_PHASES];
+};
+
+static int phase_index(struct phase_totals *pt, const char *name)
+{
+	int i;
+
+	for (i = 0; i < pt->count; i++) {
+		if (!strcmp(pt->names[i], name))
+			return i;
+	}
+	pt->names[pt->count] = name;
+	pt->usecs[pt->count] = 0;
+	return pt->count++;
+}
+
+static void sum_phases(const struct timestamp_run *run,
+		       struct phase_totals *pt)
+{
+	int i;
+
+	for (i = 0; i < run->num_entries; i++)
+		pt->usecs[phase_index(pt, timestamp_phase(run->ids[i]))] +=
+			timestamp_step(run, i);
+}
+
+/*
+ * Print the timestamps as a Chrome trace-event timeline that can be loaded
+ * into chrome://tracing or Perfetto. Every run is a process, every phase a
+ * thread and the step leading up to each timestamp a complete event.
+ */
+static void dump_trace_events(const struct timestamp_run *runs, int count)
+{
+	const char *sep = "";
+	int r, i;
+
+	printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	for (r = 0; r < count; r++) {
+		const struct timestamp_run *run = &runs[r];
+		struct phase_totals pt;
+
+		memset(&pt, 0, sizeof(pt));
+		for (i = 0; i < run->num_entries; i++) {
+			const char *phase = timestamp_phase(run->ids[i]);
+			int tid = phase_index(&pt, phase);
+			uint64_t step = timestamp_step(run, i);
+
+			printf("%s\n{\"name\":\"%s\",\"cat\":\"%s\","
+			       "\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+			       "\"ts\":%" PRIu64 ",\"dur\":%" PRIu64 ","
+			       "\"args\":{\"id\":%u}}",
+			       sep, timestamp_name(run->ids[i]), phase, r, tid,
+			       run->stamps[i] - step, step, run->ids[i]);
+			sep = ",";
+		}
+		for (i = 0; i < pt.count; i++)
+			printf(",\n{\"name\":\"thread_name\",\"ph\":\"M\","
+			       "\"pid\":%d,\"tid\":%d,"
+			       "\"args\":{\"name\":\"%s\"}}",
+			       r, i, pt.names[i]);
+		printf("%s\n{\"name\":\"process_name\",\"ph\":\"M\","
+		       "\"pid\":%d,\"args\":{\"name\":\"boot %d\"}}",
+		       sep, r, r);
+		sep = ",";
+	}
+	printf("\n]}\n");
+}
+
+/* Print the time spent in each boot phase, averaged over all runs. */
+static void dump_phase_summary(const struct timestamp_run *runs, int count)
+{
+	struct phase_totals pt, run_pt;
+	uint64_t min[MAX_PHASES], max[MAX_PHASES];
+	int seen[MAX_PHASES];
+	uint64_t total = 0;
+	int r, i;
+
+	memset(&pt, 0, sizeof(pt));
+	memset(seen, 0, sizeof(seen));
+	for (r = 0; r < count; r++) {
+		memset(&run_pt, 0, sizeof(run_pt));
+		sum_phases(&runs[r], &run_pt);
+		for (i = 0; i < run_pt.count; i++) {
+			int p = phase_index(&pt, run_pt.names[i]);
+			uint64_t t = run_pt.usecs[i];
+
+			if (!seen[p] || t < min[p])
+				min[p] = t;
+			if (!seen[p] || t > max[p])
+				max[p] = t;
+			seen[p] = 1;
+			pt.usecs[p] += t;
+			total += t;
+		}
+	}
+	if (!total)
+		return;
+
+	printf("%d run%s:\n\n", count, count == 1 ? "" : "s");
+	printf("%-12s %14s %8s %14s %14s\n", "phase", "mean (us)", "share",
+	       "min (us)", "max (us)");
+	for (i = 0; i < pt.count; i++) {
+		printf("%-12s %14" PRIu64 " %7.1f%% %14" PRIu64 " %14" PRIu64
+		       "\n", pt.names[i], pt.usecs[i] / count,
+		       100.0 * pt.usecs[i] / total, min[i], max[i]);
+	}
+	printf("%-12s %14" PRIu64 "\n", "total", total / count);
+}
+
+/* Two-sided 95% critical values of Student's t for 1..30 degrees of freedom */
+static const double t_critical[] = {
+	12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+	2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+	2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+struct sample_stats {
+	int n;
+	double mean;
+	double var;
+};
+
+static void sample_stats(const double *v, int n, struct sample_stats *st)
+{
+	int i;
+
+	st->n = n;
+	st->mean = 0;
+	st->var = 0;
+	for (i = 0; i < n; i++)
+		st->mean += v[i];
+	st->mean /= n;
+	for (i = 0; i < n; i++)
+		st->var += (v[i] - st->mean) * (v[i] - st->mean);
+	if (n > 1)
+		st->var /= n - 1;
+}
+
+/*
+ * Welch's t-test on the two samples. Returns 1 if the means differ at the
+ * 95% level, 0 if they do not and -1 if there are too few runs to tell.
+ */
+static int significant_change(const struct sample_stats *a,
+			      const struct sample_stats *b)
+{
+	double va, vb, se2, t, df;
+	int idf;
+
+	if (a->n < 2 || b->n < 2)
+		return -1;
+	va = a->var / a->n;
+	vb = b->var / b->n;
+	se2 = va + vb;
+	if (se2 == 0)
+		return a->mean != b->mean;
+	t = fabs(b->mean - a->mean) / sqrt(se2);
+	df = se2 * se2 / (va * va / (a->n - 1) + vb * vb / (b->n - 1));
+	idf = (int)df;
+	if (idf < 1)
+		idf = 1;
+	if (idf > ARRAY_SIZE(t_critical))
+		return t > 1.960;
+	return t > t_critical[idf - 1];
+}
+
+/* The per run times of one timestamp ID or one phase. */
+struct diff_row {
+	uint32_t id;
+	const char *phase;	/* NULL for timestamp rows */
+	double *base;
+	double *cur;
+};
+
+static struct diff_row *diff_row(struct diff_row **rows, int *count,
+				 uint32_t id, const char *phase,
+				 int base_runs, int cur_runs)
+{
+	struct diff_row *row;
+	int i;
+
+	for (i = 0; i < *count; i++) {
+		row = &(*rows)[i];
+		if (phase ? (row->phase && !strcmp(row->phase, phase)) :
+		    (!row->phase && row->id == id))
+			return row;
+	}
+	*rows = realloc(*rows, (*count + 1) * sizeof(**rows));
+	if (!*rows) {
+		fprintf(stderr, "Not enough memory for timestamp diff.\n");
+		exit(1);
+	}
+	row = &(*rows)[(*count)++];
+	row->id = id;
+	row->phase = phase;
+	row->base = calloc(base_runs, sizeof(double));
+	row->cur = calloc(cur_runs, sizeof(double));
+	if (!row->base || !row->cur) {
+		fprintf(stderr, "Not enough memory for timestamp diff.\n");
+		exit(1);
+	}
+	return row;
+}
+
+static void collect_diff_rows(struct diff_row **rows, int *count,
+			      const struct timestamp_run *runs,
+			      int base_runs, int cur_runs, int is_base)
+{
+	int nruns = is_base ? base_runs : cur_runs;
+	int r, i;
+
+	for (r = 0; r < nruns; r++) {
+		const struct timestamp_run *run = &runs[r];
+
+		for (i = 0; i < run->num_entries; i++) {
+			uint64_t step = timestamp_step(run, i);
+			struct diff_row *row;
+
+			row = diff_row(rows, count, run->ids[i], NULL,
+				       base_runs, cur_runs);
+			(is_base ? row->base : row->cur)[r] += step;
+			row = diff_row(rows, count, 0,
+				       timestamp_phase(run->ids[i]),
+				       base_runs, cur_runs);
+			(is_base ? row->base : row->cur)[r] += step;
+		}
+	}
+}
+
+/*
+ * Compare the step times and phase totals of two sets of boots and flag
+ * the statistically significant changes. Returns the number of significant
+ * regressions.
+ */
+static int diff_timestamps(const struct timestamp_run *base, int base_runs,
+			   const struct timestamp_run *cur, int cur_runs)
+{
+	struct diff_row *rows = NULL;
+	int count = 0, regressions = 0;
+	int pass, i;
+
+	collect_diff_rows(&rows, &count, base, base_runs, cur_runs, 1);
+	collect_diff_rows(&rows, &count, cur, base_runs, cur_runs, 0);
+
+	printf("Comparing %d baseline run%s against %d run%s "
+	       "(times in us):\n", base_runs, base_runs == 1 ? "" : "s",
+	       cur_runs, cur_runs == 1 ? "" : "s");
+
+	/* Timestamps first, then the phase totals. */
+	for (pass = 0; pass < 2; pass++) {
+		printf("\n%-55s %12s %12s %12s\n",
+		       pass ? "phase" : "timestamp", "baseline", "new",
+		       "delta");
+		for (i = 0; i < count; i++) {
+			struct diff_row *row = &rows[i];
+			struct sample_stats a, b;
+			const char *flag = "";
+			int sig;
+
+			if ((row->phase != NULL) != pass)
+				continue;
+			sample_stats(row->base, base_runs, &a);
+			sample_stats(row->cur, cur_runs, &b);
+			sig = significant_change(&a, &b);
+			if (sig > 0 && b.mean > a.mean) {
+				flag = "  REGRESSION";
+				regressions++;
+			} else if (sig > 0) {
+				flag = "  improved";
+			}
+
+			if (pass)
+				printf("%-55s", row->phase);
+			else
+				printf("%4d:%-50s", row->id,
+				       timestamp_name(row->id));
+			printf(" %12.0f %12.0f %+12.0f", a.mean, b.mean,
+			       b.mean - a.mean);
+			if (a.mean)
+				printf(" (%+.1f%%)",
+				       100.0 * (b.mean - a.mean) / a.mean);
+			printf("%s\n", flag);
+		}
+	}
+	if (base_runs < 2 || cur_runs < 2)
+		printf("\nAt least two runs on each side are needed to flag "
+		       "significant changes.\n");
+	else
+		printf("\n%d significant regression%s "
+		       "(Welch's t-test, 95%% confidence).\n",
+		       regressions, regressions == 1 ? "" : "s");
+
+	for (i = 0; i < count; i++) {
+		free(rows[i].base);
+		free(rows[i].cur);
+	}
+	free(rows);
+	return regressions;
+}
+
+/*
+ * Function trace support. The trace is a CBMEM_ID_TRACE buffer holding one
+ * ring of function entry/exit records per CPU. Records are symbolized with
+ * the function symbols of the stage ELFs given with -e and turned into
+ * folded stacks ("a;b;c <microseconds>") or a flame graph SVG.
+ */
+struct elf_sym {
+	uint64_t addr;
+	uint64_t size;
+	const char *name;
+};
+
+static struct elf_sym *elf_syms;
+static size_t elf_sym_count;
+
+static int elf_sym_cmp(const void *a, const void *b)
+{
+	const struct elf_sym *x = a, *y = b;
+
+	if (x->addr != y->addr)
+		return x->addr < y->addr ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Add the function symbols of an ELF file. If the trace recorded where the
+ * traced stage's _program symbol ended up at runtime, symbols of an ELF
+ * defining _program are relocated to match. Exits on any error.
+ */
+static void load_elf_symbols(const char *filename, uint64_t program_base)
+{
+	uint8_t *buf;
+	struct stat st;
+	size_t first = elf_sym_count;
+	int64_t reloc = 0;
+	int is64;
+	size_t shoff, shentsize, shnum, i, j;
+	FILE *f;
+
+	f = fopen(filename, "rb");
+	if (!f || fstat(fileno(f), &st)) {
+		fprintf(stderr, "Could not open %s: %s\n", filename,
+			strerror(errno));
+		exit(1);
+	}
+	buf = malloc(st.st_size);
+	if (!buf || fread(buf, st.st_size, 1, f) != 1) {
+		fprintf(stderr, "Could not read %s\n", filename);
+		exit(1);
+	}
+	fclose(f);
+
+	if (st.st_size < sizeof(Elf32_Ehdr) || memcmp(buf, ELFMAG, SELFMAG)) {
+		fprintf(stderr, "%s is not an ELF file\n", filename);
+		exit(1);
+	}
+	is64 = buf[EI_CLASS] == ELFCLASS64;
+	if (is64) {
+		Elf64_Ehdr *eh = (void *)buf;
+		shoff = eh->e_shoff;
+		shentsize = eh->e_shentsize;
+		shnum = eh->e_shnum;
+	} else {
+		Elf32_Ehdr *eh = (void *)buf;
+		shoff = eh->e_shoff;
+		shentsize = eh->e_shentsize;
+		shnum = eh->e_shnum;
+	}
+	if (shoff > st.st_size || shnum * shentsize > st.st_size - shoff) {
+		fprintf(stderr, "%s: corrupt section headers\n", filename);
+		exit(1);
+	}
+
+	for (i = 0; i < shnum; i++) {
+		uint64_t type, off, size, entsize, link, stroff, strsize;
+		uint8_t *sh = buf + shoff + i * shentsize;
+
+		if (is64) {
+			Elf64_Shdr *s = (void *)sh;
+			type = s->sh_type; off = s->sh_offset;
+			size = s->sh_size; entsize = s->sh_entsize;
+			link = s->sh_link;
+		} else {
+			Elf32_Shdr *s = (void *)sh;
+			type = s->sh_type; off = s->sh_offset;
+			size = s->sh_size; entsize = s->sh_entsize;
+			link = s->sh_link;
+		}
+		if (type != SHT_SYMTAB || !entsize || link >= shnum)
+			continue;
+
+		sh = buf + shoff + link * shentsize;
+		if (is64) {
+			stroff = ((Elf64_Shdr *)sh)->sh_offset;
+			strsize = ((Elf64_Shdr *)sh)->sh_size;
+		} else {
+			stroff = ((Elf32_Shdr *)sh)->sh_offset;
+			strsize = ((Elf32_Shdr *)sh)->sh_size;
+		}
+		if (off > st.st_size || size > st.st_size - off ||
+		    stroff > st.st_size || strsize > st.st_size - stroff)
+			continue;
+		/* Symbol names are used in place, so the last must end. */
+		if (!strsize || buf[stroff + strsize - 1] != '\0')
+			continue;
+
+		elf_syms = realloc(elf_syms, (elf_sym_count + size / entsize) *
+				   sizeof(*elf_syms));
+		if (!elf_syms) {
+			fprintf(stderr, "Out of memory.\n");
+			exit(1);
+		}
+
+		for (j = 0; j < size / entsize; j++) {
+			uint8_t *p = buf + off + j * entsize;
+			uint64_t name, value, symsize;
+			int symtype;
+
+			if (is64) {
+				Elf64_Sym *sym = (void *)p;
+				name = sym->st_name; value = sym->st_value;
+				symsize = sym->st_size;
+				symtype = ELF64_ST_TYPE(sym->st_info);
+			} else {
+				Elf32_Sym *sym = (void *)p;
+				name = sym->st_name; value = sym->st_value;
+				symsize = sym->st_size;
+				symtype = ELF32_ST_TYPE(sym->st_info);
+			}
+			if (name >= strsize)
+				continue;
+			if (!strcmp((char *)buf + stroff + name, "_program") &&
+			    program_base)
+				reloc = program_base - value;
+			if (symtype != STT_FUNC)
+				continue;
+
+			elf_syms[elf_sym_count].addr = value;
+			elf_syms[elf_sym_count].size = symsize;
+			elf_syms[elf_sym_count].name =
+				(char *)buf + stroff + name;
+			elf_sym_count++;
+		}
+	}
+
+	debug("%s: %zu function symbols, relocated by %" PRId64 "\n",
+	      filename, elf_sym_count - first, reloc);
+	for (i = first; i < elf_sym_count; i++)
+		elf_syms[i].addr += reloc;
+	if (elf_sym_count)
+		qsort(elf_syms, elf_sym_count, sizeof(*elf_syms), elf_sym_cmp);
+}
+
+static const char *trace_symbol(uint64_t addr)
+{
+	static char unknown[20];
+	size_t low = 0, high = elf_sym_count;
+
+	/* Find the last symbol starting at or below addr. */
+	while (low < high) {
+		size_t mid = (low + high) / 2;
+
+		if (elf_syms[mid].addr <= addr)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	if (low && (addr < elf_syms[low - 1].addr + elf_syms[low - 1].size ||
+		    (!elf_syms[low - 1].size && addr == elf_syms[low - 1].addr)))
+		return elf_syms[low - 1].name;
+
+	snprintf(unknown, sizeof(unknown), "0x%" PRIx64, addr);
+	return unknown;
+}
 
+/* Copy the trace buffer out of CBMEM. Returns NULL if there is none. */
+static struct trace_buffer *read_trace_buffer(size_t *size)
+{
+	struct trace_buffer *trace;
+	uint64_t addr;
+	void *p;
+
+	if (find_cbmem_entry(CBMEM_ID_TRACE, &addr, size)) {
+		fprintf(stderr, "No function trace found in CBMEM.\n");
+		return NULL;
+	}
+
+	p = map_memory_size(addr, *size, 1);
+	trace = malloc(*size);
+	if (!trace) {
+		fprintf(stderr, "Not enough memory for the trace.\n");
+		exit(1);
+	}
+	memcpy(trace, p, *size);
 	unmap_memory();
+	return trace;
+}
+
+/* Load a trace saved with "cbmem -r 54524345". Exits on any error. */
+static struct trace_buffer *load_trace_buffer(const char *filename,
+					      size_t *size)
+{
+	struct trace_buffer *trace;
+	struct stat st;
+	FILE *f;
+
+	f = fopen(filename, "rb");
+	if (!f || fstat(fileno(f), &st)) {
+		fprintf(stderr, "Could not open %s: %s\n", filename,
+			strerror(errno));
+		exit(1);
+	}
+	*size = st.st_size;
+	trace = malloc(*size);
+	if (!trace || fread(trace, *size, 1, f) != 1) {
+		fprintf(stderr, "Could not read %s\n", filename);
+		exit(1);
+	}
+	fclose(f);
+	return trace;
+}
+
+static int trace_buffer_valid(const struct trace_buffer *trace, size_t size)
+{
+	size_t ring_size;
+
+	if (size < sizeof(*trace) || trace->magic != TRACE_BUFFER_MAGIC ||
+	    trace->version != TRACE_BUFFER_VERSION || !trace->ring_entries ||
+	    (trace->ring_entries & (trace->ring_entries - 1))) {
+		fprintf(stderr, "Function trace has an unknown format.\n");
+		return 0;
+	}
+
+	ring_size = sizeof(struct trace_ring) +
+		trace->ring_entries * sizeof(struct trace_entry);
+	if (sizeof(*trace) + trace->num_cpus * ring_size > size) {
+		fprintf(stderr, "Function trace is truncated.\n");
+		return 0;
+	}
+	return 1;
+}
+
+struct folded_stack {
+	char *path;
+	uint64_t ticks;
+};
+
+static int folded_stack_cmp(const void *a, const void *b)
+{
+	const struct folded_stack *x = a, *y = b;
+
+	return strcmp(x->path, y->path);
+}
+
+#define TRACE_MAX_DEPTH 256
+
+/*
+ * Replay each CPU's ring and charge the time between consecutive records to
+ * the call stack active in between. Records lost to ring wrap-around show up
+ * as exits without an entry, which are skipped. Returns the merged stacks
+ * sorted by path.
+ */
+static struct folded_stack *fold_trace(struct trace_buffer *trace,
+				       size_t *count)
+{
+	struct folded_stack *stacks = NULL;
+	size_t n = 0, alloc = 0, i, out;
+	unsigned int cpu;
+
+	for (cpu = 0; cpu < trace->num_cpus; cpu++) {
+		struct trace_ring *ring = trace_buffer_ring(trace, cpu);
+		uint64_t stack[TRACE_MAX_DEPTH];
+		int depth = 0;
+		uint64_t first, rec, prev_stamp = 0;
+
+		first = 0;
+		if (ring->head > trace->ring_entries)
+			first = ring->head - trace->ring_entries;
+
+		for (rec = first; rec < ring->head; rec++) {
+			struct trace_entry *e;
+			uint64_t stamp;
+			int exit_rec;
+
+			e = &ring->entries[rec & (trace->ring_entries - 1)];
+			stamp = e->stamp & ~TRACE_EXIT;
+			exit_rec = !!(e->stamp & TRACE_EXIT);
+
+			if (depth && stamp > prev_stamp) {
+				char *path;
+				size_t len = 32;
+				int d, shown;
+
+				/* Frames past the cap are only counted. */
+				shown = depth < TRACE_MAX_DEPTH ? depth :
+					TRACE_MAX_DEPTH;
+				for (d = 0; d < shown; d++)
+					len += strlen(trace_symbol(stack[d])) + 1;
+				path = malloc(len);
+				if (!path) {
+					fprintf(stderr, "Out of memory.\n");
+					exit(1);
+				}
+				len = sprintf(path, "cpu%u", cpu);
+				for (d = 0; d < shown; d++)
+					len += sprintf(path + len, ";%s",
+						       trace_symbol(stack[d]));
+				if (depth > shown)
+					sprintf(path + len, ";[%d more]",
+						depth - shown);
+
+				if (n == alloc) {
+					alloc = alloc ? alloc * 2 : 1024;
+					stacks = realloc(stacks,
+							 alloc * sizeof(*stacks));
+					if (!stacks) {
+						fprintf(stderr, "Out of memory.\n");
+						exit(1);
+					}
+				}
+				stacks[n].path = path;
+				stacks[n].ticks = stamp - prev_stamp;
+				n++;
+			}
+			prev_stamp = stamp;
+
+			if (!exit_rec) {
+				if (depth < TRACE_MAX_DEPTH)
+					stack[depth] = e->func;
+				depth++;
+				continue;
+			}
+
+			/* Frames past the cap have nothing to match against. */
+			if (depth > TRACE_MAX_DEPTH) {
+				depth--;
+				continue;
+			}
+
+			/* Unwind to the matching entry, if there is one. */
+			for (i = depth; i > 0; i--) {
+				if (stack[i - 1] == e->func)
+					break;
+			}
+			if (i > 0)
+				depth = i - 1;
+		}
+	}
+
+	if (n)
+		qsort(stacks, n, sizeof(*stacks), folded_stack_cmp);
+
+	/* Merge identical stacks. */
+	for (i = 0, out = 0; i < n; i++) {
+		if (out && !strcmp(stacks[out - 1].path, stacks[i].path)) {
+			stacks[out - 1].ticks += stacks[i].ticks;
+			free(stacks[i].path);
+			continue;
+		}
+		stacks[out++] = stacks[i];
+	}
+
+	*count = out;
+	return stacks;
+}
+
+static void dump_folded_stacks(const struct folded_stack *stacks, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		printf("%s %llu\n", stacks[i].path,
+		       (unsigned long long)
+		       arch_convert_raw_ts_entry(stacks[i].ticks));
+}
+
+/* Number of ';' separated frames two paths have in common. */
+static int common_frames(const char *a, const char *b)
+{
+	int frames = 0;
+
+	while (1) {
+		size_t la = strcspn(a, ";"), lb = strcspn(b, ";");
+
+		if (la != lb || strncmp(a, b, la))
+			return frames;
+		frames++;
+		if (!a[la] || !b[lb])
+			return frames;
+		a += la + 1;
+		b += lb + 1;
+	}
+}
+
+static void svg_escape(const char *s, size_t len)
+{
+	for (; len && *s; s++, len--) {
+		switch (*s) {
+		case '<': printf("&lt;"); break;
+		case '>': printf("&gt;"); break;
+		case '&': printf("&amp;"); break;
+		case '"': printf("&quot;"); break;
+		default: putchar(*s);
+		}
+	}
+}
+
+#define FLAME_WIDTH	1200
+#define FLAME_FRAME	16
+
+static void flame_frame(const char *name, size_t len, int depth,
+			uint64_t start, uint64_t end, uint64_t total,
+			int max_depth)
+{
+	double x = 10 + (double)start * (FLAME_WIDTH - 20) / total;
+	double w = (double)(end - start) * (FLAME_WIDTH - 20) / total;
+	int y = (max_depth - depth) * FLAME_FRAME;
+	unsigned int hash = 0;
+	size_t i, chars;
+
+	if (w < 0.1)
+		return;
+
+	for (i = 0; i < len; i++)
+		hash = hash * 31 + name[i];
+
+	printf("<g><title>");
+	svg_escape(name, len);
+	printf(" (%llu us, %.2f%%)</title>",
+	       (unsigned long long)arch_convert_raw_ts_entry(end - start),
+	       100.0 * (end - start) / total);
+	printf("<rect x=\"%.1f\" y=\"%d\" width=\"%.1f\" height=\"%d\" "
+	       "fill=\"rgb(%u,%u,%u)\" rx=\"2\"/>", x, y, w, FLAME_FRAME - 1,
+	       205 + hash % 50, 80 + (hash >> 8) % 150, (hash >> 16) % 60);
+	chars = w / 7;
+	if (chars > 2) {
+		printf("<text x=\"%.1f\" y=\"%d\">", x + 3, y + FLAME_FRAME - 4);
+		svg_escape(name, chars - 2 < len ? chars - 2 : len);
+		if (chars - 2 < len)
+			printf("..");
+		printf("</text>");
+	}
+	printf("</g>\n");
+}
+
+/*
+ * Print a flame graph. The stacks are sorted, so each frame spans a run of
+ * consecutive stacks sharing its prefix, the same way flamegraph.pl does it.
+ */
+static void dump_flame_graph(const struct folded_stack *stacks, size_t n)
+{
+	uint64_t total = 0, x = 0;
+	uint64_t start[TRACE_MAX_DEPTH + 1];
+	const char *names[TRACE_MAX_DEPTH + 1];
+	size_t lens[TRACE_MAX_DEPTH + 1];
+	int max_depth = 0, depth = 0;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		const char *p = stacks[i].path;
+		int frames = 1;
+
+		total += stacks[i].ticks;
+		while ((p = strchr(p, ';'))) {
+			frames++;
+			p++;
+		}
+		if (frames > TRACE_MAX_DEPTH + 1)
+			frames = TRACE_MAX_DEPTH + 1;
+		if (frames > max_depth)
+			max_depth = frames;
+	}
+	if (!total)
+		total = 1;
+
+	printf("<?xml version=\"1.0\" standalone=\"no\"?>\n"
+	       "<svg version=\"1.1\" width=\"%d\" height=\"%d\" "
+	       "xmlns=\"http://www.w3.org/2000/svg\" "
+	       "font-family=\"Verdana\" font-size=\"11\">\n"
+	       "<rect width=\"100%%\" height=\"100%%\" fill=\"#eeeeee\"/>\n",
+	       FLAME_WIDTH, (max_depth + 1) * FLAME_FRAME);
+
+	for (i = 0; i <= n; i++) {
+		int keep = 0, frames = 0;
+		const char *p;
+
+		if (i < n && i > 0)
+			keep = common_frames(stacks[i - 1].path,
+					     stacks[i].path);
+
+		/* Close frames not shared with the next stack. */
+		while (depth > keep) {
+			depth--;
+			flame_frame(names[depth], lens[depth], depth,
+				    start[depth], x, total, max_depth);
+		}
+		if (i == n)
+			break;
+
+		/* Open the remaining frames of this stack. */
+		for (p = stacks[i].path; *p && frames <= TRACE_MAX_DEPTH;
+		     frames++) {
+			size_t len = strcspn(p, ";");
+
+			if (frames >= depth) {
+				names[depth] = p;
+				lens[depth] = len;
+				start[depth] = x;
+				depth++;
+			}
+			p += len;
+			if (*p)
+				p++;
+		}
+		x += stacks[i].ticks;
+	}
+
+	printf("</svg>\n");
+}
+
+static void dump_trace(struct trace_buffer *trace, size_t size,
+		       const char **elf_files, int elf_count, int flame)
+{
+	struct folded_stack *stacks;
+	size_t n, i;
+
+	if (!trace_buffer_valid(trace, size))
+		return;
+
+	for (i = 0; i < elf_count; i++)
+		load_elf_symbols(elf_files[i], trace->program_base);
+
+	timestamp_set_tick_freq(trace->tick_freq_mhz);
+
+	stacks = fold_trace(trace, &n);
+	if (flame)
+		dump_flame_graph(stacks, n);
+	else
+		dump_folded_stacks(stacks, n);
+
+	for (i = 0; i < n; i++)
+		free(stacks[i].path);
+	free(stacks);
 }
 
 /* dump the cbmem console */
@@ -888,7 +1857,8 @@ static void print_version(void)
 
 static void print_usage(const char *name, int exit_code)
 {
-	printf("usage: %s [-cCltTxVvh?]\n", name);
+	printf("usage: %s [-cCltTjpFgxVvh?] [-f file]... [-b file]... "
+	       "[-e elf]... [-i file]\n", name);
 	printf("\n"
 	     "   -c | --console:                   print cbmem console\n"
 	     "   -C | --coverage:                  dump coverage information\n"
@@ -897,6 +1867,18 @@ static void print_usage(const char *name, int exit_code)
 	     "   -r | --rawdump ID:                print rawdump of specific ID (in hex) of cbtable\n"
 	     "   -t | --timestamps:                print timestamp information\n"
 	     "   -T | --parseable-timestamps:      print parseable timestamps\n"
+	     "   -j | --trace-events:              print timestamps as Chrome trace-event JSON\n"
+	     "   -p | --phases:                    print time spent in each boot phase\n"
+	     "   -f | --timestamp-file FILE:       read timestamps saved with -r 54494d45\n"
+	     "                                     instead of memory (may be repeated)\n"
+	     "   -b | --baseline FILE:             compare timestamps against saved baseline\n"
+	     "                                     runs (may be repeated), exit 2 on regression\n"
+	     "   -F | --trace-folded:              print function trace as folded stacks\n"
+	     "   -g | --flame-graph:               print function trace as flame graph SVG\n"
+	     "   -e | --elf FILE:                  symbolize function trace with a stage ELF\n"
+	     "                                     (may be repeated)\n"
+	     "   -i | --trace-file FILE:           read function trace saved with -r 54524345\n"
+	     "                                     instead of memory\n"
 	     "   -V | --verbose:                   verbose (debugging) output\n"
 	     "   -v | --version:                   print the version\n"
 	     "   -h | --help:                      print this help\n"
@@ -1019,6 +2001,82 @@ static char *dt_find_compat(const char *parent, const char *compat,
 }
 #endif /* __arm__ */
 
+/* Open /dev/mem and find the coreboot table. Returns 0 on success. */
+static int open_cbtable(void)
+{
+	mem_fd = open("/dev/mem", O_RDONLY, 0);
+	if (mem_fd < 0) {
+		fprintf(stderr, "Failed to gain memory access: %s\n",
+			strerror(errno));
+		return 1;
+	}
+
+#ifdef __arm__
+	int addr_cells, size_cells;
+	char *coreboot_node = dt_find_compat("/proc/device-tree", "coreboot",
+					     &addr_cells, &size_cells);
+
+	if (!coreboot_node) {
+		fprintf(stderr, "Could not find 'coreboot' compatible node!\n");
+		return 1;
+	}
+
+	if (addr_cells < 0) {
+		fprintf(stderr, "Warning: no #address-cells node in tree!\n");
+		addr_cells = 1;
+	}
+
+	int nlen = strlen(coreboot_node);
+	char *reg = alloca(nlen + sizeof("/reg"));
+
+	strcpy(reg, coreboot_node);
+	strcpy(reg + nlen, "/reg");
+	free(coreboot_node);
+
+	int fd = open(reg, O_RDONLY);
+	if (fd < 0) {
+		perror(reg);
+		return 1;
+	}
+
+	int i;
+	size_t size_to_read = addr_cells * 4 + size_cells * 4;
+	u8 *dtbuffer = alloca(size_to_read);
+	if (read(fd, dtbuffer, size_to_read) < 0) {
+		perror(reg);
+		return 1;
+	}
+	close(fd);
+
+	/* No variable-length byte swap function anywhere in C... how sad. */
+	u64 baseaddr = 0;
+	for (i = 0; i < addr_cells * 4; i++) {
+		baseaddr <<= 8;
+		baseaddr |= *dtbuffer;
+		dtbuffer++;
+	}
+	u64 cb_table_size = 0;
+	for (i = 0; i < size_cells * 4; i++) {
+		cb_table_size <<= 8;
+		cb_table_size |= *dtbuffer;
+		dtbuffer++;
+	}
+
+	parse_cbtable(baseaddr, cb_table_size, 1);
+#else
+	int j;
+	static const int possible_base_addresses[] = { 0, 0xf0000 };
+
+	/* Find and parse coreboot table */
+	for (j = 0; j < ARRAY_SIZE(possible_base_addresses); j++) {
+		if (parse_cbtable(possible_base_addresses[j], MAP_BYTES, 1))
+			break;
+	}
+#endif
+
+	return 0;
+}
+
 int main(int argc, char** argv)
 {
 	int print_defaults = 1;
@@ -1029,7 +2087,22 @@ int main(int argc, char** argv)
 	int print_rawdump = 0;
 	int print_timestamps = 0;
 	int machine_readable_timestamps = 0;
+	int print_trace_events = 0;
+	int print_phases = 0;
 	unsigned int rawdump_id = 0;
+	const char **timestamp_files = NULL;
+	int timestamp_file_count = 0;
+	const char **baseline_files = NULL;
+	int baseline_count = 0;
+	struct timestamp_table **tables = NULL;
+	int table_count = 0;
+	int print_trace = 0;
+	int flame_graph = 0;
+	const char **elf_files = NULL;
+	int elf_count = 0;
+	const char *trace_file = NULL;
+	int ret = 0;
+	int i;
 
 	int opt, option_index = 0;
 	static struct option long_options[] = {
@@ -1038,6 +2111,14 @@ int main(int argc, char** argv)
 		{"list", 0, 0, 'l'},
 		{"timestamps", 0, 0, 't'},
 		{"parseable-timestamps", 0, 0, 'T'},
+		{"trace-events", 0, 0, 'j'},
+		{"phases", 0, 0, 'p'},
+		{"timestamp-file", required_argument, 0, 'f'},
+		{"baseline", required_argument, 0, 'b'},
+		{"trace-folded", 0, 0, 'F'},
+		{"flame-graph", 0, 0, 'g'},
+		{"elf", required_argument, 0, 'e'},
+		{"trace-file", required_argument, 0, 'i'},
 		{"hexdump", 0, 0, 'x'},
 		{"rawdump", required_argument, 0, 'r'},
 		{"verbose", 0, 0, 'V'},
@@ -1045,7 +2126,7 @@ int main(int argc, char** argv)
 		{"help", 0, 0, 'h'},
 		{0, 0, 0, 0}
 	};
-	while ((opt = getopt_long(argc, argv, "cCltTxVvh?r:",
+	while ((opt = getopt_long(argc, argv, "cCltTjpFgxVvh?r:f:b:e:i:",
 				  long_options, &option_index)) != EOF) {
 		switch (opt) {
 		case 'c':
@@ -1078,6 +2159,54 @@ int main(int argc, char** argv)
 			machine_readable_timestamps = 1;
 			print_defaults = 0;
 			break;
+		case 'j':
+			print_trace_events = 1;
+			print_defaults = 0;
+			break;
+		case 'p':
+			print_phases = 1;
+			print_defaults = 0;
+			break;
+		case 'f':
+			timestamp_files = realloc(timestamp_files,
+				(timestamp_file_count + 1) * sizeof(char *));
+			if (!timestamp_files) {
+				fprintf(stderr, "Out of memory.\n");
+				return 1;
+			}
+			timestamp_files[timestamp_file_count++] = optarg;
+			break;
+		case 'b':
+			baseline_files = realloc(baseline_files,
+				(baseline_count + 1) * sizeof(char *));
+			if (!baseline_files) {
+				fprintf(stderr, "Out of memory.\n");
+				return 1;
+			}
+			baseline_files[baseline_count++] = optarg;
+			print_defaults = 0;
+			break;
+		case 'F':
+			print_trace = 1;
+			print_defaults = 0;
+			break;
+		case 'g':
+			print_trace = 1;
+			flame_graph = 1;
+			print_defaults = 0;
+			break;
+		case 'e':
+			elf_files = realloc(elf_files,
+				(elf_count + 1) * sizeof(char *));
+			if (!elf_files) {
+				fprintf(stderr, "Out of memory.\n");
+				return 1;
+			}
+			elf_files[elf_count++] = optarg;
+			break;
+		case 'i':
+			trace_file = optarg;
+			break;
 		case 'V':
 			verbose = 1;
 			break;
@@ -1095,76 +2224,14 @@ int main(int argc, char** argv)
 		}
 	}
 
-	mem_fd = open("/dev/mem", O_RDONLY, 0);
-	if (mem_fd < 0) {
-		fprintf(stderr, "Failed to gain memory access: %s\n",
-			strerror(errno));
-		return 1;
+	/* Saved timestamp tables do not need the coreboot table. */
+	if (print_console || print_coverage || print_list || print_hexdump ||
+	    print_rawdump || (print_trace && !trace_file) ||
+	    (!timestamp_file_count && !print_trace)) {
+		if (open_cbtable())
+			return 1;
 	}
 
-#ifdef __arm__
-	int addr_cells, size_cells;
-	char *coreboot_node = dt_find_compat("/proc/device-tree", "coreboot",
-					     &addr_cells, &size_cells);
-
-	if (!coreboot_node) {
-		fprintf(stderr, "Could not find 'coreboot' compatible node!\n");
-		return 1;
-	}
-
-	if (addr_cells < 0) {
-		fprintf(stderr, "Warning: no #address-cells node in tree!\n");
-		addr_cells = 1;
-	}
-
-	int nlen = strlen(coreboot_node);
-	char *reg = alloca(nlen + sizeof("/reg"));
-
-	strcpy(reg, coreboot_node);
-	strcpy(reg + nlen, "/reg");
-	free(coreboot_node);
-
-	int fd = open(reg, O_RDONLY);
-	if (fd < 0) {
-		perror(reg);
-		return 1;
-	}
-
-	int i;
-	size_t size_to_read = addr_cells * 4 + size_cells * 4;
-	u8 *dtbuffer = alloca(size_to_read);
-	if (read(fd, dtbuffer, size_to_read) < 0) {
-		perror(reg);
-		return 1;
-	}
-	close(fd);
-
-	/* No variable-length byte swap function anywhere in C... how sad. */
-	u64 baseaddr = 0;
-	for (i = 0; i < addr_cells * 4; i++) {
-		baseaddr <<= 8;
-		baseaddr |= *dtbuffer;
-		dtbuffer++;
-	}
-	u64 cb_table_size = 0;
-	for (i = 0; i < size_cells * 4; i++) {
-		cb_table_size <<= 8;
-		cb_table_size |= *dtbuffer;
-		dtbuffer++;
-	}
-
-	parse_cbtable(baseaddr, cb_table_size, 1);
-#else
-	int j;
-	static const int possible_base_addresses[] = { 0, 0xf0000 };
-
-	/* Find and parse coreboot table */
-	for (j = 0; j < ARRAY_SIZE(possible_base_addresses); j++) {
-		if (parse_cbtable(possible_base_addresses[j], MAP_BYTES, 1))
-			break;
-	}
-#endif
-
 	if (print_console)
 		dump_console();
 
@@ -1180,9 +2247,79 @@ int main(int argc, char** argv)
 	if (print_rawdump)
 		dump_cbmem_raw(rawdump_id);
 
-	if (print_defaults || print_timestamps)
-		dump_timestamps(machine_readable_timestamps);
+	if (print_trace) {
+		struct trace_buffer *trace;
+		size_t size;
 
-	close(mem_fd);
-	return 0;
+		if (trace_file)
+			trace = load_trace_buffer(trace_file, &size);
+		else
+			trace = read_trace_buffer(&size);
+		if (trace)
+			dump_trace(trace, size, elf_files, elf_count,
+				   flame_graph);
+		else
+			ret = 1;
+		free(trace);
+	}
+
+	if (print_defaults || print_timestamps || print_trace_events ||
+	    print_phases || baseline_count) {
+		if (timestamp_file_count) {
+			tables = calloc(timestamp_file_count, sizeof(*tables));
+			if (!tables) {
+				fprintf(stderr, "Out of memory.\n");
+				return 1;
+			}
+			for (i = 0; i < timestamp_file_count; i++)
+				tables[i] = load_timestamp_table(
+						timestamp_files[i]);
+			table_count = timestamp_file_count;
+		} else {
+			tables = calloc(1, sizeof(*tables));
+			if (tables && (tables[0] = read_timestamp_table()))
+				table_count = 1;
+		}
+	}
+
+	if (print_defaults || print_timestamps) {
+		for (i = 0; i < table_count; i++)
+			dump_timestamps(tables[i],
+					machine_readable_timestamps);
+	}
+
+	if (table_count && (print_trace_events || print_phases ||
+			    baseline_count)) {
+		struct timestamp_run *runs, *base_runs = NULL;
+
+		runs = calloc(table_count, sizeof(*runs));
+		if (baseline_count)
+			base_runs = calloc(baseline_count, sizeof(*base_runs));
+		if (!runs || (baseline_count && !base_runs)) {
+			fprintf(stderr, "Out of memory.\n");
+			return 1;
+		}
+		for (i = 0; i < table_count; i++)
+			convert_timestamp_table(tables[i], &runs[i]);
+		for (i = 0; i < baseline_count; i++) {
+			struct timestamp_table *base;
+
+			base = load_timestamp_table(baseline_files[i]);
+			convert_timestamp_table(base, &base_runs[i]);
+			free(base);
+		}
+
+		if (print_trace_events)
+			dump_trace_events(runs, table_count);
+		if (print_phases)
+			dump_phase_summary(runs, table_count);
+		if (baseline_count &&
+		    diff_timestamps(base_runs, baseline_count,
+				    runs, table_count))
+			ret = 2;
+	}
+
+	if (mem_fd > 0)
+		close(mem_fd);
+	return ret;
 }
@@ -22,6 +22,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include "ifdtool.h"
+#include "mapped_file.h"
 
 #ifndef O_BINARY
 #define O_BINARY 0
@@ -31,6 +32,8 @@ static int ifd_version;
 static int max_regions = 0;
 static int selected_chip = 0;
 static int platform = -1;
+/* Set when modifications go back into the input file instead of a .new one. */
+static struct mapped_file *inplace_file;
 
 static const struct region_name region_names[MAX_REGIONS] = {
 	{ "Flash Descriptor", "fd" },
@@ -689,11 +692,39 @@ static void write_regions(char *image, int size)
 	}
 }
 
+static void write_image_in_place(char *filename, char *image, int size)
+{
+	ssize_t written;
+
+	if ((size_t)size != mapped_file_size(inplace_file)) {
+		fprintf(stderr, "New image size differs, can't update %s in place\n",
+			filename);
+		exit(EXIT_FAILURE);
+	}
+
+	if (image == mapped_file_data(inplace_file)) {
+		if (mapped_file_mark_dirty(inplace_file, 0, size))
+			exit(EXIT_FAILURE);
+	} else if (mapped_file_update(inplace_file, 0, image, size)) {
+		exit(EXIT_FAILURE);
+	}
+
+	written = mapped_file_flush(inplace_file);
+	if (written < 0)
+		exit(EXIT_FAILURE);
+	printf("Updated %zd bytes of %s in place\n", written, filename);
+}
+
 static void write_image(char *filename, char *image, int size)
 {
 	char new_filename[FILENAME_MAX]; // allow long file names
 	int new_fd;
 
+	if (inplace_file) {
+		write_image_in_place(filename, image, size);
+		return;
+	}
+
 	// - 5: leave room for ".new\0"
 	strncpy(new_filename, filename, FILENAME_MAX - 5);
 	strncat(new_filename, ".new", FILENAME_MAX - strlen(filename));
@@ -1157,6 +1188,8 @@ static void print_usage(const char *name)
 	       "   -u | --unlock                      Unlock firmware descriptor and ME region\n"
 	       "   -p | --platform                    Add platform-specific quirks\n"
 	       "                                      aplk - Apollo Lake\n"
+	       "   -I | --inplace                     Modify <file> itself instead of writing <file>.new,\n"
+	       "                                      only changed blocks are written\n"
 	       "   -v | --version:                    print the version\n"
 	       "   -h | --help:                       print this help\n\n"
 	       "<region> is one of Descriptor, BIOS, ME, GbE, Platform\n"
@@ -1169,6 +1202,7 @@ int main(int argc, char *argv[])
 	int mode_dump = 0, mode_extract = 0, mode_inject = 0, mode_spifreq = 0;
 	int mode_em100 = 0, mode_locked = 0, mode_unlocked = 0;
 	int mode_layout = 0, mode_newlayout = 0, mode_density = 0;
+	int mode_inplace = 0;
 	char *region_type_string = NULL, *region_fname = NULL, *layout_fname = NULL;
 	int region_type = -1, inputfreq = 0;
 	unsigned int new_density = 0;
@@ -1189,10 +1223,11 @@ int main(int argc, char *argv[])
 		{"version", 0, NULL, 'v'},
 		{"help", 0, NULL, 'h'},
 		{"platform", 0, NULL, 'p'},
+		{"inplace", 0, NULL, 'I'},
 		{0, 0, 0, 0}
 	};
 
-	while ((opt = getopt_long(argc, argv, "df:D:C:xi:n:s:p:eluvh?",
+	while ((opt = getopt_long(argc, argv, "df:D:C:xi:n:s:p:eluIvh?",
 				  long_options, &option_index)) != EOF) {
 		switch (opt) {
 		case 'd':
@@ -1355,6 +1390,9 @@ int main(int argc, char *argv[])
 			print_version();
 			exit(EXIT_SUCCESS);
 			break;
+		case 'I':
+			mode_inplace = 1;
+			break;
 		case 'h':
 		case '?':
 		default:
@@ -1387,32 +1425,22 @@ int main(int argc, char *argv[])
 	}
 
 	char *filename = argv[optind];
-	int bios_fd = open(filename, O_RDONLY | O_BINARY);
-	if (bios_fd == -1) {
-		perror("Could not open file");
-		exit(EXIT_FAILURE);
-	}
-	struct stat buf;
-	if (fstat(bios_fd, &buf) == -1) {
-		perror("Could not stat file");
-		exit(EXIT_FAILURE);
-	}
-	int size = buf.st_size;
-
-	printf("File %s is %d bytes\n", filename, size);
-
-	char *image = malloc(size);
-	if (!image) {
-		printf("Out of memory.\n");
+	/*
+	 * The image is mapped copy-on-write: modes that change it work on
+	 * the mapping and write_image() decides where the result goes.
+	 */
+	struct mapped_file *bios_file = mapped_file_open(filename, mode_inplace);
+	if (!bios_file) {
+		fprintf(stderr, "Could not open file\n");
 		exit(EXIT_FAILURE);
 	}
+	if (mode_inplace)
+		inplace_file = bios_file;
 
-	if (read(bios_fd, image, size) != size) {
-		perror("Could not read file");
-		exit(EXIT_FAILURE);
-	}
+	int size = mapped_file_size(bios_file);
+	char *image = mapped_file_data(bios_file);
 
-	close(bios_fd);
+	printf("File %s is %d bytes\n", filename, size);
 
 	check_ifd_version(image, size);
 
@@ -1447,7 +1475,7 @@ int main(int argc, char *argv[])
 	if (mode_unlocked)
 		unlock_descriptor(filename, image, size);
 
-	free(image);
+	mapped_file_close(bios_file);
 
 	return 0;
 }
@@ -5,12 +5,16 @@
 #ifndef IP_CHECKSUM_H
 #define IP_CHECKSUM_H
 
-/* Note: The contents of this file were borrowed from the coreboot source
- *       code which may be obtained from http://www.coreboot.org.
- *       Specifically, this code was obtained from coreboot (LinuxBIOS)
- *       version 1.0.0.8.
+/* Note: The checksum is computed by the coreboot source code shared with
+ *       the firmware, see src/commonlib/checksum.c.
  */
 
-unsigned long compute_ip_checksum(void *addr, unsigned long length);
+#include <commonlib/checksum.h>
+
+static inline unsigned long compute_ip_checksum(void *addr,
+						unsigned long length)
+{
+	return ip_checksum(addr, length);
+}
 
 #endif				/* IP_CHECKSUM_H */
@@ -21,9 +21,12 @@
 #include <limits.h>
 #include <locale.h>
 #include <time.h>
+#include <setjmp.h>
+#include <pthread.h>
 
 #define MAX_CWD_SIZE 4096
 #define MAX_ALLOCATION_PASSES 100
+#define MAX_THREADS 64
 
 /* NOTE: Before you even start thinking to touch anything
  * in this code, set DEBUG_ROMCC_WARNINGS to 1 to get an
@@ -193,6 +196,250 @@ static char *xstrdup(const char *str)
 	return new;
 }
 
+/* Small object allocator.
+ *
+ * The intermediate representation is built out of a huge number of
+ * small objects (triples, use lists, blocks, hash entries) that the
+ * optimizer creates and destroys constantly.  Carve them out of large
+ * arena chunks and recycle them through per size free lists instead
+ * of calling malloc and free for each one.  Objects larger than
+ * POOL_MAX_SIZE fall back to malloc.
+ */
+#define POOL_ALIGN       8
+#define POOL_MAX_SIZE    2048
+#define POOL_CLASSES     (POOL_MAX_SIZE/POOL_ALIGN + 1)
+#define POOL_CHUNK_SIZE  (256*1024)
+
+struct pool_object {
+	struct pool_object *next;
+};
+
+struct pool_chunk {
+	struct pool_chunk *next;
+};
+
+struct pool_state {
+	struct pool_chunk *chunks;
+	char *cur, *end;
+	struct pool_object *free[POOL_CLASSES];
+	size_t arena_bytes;
+	size_t in_use;
+	size_t peak;
+};
+
+static struct pool_state pool;
+
+static size_t pool_size(size_t size)
+{
+	return (size + POOL_ALIGN - 1) & ~((size_t)POOL_ALIGN - 1);
+}
+
+static void pool_account(size_t size)
+{
+	pool.in_use += size;
+	if (pool.in_use > pool.peak) {
+		pool.peak = pool.in_use;
+	}
+}
+
+static void *pool_alloc(size_t size, const char *name)
+{
+	struct pool_object **head;
+	void *buf;
+	size = pool_size(size);
+	if (size > POOL_MAX_SIZE) {
+		pool_account(size);
+		return xcmalloc(size, name);
+	}
+	head = &pool.free[size/POOL_ALIGN];
+	if (*head) {
+		buf = *head;
+		*head = (*head)->next;
+	}
+	else {
+		if ((size_t)(pool.end - pool.cur) < size) {
+			struct pool_chunk *chunk;
+			chunk = xmalloc(POOL_CHUNK_SIZE, name);
+			chunk->next = pool.chunks;
+			pool.chunks = chunk;
+			pool.cur = (char *)chunk + pool_size(sizeof(*chunk));
+			pool.end = (char *)chunk + POOL_CHUNK_SIZE;
+			pool.arena_bytes += POOL_CHUNK_SIZE;
+		}
+		buf = pool.cur;
+		pool.cur += size;
+	}
+	pool_account(size);
+	memset(buf, 0, size);
+	return buf;
+}
+
+static void pool_free(const void *ptr, size_t size)
+{
+	struct pool_object *obj;
+	if (!ptr) {
+		return;
+	}
+	size = pool_size(size);
+	pool.in_use -= size;
+	if (size > POOL_MAX_SIZE) {
+		xfree(ptr);
+		return;
+	}
+	obj = (struct pool_object *)ptr;
+	obj->next = pool.free[size/POOL_ALIGN];
+	pool.free[size/POOL_ALIGN] = obj;
+}
+
+static void pool_release(void)
+{
+	struct pool_chunk *chunk;
+	while((chunk = pool.chunks)) {
+		pool.chunks = chunk->next;
+		xfree(chunk);
+	}
+	memset(&pool, 0, sizeof(pool));
+}
+
+/* Dense bit sets used by the register allocator */
+#define BITSET_WORD_BITS (sizeof(unsigned long)*CHAR_BIT)
+
+static size_t bitset_words(size_t bits)
+{
+	return (bits + BITSET_WORD_BITS - 1)/BITSET_WORD_BITS;
+}
+
+static unsigned long *alloc_bitset(size_t bits, const char *name)
+{
+	return xcmalloc(bitset_words(bits)*sizeof(unsigned long), name);
+}
+
+static int bitset_test(const unsigned long *set, size_t bit)
+{
+	return (set[bit/BITSET_WORD_BITS] >> (bit % BITSET_WORD_BITS)) & 1;
+}
+
+static void bitset_set(unsigned long *set, size_t bit)
+{
+	set[bit/BITSET_WORD_BITS] |= 1UL << (bit % BITSET_WORD_BITS);
+}
+
+static void bitset_clear(unsigned long *set, size_t bit)
+{
+	set[bit/BITSET_WORD_BITS] &= ~(1UL << (bit % BITSET_WORD_BITS));
+}
+
+/* Worker threads.
+ *
+ * A fixed set of threads that run the jobs of a batch in parallel
+ * with the calling thread, which helps out until the batch is done.
+ * Jobs must not allocate from the pool or touch anything but their
+ * own results; the IR may only be read while a batch is running.
+ */
+struct work_pool {
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t done;
+	void (*func)(void *arg, int job);
+	void *arg;
+	int jobs;
+	int next_job;
+	int jobs_left;
+	int shutdown;
+	int thread_count;
+	pthread_t *threads;
+};
+
+static struct work_pool work_pool;
+
+/* Called with work_pool.lock held */
+static void work_pool_run_jobs(void)
+{
+	while(work_pool.next_job < work_pool.jobs) {
+		int job;
+		job = work_pool.next_job++;
+		pthread_mutex_unlock(&work_pool.lock);
+		work_pool.func(work_pool.arg, job);
+		pthread_mutex_lock(&work_pool.lock);
+		if (--work_pool.jobs_left == 0) {
+			pthread_cond_signal(&work_pool.done);
+		}
+	}
+}
+
+static void *work_pool_thread(void *arg)
+{
+	pthread_mutex_lock(&work_pool.lock);
+	for(;;) {
+		while(!work_pool.shutdown &&
+			(work_pool.next_job >= work_pool.jobs)) {
+			pthread_cond_wait(&work_pool.start, &work_pool.lock);
+		}
+		if (work_pool.shutdown) {
+			break;
+		}
+		work_pool_run_jobs();
+	}
+	pthread_mutex_unlock(&work_pool.lock);
+	return 0;
+}
+
+static void work_pool_init(unsigned long threads)
+{
+	int i;
+	memset(&work_pool, 0, sizeof(work_pool));
+	pthread_mutex_init(&work_pool.lock, 0);
+	pthread_cond_init(&work_pool.start, 0);
+	pthread_cond_init(&work_pool.done, 0);
+	if (threads <= 1) {
+		return;
+	}
+	work_pool.threads = xcmalloc(sizeof(pthread_t)*(threads - 1),
+		"work_pool threads");
+	for(i = 0; i < threads - 1; i++) {
+		if (pthread_create(&work_pool.threads[i], 0,
+			work_pool_thread, 0) != 0) {
+			break;
+		}
+		work_pool.thread_count++;
+	}
+}
+
+static void work_pool_run(void (*func)(void *arg, int job), void *arg, int jobs)
+{
+	pthread_mutex_lock(&work_pool.lock);
+	work_pool.func      = func;
+	work_pool.arg       = arg;
+	work_pool.jobs      = jobs;
+	work_pool.next_job  = 0;
+	work_pool.jobs_left = jobs;
+	pthread_cond_broadcast(&work_pool.start);
+	work_pool_run_jobs();
+	while(work_pool.jobs_left > 0) {
+		pthread_cond_wait(&work_pool.done, &work_pool.lock);
+	}
+	work_pool.jobs = 0;
+	work_pool.next_job = 0;
+	pthread_mutex_unlock(&work_pool.lock);
+}
+
+static void work_pool_release(void)
+{
+	int i;
+	pthread_mutex_lock(&work_pool.lock);
+	work_pool.shutdown = 1;
+	pthread_cond_broadcast(&work_pool.start);
+	pthread_mutex_unlock(&work_pool.lock);
+	for(i = 0; i < work_pool.thread_count; i++) {
+		pthread_join(work_pool.threads[i], 0);
+	}
+	xfree(work_pool.threads);
+	pthread_cond_destroy(&work_pool.done);
+	pthread_cond_destroy(&work_pool.start);
+	pthread_mutex_destroy(&work_pool.lock);
+	memset(&work_pool, 0, sizeof(work_pool));
+}
+
 static void xchdir(const char *path)
 {
 	if (chdir(path) != 0) {
@@ -948,6 +1195,7 @@ struct triple {
 	unsigned int rhs  : 7;
 	unsigned int misc : 2;
 	unsigned int targ : 1;
+	unsigned int dirty : 1; /* Uses changed since the last verification */
 #define TRIPLE_SIZE(TRIPLE) \
 	((TRIPLE)->lhs + (TRIPLE)->rhs + (TRIPLE)->misc + (TRIPLE)->targ)
 #define TRIPLE_LHS_OFF(PTR)  (0)
@@ -1054,6 +1302,7 @@ struct compiler_state {
 	unsigned long flags;
 	unsigned long debug;
 	unsigned long max_allocation_passes;
+	unsigned long threads;
 
 	size_t include_path_count;
 	const char **include_paths;
@@ -1116,6 +1365,7 @@ struct compile_state {
 	struct triple *global_pool;
 	struct basic_blocks bb;
 	int functions_joined;
+	jmp_buf *verify_jmp;
 };
 
 /* visibility global/local */
@@ -1405,7 +1655,12 @@ static void print_dominance_frontiers(struct compile_state *state,
 #define COMPILER_SIMPLIFY_BITWISE          0x00002000
 #define COMPILER_SIMPLIFY_LOGICAL          0x00004000
 #define COMPILER_SIMPLIFY_BITFIELD         0x00008000
+#define COMPILER_VERIFY_MASK               0x00030000
+#define COMPILER_VERIFY_FULL               0x00000000
+#define COMPILER_VERIFY_OFF                0x00010000
+#define COMPILER_VERIFY_CHEAP              0x00020000
 
+#define COMPILER_TIME_REPORT               0x20000000
 #define COMPILER_TRIGRAPHS                 0x40000000
 #define COMPILER_PP_ONLY                   0x80000000
 
@@ -1413,6 +1668,7 @@ static void print_dominance_frontiers(struct compile_state *state,
 	COMPILER_TRIGRAPHS | \
 	COMPILER_ELIMINATE_INEFECTUAL_CODE | \
 	COMPILER_INLINE_DEFAULTON | \
+	COMPILER_VERIFY_FULL | \
 	COMPILER_SIMPLIFY_OP | \
 	COMPILER_SIMPLIFY_PHI | \
 	COMPILER_SIMPLIFY_LABEL | \
@@ -1440,6 +1696,7 @@ static void init_compiler_state(struct compiler_state *compiler)
 	compiler->flags = COMPILER_DEFAULT_FLAGS;
 	compiler->debug = 0;
 	compiler->max_allocation_passes = MAX_ALLOCATION_PASSES;
+	compiler->threads = 1;
 	compiler->include_path_count = 1;
 	compiler->include_paths      = xcmalloc(sizeof(char *), "include_paths");
 	compiler->define_count       = 1;
@@ -1606,6 +1863,7 @@ static const struct compiler_flag romcc_flags[] = {
 	{ "simplify-bitwise",          COMPILER_SIMPLIFY_BITWISE },
 	{ "simplify-logical",          COMPILER_SIMPLIFY_LOGICAL },
 	{ "simplify-bitfield",         COMPILER_SIMPLIFY_BITFIELD },
+	{ "time-report",               COMPILER_TIME_REPORT },
 	{ 0, 0 },
 };
 static const struct compiler_arg romcc_args[] = {
@@ -1619,6 +1877,14 @@ static const struct compiler_arg romcc_args[] = {
 			{ 0, 0 },
 		},
 	},
+	{ "verify",                    COMPILER_VERIFY_MASK,
+		{
+			{ "off",         COMPILER_VERIFY_OFF, },
+			{ "cheap",       COMPILER_VERIFY_CHEAP, },
+			{ "full",        COMPILER_VERIFY_FULL, },
+			{ 0, 0 },
+		},
+	},
 	{ 0, 0 },
 };
 static const struct compiler_flag romcc_opt_flags[] = {
@@ -1692,6 +1958,16 @@ static int compiler_encode_flag(
 			compiler->max_allocation_passes = max_passes;
 		}
 	}
+	else if (act && strncmp(flag, "threads=", 8) == 0) {
+		unsigned long threads;
+		char *end;
+		threads = strtoul(flag + 8, &end, 10);
+		if ((end[0] == '\0') && (threads > 0) &&
+			(threads <= MAX_THREADS)) {
+			result = 0;
+			compiler->threads = threads;
+		}
+	}
 	else if (act && strcmp(flag, "debug") == 0) {
 		result = 0;
 		compiler->debug |= DEBUG_DEFAULT;
@@ -1717,6 +1993,7 @@ static void compiler_usage(FILE *fp)
 	flag_usage(fp, romcc_debug_flags, "-fdebug-", "-fno-debug-");
 	fprintf(fp, "-flabel-prefix=<prefix for assembly language labels>\n");
 	fprintf(fp, "--label-prefix=<prefix for assembly language labels>\n");
+	fprintf(fp, "-fthreads=<number of verification threads>\n");
 	fprintf(fp, "-I<include path>\n");
 	fprintf(fp, "-D<macro>[=defn]\n");
 	fprintf(fp, "-U<macro>\n");
@@ -1786,6 +2063,9 @@ static void __attribute__ ((noreturn)) internal_error(struct compile_state *stat
 {
 	FILE *fp = state->errout;
 	va_list args;
+	if (state->verify_jmp) {
+		longjmp(*state->verify_jmp, 1);
+	}
 	va_start(args, fmt);
 	loc(fp, state, ptr);
 	fputc('\n', fp);
@@ -1806,6 +2086,9 @@ static void internal_warning(struct compile_state *state, struct triple *ptr,
 {
 	FILE *fp = state->errout;
 	va_list args;
+	if (state->verify_jmp) {
+		longjmp(*state->verify_jmp, 1);
+	}
 	va_start(args, fmt);
 	loc(fp, state, ptr);
 	if (ptr) {
@@ -1919,10 +2202,12 @@ static void use_triple(struct triple *used, struct triple *user)
 	 * copy_func and rename_block_variables
 	 * depends on this.
 	 */
-	new = xcmalloc(sizeof(*new), "triple_set");
+	new = pool_alloc(sizeof(*new), "triple_set");
 	new->member = user;
 	new->next   = used->use;
 	used->use   = new;
+	used->dirty = 1;
+	user->dirty = 1;
 }
 
 static void unuse_triple(struct triple *used, struct triple *unuser)
@@ -1936,7 +2221,11 @@ static void unuse_triple(struct triple *used, struct triple *unuser)
 		use = *ptr;
 		if (use->member == unuser) {
 			*ptr = use->next;
-			xfree(use);
+			pool_free(use, sizeof(*use));
+			used->dirty = 1;
+			if (unuser) {
+				unuser->dirty = 1;
+			}
 		}
 		else {
 			ptr = &use->next;
@@ -1952,7 +2241,7 @@ static void put_occurance(struct occurance *occurance)
 			if (occurance->parent) {
 				put_occurance(occurance->parent);
 			}
-			xfree(occurance);
+			pool_free(occurance, sizeof(*occurance));
 		}
 	}
 }
@@ -1999,7 +2288,7 @@ static struct occurance *new_occurance(struct compile_state *state)
 		state->last_occurance = 0;
 		put_occurance(last);
 	}
-	result = xmalloc(sizeof(*result), "occurance");
+	result = pool_alloc(sizeof(*result), "occurance");
 	result->count    = 2;
 	result->filename = filename;
 	result->function = function;
@@ -2043,7 +2332,7 @@ static struct occurance *inline_occurance(struct compile_state *state,
 	}
 	/* Generate a new occurance structure */
 	get_occurance(base);
-	result = xmalloc(sizeof(*result), "occurance");
+	result = pool_alloc(sizeof(*result), "occurance");
 	result->count    = 2;
 	result->filename = top->filename;
 	result->function = top->function;
@@ -2086,11 +2375,21 @@ static struct triple unknown_triple = {
 
 static size_t registers_of(struct compile_state *state, struct type *type);
 
+static size_t sizeof_triple(size_t params)
+{
+	size_t min_count, extra_count;
+	min_count = sizeof(((struct triple *)0)->param)/
+		sizeof(((struct triple *)0)->param[0]);
+	extra_count = (params < min_count)? 0 : params - min_count;
+	return sizeof(struct triple) +
+		sizeof(((struct triple *)0)->param[0]) * extra_count;
+}
+
 static struct triple *alloc_triple(struct compile_state *state,
 	int op, struct type *type, int lhs_wanted, int rhs_wanted,
 	struct occurance *occurance)
 {
-	size_t size, extra_count, min_count;
+	size_t size;
 	int lhs, rhs, misc, targ;
 	struct triple *ret, dummy;
 	dummy.op = op;
@@ -2132,12 +2431,8 @@ static struct triple *alloc_triple(struct compile_state *state,
 		internal_error(state, &dummy, "bad targs count %d", targ);
 	}
 
-	min_count = sizeof(ret->param)/sizeof(ret->param[0]);
-	extra_count = lhs + rhs + misc + targ;
-	extra_count = (extra_count < min_count)? 0 : extra_count - min_count;
-
-	size = sizeof(*ret) + sizeof(ret->param[0]) * extra_count;
-	ret = xcmalloc(size, "tripple");
+	size = sizeof_triple(lhs + rhs + misc + targ);
+	ret = pool_alloc(size, "tripple");
 	ret->op        = op;
 	ret->lhs       = lhs;
 	ret->rhs       = rhs;
@@ -2177,6 +2472,14 @@ struct triple *dup_triple(struct compile_state *state, struct triple *src)
 	return dup;
 }
 
+/* Release a scratch triple from dup_triple that was never
+ * linked into the instruction list.
+ */
+static void free_dup_triple(struct triple *dup)
+{
+	pool_free(dup, sizeof_triple(TRIPLE_SIZE(dup)));
+}
+
 static struct triple *copy_triple(struct compile_state *state, struct triple *src)
 {
 	struct triple *copy;
@@ -2973,8 +3276,7 @@ static int find_rhs_use(struct compile_state *state,
 static void free_triple(struct compile_state *state, struct triple *ptr)
 {
 	size_t size;
-	size = sizeof(*ptr) - sizeof(ptr->param) +
-		(sizeof(ptr->param[0])*TRIPLE_SIZE(ptr));
+	size = sizeof_triple(TRIPLE_SIZE(ptr));
 	ptr->prev->next = ptr->next;
 	ptr->next->prev = ptr->prev;
 	if (ptr->use) {
@@ -2982,7 +3284,7 @@ static void free_triple(struct compile_state *state, struct triple *ptr)
 	}
 	put_occurance(ptr->occurance);
 	memset(ptr, -1, size);
-	xfree(ptr);
+	pool_free(ptr, size);
 }
 
 static void release_triple(struct compile_state *state, struct triple *ptr)
@@ -3340,7 +3642,7 @@ static struct hash_entry *lookup(
 		new_name[name_len] = '\0';
 
 		/* Create a new hash entry */
-		entry = xcmalloc(sizeof(*entry), "hash_entry");
+		entry = pool_alloc(sizeof(*entry), "hash_entry");
 		entry->next = state->hash_table[index];
 		entry->name = new_name;
 		entry->name_len = name_len;
@@ -14000,7 +14302,7 @@ static void insert_triple_set(
 	struct triple_reg_set **head, struct triple *member)
 {
 	struct triple_reg_set *new;
-	new = xcmalloc(sizeof(*new), "triple_set");
+	new = pool_alloc(sizeof(*new), "triple_set");
 	new->member = member;
 	new->new    = 0;
 	new->next   = *head;
@@ -14881,6 +15183,11 @@ static void join_functions(struct compile_state *state)
  */
 
 
+/* Set whenever a block edge, user or dominator changes, so the
+ * incremental consistency checks know to recheck the blocks.
+ */
+static int cfg_dirty;
+
 static int do_use_block(
 	struct block *used, struct block_set **head, struct block *user,
 	int front)
@@ -14897,8 +15204,9 @@ static int do_use_block(
 		}
 		ptr = &(*ptr)->next;
 	}
-	new = xcmalloc(sizeof(*new), "block_set");
+	new = pool_alloc(sizeof(*new), "block_set");
 	new->member = user;
+	cfg_dirty = 1;
 	if (front) {
 		new->next = *head;
 		*head = new;
@@ -14921,8 +15229,9 @@ static int do_unuse_block(
 		if (use->member == unuser) {
 			*ptr = use->next;
 			memset(use, -1, sizeof(*use));
-			xfree(use);
+			pool_free(use, sizeof(*use));
 			count += 1;
+			cfg_dirty = 1;
 		}
 		else {
 			ptr = &use->next;
@@ -15196,7 +15505,7 @@ static struct block *basic_block(struct compile_state *state,
 	}
 	/* Allocate another basic block structure */
 	bb->last_vertex += 1;
-	block = xcmalloc(sizeof(*block), "block");
+	block = pool_alloc(sizeof(*block), "block");
 	block->first = block->last = first;
 	block->vertex = bb->last_vertex;
 	ptr = first;
@@ -16272,7 +16581,7 @@ static void push_triple(struct stack *stacks, struct triple *var, struct triple
 	/* Append new to the head of the list,
 	 * it's the only sensible behavoir for a stack.
 	 */
-	new = xcmalloc(sizeof(*new), "triple_set");
+	new = pool_alloc(sizeof(*new), "triple_set");
 	new->member = val;
 	new->next   = stacks[var->id].top;
 	stacks[var->id].top = new;
@@ -16286,7 +16595,7 @@ static void pop_triple(struct stack *stacks, struct triple *var, struct triple *
 		set = *ptr;
 		if (set->member == oldval) {
 			*ptr = set->next;
-			xfree(set);
+			pool_free(set, sizeof(*set));
 			/* Only free one occurance from the stack */
 			return;
 		}
@@ -17333,10 +17642,21 @@ struct triple_reg_set;
 struct reg_block;
 
 
+static void push_triple_set(struct triple_reg_set **head,
+	struct triple *member, struct triple *new_member)
+{
+	struct triple_reg_set *new;
+	new = pool_alloc(sizeof(*new), "triple_set");
+	new->member = member;
+	new->new    = new_member;
+	new->next   = *head;
+	*head       = new;
+}
+
 static int do_triple_set(struct triple_reg_set **head,
 	struct triple *member, struct triple *new_member)
 {
-	struct triple_reg_set **ptr, *new;
+	struct triple_reg_set **ptr;
 	if (!member)
 		return 0;
 	ptr = head;
@@ -17346,11 +17666,7 @@ static int do_triple_set(struct triple_reg_set **head,
 		}
 		ptr = &(*ptr)->next;
 	}
-	new = xcmalloc(sizeof(*new), "triple_set");
-	new->member = member;
-	new->new    = new_member;
-	new->next   = *head;
-	*head       = new;
+	push_triple_set(head, member, new_member);
 	return 1;
 }
 
@@ -17362,7 +17678,7 @@ static void do_triple_unset(struct triple_reg_set **head, struct triple *member)
 		entry = *ptr;
 		if (entry->member == member) {
 			*ptr = entry->next;
-			xfree(entry);
+			pool_free(entry, sizeof(*entry));
 			return;
 		}
 		else {
@@ -17371,9 +17687,88 @@ static void do_triple_unset(struct triple_reg_set **head, struct triple *member)
 	}
 }
 
-static int in_triple(struct reg_block *rb, struct triple *in)
+/* Scratch state of compute_variable_lifetimes.
+ *
+ * The in and out sets of each block are kept as lists because their
+ * order determines the order in which the interference graph is built,
+ * and with it the final register assignment.  Membership is tracked
+ * in parallel in bit sets indexed by a dense numbering of the
+ * instructions, so the dataflow never has to search the lists.
+ */
+struct lifetime_state {
+	struct triple **index;
+	unsigned *index_id;
+	size_t index_mask;
+	size_t count;
+	size_t words;
+	unsigned long *in;
+	unsigned long *out;
+	unsigned long *defs;
+	unsigned *first_def;
+	int *pred_first;
+	int *preds;
+	char *dirty;
+	char *visited;
+};
+
+static size_t lifetime_hash(struct lifetime_state *ls, struct triple *ins)
+{
+	unsigned long val;
+	val = ((unsigned long)ins)/sizeof(void *);
+	return (val * 2654435761UL) & ls->index_mask;
+}
+
+static long lifetime_index(struct lifetime_state *ls, struct triple *ins)
+{
+	size_t hash;
+	hash = lifetime_hash(ls, ins);
+	while(ls->index[hash]) {
+		if (ls->index[hash] == ins) {
+			return ls->index_id[hash];
+		}
+		hash = (hash + 1) & ls->index_mask;
+	}
+	return -1;
+}
+
+static void lifetime_add_index(struct lifetime_state *ls, struct triple *ins)
+{
+	size_t hash;
+	hash = lifetime_hash(ls, ins);
+	while(ls->index[hash]) {
+		if (ls->index[hash] == ins) {
+			return;
+		}
+		hash = (hash + 1) & ls->index_mask;
+	}
+	ls->index[hash] = ins;
+	ls->index_id[hash] = ls->count++;
+}
+
+static int lifetime_set(struct lifetime_state *ls, unsigned long *sets,
+	struct triple_reg_set **head, int vertex, struct triple *member)
+{
+	unsigned long *set;
+	long id;
+	if (!member)
+		return 0;
+	id = lifetime_index(ls, member);
+	if (id < 0) {
+		return do_triple_set(head, member, 0);
+	}
+	set = sets + vertex*ls->words;
+	if (bitset_test(set, id)) {
+		return 0;
+	}
+	bitset_set(set, id);
+	push_triple_set(head, member, 0);
+	return 1;
+}
+
+static int in_triple(struct lifetime_state *ls,
+	struct reg_block *rb, struct triple *in)
 {
-	return do_triple_set(&rb->in, in, 0);
+	return lifetime_set(ls, ls->in, &rb->in, rb->vertex, in);
 }
 
 #if DEBUG_ROMCC_WARNING
@@ -17383,9 +17778,10 @@ static void unin_triple(struct reg_block *rb, struct triple *unin)
 }
 #endif
 
-static int out_triple(struct reg_block *rb, struct triple *out)
+static int out_triple(struct lifetime_state *ls,
+	struct reg_block *rb, struct triple *out)
 {
-	return do_triple_set(&rb->out, out, 0);
+	return lifetime_set(ls, ls->out, &rb->out, rb->vertex, out);
 }
 #if DEBUG_ROMCC_WARNING
 static void unout_triple(struct reg_block *rb, struct triple *unout)
@@ -17463,8 +17859,27 @@ static int this_def(struct compile_state *state,
 	return ins == other;
 }
 
-static int phi_in(struct compile_state *state, struct reg_block *blocks,
-	struct reg_block *rb, struct block *suc)
+static int block_defines(struct compile_state *state,
+	struct lifetime_state *ls, struct reg_block *rb, struct triple *var)
+{
+	struct triple *ptr;
+	long id;
+	int done;
+	id = lifetime_index(ls, var);
+	if (id >= 0) {
+		return bitset_test(ls->defs + rb->vertex*ls->words, id);
+	}
+	for(done = 0, ptr = rb->block->first; !done; ptr = ptr->next) {
+		if (this_def(state, ptr, var)) {
+			return 1;
+		}
+		done = (ptr == rb->block->last);
+	}
+	return 0;
+}
+
+static int phi_in(struct compile_state *state, struct lifetime_state *ls,
+	struct reg_block *blocks, struct reg_block *rb, struct block *suc)
 {
 	/* Read the conditional input set of a successor block
 	 * (i.e. the input to the phi nodes) and place it in the
@@ -17485,38 +17900,31 @@ static int phi_in(struct compile_state *state, struct reg_block *blocks,
 		internal_error(state, 0, "Not coming on a control edge?");
 	}
 	for(done = 0, ptr = suc->first; !done; ptr = ptr->next) {
-		struct triple **slot, *expr, *ptr2;
-		int out_change, done2;
+		struct triple **slot, *expr;
+		int out_change;
 		done = (ptr == suc->last);
 		if (ptr->op != OP_PHI) {
 			continue;
 		}
 		slot = &RHS(ptr, 0);
 		expr = slot[edge];
-		out_change = out_triple(rb, expr);
+		out_change = out_triple(ls, rb, expr);
 		if (!out_change) {
 			continue;
 		}
 		/* If we don't define the variable also plast it
 		 * in the current blocks input set.
 		 */
-		ptr2 = rb->block->first;
-		for(done2 = 0; !done2; ptr2 = ptr2->next) {
-			if (this_def(state, ptr2, expr)) {
-				break;
-			}
-			done2 = (ptr2 == rb->block->last);
-		}
-		if (!done2) {
+		if (block_defines(state, ls, rb, expr)) {
 			continue;
 		}
-		change |= in_triple(rb, expr);
+		change |= in_triple(ls, rb, expr);
 	}
 	return change;
 }
 
-static int reg_in(struct compile_state *state, struct reg_block *blocks,
-	struct reg_block *rb, struct block *suc)
+static int reg_in(struct compile_state *state, struct lifetime_state *ls,
+	struct reg_block *blocks, struct reg_block *rb, struct block *suc)
 {
 	struct triple_reg_set *in_set;
 	int change;
@@ -17526,50 +17934,75 @@ static int reg_in(struct compile_state *state, struct reg_block *blocks,
 	 */
 	in_set = blocks[suc->vertex].in;
 	for(; in_set; in_set = in_set->next) {
-		int out_change, done;
-		struct triple *first, *last, *ptr;
-		out_change = out_triple(rb, in_set->member);
+		int out_change;
+		out_change = out_triple(ls, rb, in_set->member);
 		if (!out_change) {
 			continue;
 		}
 		/* If we don't define the variable also place it
 		 * in the current blocks input set.
 		 */
-		first = rb->block->first;
-		last = rb->block->last;
-		done = 0;
-		for(ptr = first; !done; ptr = ptr->next) {
-			if (this_def(state, ptr, in_set->member)) {
-				break;
-			}
-			done = (ptr == last);
-		}
-		if (!done) {
+		if (block_defines(state, ls, rb, in_set->member)) {
 			continue;
 		}
-		change |= in_triple(rb, in_set->member);
+		change |= in_triple(ls, rb, in_set->member);
 	}
-	change |= phi_in(state, blocks, rb, suc);
+	change |= phi_in(state, ls, blocks, rb, suc);
 	return change;
 }
 
-static int use_in(struct compile_state *state, struct reg_block *rb)
+static void note_first_def(struct lifetime_state *ls,
+	struct triple *ins, unsigned pos)
+{
+	long id;
+	if (!ins) {
+		return;
+	}
+	id = lifetime_index(ls, ins);
+	if ((id >= 0) && (ls->first_def[id] > pos)) {
+		ls->first_def[id] = pos;
+	}
+}
+
+static void clear_first_def(struct lifetime_state *ls, struct triple *ins)
+{
+	long id;
+	if (!ins) {
+		return;
+	}
+	id = lifetime_index(ls, ins);
+	if (id >= 0) {
+		ls->first_def[id] = UINT_MAX;
+	}
+}
+
+static int use_in(struct compile_state *state, struct lifetime_state *ls,
+	struct reg_block *rb)
 {
 	/* Find the variables we use but don't define and add
 	 * it to the current blocks input set.
 	 */
-#if DEBUG_ROMCC_WARNINGS
-#warning "FIXME is this O(N^2) algorithm bad?"
-#endif
 	struct block *block;
 	struct triple *ptr;
+	unsigned pos;
 	int done;
 	int change;
 	block = rb->block;
 	change = 0;
+	/* Remember where each variable is first defined in the block.
+	 * A write counts as a definition.
+	 */
+	for(pos = 0, done = 0, ptr = block->first; !done; ptr = ptr->next, pos++) {
+		done = (ptr == block->last);
+		note_first_def(ls, ptr, pos);
+		if (ptr->op == OP_WRITE) {
+			note_first_def(ls, part_to_piece(state, MISC(ptr, 0)), pos);
+		}
+	}
 	for(done = 0, ptr = block->last; !done; ptr = ptr->prev) {
 		struct triple **expr;
 		done = (ptr == block->first);
+		pos--;
 		/* The variable a phi function uses depends on the
 		 * control flow, and is handled in phi_in, not
 		 * here.
@@ -17580,16 +18013,21 @@ static int use_in(struct compile_state *state, struct reg_block *rb)
 		expr = triple_rhs(state, ptr, 0);
 		for(;expr; expr = triple_rhs(state, ptr, expr)) {
 			struct triple *rhs, *test;
+			long id;
 			int tdone;
 			rhs = part_to_piece(state, *expr);
 			if (!rhs) {
 				continue;
 			}
 
-			/* See if rhs is defined in this block.
-			 * A write counts as a definition.
-			 */
-			for(tdone = 0, test = ptr; !tdone; test = test->prev) {
+			/* See if rhs is defined in this block. */
+			id = lifetime_index(ls, rhs);
+			if (id >= 0) {
+				if (ls->first_def[id] <= pos) {
+					rhs = 0;
+				}
+			}
+			else for(tdone = 0, test = ptr; !tdone; test = test->prev) {
 				tdone = (test == block->first);
 				if (this_def(state, test, rhs)) {
 					rhs = 0;
@@ -17597,35 +18035,169 @@ static int use_in(struct compile_state *state, struct reg_block *rb)
 				}
 			}
 			/* If I still have a valid rhs add it to in */
-			change |= in_triple(rb, rhs);
+			change |= in_triple(ls, rb, rhs);
+		}
+	}
+	for(done = 0, ptr = block->first; !done; ptr = ptr->next) {
+		done = (ptr == block->last);
+		clear_first_def(ls, ptr);
+		if (ptr->op == OP_WRITE) {
+			clear_first_def(ls, part_to_piece(state, MISC(ptr, 0)));
 		}
 	}
 	return change;
 }
 
+static void init_lifetime_state(struct compile_state *state,
+	struct basic_blocks *bb, struct reg_block *blocks,
+	struct lifetime_state *ls)
+{
+	size_t size, sets;
+	int i, count;
+
+	memset(ls, 0, sizeof(*ls));
+	/* Number the instructions of every block */
+	count = 0;
+	for(i = 1; i <= bb->last_vertex; i++) {
+		struct triple *ptr;
+		int done;
+		for(done = 0, ptr = blocks[i].block->first; !done; ptr = ptr->next) {
+			done = (ptr == blocks[i].block->last);
+			count++;
+		}
+	}
+	for(size = 16; size < (size_t)count*2; size <<= 1)
+		;
+	ls->index_mask = size - 1;
+	ls->index    = xcmalloc(sizeof(ls->index[0])*size, "lifetime index");
+	ls->index_id = xcmalloc(sizeof(ls->index_id[0])*size, "lifetime index");
+	for(i = 1; i <= bb->last_vertex; i++) {
+		struct triple *ptr;
+		int done;
+		for(done = 0, ptr = blocks[i].block->first; !done; ptr = ptr->next) {
+			done = (ptr == blocks[i].block->last);
+			lifetime_add_index(ls, ptr);
+		}
+	}
+
+	/* Allocate the per block bit sets */
+	ls->words = bitset_words(ls->count);
+	sets = (bb->last_vertex + 1)*ls->words;
+	ls->in   = xcmalloc(sizeof(unsigned long)*sets, "live in");
+	ls->out  = xcmalloc(sizeof(unsigned long)*sets, "live out");
+	ls->defs = xcmalloc(sizeof(unsigned long)*sets, "block defs");
+	ls->first_def = xmalloc(sizeof(ls->first_def[0])*(ls->count + 1),
+		"first def");
+	memset(ls->first_def, 0xff, sizeof(ls->first_def[0])*(ls->count + 1));
+
+	/* Record what each block defines.  A write counts as a definition. */
+	for(i = 1; i <= bb->last_vertex; i++) {
+		struct triple *ptr;
+		unsigned long *defs;
+		int done;
+		defs = ls->defs + i*ls->words;
+		for(done = 0, ptr = blocks[i].block->first; !done; ptr = ptr->next) {
+			long id;
+			done = (ptr == blocks[i].block->last);
+			bitset_set(defs, lifetime_index(ls, ptr));
+			if (ptr->op != OP_WRITE) {
+				continue;
+			}
+			id = lifetime_index(ls, part_to_piece(state, MISC(ptr, 0)));
+			if (id >= 0) {
+				bitset_set(defs, id);
+			}
+		}
+	}
+
+	/* Find the predecessors of each block */
+	ls->pred_first = xcmalloc(sizeof(int)*(bb->last_vertex + 2), "preds");
+	for(i = 1; i <= bb->last_vertex; i++) {
+		struct block_set *edge;
+		for(edge = blocks[i].block->edges; edge; edge = edge->next) {
+			ls->pred_first[edge->member->vertex + 1] += 1;
+		}
+	}
+	for(i = 1; i <= bb->last_vertex + 1; i++) {
+		ls->pred_first[i] += ls->pred_first[i - 1];
+	}
+	ls->preds = xcmalloc(sizeof(int)*(ls->pred_first[bb->last_vertex + 1] + 1),
+		"preds");
+	ls->dirty = xcmalloc(bb->last_vertex + 1, "dirty");
+	for(i = 1; i <= bb->last_vertex; i++) {
+		struct block_set *edge;
+		for(edge = blocks[i].block->edges; edge; edge = edge->next) {
+			int vertex = edge->member->vertex;
+			ls->preds[ls->pred_first[vertex] + ls->dirty[vertex]++] = i;
+		}
+	}
+	memset(ls->dirty, 1, bb->last_vertex + 1);
+	ls->visited = xcmalloc(bb->last_vertex + 1, "visited");
+}
+
+static void free_lifetime_state(struct lifetime_state *ls)
+{
+	xfree(ls->index);
+	xfree(ls->index_id);
+	xfree(ls->in);
+	xfree(ls->out);
+	xfree(ls->defs);
+	xfree(ls->first_def);
+	xfree(ls->pred_first);
+	xfree(ls->preds);
+	xfree(ls->dirty);
+	xfree(ls->visited);
+	memset(ls, 0, sizeof(*ls));
+}
+
 static struct reg_block *compute_variable_lifetimes(
 	struct compile_state *state, struct basic_blocks *bb)
 {
+	struct lifetime_state ls;
 	struct reg_block *blocks;
 	int change;
 	blocks = xcmalloc(
 		sizeof(*blocks)*(bb->last_vertex + 1), "reg_block");
 	initialize_regblock(blocks, bb->last_block, 0);
+	init_lifetime_state(state, bb, blocks, &ls);
+	/* Iterate to a fixed point.  A block only needs to be visited
+	 * again when the input set of one of its successors has grown
+	 * since its last visit.  The blocks are still visited in vertex
+	 * order, so the sets are built up in exactly the order a full
+	 * sweep over every block would produce.
+	 */
 	do {
 		int i;
 		change = 0;
 		for(i = 1; i <= bb->last_vertex; i++) {
 			struct block_set *edge;
 			struct reg_block *rb;
+			int in_change, j;
+			if (!ls.dirty[i]) {
+				continue;
+			}
+			ls.dirty[i] = 0;
 			rb = &blocks[i];
+			in_change = 0;
 			/* Add the all successor's input set to in */
 			for(edge = rb->block->edges; edge; edge = edge->next) {
-				change |= reg_in(state, blocks, rb, edge->member);
+				in_change |= reg_in(state, &ls, blocks, rb, edge->member);
+			}
+			/* Add use to in, the uses of a block never change */
+			if (!ls.visited[i]) {
+				ls.visited[i] = 1;
+				in_change |= use_in(state, &ls, rb);
+			}
+			if (!in_change) {
+				continue;
+			}
+			change = 1;
+			for(j = ls.pred_first[i]; j < ls.pred_first[i + 1]; j++) {
+				ls.dirty[ls.preds[j]] = 1;
 			}
-			/* Add use to in... */
-			change |= use_in(state, rb);
 		}
 	} while(change);
+	free_lifetime_state(&ls);
 	return blocks;
 }
 
@@ -18196,16 +18768,8 @@ struct live_range_def {
 	unsigned orig_id;
 };
 
-#define LRE_HASH_SIZE 2048
-struct lre_hash {
-	struct lre_hash *next;
-	struct live_range *left;
-	struct live_range *right;
-};
-
-
 struct reg_state {
-	struct lre_hash *hash[LRE_HASH_SIZE];
+	unsigned long *interference;
 	struct reg_block *blocks;
 	struct live_range_def *lrd;
 	struct live_range *lr;
@@ -18414,66 +18978,42 @@ static void reg_inc_used(struct compile_state *state, char *used, int reg)
 	return;
 }
 
-static unsigned int hash_live_edge(
+static size_t interference_bits(struct reg_state *rstate)
+{
+	return ((size_t)rstate->ranges + 1)*rstate->ranges/2 + 1;
+}
+
+static size_t live_edge_bit(struct reg_state *rstate,
 	struct live_range *left, struct live_range *right)
 {
-	unsigned int hash, val;
-	unsigned long lval, rval;
-	lval = ((unsigned long)left)/sizeof(struct live_range);
-	rval = ((unsigned long)right)/sizeof(struct live_range);
-	hash = 0;
-	while(lval) {
-		val = lval & 0xff;
-		lval >>= 8;
-		hash = (hash *263) + val;
+	size_t lval, rval;
+	lval = left - rstate->lr;
+	rval = right - rstate->lr;
+	/* Ensure left < right */
+	if (lval > rval) {
+		size_t tmp;
+		tmp = lval;
+		lval = rval;
+		rval = tmp;
 	}
-	while(rval) {
-		val = rval & 0xff;
-		rval >>= 8;
-		hash = (hash *263) + val;
-	}
-	hash = hash & (LRE_HASH_SIZE - 1);
-	return hash;
-}
-
-static struct lre_hash **lre_probe(struct reg_state *rstate,
-	struct live_range *left, struct live_range *right)
-{
-	struct lre_hash **ptr;
-	unsigned int index;
-	/* Ensure left <= right */
-	if (left > right) {
-		struct live_range *tmp;
-		tmp = left;
-		left = right;
-		right = tmp;
-	}
-	index = hash_live_edge(left, right);
-
-	ptr = &rstate->hash[index];
-	while(*ptr) {
-		if (((*ptr)->left == left) && ((*ptr)->right == right)) {
-			break;
-		}
-		ptr = &(*ptr)->next;
-	}
-	return ptr;
+	return (rval*(rval - 1))/2 + lval;
 }
 
 static int interfere(struct reg_state *rstate,
 	struct live_range *left, struct live_range *right)
 {
-	struct lre_hash **ptr;
-	ptr = lre_probe(rstate, left, right);
-	return ptr && *ptr;
+	if (left == right) {
+		return 0;
+	}
+	return bitset_test(rstate->interference,
+		live_edge_bit(rstate, left, right));
 }
 
 static void add_live_edge(struct reg_state *rstate,
 	struct live_range *left, struct live_range *right)
 {
-	/* FIXME the memory allocation overhead is noticeable here... */
-	struct lre_hash **ptr, *new_hash;
 	struct live_range_edge *edge;
+	size_t bit;
 
 	if (left == right) {
 		return;
@@ -18488,27 +19028,23 @@ static void add_live_edge(struct reg_state *rstate,
 		left = right;
 		right = tmp;
 	}
-	ptr = lre_probe(rstate, left, right);
-	if (*ptr) {
+	bit = live_edge_bit(rstate, left, right);
+	if (bitset_test(rstate->interference, bit)) {
 		return;
 	}
 #if 0
 	fprintf(state->errout, "new_live_edge(%p, %p)\n",
 		left, right);
 #endif
-	new_hash = xmalloc(sizeof(*new_hash), "lre_hash");
-	new_hash->next  = *ptr;
-	new_hash->left  = left;
-	new_hash->right = right;
-	*ptr = new_hash;
+	bitset_set(rstate->interference, bit);
 
-	edge = xmalloc(sizeof(*edge), "live_range_edge");
+	edge = pool_alloc(sizeof(*edge), "live_range_edge");
 	edge->next   = left->edges;
 	edge->node   = right;
 	left->edges  = edge;
 	left->degree += 1;
 
-	edge = xmalloc(sizeof(*edge), "live_range_edge");
+	edge = pool_alloc(sizeof(*edge), "live_range_edge");
 	edge->next    = right->edges;
 	edge->node    = left;
 	right->edges  = edge;
@@ -18519,21 +19055,17 @@ static void remove_live_edge(struct reg_state *rstate,
 	struct live_range *left, struct live_range *right)
 {
 	struct live_range_edge *edge, **ptr;
-	struct lre_hash **hptr, *entry;
-	hptr = lre_probe(rstate, left, right);
-	if (!hptr || !*hptr) {
+	if (!interfere(rstate, left, right)) {
 		return;
 	}
-	entry = *hptr;
-	*hptr = entry->next;
-	xfree(entry);
+	bitset_clear(rstate->interference, live_edge_bit(rstate, left, right));
 
 	for(ptr = &left->edges; *ptr; ptr = &(*ptr)->next) {
 		edge = *ptr;
 		if (edge->node == right) {
 			*ptr = edge->next;
 			memset(edge, 0, sizeof(*edge));
-			xfree(edge);
+			pool_free(edge, sizeof(*edge));
 			right->degree--;
 			break;
 		}
@@ -18543,22 +19075,13 @@ static void remove_live_edge(struct reg_state *rstate,
 		if (edge->node == left) {
 			*ptr = edge->next;
 			memset(edge, 0, sizeof(*edge));
-			xfree(edge);
+			pool_free(edge, sizeof(*edge));
 			left->degree--;
 			break;
 		}
 	}
 }
 
-static void remove_live_edges(struct reg_state *rstate, struct live_range *range)
-{
-	struct live_range_edge *edge, *next;
-	for(edge = range->edges; edge; edge = next) {
-		next = edge->next;
-		remove_live_edge(rstate, range, edge->node);
-	}
-}
-
 static void transfer_live_edges(struct reg_state *rstate,
 	struct live_range *dest, struct live_range *src)
 {
@@ -18582,8 +19105,8 @@ static void transfer_live_edges(struct reg_state *rstate,
  * degree(g, x) --- Return the degree of the node x in the graph g
  * neighbors(g, x, f) --- Apply function f to each neighbor of node x in the graph g
  *
- * Implement with a hash table && a set of adjcency vectors.
- * The hash table supports constant time implementations of add and interfere.
+ * Implement with a triangular bit matrix && a set of adjcency vectors.
+ * The bit matrix supports constant time implementations of add and interfere.
  * The adjacency vectors support an efficient implementation of neighbors.
  */
 
@@ -18849,6 +19372,10 @@ static void initialize_live_ranges(
 	} while(ins != first);
 	rstate->ranges = i;
 
+	/* Allocate the interference graph */
+	rstate->interference = alloc_bitset(
+		interference_bits(rstate), "interference graph");
+
 	/* Make a second pass to handle achitecture specific register
 	 * constraints.
 	 */
@@ -20037,15 +20564,29 @@ static void ids_from_rstate(struct compile_state *state,
 static void cleanup_live_edges(struct reg_state *rstate)
 {
 	int i;
+	if (!rstate->interference) {
+		return;
+	}
 	/* Free the edges on each node */
 	for(i = 1; i <= rstate->ranges; i++) {
-		remove_live_edges(rstate, &rstate->lr[i]);
+		struct live_range *range;
+		struct live_range_edge *edge, *next;
+		range = &rstate->lr[i];
+		for(edge = range->edges; edge; edge = next) {
+			next = edge->next;
+			range->degree--;
+			pool_free(edge, sizeof(*edge));
+		}
+		range->edges = 0;
 	}
+	memset(rstate->interference, 0,
+		bitset_words(interference_bits(rstate))*sizeof(unsigned long));
 }
 
 static void cleanup_rstate(struct compile_state *state, struct reg_state *rstate)
 {
 	cleanup_live_edges(rstate);
+	xfree(rstate->interference);
 	xfree(rstate->lrd);
 	xfree(rstate->lr);
 
@@ -20055,6 +20596,7 @@ static void cleanup_rstate(struct compile_state *state, struct reg_state *rstate
 	}
 	rstate->defs = 0;
 	rstate->ranges = 0;
+	rstate->interference = 0;
 	rstate->lrd = 0;
 	rstate->lr = 0;
 	rstate->blocks = 0;
@@ -20614,7 +21156,7 @@ static struct triple *preserve_lval(
 	if (lnode->val) {
 		old = dup_triple(state, lnode->val);
 		if (lnode->val != lnode->def) {
-			xfree(lnode->val);
+			free_dup_triple(lnode->val);
 		}
 		lnode->val = 0;
 	} else {
@@ -20640,7 +21182,7 @@ static int lval_changed(struct compile_state *state,
 		changed = 0;
 	}
 	if (old) {
-		xfree(old);
+		free_dup_triple(old);
 	}
 	return changed;
 
@@ -20791,7 +21333,7 @@ static int compute_lnode_val(struct compile_state *state, struct scc_state *scc,
 
 	/* See if we need to free the scratch value */
 	if (lnode->val != scratch) {
-		xfree(scratch);
+		free_dup_triple(scratch);
 	}
 
 	return changed;
@@ -21025,7 +21567,7 @@ static void scc_writeback_values(
 				internal_error(state, 0, "constants not equal");
 			}
 			/* Free the lattice nodes */
-			xfree(lnode->val);
+			free_dup_triple(lnode->val);
 			lnode->val = 0;
 		}
 		ins = ins->next;
@@ -21146,74 +21688,91 @@ static void transform_to_arch_instructions(struct compile_state *state)
 }
 
 #if DEBUG_CONSISTENCY
-static void verify_uses(struct compile_state *state)
+static void verify_triple_uses(struct compile_state *state, struct triple *ins)
 {
-	struct triple *first, *ins;
 	struct triple_set *set;
-	first = state->first;
-	ins = first;
-	do {
-		struct triple **expr;
-		expr = triple_rhs(state, ins, 0);
-		for(; expr; expr = triple_rhs(state, ins, expr)) {
-			struct triple *rhs;
-			rhs = *expr;
-			for(set = rhs?rhs->use:0; set; set = set->next) {
-				if (set->member == ins) {
-					break;
-				}
+	struct triple **expr;
+	expr = triple_rhs(state, ins, 0);
+	for(; expr; expr = triple_rhs(state, ins, expr)) {
+		struct triple *rhs;
+		rhs = *expr;
+		for(set = rhs?rhs->use:0; set; set = set->next) {
+			if (set->member == ins) {
+				break;
 			}
-			if (!set) {
-				internal_error(state, ins, "rhs not used");
+		}
+		if (!set) {
+			internal_error(state, ins, "rhs not used");
+		}
+	}
+	expr = triple_lhs(state, ins, 0);
+	for(; expr; expr = triple_lhs(state, ins, expr)) {
+		struct triple *lhs;
+		lhs = *expr;
+		for(set =  lhs?lhs->use:0; set; set = set->next) {
+			if (set->member == ins) {
+				break;
 			}
 		}
-		expr = triple_lhs(state, ins, 0);
-		for(; expr; expr = triple_lhs(state, ins, expr)) {
-			struct triple *lhs;
-			lhs = *expr;
-			for(set =  lhs?lhs->use:0; set; set = set->next) {
+		if (!set) {
+			internal_error(state, ins, "lhs not used");
+		}
+	}
+	expr = triple_misc(state, ins, 0);
+	if (ins->op != OP_PHI) {
+		for(; expr; expr = triple_targ(state, ins, expr)) {
+			struct triple *misc;
+			misc = *expr;
+			for(set = misc?misc->use:0; set; set = set->next) {
 				if (set->member == ins) {
 					break;
 				}
 			}
 			if (!set) {
-				internal_error(state, ins, "lhs not used");
+				internal_error(state, ins, "misc not used");
 			}
 		}
-		expr = triple_misc(state, ins, 0);
-		if (ins->op != OP_PHI) {
-			for(; expr; expr = triple_targ(state, ins, expr)) {
-				struct triple *misc;
-				misc = *expr;
-				for(set = misc?misc->use:0; set; set = set->next) {
-					if (set->member == ins) {
-						break;
-					}
-				}
-				if (!set) {
-					internal_error(state, ins, "misc not used");
+	}
+	if (!triple_is_ret(state, ins)) {
+		expr = triple_targ(state, ins, 0);
+		for(; expr; expr = triple_targ(state, ins, expr)) {
+			struct triple *targ;
+			targ = *expr;
+			for(set = targ?targ->use:0; set; set = set->next) {
+				if (set->member == ins) {
+					break;
 				}
 			}
-		}
-		if (!triple_is_ret(state, ins)) {
-			expr = triple_targ(state, ins, 0);
-			for(; expr; expr = triple_targ(state, ins, expr)) {
-				struct triple *targ;
-				targ = *expr;
-				for(set = targ?targ->use:0; set; set = set->next) {
-					if (set->member == ins) {
-						break;
-					}
-				}
-				if (!set) {
-					internal_error(state, ins, "targ not used");
-				}
+			if (!set) {
+				internal_error(state, ins, "targ not used");
 			}
 		}
+	}
+}
+
+static void verify_uses(struct compile_state *state)
+{
+	struct triple *first, *ins;
+	first = state->first;
+	ins = first;
+	do {
+		verify_triple_uses(state, ins);
 		ins = ins->next;
 	} while(ins != first);
 
 }
+
+static void verify_triple_present(struct compile_state *state, struct triple *ins)
+{
+	valid_ins(state, ins);
+	if (triple_stores_block(state, ins)) {
+		if (!ins->u.block) {
+			internal_error(state, ins,
+				"%p not in a block?", ins);
+		}
+	}
+}
+
 static void verify_blocks_present(struct compile_state *state)
 {
 	struct triple *first, *ins;
@@ -21223,13 +21782,7 @@ static void verify_blocks_present(struct compile_state *state)
 	first = state->first;
 	ins = first;
 	do {
-		valid_ins(state, ins);
-		if (triple_stores_block(state, ins)) {
-			if (!ins->u.block) {
-				internal_error(state, ins,
-					"%p not in a block?", ins);
-			}
-		}
+		verify_triple_present(state, ins);
 		ins = ins->next;
 	} while(ins != first);
 
@@ -21338,10 +21891,55 @@ static void verify_blocks(struct compile_state *state)
 	}
 }
 
+static void verify_triple_domination(struct compile_state *state, struct triple *ins)
+{
+	struct triple_set *set;
+	for(set = ins->use; set; set = set->next) {
+		struct triple **slot;
+		struct triple *use_point;
+		int i, zrhs;
+		use_point = 0;
+		zrhs = set->member->rhs;
+		slot = &RHS(set->member, 0);
+		/* See if the use is on the right hand side */
+		for(i = 0; i < zrhs; i++) {
+			if (slot[i] == ins) {
+				break;
+			}
+		}
+		if (i < zrhs) {
+			use_point = set->member;
+			if (set->member->op == OP_PHI) {
+				struct block_set *bset;
+				int edge;
+				bset = set->member->u.block->use;
+				for(edge = 0; bset && (edge < i); edge++) {
+					bset = bset->next;
+				}
+				if (!bset) {
+					internal_error(state, set->member,
+						"no edge for phi rhs %d", i);
+				}
+				use_point = bset->member->last;
+			}
+		}
+		if (use_point &&
+			!tdominates(state, ins, use_point)) {
+			if (is_const(ins)) {
+				internal_warning(state, ins,
+				"non dominated rhs use point %p?", use_point);
+			}
+			else {
+				internal_error(state, ins,
+					"non dominated rhs use point %p?", use_point);
+			}
+		}
+	}
+}
+
 static void verify_domination(struct compile_state *state)
 {
 	struct triple *first, *ins;
-	struct triple_set *set;
 	if (!state->bb.first_block) {
 		return;
 	}
@@ -21349,100 +21947,70 @@ static void verify_domination(struct compile_state *state)
 	first = state->first;
 	ins = first;
 	do {
-		for(set = ins->use; set; set = set->next) {
-			struct triple **slot;
-			struct triple *use_point;
-			int i, zrhs;
-			use_point = 0;
-			zrhs = set->member->rhs;
-			slot = &RHS(set->member, 0);
-			/* See if the use is on the right hand side */
-			for(i = 0; i < zrhs; i++) {
-				if (slot[i] == ins) {
-					break;
-				}
-			}
-			if (i < zrhs) {
-				use_point = set->member;
-				if (set->member->op == OP_PHI) {
-					struct block_set *bset;
-					int edge;
-					bset = set->member->u.block->use;
-					for(edge = 0; bset && (edge < i); edge++) {
-						bset = bset->next;
-					}
-					if (!bset) {
-						internal_error(state, set->member,
-							"no edge for phi rhs %d", i);
-					}
-					use_point = bset->member->last;
-				}
-			}
-			if (use_point &&
-				!tdominates(state, ins, use_point)) {
-				if (is_const(ins)) {
-					internal_warning(state, ins,
-					"non dominated rhs use point %p?", use_point);
-				}
-				else {
-					internal_error(state, ins,
-						"non dominated rhs use point %p?", use_point);
-				}
-			}
-		}
+		verify_triple_domination(state, ins);
 		ins = ins->next;
 	} while(ins != first);
 }
 
+static void verify_triple_rhs(struct compile_state *state, struct triple *ins)
+{
+	struct triple **slot;
+	int zrhs, i;
+	zrhs = ins->rhs;
+	slot = &RHS(ins, 0);
+	for(i = 0; i < zrhs; i++) {
+		if (slot[i] == 0) {
+			internal_error(state, ins,
+				"missing rhs %d on %s",
+				i, tops(ins->op));
+		}
+		if ((ins->op != OP_PHI) && (slot[i] == ins)) {
+			internal_error(state, ins,
+				"ins == rhs[%d] on %s",
+				i, tops(ins->op));
+		}
+	}
+}
+
 static void verify_rhs(struct compile_state *state)
 {
 	struct triple *first, *ins;
 	first = state->first;
 	ins = first;
 	do {
-		struct triple **slot;
-		int zrhs, i;
-		zrhs = ins->rhs;
-		slot = &RHS(ins, 0);
-		for(i = 0; i < zrhs; i++) {
-			if (slot[i] == 0) {
-				internal_error(state, ins,
-					"missing rhs %d on %s",
-					i, tops(ins->op));
-			}
-			if ((ins->op != OP_PHI) && (slot[i] == ins)) {
-				internal_error(state, ins,
-					"ins == rhs[%d] on %s",
-					i, tops(ins->op));
-			}
-		}
+		verify_triple_rhs(state, ins);
 		ins = ins->next;
 	} while(ins != first);
 }
 
+static void verify_triple_piece(struct compile_state *state, struct triple *ins)
+{
+	struct triple *ptr;
+	int lhs, i;
+	lhs = ins->lhs;
+	for(ptr = ins->next, i = 0; i < lhs; i++, ptr = ptr->next) {
+		if (ptr != LHS(ins, i)) {
+			internal_error(state, ins, "malformed lhs on %s",
+				tops(ins->op));
+		}
+		if (ptr->op != OP_PIECE) {
+			internal_error(state, ins, "bad lhs op %s at %d on %s",
+				tops(ptr->op), i, tops(ins->op));
+		}
+		if (ptr->u.cval != i) {
+			internal_error(state, ins, "bad u.cval of %d %d expected",
+				ptr->u.cval, i);
+		}
+	}
+}
+
 static void verify_piece(struct compile_state *state)
 {
 	struct triple *first, *ins;
 	first = state->first;
 	ins = first;
 	do {
-		struct triple *ptr;
-		int lhs, i;
-		lhs = ins->lhs;
-		for(ptr = ins->next, i = 0; i < lhs; i++, ptr = ptr->next) {
-			if (ptr != LHS(ins, i)) {
-				internal_error(state, ins, "malformed lhs on %s",
-					tops(ins->op));
-			}
-			if (ptr->op != OP_PIECE) {
-				internal_error(state, ins, "bad lhs op %s at %d on %s",
-					tops(ptr->op), i, tops(ins->op));
-			}
-			if (ptr->u.cval != i) {
-				internal_error(state, ins, "bad u.cval of %d %d expected",
-					ptr->u.cval, i);
-			}
-		}
+		verify_triple_piece(state, ins);
 		ins = ins->next;
 	} while(ins != first);
 }
@@ -21458,9 +22026,8 @@ static void verify_ins_colors(struct compile_state *state)
 	} while(ins != first);
 }
 
-static void verify_unknown(struct compile_state *state)
+static void verify_unknown_globals(struct compile_state *state)
 {
-	struct triple *first, *ins;
 	if (	(unknown_triple.next != &unknown_triple) ||
 		(unknown_triple.prev != &unknown_triple) ||
 #if 0
@@ -21489,19 +22056,30 @@ static void verify_unknown(struct compile_state *state)
 	if (	(unknown_type.type != TYPE_UNKNOWN)) {
 		internal_error(state, &unknown_triple, "unknown_type corrupted!");
 	}
+}
+
+static void verify_triple_unknown(struct compile_state *state, struct triple *ins)
+{
+	int params, i;
+	if (ins == &unknown_triple) {
+		internal_error(state, ins, "unknown triple in list");
+	}
+	params = TRIPLE_SIZE(ins);
+	for(i = 0; i < params; i++) {
+		if (ins->param[i] == &unknown_triple) {
+			internal_error(state, ins, "unknown triple used!");
+		}
+	}
+}
+
+static void verify_unknown(struct compile_state *state)
+{
+	struct triple *first, *ins;
+	verify_unknown_globals(state);
 	first = state->first;
 	ins = first;
 	do {
-		int params, i;
-		if (ins == &unknown_triple) {
-			internal_error(state, ins, "unknown triple in list");
-		}
-		params = TRIPLE_SIZE(ins);
-		for(i = 0; i < params; i++) {
-			if (ins->param[i] == &unknown_triple) {
-				internal_error(state, ins, "unknown triple used!");
-			}
-		}
+		verify_triple_unknown(state, ins);
 		ins = ins->next;
 	} while(ins != first);
 }
@@ -21527,6 +22105,23 @@ static void verify_types(struct compile_state *state)
 	} while(ins != first);
 }
 
+static void verify_triple_copy(struct compile_state *state, struct triple *ins)
+{
+	if (ins->op != OP_COPY) {
+		return;
+	}
+	if (!equiv_types(ins->type, RHS(ins, 0)->type)) {
+		FILE *fp = state->errout;
+		fprintf(fp, "src type: ");
+		name_of(fp, RHS(ins, 0)->type);
+		fprintf(fp, "\n");
+		fprintf(fp, "dst type: ");
+		name_of(fp, ins->type);
+		fprintf(fp, "\n");
+		internal_error(state, ins, "type mismatch in copy");
+	}
+}
+
 static void verify_copy(struct compile_state *state)
 {
 	struct triple *first, *ins, *next;
@@ -21535,23 +22130,11 @@ static void verify_copy(struct compile_state *state)
 	do {
 		ins = next;
 		next = ins->next;
-		if (ins->op != OP_COPY) {
-			continue;
-		}
-		if (!equiv_types(ins->type, RHS(ins, 0)->type)) {
-			FILE *fp = state->errout;
-			fprintf(fp, "src type: ");
-			name_of(fp, RHS(ins, 0)->type);
-			fprintf(fp, "\n");
-			fprintf(fp, "dst type: ");
-			name_of(fp, ins->type);
-			fprintf(fp, "\n");
-			internal_error(state, ins, "type mismatch in copy");
-		}
+		verify_triple_copy(state, ins);
 	} while(next != first);
 }
 
-static void verify_consistency(struct compile_state *state)
+static void verify_consistency_serial(struct compile_state *state)
 {
 	verify_unknown(state);
 	verify_uses(state);
@@ -21563,6 +22146,191 @@ static void verify_consistency(struct compile_state *state)
 	verify_ins_colors(state);
 	verify_types(state);
 	verify_copy(state);
+}
+
+/* Parallel verification.
+ *
+ * With -fthreads=N the per triple checks run over slices of the
+ * instruction list on the worker threads.  A worker that trips over
+ * a problem does not report it, it only marks its slice as failed;
+ * the whole battery is then rerun serially so the diagnostics are
+ * exactly the ones a single threaded run prints.
+ *
+ * Only the checks are threaded.  join_functions() folds every function
+ * into one instruction list before optimize() runs, and the use lists,
+ * triple ids and the pool allocator are shared by the whole program,
+ * so ssa construction and simplification cannot be split per function.
+ */
+#define VERIFY_SLICE_SIZE 2048
+
+struct verify_slice {
+	struct triple *first;
+	struct triple *last;
+	int failed;
+};
+
+struct verify_work {
+	struct compile_state *state;
+	struct verify_slice *slices;
+	FILE *sink;
+};
+
+static void verify_slice_job(void *arg, int job)
+{
+	struct verify_work *work = arg;
+	struct verify_slice *slice;
+	struct compile_state local;
+	jmp_buf env;
+	struct triple *ins;
+	slice = &work->slices[job];
+	local = *work->state;
+	local.errout = work->sink;
+	local.dbgout = work->sink;
+	local.verify_jmp = &env;
+	if (setjmp(env)) {
+		slice->failed = 1;
+		return;
+	}
+	ins = slice->first;
+	for(;;) {
+		verify_triple_unknown(&local, ins);
+		verify_triple_uses(&local, ins);
+		if (local.bb.first_block) {
+			verify_triple_present(&local, ins);
+			verify_triple_domination(&local, ins);
+		}
+		verify_triple_rhs(&local, ins);
+		verify_triple_piece(&local, ins);
+		verify_triple_copy(&local, ins);
+		if (ins == slice->last) {
+			break;
+		}
+		ins = ins->next;
+	}
+}
+
+static int verify_consistency_parallel(struct compile_state *state)
+{
+	static FILE *sink;
+	struct verify_work work;
+	struct triple *first, *ins;
+	size_t count, slices, i;
+	int failed;
+
+	if (!sink) {
+		sink = tmpfile();
+		if (!sink) {
+			return 0;
+		}
+	}
+	first = state->first;
+	count = 0;
+	ins = first;
+	do {
+		count++;
+		ins = ins->next;
+	} while(ins != first);
+	slices = (count + VERIFY_SLICE_SIZE - 1)/VERIFY_SLICE_SIZE;
+	if (slices < 2) {
+		return 0;
+	}
+
+	work.state  = state;
+	work.sink   = sink;
+	work.slices = xcmalloc(sizeof(*work.slices)*slices, "verify_slices");
+	ins = first;
+	for(i = 0; i < slices; i++) {
+		size_t j;
+		work.slices[i].first = ins;
+		for(j = 1; (j < VERIFY_SLICE_SIZE) && (ins->next != first); j++) {
+			ins = ins->next;
+		}
+		work.slices[i].last = ins;
+		ins = ins->next;
+	}
+
+	verify_unknown_globals(state);
+	work_pool_run(verify_slice_job, &work, slices);
+
+	failed = 0;
+	for(i = 0; i < slices; i++) {
+		failed |= work.slices[i].failed;
+	}
+	xfree(work.slices);
+	if (failed) {
+		return 0;
+	}
+	/* The checks that walk the blocks rather than the triples */
+	verify_blocks(state);
+	verify_types(state);
+	return 1;
+}
+
+/* Incremental verification.
+ *
+ * use_triple() and unuse_triple() mark both ends of every use they
+ * add or remove as dirty, and any change to a block edge marks the
+ * CFG dirty.  With -fverify=cheap only the per triple checks of dirty
+ * triples are rerun, plus the block checks if the CFG changed.
+ * Instructions that were only moved, or whose block's dominator
+ * changed, are not rechecked until -fverify=full.
+ */
+static void verify_dirty_triples(struct compile_state *state)
+{
+	struct triple *first, *ins;
+	first = state->first;
+	ins = first;
+	do {
+		if (ins->dirty) {
+			ins->dirty = 0;
+			verify_triple_unknown(state, ins);
+			verify_triple_uses(state, ins);
+			if (state->bb.first_block) {
+				verify_triple_present(state, ins);
+				verify_triple_domination(state, ins);
+			}
+			verify_triple_rhs(state, ins);
+			verify_triple_piece(state, ins);
+			verify_triple_copy(state, ins);
+		}
+		ins = ins->next;
+	} while(ins != first);
+	verify_types(state);
+}
+
+static void clear_dirty_triples(struct compile_state *state)
+{
+	struct triple *first, *ins;
+	first = state->first;
+	ins = first;
+	do {
+		ins->dirty = 0;
+		ins = ins->next;
+	} while(ins != first);
+}
+
+static void verify_consistency(struct compile_state *state)
+{
+	unsigned long level;
+	level = state->compiler->flags & COMPILER_VERIFY_MASK;
+	if (level == COMPILER_VERIFY_OFF) {
+		return;
+	}
+	if (level == COMPILER_VERIFY_CHEAP) {
+		verify_unknown_globals(state);
+		if (cfg_dirty) {
+			verify_blocks(state);
+		}
+		verify_dirty_triples(state);
+	}
+	else {
+		if ((work_pool.thread_count == 0) ||
+			!verify_consistency_parallel(state)) {
+			verify_consistency_serial(state);
+		}
+		clear_dirty_triples(state);
+	}
+	cfg_dirty = 0;
 	if (state->compiler->debug & DEBUG_VERIFICATION) {
 		fprintf(state->dbgout, "consistency verified\n");
 	}
@@ -21571,6 +22339,76 @@ static void verify_consistency(struct compile_state *state)
 static void verify_consistency(struct compile_state *state) {}
 #endif /* DEBUG_CONSISTENCY */
 
+/* Per phase statistics for -ftime-report.
+ *
+ * The intermediate code lives from parsing to code generation and every
+ * phase rewrites it in place, so the pool cannot be reset between phases
+ * and its arena only grows.  Report how much of it is live and how much
+ * is reserved when each phase ends instead of a per phase peak.
+ */
+#define MAX_REPORT_PHASES 16
+struct phase_report {
+	const char *name;
+	clock_t ticks;
+	size_t in_use;
+	size_t arena_bytes;
+};
+static struct phase_report phase_reports[MAX_REPORT_PHASES];
+static int phase_report_count;
+static clock_t phase_start;
+
+static void end_phase(struct compile_state *state, const char *name)
+{
+	struct phase_report *report;
+	clock_t now;
+	int i;
+	now = clock();
+	report = 0;
+	for(i = 0; i < phase_report_count; i++) {
+		if (strcmp(phase_reports[i].name, name) == 0) {
+			report = &phase_reports[i];
+			break;
+		}
+	}
+	if (!report) {
+		if (phase_report_count >= MAX_REPORT_PHASES) {
+			internal_error(state, 0, "too many phases");
+		}
+		report = &phase_reports[phase_report_count++];
+		report->name = name;
+	}
+	report->ticks += now - phase_start;
+	report->in_use = pool.in_use;
+	report->arena_bytes = pool.arena_bytes;
+	phase_start = clock();
+}
+
+static void print_time_report(struct compile_state *state)
+{
+	clock_t total;
+	int i;
+	if (!(state->compiler->flags & COMPILER_TIME_REPORT)) {
+		return;
+	}
+	total = 0;
+	fprintf(state->errout, "\nExecution times (seconds) and pool memory "
+		"live/reserved at the end of each phase\n");
+	for(i = 0; i < phase_report_count; i++) {
+		struct phase_report *report = &phase_reports[i];
+		total += report->ticks;
+		fprintf(state->errout, " %-24s: %8.2f %8lu kB %8lu kB\n",
+			report->name,
+			(double)report->ticks / CLOCKS_PER_SEC,
+			(unsigned long)(report->in_use / 1024),
+			(unsigned long)(report->arena_bytes / 1024));
+	}
+	fprintf(state->errout, " %-24s: %8.2f %8lu kB %8lu kB\n",
+		"TOTAL",
+		(double)total / CLOCKS_PER_SEC,
+		(unsigned long)(pool.peak / 1024),
+		(unsigned long)(pool.arena_bytes / 1024));
+}
+
 static void optimize(struct compile_state *state)
 {
 	/* Join all of the functions into one giant function */
@@ -21584,6 +22422,7 @@ static void optimize(struct compile_state *state)
 	print_triples(state);
 
 	verify_consistency(state);
+	end_phase(state, "decompose");
 	/* Analyze the intermediate code */
 	state->bb.first = state->first;
 	analyze_basic_blocks(state, &state->bb);
@@ -21599,17 +22438,21 @@ static void optimize(struct compile_state *state)
 	 */
 	transform_to_ssa_form(state);
 	verify_consistency(state);
+	end_phase(state, "ssa form");
 
 	/* Remove dead code */
 	eliminate_inefectual_code(state);
 	verify_consistency(state);
+	end_phase(state, "dead code elimination");
 
 	/* Do strength reduction and simple constant optimizations */
 	simplify_all(state);
 	verify_consistency(state);
+	end_phase(state, "simplify");
 	/* Propogate constants throughout the code */
 	scc_transform(state);
 	verify_consistency(state);
+	end_phase(state, "scc transform");
 #if DEBUG_ROMCC_WARNINGS
 #warning "WISHLIST implement single use constants (least possible register pressure)"
 #warning "WISHLIST implement induction variable elimination"
@@ -21619,10 +22462,12 @@ static void optimize(struct compile_state *state)
 	 */
 	transform_to_arch_instructions(state);
 	verify_consistency(state);
+	end_phase(state, "instruction selection");
 
 	/* Remove dead code */
 	eliminate_inefectual_code(state);
 	verify_consistency(state);
+	end_phase(state, "dead code elimination");
 
 	/* Color all of the variables to see if they will fit in registers */
 	insert_copies_to_phi(state);
@@ -21630,9 +22475,11 @@ static void optimize(struct compile_state *state)
 
 	insert_mandatory_copies(state);
 	verify_consistency(state);
+	end_phase(state, "insert copies");
 
 	allocate_registers(state);
 	verify_consistency(state);
+	end_phase(state, "register allocation");
 
 	/* Remove the optimization information.
 	 * This is more to check for memory consistency than to free memory.
@@ -24965,6 +25812,9 @@ static void compile(const char *filename,
 	exit_state = &state;
 	atexit(exit_cleanup);
 
+	phase_start = clock();
+	work_pool_init(state.compiler->threads);
+
 	/* Prep the preprocessor */
 	state.if_depth = 0;
 	memset(state.if_bytes, 0, sizeof(state.if_bytes));
@@ -25032,6 +25882,7 @@ static void compile(const char *filename,
 
 	/* Exit the global definition scope */
 	end_scope(&state);
+	end_phase(&state, "parse");
 
 	/* Now that basic compilation has happened
 	 * optimize the intermediate code
@@ -25039,10 +25890,14 @@ static void compile(const char *filename,
 	optimize(&state);
 
 	generate_code(&state);
+	end_phase(&state, "code generation");
+	print_time_report(&state);
 	if (state.compiler->debug) {
 		fprintf(state.errout, "done\n");
 	}
 	exit_state = 0;
+	work_pool_release();
+	pool_release();
 }
 
 static void version(FILE *fp)
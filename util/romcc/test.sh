@@ -48,6 +48,7 @@ usage () {
 	echo "  all     - all tests"
 	echo "  simple  - simple tests"
 	echo "  linux   - linux programs whose output is checked against a reference"
+	echo "  bench   - time and peak memory of compiling every test with -O2"
 	echo ""
 	echo "--nocolor disables colors."
 	exit 1
@@ -196,6 +197,23 @@ run_linux_tests() {
 	echo
 }
 
+run_benchmarks() {
+	echo "Running benchmarks..."
+
+	local t
+	for t in $(find "$BASEDIR/tests" -name 'simple_test*.c' -o \
+			-name 'linux_test*.c' -o -name 'raminit_test*.c' | sort); do
+		printf "%-24s" "$(basename "$t")"
+		timeout 600 "$ROMCC" -O2 -ftime-report "$t" \
+				-o "$BUILDDIR/dummy.S" 2>&1 |
+			awk '/^ TOTAL/ { time = $3; mem = $4 }
+			     END { if (time == "") print "failed";
+				   else printf "%8ss %8s kB\n", time, mem }'
+	done
+
+	echo
+}
+
 
 if [ $# -ne 1 ]; then
 	usage
@@ -220,6 +238,10 @@ case "$CLASS" in
 		run_linux_tests
 		show_stats
 		;;
+	bench)
+		init_testing
+		run_benchmarks
+		;;
 	*)
 		echo "Invalid test class $CLASS"
 		echo